@@ -2,7 +2,11 @@
 
 #include "App.xaml.h"
 #include "MainWindow.xaml.h"
+#include "TestPage1.xaml.h"
 
+#include "../Shared1/FlightRecorder.h"
+#include "../Shared1/LogQueue.h"
+#include "../Shared1/TextConvert.h"
 #include "SettingsViewModel.h"
 
 #include <source_location>
@@ -15,39 +19,87 @@ using namespace std::placeholders;
 using namespace Windows::Foundation;
 using namespace Microsoft::UI::Xaml::Controls;
 using namespace Microsoft::UI::Xaml::Navigation;
+using Microsoft::Windows::System::Power::PowerManager;
+using Microsoft::Windows::System::Power::SystemSuspendStatus;
 
 App::App() noexcept(false) {
+    // read the settings while XAML is initialized. The defaults are used until the load is done
+    provider.Settings(winrt::make<implementation::SettingsViewModel>());
+    provider.Settings().LoadAsync();
+    // the pipelines are compiled with the cached blobs before the first TestPage1
+    TestPage1::prewarm_pipelines();
     InitializeComponent();
-#if defined _DEBUG && !defined DISABLE_XAML_GENERATED_BREAK_ON_UNHANDLED_EXCEPTION
+    // the release build also needs the flight recorder's dump
     UnhandledException({this, &App::OnUnhandledException});
-#endif
-    provider.Settings(winrt::make<implementation::SettingsViewModel>());
+}
+
+/// @return elapsed time since the creation of the process
+static std::chrono::milliseconds get_process_uptime() noexcept {
+    FILETIME creation{}, exit{}, kernel{}, user{}, now{};
+    if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user) == FALSE)
+        return {};
+    GetSystemTimeAsFileTime(&now);
+    auto to_ticks = [](const FILETIME& time) {
+        return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::duration<uint64_t, std::ratio<1, 10'000'000>>{to_ticks(now) - to_ticks(creation)});
 }
 
 App::~App() noexcept {
+    if (suspend_token)
+        PowerManager::SystemSuspendStatusChanged(suspend_token);
     clear_settings_event();
 }
 
 void App::OnUnhandledException(IInspectable const&, UnhandledExceptionEventArgs const& e) {
     winrt::hstring txt = e.Message();
+    spdlog::critical("App: {:s}", txt);
+    if (auto path = dump_flight_recorder("crash"); path.empty() == false)
+        spdlog::critical("App: flight recorder - {}", Utf8Text{path.native()});
     if (IsDebuggerPresent())
         __debugbreak();
-    spdlog::critical(L"App: {:s}", static_cast<std::wstring_view>(txt));
 }
 
 void App::OnLaunched(LaunchActivatedEventArgs const&) {
     spdlog::info("App: {:s}", std::source_location::current().function_name());
     // note: the App will be the first which receives the events
-    settings_changed_token = provider.Settings().PropertyChanged({this, &App::on_settings_changed});
+    settings_changed_token = provider.Settings().Changed({this, &App::on_settings_changed});
     auto w = winrt::make<implementation::MainWindow>();
     w.Provider(provider);
     window = w;
+    window.Closed({this, &App::on_window_closed});
+    suspend_token = PowerManager::SystemSuspendStatusChanged({this, &App::on_suspend_status_changed});
     window.Activate();
+    spdlog::info("App: first window in {} ms", get_process_uptime().count());
+}
+
+void App::on_window_closed(IInspectable const&, WindowEventArgs const&) {
+    flush_settings();
+    TestPage1::save_pipelines();
+}
+
+void App::on_suspend_status_changed(IInspectable const&, IInspectable const&) {
+    if (PowerManager::SystemSuspendStatus() != SystemSuspendStatus::Entering)
+        return;
+    flush_settings();
+    TestPage1::save_pipelines();
+}
+
+void App::flush_settings() noexcept {
+    auto settings = provider.Settings();
+    if (settings == nullptr)
+        return;
+    settings.Flush();
+    const auto stats = winrt::get_self<implementation::SettingsViewModel>(settings)->WriterStats();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(stats.writeTime);
+    spdlog::info("App: settings {} changes, {} writes, {} failures, {} retries, {} us in the writes", stats.changes,
+                 stats.writes, stats.failures, stats.retries, elapsed.count());
 }
 
-void App::on_settings_changed(IInspectable const&, PropertyChangedEventArgs const& e) {
+void App::on_settings_changed(App1::SettingsViewModel const&, App1::SettingsProperties changed) {
     // ... reserved section. nothing to do for now ...
-    spdlog::debug(L"App: changed - {}", e.PropertyName());
+    spdlog::debug("App: changed - {:#x}", static_cast<uint32_t>(changed));
 }
 
 void App::clear_settings_event() noexcept {
@@ -55,7 +107,7 @@ void App::clear_settings_event() noexcept {
     if (viewmodel == nullptr)
         return;
     if (settings_changed_token) {
-        viewmodel.PropertyChanged(settings_changed_token);
+        viewmodel.Changed(settings_changed_token);
         settings_changed_token = {};
     }
 }
@@ -76,13 +128,21 @@ int WINAPI wWinMain(HINSTANCE, HINSTANCE, PWSTR, int) {
     }
 
     // setup the logger and print the current executable's path
-    winrt::App1::set_log_stream("App");
+    // the UI thread must not wait for the console. When its queue is full, the oldest messages are discarded
+    winrt::App1::set_log_stream("App1.Core", winrt::App1::OverflowPolicy::DropOldest, 1024);
     auto exe = winrt::App1::get_module_path();
-    spdlog::debug(L"{}", exe.native());
+    spdlog::debug("{}", winrt::App1::Utf8Text{exe.native()});
+    // the rate limited call sites report what they have dropped
+    using winrt::Windows::System::Threading::ThreadPoolTimer;
+    auto summary = ThreadPoolTimer::CreatePeriodicTimer([](auto&&) { winrt::App1::log_suppressed_counts(); },
+                                                        std::chrono::seconds{10});
 
     winrt::Microsoft::UI::Xaml::Application::Start([](auto&&) {
         // ... start the application lifecycle ...
         winrt::make<winrt::App1::implementation::App>();
     });
+    summary.Cancel();
+    winrt::App1::log_suppressed_counts();
+    winrt::App1::log_channel_counters();
     return S_OK;
 }
\ No newline at end of file
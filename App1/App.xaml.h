@@ -6,7 +6,7 @@ namespace winrt::App1::implementation {
 using Microsoft::UI::Xaml::LaunchActivatedEventArgs;
 using Microsoft::UI::Xaml::UnhandledExceptionEventArgs;
 using Microsoft::UI::Xaml::Window;
-using Microsoft::UI::Xaml::Data::PropertyChangedEventArgs;
+using Microsoft::UI::Xaml::WindowEventArgs;
 using Windows::Foundation::IInspectable;
 
 struct App : AppT<App> {
@@ -14,6 +14,7 @@ struct App : AppT<App> {
     Window window = nullptr;
     App1::ViewModelProvider provider{};
     winrt::event_token settings_changed_token{};
+    winrt::event_token suspend_token{};
 
   public:
     App() noexcept(false);
@@ -22,8 +23,12 @@ struct App : AppT<App> {
     void OnLaunched(LaunchActivatedEventArgs const&);
     void OnUnhandledException(IInspectable const&, UnhandledExceptionEventArgs const&);
 
-    void on_settings_changed(IInspectable const&, PropertyChangedEventArgs const&);
+    void on_settings_changed(App1::SettingsViewModel const&, App1::SettingsProperties changed);
     void clear_settings_event() noexcept;
+    void on_window_closed(IInspectable const&, WindowEventArgs const&);
+    void on_suspend_status_changed(IInspectable const&, IInspectable const&);
+    /// @brief Write the pending settings before the process stops
+    void flush_settings() noexcept;
 };
 
 } // namespace winrt::App1::implementation
@@ -8,6 +8,10 @@
 #include "SupportPage.xaml.h"
 #include "TestPage1.xaml.h"
 
+#include "../Shared1/FlightRecorder.h"
+#include "../Shared1/FormatBuffer.h"
+#include "../Shared1/LogLimit.h"
+
 #include <microsoft.ui.xaml.window.h>
 #include <spdlog/spdlog.h>
 
@@ -16,7 +20,8 @@ namespace winrt::App1::implementation {
 /// @see https://learn.microsoft.com/pl-pl/windows/apps/design/controls/navigationview
 MainWindow::MainWindow() noexcept(false) {
     ExtendsContentIntoTitleBar(true);
-    spdlog::info("HWND {:p}", reinterpret_cast<void*>(WindowHandle()));
+    log_buffered(*spdlog::default_logger_raw(), spdlog::level::info, "HWND {:p}",
+                 reinterpret_cast<void*>(WindowHandle()));
 }
 
 MainWindow::~MainWindow() noexcept {
@@ -24,12 +29,12 @@ MainWindow::~MainWindow() noexcept {
 }
 
 void MainWindow::clear_settings_event() noexcept {
-    // Disconnect from SettingsViewModel property changes
+    // Disconnect from SettingsViewModel changes
     auto viewmodel = Settings();
     if (viewmodel == nullptr)
         return;
     if (settings_changed_token) {
-        viewmodel.PropertyChanged(settings_changed_token);
+        viewmodel.Changed(settings_changed_token);
         settings_changed_token = {};
     }
 }
@@ -43,7 +48,7 @@ void MainWindow::Provider(App1::ViewModelProvider value) noexcept(false) {
         throw winrt::hresult_invalid_argument(L"ViewModelProvider cannot be null");
     provider = value;
     if (auto settings = provider.Settings(); settings != nullptr)
-        settings_changed_token = settings.PropertyChanged({this, &MainWindow::on_settings_changed});
+        settings_changed_token = settings.Changed({this, &MainWindow::on_settings_changed});
 }
 
 App1::SettingsViewModel MainWindow::Settings() const noexcept {
@@ -53,8 +58,8 @@ App1::SettingsViewModel MainWindow::Settings() const noexcept {
     return p.Settings();
 }
 
-void MainWindow::on_settings_changed(IInspectable const&, PropertyChangedEventArgs const& e) {
-    if (e.PropertyName() == L"Counter") {
+void MainWindow::on_settings_changed(App1::SettingsViewModel const&, App1::SettingsProperties changed) {
+    if ((changed & App1::SettingsProperties::Counter) == App1::SettingsProperties::Counter) {
         // ... nothing to do for now ...
     }
 }
@@ -69,12 +74,16 @@ uint64_t MainWindow::WindowHandle() const noexcept {
 }
 
 void MainWindow::on_window_size_changed(IInspectable const&, WindowSizeChangedEventArgs const& e) {
+    // the event is raised for each step of the resize
     auto s = e.Size();
-    spdlog::info("{}: size ({:.2f},{:.2f})", "MainWindow", s.Width, s.Height);
+    // every step is in the flight recorder with the raw values. Only the text is rate limited
+    FLIGHT_RECORD(BinaryLogLevel::Debug, "MainWindow: size ({:.2f},{:.2f})", s.Width, s.Height);
+    LOG_RATE_LIMITED(spdlog::default_logger_raw(), spdlog::level::info, 2, 4, "{}: size ({:.2f},{:.2f})", "MainWindow",
+                     s.Width, s.Height);
 }
 
 void MainWindow::on_window_visibility_changed(IInspectable const&, WindowVisibilityChangedEventArgs const& e) {
-    spdlog::info("{}: visibility {}", "MainWindow", e.Visible());
+    log_buffered(*spdlog::default_logger_raw(), spdlog::level::info, "{}: visibility {}", "MainWindow", e.Visible());
 }
 
 /// @see https://learn.microsoft.com/en-us/uwp/api/windows.ui.xaml.controls.frame.navigate
@@ -17,7 +17,6 @@ using Microsoft::UI::Xaml::Controls::NavigationViewBackRequestedEventArgs;
 using Microsoft::UI::Xaml::Controls::NavigationViewItem;
 using Microsoft::UI::Xaml::Controls::NavigationViewItemInvokedEventArgs;
 using Microsoft::UI::Xaml::Controls::Page;
-using Microsoft::UI::Xaml::Data::PropertyChangedEventArgs;
 using Windows::Foundation::IAsyncAction;
 using Windows::Foundation::IInspectable;
 
@@ -42,7 +41,7 @@ struct MainWindow : MainWindowT<MainWindow> {
     void on_window_visibility_changed(IInspectable const& sender, WindowVisibilityChangedEventArgs const& e);
     void on_item_invoked(NavigationView const&, NavigationViewItemInvokedEventArgs const&);
     void on_back_requested(NavigationView const&, NavigationViewBackRequestedEventArgs const&);
-    void on_settings_changed(IInspectable const&, PropertyChangedEventArgs const&);
+    void on_settings_changed(App1::SettingsViewModel const&, App1::SettingsProperties changed);
     void clear_settings_event() noexcept;
 };
 
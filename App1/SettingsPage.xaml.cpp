@@ -26,15 +26,15 @@ void SettingsPage::OnNavigatedTo(const NavigationEventArgs& e) {
     // Get the ViewModel from the navigation parameter. Ensure ViewModel is always valid
     setup_viewmodels(e.Parameter());
 
-    // Connect to property changed events
-    settings_changed_token = ViewModel().PropertyChanged({this, &SettingsPage::on_settings_property_changed});
+    // Connect to the settings changes. Raised once for many properties
+    settings_changed_token = ViewModel().Changed({this, &SettingsPage::on_settings_changed});
     UpdateCounterDisplay();
 }
 
 void SettingsPage::OnNavigatedFrom(const NavigationEventArgs&) {
-    // Disconnect from property changed events
+    // Disconnect from the settings changes
     if (settings_changed_token) {
-        viewmodel0.PropertyChanged(settings_changed_token);
+        viewmodel0.Changed(settings_changed_token);
         settings_changed_token = {};
     }
     viewmodel0 = nullptr;
@@ -44,8 +44,8 @@ void SettingsPage::UpdateCounterDisplay() {
     CounterTextBlock().Text(winrt::to_hstring(ViewModel().Counter()));
 }
 
-void SettingsPage::on_settings_property_changed(IInspectable const&, PropertyChangedEventArgs const& e) {
-    if (e.PropertyName() == L"Counter") {
+void SettingsPage::on_settings_changed(App1::SettingsViewModel const&, App1::SettingsProperties changed) {
+    if ((changed & App1::SettingsProperties::Counter) == App1::SettingsProperties::Counter) {
         UpdateCounterDisplay();
     }
 }
@@ -5,8 +5,6 @@
 
 namespace winrt::App1::implementation {
 using Microsoft::UI::Xaml::RoutedEventArgs;
-using Microsoft::UI::Xaml::Data::PropertyChangedEventArgs;
-using Microsoft::UI::Xaml::Data::PropertyChangedEventHandler;
 using Microsoft::UI::Xaml::Navigation::NavigationEventArgs;
 using Windows::Foundation::IInspectable;
 
@@ -16,7 +14,7 @@ struct SettingsPage : SettingsPageT<SettingsPage> {
     winrt::event_token settings_changed_token{};
 
     void UpdateCounterDisplay();
-    void on_settings_property_changed(IInspectable const& sender, PropertyChangedEventArgs const& e);
+    void on_settings_changed(App1::SettingsViewModel const& sender, App1::SettingsProperties changed);
 
   public:
     SettingsPage() noexcept = default;
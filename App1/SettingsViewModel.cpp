@@ -8,63 +8,201 @@
 #define SPDLOG_WCHAR_TO_UTF8_SUPPORT
 #include <spdlog/spdlog.h>
 
+#include "../Shared1/FormatBuffer.h"
+#include "../Shared1/LogCounterSink.h"
+#include "../Shared1/TextConvert.h"
+
+#include <cstring>
+#include <utility>
+
 namespace winrt::App1::implementation {
 using namespace winrt::Microsoft::UI::Xaml::Data;
+using Windows::Foundation::IPropertyValue;
+using Windows::Foundation::PropertyType;
+using Windows::Foundation::PropertyValue;
 
-SettingsViewModel::SettingsViewModel() noexcept {
-    LoadSettings();
+/// @brief The load and the save are in the Persistence channel
+static std::shared_ptr<spdlog::logger> get_logger() noexcept(false) {
+    return App1::get_channel_logger(App1::LogChannel::Persistence);
 }
 
-ApplicationDataContainer SettingsViewModel::GetLocalSettings() noexcept(false) {
-    return ApplicationData::Current().LocalSettings();
+static_assert(settings::Schema::bit<settings::counter>() == static_cast<uint32_t>(App1::SettingsProperties::Counter));
+static_assert(settings::Schema::size() <= 32, "SettingsProperties has 32 bits");
+
+/**
+ * @brief The settings in ApplicationData.LocalSettings. The values are UInt8 arrays
+ * @note The scalar values of the older versions are read when their sizes match
+ */
+struct LocalSettingsBackend final : App1::SettingsBackend {
+    ApplicationDataContainer container;
+
+    explicit LocalSettingsBackend(ApplicationDataContainer container) noexcept : container{std::move(container)} {
+    }
+
+    bool read(const App1::SettingsKey& key, std::span<std::byte> value) const noexcept(false) override {
+        auto property = container.Values().TryLookup(winrt::to_hstring(key.name)).try_as<IPropertyValue>();
+        if (property == nullptr)
+            return false;
+        switch (property.Type()) {
+        case PropertyType::UInt8Array: {
+            winrt::com_array<uint8_t> bytes{};
+            property.GetUInt8Array(bytes);
+            if (bytes.size() != value.size())
+                return false;
+            std::memcpy(value.data(), bytes.data(), bytes.size());
+            return true;
+        }
+        case PropertyType::UInt32: {
+            const uint32_t scalar = property.GetUInt32();
+            if (value.size() != sizeof(scalar))
+                return false;
+            std::memcpy(value.data(), &scalar, sizeof(scalar));
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    void write(const App1::SettingsKey& key, std::span<const std::byte> value) noexcept(false) override {
+        const auto bytes = reinterpret_cast<const uint8_t*>(value.data());
+        container.Values().Insert(winrt::to_hstring(key.name),
+                                  PropertyValue::CreateUInt8Array({bytes, static_cast<uint32_t>(value.size())}));
+    }
+
+    void commit() noexcept(false) override {
+        // LocalSettings persists each write
+    }
+};
+
+std::shared_ptr<App1::SettingsBackend> SettingsViewModel::MakeBackend() noexcept(false) {
+    const std::filesystem::path folder{std::wstring_view{ApplicationData::Current().LocalFolder().Path()}};
+    // the journal is compacted to settings.bin. The file of the older versions is the snapshot
+    auto store = std::make_shared<App1::JournaledSettingsStore>(folder / "settings.bin");
+    if (store->empty() == false)
+        return store;
+    // the first run after the update. Move the values in LocalSettings
+    try {
+        LocalSettingsBackend legacy{ApplicationData::Current().LocalSettings()};
+        if (auto value = legacy.get<uint32_t>(settings::counter.key)) {
+            store->set(settings::counter.key, *value);
+            store->commit();
+            log_buffered(*get_logger(), spdlog::level::info, "SettingsViewModel: moved LocalSettings to {}",
+                         Utf8Text{store->path().native()});
+        }
+    } catch (const winrt::hresult_error& ex) {
+        log_buffered(*get_logger(), spdlog::level::warn, "SettingsViewModel: LocalSettings - {}", ex.message());
+    }
+    return store;
+}
+
+SettingsViewModel::SettingsViewModel() noexcept(false)
+    : m_backend{m_loaded.get_future().share()}, m_writer{[this]() { return SaveSettings(); }} {
+}
+
+IAsyncAction SettingsViewModel::LoadAsync() {
+    if (m_loading.exchange(true))
+        co_return;
+    auto lifetime = get_strong();
+    winrt::apartment_context ui_thread{};
+    const auto start = std::chrono::steady_clock::now();
+    co_await winrt::resume_background();
+
+    std::shared_ptr<App1::SettingsBackend> backend{};
+    settings::Schema::Values values = settings::Schema::defaults();
+    try {
+        backend = MakeBackend();
+        values = settings::Schema::load(*backend);
+    } catch (const winrt::hresult_error& ex) {
+        log_buffered(*get_logger(), spdlog::level::err, "LoadSettings: {}", ex.message());
+    } catch (const std::exception& ex) {
+        log_buffered(*get_logger(), spdlog::level::err, "LoadSettings: {}", ex.what());
+    }
+    // before the writer can save. The values which are changed before the load are kept
+    const App1::SettingsMask changed = m_state.load(values);
+    m_loaded.set_value(backend);
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    log_buffered(*get_logger(), spdlog::level::info, "SettingsViewModel: loaded in {:.1f} ms", elapsed.count());
+
+    co_await ui_thread;
+    if (changed != 0)
+        RaiseChanged(changed);
 }
 
 uint32_t SettingsViewModel::Counter() const noexcept {
-    return counter;
+    if (m_update) // the staged value
+        return m_update->get<settings::counter>();
+    return m_state.get<settings::counter>();
+}
+
+void SettingsViewModel::Counter(uint32_t value) noexcept(false) {
+    BeginUpdate();
+    m_update->set<settings::counter>(value);
+    EndUpdate();
+}
+
+void SettingsViewModel::ResetToDefault() noexcept(false) {
+    BeginUpdate();
+    m_update->assign(settings::Schema::defaults());
+    EndUpdate();
+}
+
+void SettingsViewModel::BeginUpdate() noexcept {
+    if (m_updateDepth++ == 0)
+        m_update.emplace(m_state.begin());
 }
 
-void SettingsViewModel::Counter(uint32_t value) noexcept {
-    if (counter == value)
+void SettingsViewModel::EndUpdate() noexcept(false) {
+    if (m_updateDepth == 0)
+        throw winrt::hresult_illegal_method_call{L"EndUpdate without BeginUpdate"};
+    if (--m_updateDepth != 0)
         return;
-    counter = value;
-    SaveSettings();
-    RaisePropertyChanged(L"Counter");
+    const auto update = *std::exchange(m_update, std::nullopt);
+    Apply(update);
 }
 
-void SettingsViewModel::ResetToDefault() noexcept {
-    Counter(0);
-    SaveSettings();
+void SettingsViewModel::Apply(const App1::SettingsTransaction<settings::Schema>& update) {
+    const App1::SettingsMask changed = m_state.commit(update);
+    if (changed == 0)
+        return;
+    m_writer.mark_dirty();
+    RaiseChanged(changed);
 }
 
-void SettingsViewModel::SaveSettings() noexcept {
-    try {
-        auto settings = GetLocalSettings();
-        if (settings == nullptr) {
-            spdlog::error(L"Local settings are not available.");
-            return;
-        }
-        IPropertySet values = settings.Values();
-        values.Insert(L"Counter", winrt::box_value(counter));
-    } catch (const winrt::hresult_error& ex) {
-        spdlog::error(L"SaveSettings: {}", ex.message());
-    }
+void SettingsViewModel::RaiseChanged(App1::SettingsMask changed) {
+    m_settingsChanged(*this, static_cast<App1::SettingsProperties>(changed));
+    // one pass for the bindings. The empty name is all properties
+    if (changed == settings::Schema::bit<settings::counter>())
+        RaisePropertyChanged(L"Counter");
+    else
+        RaisePropertyChanged(L"");
+}
+
+void SettingsViewModel::Flush() noexcept {
+    // the caller is the UI thread. The writer thread saves the changes, after the load if it is running
+    const bool loaded = m_backend.wait_for(std::chrono::seconds{0}) == std::future_status::ready;
+    m_writer.request_flush(loaded ? flush_timeout : std::chrono::milliseconds{0});
+}
+
+App1::SettingsWriter::Stats SettingsViewModel::WriterStats() const noexcept {
+    return m_writer.stats();
 }
 
-void SettingsViewModel::LoadSettings() noexcept {
-    counter = 0; // Initialize to default value
+bool SettingsViewModel::SaveSettings() noexcept {
     try {
-        auto settings = GetLocalSettings();
-        if (settings == nullptr) {
-            spdlog::error(L"Local settings are not available.");
-            return;
+        if (m_loading == false) {
+            get_logger()->error("SaveSettings: LoadAsync is not called");
+            return false;
         }
-        IPropertySet values = settings.Values();
-        if (const auto key = L"Counter"; values.HasKey(key)) {
-            if (auto boxed = values.Lookup(key); boxed != nullptr)
-                counter = winrt::unbox_value<uint32_t>(boxed);
-        }
-    } catch (const winrt::hresult_error& ex) {
-        spdlog::error(L"LoadSettings: {}", ex.message());
+        const auto backend = m_backend.get();
+        if (backend == nullptr)
+            return false;
+        settings::Schema::save(*backend, m_state.snapshot());
+        backend->commit();
+        return true;
+    } catch (const std::exception& ex) {
+        log_buffered(*get_logger(), spdlog::level::err, "SaveSettings: {}", ex.what());
+        return false;
     }
 }
 
@@ -76,6 +214,15 @@ void SettingsViewModel::PropertyChanged(winrt::event_token const& token) noexcep
     m_propertyChanged.remove(token);
 }
 
+winrt::event_token
+SettingsViewModel::Changed(TypedEventHandler<App1::SettingsViewModel, App1::SettingsProperties> const& handler) {
+    return m_settingsChanged.add(handler);
+}
+
+void SettingsViewModel::Changed(winrt::event_token const& token) noexcept {
+    m_settingsChanged.remove(token);
+}
+
 void SettingsViewModel::RaisePropertyChanged(winrt::hstring const& propertyName) {
     m_propertyChanged(*this, PropertyChangedEventArgs(propertyName));
 }
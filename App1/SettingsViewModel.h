@@ -2,9 +2,29 @@
 
 #include "SettingsViewModel.g.h"
 
+#include "../Shared1/SettingsJournal.h"
+#include "../Shared1/SettingsSchema.h"
+#include "../Shared1/SettingsWriter.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <optional>
+
+namespace winrt::App1::settings {
+
+/// @note Append the new settings to the Schema. The key name must not change after a release
+inline constexpr Setting<uint32_t> counter{SettingsKey{"Counter"}, 0};
+
+using Schema = SettingsSchema<counter>;
+
+} // namespace winrt::App1::settings
+
 namespace winrt::App1::implementation {
 using Microsoft::UI::Xaml::Data::PropertyChangedEventHandler;
 using Windows::Foundation::IAsyncAction;
+using Windows::Foundation::TypedEventHandler;
 using Windows::Foundation::Collections::IObservableVector;
 using Windows::Foundation::Collections::IPropertySet;
 using Windows::Storage::ApplicationData;
@@ -18,29 +38,64 @@ using Windows::Storage::StorageFolder;
  * @see https://learn.microsoft.com/en-us/windows/apps/design/app-settings/store-and-retrieve-app-data
  * @see Windows.Storage.ApplicationDataContainer
  * @see Windows.Storage.StorageFolder
+ * @see JournaledSettingsStore
  */
 struct SettingsViewModel : SettingsViewModelT<SettingsViewModel> {
   private:
-    uint32_t counter = 0;
+    App1::SettingsState<settings::Schema> m_state{}; // the writer reads it in the background
     winrt::event<PropertyChangedEventHandler> m_propertyChanged;
+    winrt::event<TypedEventHandler<App1::SettingsViewModel, App1::SettingsProperties>> m_settingsChanged;
+    std::optional<App1::SettingsTransaction<settings::Schema>> m_update{}; // between BeginUpdate and EndUpdate
+    uint32_t m_updateDepth = 0;
+    std::promise<std::shared_ptr<App1::SettingsBackend>> m_loaded{};
+    std::shared_future<std::shared_ptr<App1::SettingsBackend>> m_backend; // null if the load failed
+    std::atomic<bool> m_loading = false;
+    App1::SettingsWriter m_writer; // after m_backend. The destructor writes the pending changes
 
   public:
-    SettingsViewModel() noexcept;
+    /// @brief The longest wait of `Flush` on the UI thread
+    static constexpr std::chrono::milliseconds flush_timeout{200};
+
+    /// @note The properties are the defaults until `LoadAsync` completes
+    SettingsViewModel() noexcept(false);
 
     uint32_t Counter() const noexcept;
-    void Counter(uint32_t value) noexcept;
-    void ResetToDefault() noexcept;
+    void Counter(uint32_t value) noexcept(false);
+    void ResetToDefault() noexcept(false);
+    void BeginUpdate() noexcept;
+    /// @throws winrt::hresult_illegal_method_call without BeginUpdate
+    void EndUpdate() noexcept(false);
+    /**
+     * @brief Let the writer thread save the pending changes now
+     * @details Waits for it up to `flush_timeout`. Doesn't wait if `LoadAsync` is running. The writer saves after it
+     */
+    void Flush() noexcept;
+    IAsyncAction LoadAsync();
+    App1::SettingsWriter::Stats WriterStats() const noexcept;
 
     // INotifyPropertyChanged implementation
     winrt::event_token PropertyChanged(PropertyChangedEventHandler const&);
     void PropertyChanged(winrt::event_token const&) noexcept;
 
+    winrt::event_token Changed(TypedEventHandler<App1::SettingsViewModel, App1::SettingsProperties> const&);
+    void Changed(winrt::event_token const&) noexcept;
+
   private:
-    void SaveSettings() noexcept;
-    void LoadSettings() noexcept;
+    /// @brief Commit the update. Write the settings and raise the events if something is changed
+    void Apply(const App1::SettingsTransaction<settings::Schema>& update);
+    void RaiseChanged(App1::SettingsMask changed);
+    /**
+     * @note Called by the writer thread, or by its destructor on the caller's thread. Waits for `LoadAsync`
+     * @note Runs in the caller's apartment as it is. The backend is a file store and makes no COM calls, so the UI STA
+     *       can call it. Never initialize an apartment here, which fails with RPC_E_CHANGED_MODE on the STA
+     */
+    bool SaveSettings() noexcept;
 
-    /// @note Declare getters in the SettingsViewModel.idl file, and limit the direct access to the ApplicationDataContainer
-    ApplicationDataContainer GetLocalSettings() noexcept(false);
+    /**
+     * @brief The settings files in the LocalFolder. The values in LocalSettings are moved to them in the first run
+     * @note Declare getters in the SettingsViewModel.idl file, and limit the direct access to the backend
+     */
+    static std::shared_ptr<App1::SettingsBackend> MakeBackend() noexcept(false);
     void RaisePropertyChanged(winrt::hstring const& propertyName);
 };
 
@@ -0,0 +1,6 @@
+// Common declarations of the App1 shaders
+
+struct FullscreenVertex {
+    float4 position : SV_Position;
+    float2 uv : TEXCOORD0;
+};
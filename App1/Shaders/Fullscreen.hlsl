@@ -0,0 +1,17 @@
+// Fullscreen triangle without vertex buffer. Draw with 3 vertices
+#include "Common.hlsli"
+
+#ifndef CLEAR_COLOR
+#define CLEAR_COLOR float4(0.1, 0.1, 0.1, 1.0)
+#endif
+
+FullscreenVertex VSMain(uint id : SV_VertexID) {
+    FullscreenVertex output;
+    output.uv = float2((id << 1) & 2, id & 2);
+    output.position = float4(output.uv * float2(2, -2) + float2(-1, 1), 0, 1);
+    return output;
+}
+
+float4 PSMain(FullscreenVertex input) : SV_Target {
+    return CLEAR_COLOR * float4(input.uv, 1, 1);
+}
@@ -9,14 +9,176 @@
 #endif
 
 #include <pix3.h>
+#include <spdlog/spdlog.h>
 
 #include "StepTimer.h"
+#include "../Shared1/FlightRecorder.h"
+#include "../Shared1/LogCounterSink.h"
+#include "../Shared1/PipelineCache.h"
+#include "../Shared1/TextConvert.h"
 
 namespace winrt::App1::implementation {
+using winrt::Windows::Storage::ApplicationData;
+
+/// @brief The shaders and the pipelines are in the DX channel
+static std::shared_ptr<spdlog::logger> get_logger() noexcept(false) {
+    return get_channel_logger(LogChannel::DX);
+}
+
+/// @note Shaders.pack is deployed next to the executable. See BuildShaderPack target in App1.vcxproj
+static DX::ShaderPack load_shader_pack() noexcept {
+    try {
+        auto filepath = get_module_path().parent_path() / L"Shaders.pack";
+        DX::ShaderPack pack = DX::ShaderPack::open(filepath);
+        get_logger()->info("TestPage1: {} shaders from Shaders.pack", pack.size());
+        return pack;
+    } catch (const winrt::hresult_error& ex) {
+        get_logger()->error("TestPage1: Shaders.pack - {}", ex.message());
+    } catch (const std::exception& ex) {
+        get_logger()->error("TestPage1: Shaders.pack - {}", ex.what());
+    }
+    return DX::ShaderPack{};
+}
+
+/// @brief Root signature of the fullscreen pipeline
+/// @param key receives the hash of the serialized root signature. See DX::HashPipelineDesc
+static winrt::com_ptr<ID3D12RootSignature> create_root_signature(ID3D12Device* device,
+                                                                 uint64_t& key) noexcept(false) {
+    const CD3DX12_ROOT_SIGNATURE_DESC signature{0, nullptr, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE};
+    winrt::com_ptr<ID3DBlob> blob = nullptr;
+    winrt::com_ptr<ID3DBlob> error = nullptr;
+    winrt::check_hresult(
+        D3D12SerializeRootSignature(&signature, D3D_ROOT_SIGNATURE_VERSION_1, blob.put(), error.put()));
+    DX::StableHasher hasher{};
+    hasher.update(blob->GetBufferPointer(), blob->GetBufferSize());
+    key = hasher.value();
+    winrt::com_ptr<ID3D12RootSignature> root_signature = nullptr;
+    winrt::check_hresult(device->CreateRootSignature(0, blob->GetBufferPointer(), blob->GetBufferSize(),
+                                                     IID_PPV_ARGS(root_signature.put())));
+    return root_signature;
+}
+
+/// @return nullopt if the pack doesn't have the shaders. The desc points the bytecode in the pack
+static std::optional<D3D12_GRAPHICS_PIPELINE_STATE_DESC>
+make_fullscreen_desc(const DX::ShaderPack& shaders, ID3D12RootSignature* root_signature, DXGI_FORMAT format) noexcept {
+    const auto vs = shaders.find("FullscreenVS");
+    const auto ps = shaders.find("FullscreenPS");
+    if (vs.has_value() == false || ps.has_value() == false)
+        return std::nullopt;
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC desc{};
+    desc.pRootSignature = root_signature;
+    desc.VS = {vs->bytecode.data(), vs->bytecode.size()};
+    desc.PS = {ps->bytecode.data(), ps->bytecode.size()};
+    desc.BlendState = CD3DX12_BLEND_DESC{D3D12_DEFAULT};
+    desc.RasterizerState = CD3DX12_RASTERIZER_DESC{D3D12_DEFAULT};
+    desc.DepthStencilState.DepthEnable = FALSE;
+    desc.DepthStencilState.StencilEnable = FALSE;
+    desc.SampleMask = UINT_MAX;
+    desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+    desc.NumRenderTargets = 1;
+    desc.RTVFormats[0] = format;
+    desc.SampleDesc.Count = 1;
+    return desc;
+}
+
+static winrt::com_ptr<ID3D12PipelineState> create_graphics_pipeline(DX::D3D12PipelineCache& cache,
+                                                                    ID3D12Device* device,
+                                                                    const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc,
+                                                                    uint64_t root_signature_key) noexcept(false) {
+    const uint64_t key = DX::HashPipelineDesc(desc, root_signature_key);
+    return cache.get_or_create(key, [device, &desc](const DX::PipelineBlob* cached) {
+        return DX::CreateGraphicsPipeline(device, desc, cached);
+    });
+}
+
+/**
+ * @brief The pipelines shared by the TestPage1 instances. See `TestPage1::prewarm_pipelines`
+ * @details The prewarmed pipelines are bound to `root_signature`. D3D12 creates one device for each adapter,
+ *          so the page's device is the same object unless it selected another adapter or it was lost
+ */
+struct PipelineStartup final {
+    std::filesystem::path filepath{};
+    std::shared_ptr<DX::D3D12PipelineCache> cache = nullptr; // nullptr if there is no hardware adapter
+    winrt::com_ptr<ID3D12RootSignature> root_signature = nullptr;
+    uint64_t root_signature_key = 0;
+};
+
+/// @note Assigned once by `prewarm_pipelines` before the window is created. The other threads wait on a copy
+static std::shared_future<PipelineStartup> g_pipelines{};
+
+static PipelineStartup load_pipelines(std::filesystem::path filepath) noexcept {
+    PipelineStartup startup{std::move(filepath)};
+    try {
+        winrt::com_ptr<IDXGIFactory6> factory = nullptr;
+        winrt::check_hresult(CreateDXGIFactory2(0, IID_PPV_ARGS(factory.put())));
+        // same preference with DX::DeviceResources
+        winrt::com_ptr<IDXGIAdapter1> adapter = nullptr;
+        winrt::check_hresult(
+            factory->EnumAdapterByGpuPreference(0, DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE, IID_PPV_ARGS(adapter.put())));
+        DX::PipelineLibrary library{DX::MakeDeviceSignature(adapter.get())};
+        if (library.load(startup.filepath) == false)
+            get_logger()->info("TestPage1: no pipeline library. the pipelines will be compiled");
+        startup.cache = std::make_shared<DX::D3D12PipelineCache>(std::move(library));
+
+        winrt::com_ptr<ID3D12Device> device = nullptr;
+        winrt::check_hresult(D3D12CreateDevice(adapter.get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(device.put())));
+        startup.root_signature = create_root_signature(device.get(), startup.root_signature_key);
+
+        const DX::ShaderPack shaders = load_shader_pack();
+        auto desc = make_fullscreen_desc(shaders, startup.root_signature.get(), TestPage1::back_buffer_format);
+        if (desc.has_value() == false)
+            return startup;
+        const uint64_t key = DX::HashPipelineDesc(desc.value(), startup.root_signature_key);
+        DX::D3D12PipelineCache::CompileFn compile = [device, &desc](const DX::PipelineBlob* cached) {
+            return DX::CreateGraphicsPipeline(device.get(), desc.value(), cached);
+        };
+        auto prewarm = startup.cache->prewarm({{key, std::move(compile)}});
+        const size_t count = prewarm.get(); // the pack and the desc must outlive the compilation
+        const auto stats = startup.cache->statistics();
+        get_logger()->info("TestPage1: prewarmed {} pipelines. warm {}, cold {}, rejected {}", count, stats.warm,
+                           stats.cold, stats.rejected);
+    } catch (const winrt::hresult_error& ex) {
+        get_logger()->error("TestPage1: load_pipelines - {}", ex.message());
+    } catch (const std::exception& ex) {
+        get_logger()->error("TestPage1: load_pipelines - {}", ex.what());
+    }
+    return startup;
+}
+
+void TestPage1::prewarm_pipelines() noexcept {
+    try {
+        const std::filesystem::path folder{std::wstring_view{ApplicationData::Current().LocalFolder().Path()}};
+        g_pipelines = std::async(std::launch::async, &load_pipelines, folder / "pipelines.bin").share();
+    } catch (const winrt::hresult_error& ex) {
+        get_logger()->error("TestPage1: prewarm_pipelines - {}", ex.message());
+    } catch (const std::exception& ex) {
+        get_logger()->error("TestPage1: prewarm_pipelines - {}", ex.what());
+    }
+}
+
+/// @note The suspend notification comes from a worker thread
+void TestPage1::save_pipelines() noexcept {
+    const std::shared_future<PipelineStartup> pipelines = g_pipelines;
+    if (pipelines.valid() == false)
+        return;
+    // don't wait for the startup. Nothing is created before it is done
+    if (pipelines.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+        return;
+    const PipelineStartup& startup = pipelines.get();
+    if (startup.cache == nullptr)
+        return;
+    try {
+        startup.cache->save(startup.filepath);
+    } catch (const std::exception& ex) {
+        get_logger()->error("TestPage1: save_pipelines - {}", ex.what());
+    }
+}
 
 TestPage1::TestPage1() noexcept(false) {
     // Initialize page, resources ...
     resources.CreateDeviceResources();
+    shaders = load_shader_pack();
+    create_pipeline();
 
     // Initialize timer0 and set up the event handler
     timer0 = DispatcherTimer();
@@ -31,10 +193,15 @@ Shared1::BasicViewModel TestPage1::ViewModel() noexcept {
 void TestPage1::OnDeviceLost() noexcept {
     // render targets, swapchains will be removed. disconnect
     std::ignore = bridge->SetSwapChain(nullptr);
+    backend = nullptr; // the transient resources belong to the lost device
+    graph.reset();
+    fullscreen = nullptr;
+    root_signature = nullptr;
 }
 
 void TestPage1::OnDeviceRestored() noexcept {
     // ... resources.CreateDeviceResources() is already done ...
+    create_pipeline();
     // CreateWindowSizeDependentResources ...
     if (IDXGISwapChain* swapchain = resources.GetSwapChain(); swapchain != nullptr)
         bridge->SetSwapChain(swapchain);
@@ -44,6 +211,7 @@ void TestPage1::panel0_size_changed(IInspectable const& sender, SizeChangedEvent
     // get the new size and update the resources
     auto size = e.NewSize();
     resources.CreateWindowSizeDependentResources(static_cast<UINT>(size.Width), static_cast<UINT>(size.Height));
+    graph.reset(); // the back buffer desc is changed
 
     if (bridge == nullptr) // note the sender is SwapChainPanel
         sender.as(bridge);
@@ -91,15 +259,105 @@ void TestPage1::on_test_button_click(IInspectable const&, RoutedEventArgs const&
     }
 }
 
-// todo: perform rendering on each timer tick
+/// @note Without the shaders in the pack, the page only clears the back buffer
+void TestPage1::create_pipeline() noexcept {
+    try {
+        ID3D12Device* device = resources.GetD3DDevice();
+        // waits for the library which is loaded in the background. See prewarm_pipelines
+        const PipelineStartup* startup = g_pipelines.valid() ? &g_pipelines.get() : nullptr;
+        std::shared_ptr<DX::D3D12PipelineCache> cache = nullptr;
+        if (startup != nullptr && startup->cache != nullptr &&
+            startup->cache->signature() == DX::MakeDeviceSignature(resources.GetAdapter()))
+            cache = startup->cache;
+
+        uint64_t root_signature_key = 0;
+        winrt::com_ptr<ID3D12Device> owner = nullptr;
+        if (cache != nullptr && startup->root_signature != nullptr)
+            winrt::check_hresult(startup->root_signature->GetDevice(IID_PPV_ARGS(owner.put())));
+        if (owner.get() == device) {
+            root_signature = startup->root_signature;
+            root_signature_key = startup->root_signature_key;
+        } else {
+            root_signature = create_root_signature(device, root_signature_key);
+            if (cache != nullptr)
+                cache->reset(); // the pipelines belong to the other device
+        }
+
+        const auto desc = make_fullscreen_desc(shaders, root_signature.get(), resources.GetBackBufferFormat());
+        if (desc.has_value() == false)
+            return;
+        if (cache == nullptr) {
+            // no library for this adapter. compile without the cache
+            auto result = DX::CreateGraphicsPipeline(device, desc.value(), nullptr);
+            fullscreen = result.has_value() ? result->pipeline : nullptr;
+            return;
+        }
+        fullscreen = create_graphics_pipeline(*cache, device, desc.value(), root_signature_key);
+    } catch (const winrt::hresult_error& ex) {
+        get_logger()->error("TestPage1: create_pipeline - {}", ex.message());
+        fullscreen = nullptr;
+        root_signature = nullptr;
+    } catch (const std::exception& ex) {
+        get_logger()->error("TestPage1: create_pipeline - {}", ex.what());
+        fullscreen = nullptr;
+        root_signature = nullptr;
+    }
+}
+
+/// @note Built once for the size of the back buffer. Each frame binds its back buffer. See on_timer_tick
+void TestPage1::build_render_graph() {
+    graph.reset();
+    const RECT size = resources.GetOutputSize();
+    const DX::TextureDesc desc{static_cast<uint32_t>(size.right - size.left),
+                               static_cast<uint32_t>(size.bottom - size.top),
+                               static_cast<uint32_t>(resources.GetBackBufferFormat())};
+    // Prepare moves the back buffer to RENDER_TARGET. The last barrier of the graph moves it to PRESENT
+    backbuffer = graph.import_texture("BackBuffer", desc, resources.GetRenderTarget(), DX::ResourceState::RenderTarget,
+                                      DX::ResourceState::Common);
+    graph.add_pass(
+        "Clear", [target = backbuffer](DX::RenderGraph::PassBuilder& builder) { builder.write(target); },
+        [this](DX::RenderPassContext&) {
+            ID3D12GraphicsCommandList* command_list = resources.GetCommandList();
+            const D3D12_CPU_DESCRIPTOR_HANDLE rtv = resources.GetRenderTargetView();
+            const float color[4]{0.1f, 0.1f, 0.1f, 1.0f};
+            command_list->ClearRenderTargetView(rtv, color, 0, nullptr);
+            if (fullscreen == nullptr)
+                return;
+            // the fullscreen triangle of Shaders.pack. No vertex buffer
+            const D3D12_VIEWPORT viewport = resources.GetScreenViewport();
+            const D3D12_RECT scissor = resources.GetScissorRect();
+            command_list->OMSetRenderTargets(1, &rtv, FALSE, nullptr);
+            command_list->RSSetViewports(1, &viewport);
+            command_list->RSSetScissorRects(1, &scissor);
+            command_list->SetGraphicsRootSignature(root_signature.get());
+            command_list->SetPipelineState(fullscreen.get());
+            command_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+            command_list->DrawInstanced(3, 1, 0, 0);
+        });
+}
+
 void TestPage1::on_timer_tick(IInspectable const&, IInspectable const&) {
     ID3D12CommandQueue* command_queue = resources.GetCommandQueue();
     PIXScopedEvent(command_queue, PIX_COLOR_DEFAULT, L"on_timer_tick");
     resources.Prepare();
-    // ...Rendering logic here...
+    // the raw values. The text is rendered when the dump is decoded
+    const RECT size = resources.GetOutputSize();
+    FLIGHT_RECORD(BinaryLogLevel::Trace, "TestPage1: tick. back buffer {} ({}x{})", resources.GetCurrentFrameIndex(),
+                  size.right - size.left, size.bottom - size.top);
+    {
+        PIXBeginEvent(command_queue, PIX_COLOR_DEFAULT, L"RenderGraph");
+        if (backend == nullptr)
+            backend = std::make_unique<DX::D3D12RenderGraphBackend>(resources.GetD3DDevice());
+        backend->SetCommandList(resources.GetCommandList());
+        if (graph.pass_count() == 0)
+            build_render_graph();
+        graph.bind_import(backbuffer, resources.GetRenderTarget());
+        graph.execute(*backend);
+        PIXEndEvent(command_queue);
+    }
     {
         PIXBeginEvent(command_queue, PIX_COLOR_DEFAULT, L"Present");
-        resources.Present();
+        resources.Present(D3D12_RESOURCE_STATE_PRESENT);
         PIXEndEvent(command_queue);
     }
 }
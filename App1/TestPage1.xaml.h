@@ -2,6 +2,8 @@
 #include "TestPage1.g.h"
 
 #include "../Shared1/DeviceResources.h"
+#include "../Shared1/RenderGraphD3D12.h"
+#include "../Shared1/ShaderPack.h"
 
 #include <microsoft.ui.xaml.media.dxinterop.h> // ISwapChainPanelNative for Microsoft namespace
 #include <winrt/Shared1.h>                     // generated file from Shared1 project
@@ -15,15 +17,35 @@ using winrt::Windows::Foundation::IInspectable;
 using winrt::Windows::Foundation::TimeSpan;
 
 struct TestPage1 : TestPage1T<TestPage1>, DX::IDeviceNotify {
+  public:
+    static constexpr DXGI_FORMAT back_buffer_format = DXGI_FORMAT_B8G8R8A8_UNORM;
+
   private:
-    DX::DeviceResources resources{DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_D24_UNORM_S8_UINT, 2};
+    DX::DeviceResources resources{back_buffer_format, DXGI_FORMAT_D24_UNORM_S8_UINT, 2};
+    DX::ShaderPack shaders{}; // precompiled by the build. No runtime compilation
+    winrt::com_ptr<ID3D12RootSignature> root_signature = nullptr;
+    winrt::com_ptr<ID3D12PipelineState> fullscreen = nullptr; // null if the pack doesn't have the shaders
+    DX::RenderGraph graph{}; // empty until the first frame after the resize or the device lost
+    DX::RenderGraphHandle backbuffer{};
+    std::unique_ptr<DX::D3D12RenderGraphBackend> backend = nullptr;
     winrt::com_ptr<ISwapChainPanelNative> bridge = nullptr;
     Shared1::BasicViewModel viewmodel0{nullptr};
     DispatcherTimer timer0{};
 
+    void create_pipeline() noexcept;
+    void build_render_graph();
+
   public:
     TestPage1() noexcept(false);
 
+    /**
+     * @brief Load the pipeline library and create the pipelines of the page in the background
+     * @note Call once at startup, before the first TestPage1 is created
+     */
+    static void prewarm_pipelines() noexcept;
+    /// @brief Write the pipelines created after the load. Use before the process is suspended or exits
+    static void save_pipelines() noexcept;
+
     void OnNavigatedTo(const NavigationEventArgs&);
     void OnNavigatedFrom(const NavigationEventArgs&);
 
@@ -4,11 +4,17 @@
 #define SPDLOG_WCHAR_FILENAMES
 #include <spdlog/pattern_formatter.h>
 #include <spdlog/sinks/base_sink.h>
+#include <spdlog/sinks/dist_sink.h>
 #include <spdlog/sinks/msvc_sink.h>
 #include <spdlog/sinks/ostream_sink.h>
 #include <spdlog/sinks/stdout_sinks.h>
 #include <spdlog/spdlog.h>
 
+#include "../Shared1/AsyncLogSink.h"
+#include "../Shared1/FlightRecorder.h"
+#include "../Shared1/LogCounterSink.h"
+#include "../Shared1/LogLimit.h"
+
 #include <cstdio>
 #include <iostream>
 
@@ -42,13 +48,102 @@ auto make_logger(const char* name, FILE* fout) noexcept(false) {
     return std::make_shared<spdlog::logger>(name, sinks.begin(), sinks.end());
 }
 
-void set_log_stream(const char* name) noexcept(false) {
-    std::shared_ptr logger = make_logger(name, stdout);
-    logger->set_pattern("%T.%e [%L] %8t %v");
+/**
+ * @brief The sinks of `make_logger` behind AsyncLogSink
+ * @details The errors are flushed before the caller continues
+ */
+auto make_async_logger(const char* name, FILE* fout, AsyncLogOptions options) noexcept(false) {
+    std::shared_ptr base = make_logger(name, fout);
+    auto sink = std::make_shared<AsyncLogSink>(base->sinks(), options);
+    auto logger = std::make_shared<spdlog::logger>(name, std::move(sink));
+    logger->flush_on(spdlog::level::level_enum::err);
+    return logger;
+}
+
+/**
+ * @brief Keeps the messages in the flight recorder. The text is truncated to the slot
+ * @details The spdlog messages are already formatted. They are kept as one string with the "{}" descriptor of the
+ *          level, so they don't get the benefit of the binary log. The hot call sites use `FLIGHT_RECORD` with the raw
+ *          arguments instead
+ * @see FlightRecorder
+ */
+class FlightRecorderSink final : public spdlog::sinks::sink {
+    FlightRecorder& m_recorder;
+
+    static uint32_t get_descriptor(spdlog::level::level_enum level) noexcept(false) {
+        static const uint32_t ids[]{
+            BINLOG_ID(BinaryLogLevel::Trace, "{}"), BINLOG_ID(BinaryLogLevel::Debug, "{}"),
+            BINLOG_ID(BinaryLogLevel::Info, "{}"),  BINLOG_ID(BinaryLogLevel::Warn, "{}"),
+            BINLOG_ID(BinaryLogLevel::Error, "{}"), BINLOG_ID(BinaryLogLevel::Critical, "{}"),
+        };
+        return ids[(std::min)(static_cast<size_t>(level), std::size(ids) - 1)];
+    }
+
+  public:
+    explicit FlightRecorderSink(FlightRecorder& recorder) noexcept : m_recorder{recorder} {
+    }
+
+    void log(const spdlog::details::log_msg& msg) override {
+        m_recorder.record(get_descriptor(msg.level), std::string_view{msg.payload.data(), msg.payload.size()});
+    }
+    void flush() override {
+    }
+    void set_pattern(const std::string&) override {
+    }
+    void set_formatter(std::unique_ptr<spdlog::formatter>) override {
+    }
+};
+
+/**
+ * @brief Register the loggers of the channels with the sinks of `logger`
+ * @details The default logger is the one of the channel which has the name of `logger`. `App1.Core` if unknown
+ * @see make_channel_loggers
+ */
+static void set_default_logger(std::shared_ptr<spdlog::logger> logger) noexcept(false) {
+    // before the other sinks, so the record is taken in the caller's thread
+    logger->set_pattern("%T.%e [%L] %8t %v"); // the sinks are shared
+    std::vector<spdlog::sink_ptr> sinks = logger->sinks();
+    sinks.insert(sinks.begin(), std::make_shared<FlightRecorderSink>(get_flight_recorder()));
+    const ChannelLoggers loggers = make_channel_loggers(sinks);
+    for (const std::shared_ptr<spdlog::logger>& item : loggers) {
+        item->flush_on(logger->flush_level());
 #if defined(_DEBUG)
-    logger->set_level(spdlog::level::level_enum::debug);
+        item->set_level(spdlog::level::level_enum::debug);
 #endif
-    spdlog::set_default_logger(logger);
+        spdlog::drop(item->name());
+        spdlog::register_logger(item);
+    }
+    spdlog::set_default_logger(loggers[static_cast<size_t>(find_log_channel(logger->name()))]);
+}
+
+void set_log_stream(const char* name) noexcept(false) {
+    std::shared_ptr logger = make_logger(name, stdout);
+    // the sinks which are added after the logger is published. See `add_log_file_sink` of BasicViewModel
+    logger->sinks().emplace_back(std::make_shared<spdlog::sinks::dist_sink_mt>());
+    set_default_logger(std::move(logger));
+}
+
+void set_log_stream(const char* name, OverflowPolicy policy, size_t capacity) noexcept(false) {
+    set_default_logger(make_async_logger(name, stdout, AsyncLogOptions{capacity, policy}));
+}
+
+void log_channel_counters() noexcept {
+    try {
+        spdlog::info("log volume\n{}", export_log_counters(snapshot_log_counters()));
+    } catch (...) {
+        // Ignore sink errors in logging
+    }
+}
+
+void log_suppressed_counts() noexcept {
+    try {
+        report_suppressed_logs([](const LogSite& site, uint64_t count) {
+            const auto level = static_cast<spdlog::level::level_enum>(site.level());
+            spdlog::log(level, "{}({}): suppressed {} messages", site.file(), site.line(), count);
+        });
+    } catch (...) {
+        // Ignore sink errors in logging
+    }
 }
 
 DWORD get_module_path(WCHAR* path, UINT capacity) noexcept(false) {
@@ -26,6 +26,7 @@
 #include <winrt/Microsoft.Windows.AppLifecycle.h>
 #include <winrt/Microsoft.Windows.ApplicationModel.Resources.h>
 #include <winrt/Microsoft.Windows.ApplicationModel.WindowsAppRuntime.h>
+#include <winrt/Microsoft.Windows.System.Power.h>
 #include <winrt/Windows.ApplicationModel.Activation.h>
 #include <winrt/Windows.Foundation.Collections.h>
 #include <winrt/Windows.Foundation.h>
@@ -43,8 +44,35 @@
 
 namespace winrt::App1 {
 
+enum class OverflowPolicy : uint8_t; // LogQueue.h
+
+/**
+ * @brief Register a logger for each channel. They share the console sinks
+ * @param name the channel of the default logger, like "App1.Core"
+ * @see get_channel_logger
+ */
 void set_log_stream(const char* name) noexcept(false);
 
+/**
+ * @brief Asynchronous version. The console is written by the writer thread
+ * @param policy when the queue is full
+ * @param capacity number of the messages in the queue of each logging thread
+ * @see AsyncLogSink
+ */
+void set_log_stream(const char* name, OverflowPolicy policy, size_t capacity) noexcept(false);
+
+/**
+ * @brief Log the message and byte counts of the channels in CSV
+ * @see snapshot_log_counters
+ */
+void log_channel_counters() noexcept;
+
+/**
+ * @brief Log the suppressed counts of the LOG_RATE_LIMITED and LOG_SAMPLED call sites
+ * @see report_suppressed_logs
+ */
+void log_suppressed_counts() noexcept;
+
 /**
  * @see https://learn.microsoft.com/en-us/windows/win32/api/libloaderapi/nf-libloaderapi-getmodulefilenamew
  * @see GetModuleFileNameW
@@ -0,0 +1,264 @@
+#include "pch.h"
+
+#define SPDLOG_WCHAR_TO_UTF8_SUPPORT
+#include "AsyncLogSink.h"
+
+#include <spdlog/pattern_formatter.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace winrt::App1 {
+
+static int64_t now_ns() noexcept {
+    const auto time = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+}
+
+static void add_stats(AsyncLogSink::Stats& sum, const AsyncLogSink::Stats& stats) noexcept {
+    sum.pushed += stats.pushed;
+    sum.dropped += stats.dropped;
+    sum.overwritten += stats.overwritten;
+    sum.blocked += stats.blocked;
+}
+
+/**
+ * @brief The queue of a logging thread
+ * @details The thread publishes its in-flight timestamp, so the writer never forwards a record which is
+ *          newer than a record still being pushed.
+ */
+struct AsyncLogSink::Lane final {
+    static constexpr int64_t idle = INT64_MAX;
+    static constexpr int64_t starting = INT64_MIN; // the timestamp is not taken yet
+
+    LogQueue<AsyncLogRecord> queue;
+    std::atomic<int64_t> inflight{idle};
+    std::atomic<bool> closed{false};
+    // the writer
+    AsyncLogRecord head{};
+    bool ready = false; // `head` is popped and not forwarded yet
+
+    explicit Lane(const AsyncLogOptions& options) noexcept(false) : queue{options.capacity, options.policy} {
+    }
+};
+
+/// @brief Queues of the current thread for each AsyncLogSink. Closed when the thread exits
+struct LocalLanes final {
+    std::vector<std::pair<uint64_t, std::shared_ptr<AsyncLogSink::Lane>>> items{};
+
+    ~LocalLanes() noexcept {
+        for (auto& [generation, lane] : items)
+            lane->closed.store(true, std::memory_order_release);
+    }
+};
+
+static thread_local LocalLanes t_lanes{};
+
+std::atomic<uint64_t> AsyncLogSink::s_generation{0};
+
+AsyncLogSink::AsyncLogSink(std::vector<spdlog::sink_ptr> sinks, AsyncLogOptions options) noexcept(false)
+    : m_sinks{std::move(sinks)}, m_options{options}, m_generation{++s_generation} {
+    if (m_options.capacity < 2)
+        throw std::invalid_argument{"capacity must be larger than 1"};
+    m_writer = std::thread{&AsyncLogSink::run, this};
+}
+
+AsyncLogSink::~AsyncLogSink() noexcept {
+    m_closed.store(true);
+    m_pushed.fetch_add(1);
+    m_pushed.notify_all();
+    if (m_writer.joinable())
+        m_writer.join();
+    std::lock_guard lck{m_mtx};
+    drain(Lane::idle);
+    for (spdlog::sink_ptr& sink : m_sinks) {
+        try {
+            sink->flush();
+        } catch (...) {
+            // Ignore sink errors in logging
+        }
+    }
+    // the threads will register again if they use the address for another sink
+    std::lock_guard lanes{m_lanesMtx};
+    for (auto& lane : m_lanes)
+        lane->closed.store(true, std::memory_order_release);
+}
+
+AsyncLogSink::Lane& AsyncLogSink::local_lane() noexcept(false) {
+    for (auto& [generation, lane] : t_lanes.items)
+        if (generation == m_generation)
+            return *lane;
+
+    // the queues of the destroyed sinks are not used anymore
+    std::erase_if(t_lanes.items, [](const auto& item) { return item.second->closed.load(); });
+    auto lane = std::make_shared<Lane>(m_options);
+    std::lock_guard lck{m_lanesMtx};
+    m_lanes.emplace_back(lane);
+    t_lanes.items.emplace_back(m_generation, lane);
+    return *lane;
+}
+
+void AsyncLogSink::run() noexcept {
+    SetThreadDescription(GetCurrentThread(), L"AsyncLogSink");
+    while (true) {
+        {
+            std::lock_guard lck{m_mtx};
+            drain(now_ns());
+        }
+        // the producers notify only when the writer is sleeping. See `log`
+        m_sleeping.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const uint32_t pushed = m_pushed.load();
+        if (pending() == false)
+            m_pushed.wait(pushed);
+        m_sleeping.store(false);
+        if (m_closed.load())
+            return;
+    }
+}
+
+bool AsyncLogSink::pending() noexcept {
+    if (m_closed.load())
+        return true;
+    bool held = false;     // by the watermark
+    bool inflight = false; // the producer will notify after its push
+    std::lock_guard lck{m_mtx};
+    std::lock_guard lanes{m_lanesMtx};
+    for (const auto& lane : m_lanes) {
+        if (lane->queue.size() != 0)
+            return true;
+        held |= lane->ready;
+        inflight |= lane->inflight.load() != Lane::idle;
+    }
+    return held && inflight == false;
+}
+
+size_t AsyncLogSink::drain(int64_t watermark) noexcept {
+    {
+        std::lock_guard lck{m_lanesMtx};
+        m_snapshot = m_lanes;
+    }
+    for (const auto& lane : m_snapshot) {
+        const int64_t inflight = lane->inflight.load();
+        if (inflight == Lane::starting)
+            watermark = (std::min)(watermark, m_watermark); // its timestamp can be anything after the last drain
+        else if (inflight != Lane::idle)
+            watermark = (std::min)(watermark, inflight);
+    }
+    // the committed records are older than now. `flush` doesn't move the watermark further
+    m_watermark = (std::max)(m_watermark, (std::min)(watermark, now_ns()));
+
+    // k-way merge of the queues. Each queue is already sorted
+    auto later = [](const std::pair<int64_t, size_t>& lhs, const std::pair<int64_t, size_t>& rhs) {
+        return lhs.first > rhs.first;
+    };
+    auto next = [this, watermark, &later](size_t index) {
+        Lane& lane = *m_snapshot[index];
+        if (lane.ready == false)
+            lane.ready = lane.queue.try_pop(lane.head);
+        if (lane.ready && lane.head.timestamp < watermark) {
+            m_heap.emplace_back(lane.head.timestamp, index);
+            std::push_heap(m_heap.begin(), m_heap.end(), later);
+        }
+    };
+    m_heap.clear();
+    for (size_t i = 0; i < m_snapshot.size(); ++i)
+        next(i);
+    size_t count = 0;
+    while (m_heap.empty() == false) {
+        std::pop_heap(m_heap.begin(), m_heap.end(), later);
+        const size_t index = m_heap.back().second;
+        m_heap.pop_back();
+        Lane& lane = *m_snapshot[index];
+        for (spdlog::sink_ptr& sink : m_sinks) {
+            if (sink->should_log(lane.head.message.level) == false)
+                continue;
+            try {
+                sink->log(lane.head.message);
+            } catch (...) {
+                // Ignore sink errors in logging
+            }
+        }
+        lane.ready = false;
+        ++count;
+        next(index);
+    }
+
+    // the threads have exited
+    std::lock_guard lck{m_lanesMtx};
+    std::erase_if(m_lanes, [this](const std::shared_ptr<Lane>& lane) {
+        if (lane->closed.load(std::memory_order_acquire) == false || lane->ready || lane->queue.size() != 0)
+            return false;
+        add_stats(m_retired, lane->queue.stats());
+        return true;
+    });
+    m_snapshot.clear();
+    return count;
+}
+
+void AsyncLogSink::log(const spdlog::details::log_msg& msg) {
+    Lane& lane = local_lane();
+    // the message refers the caller's memory
+    AsyncLogRecord record{0, spdlog::details::log_msg_buffer{msg}};
+    // the writer must not pass this record while the timestamp is being taken
+    lane.inflight.store(Lane::starting);
+    record.timestamp = now_ns();
+    lane.inflight.store(record.timestamp);
+    try {
+        lane.queue.push(record);
+    } catch (...) {
+        lane.inflight.store(Lane::idle);
+        notify();
+        throw;
+    }
+    lane.inflight.store(Lane::idle);
+    notify();
+}
+
+void AsyncLogSink::notify() noexcept {
+    // pairs with the fence in `run`. Either the writer sees the record, or this thread sees it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_relaxed)) {
+        m_pushed.fetch_add(1);
+        m_pushed.notify_one();
+    }
+}
+
+void AsyncLogSink::flush() {
+    std::lock_guard lck{m_mtx};
+    drain(Lane::idle);
+    for (spdlog::sink_ptr& sink : m_sinks)
+        sink->flush();
+}
+
+void AsyncLogSink::set_pattern(const std::string& pattern) {
+    set_formatter(std::make_unique<spdlog::pattern_formatter>(pattern));
+}
+
+void AsyncLogSink::set_formatter(std::unique_ptr<spdlog::formatter> formatter) {
+    std::lock_guard lck{m_mtx};
+    for (spdlog::sink_ptr& sink : m_sinks)
+        sink->set_formatter(formatter->clone());
+}
+
+void AsyncLogSink::add_sink(spdlog::sink_ptr sink) noexcept(false) {
+    if (sink == nullptr)
+        throw std::invalid_argument{"sink is required"};
+    std::lock_guard lck{m_mtx};
+    m_sinks.emplace_back(std::move(sink));
+}
+
+AsyncLogSink::Stats AsyncLogSink::stats() const noexcept {
+    std::lock_guard lck{m_lanesMtx};
+    Stats stats = m_retired;
+    for (const auto& lane : m_lanes)
+        add_stats(stats, lane->queue.stats());
+    return stats;
+}
+
+size_t AsyncLogSink::lanes() const noexcept {
+    std::lock_guard lck{m_lanesMtx};
+    return m_lanes.size();
+}
+
+} // namespace winrt::App1
@@ -0,0 +1,97 @@
+/**
+ * @file AsyncLogSink.h
+ * @brief spdlog sink which moves the formatting and the writes to a dedicated thread
+ */
+#pragma once
+#include "LogQueue.h"
+
+#include <spdlog/details/log_msg_buffer.h>
+#include <spdlog/sinks/sink.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace winrt::App1 {
+
+struct AsyncLogOptions {
+    size_t capacity = 1024; // messages of each logging thread. preallocated
+    OverflowPolicy policy = OverflowPolicy::Block;
+};
+
+/// @brief The message in the queue of a logging thread
+struct AsyncLogRecord {
+    int64_t timestamp = 0; // nanoseconds of steady_clock. The order of the merge
+    spdlog::details::log_msg_buffer message{};
+};
+
+/**
+ * @brief Copies the messages into the LogQueue of the calling thread. The writer thread merges the queues in the
+ *        order of the timestamps, and forwards them to the wrapped sinks
+ * @details The caller of `log` never formats or writes, and the logging threads never share a queue or a cache line.
+ *          The first `log` of a thread registers its queue with a lock.
+ *          A record is forwarded when it is older than the merge, and older than every record still being pushed,
+ *          so the merged stream stays ordered. The queues of the exited threads are released after they are drained.
+ *          The wrapped sinks are used by the writer thread only, so they can be the `_st` sinks.
+ *          `flush` drains the queues on the calling thread.
+ * @note Use `spdlog::logger::flush_on` for the messages which must be written before the caller continues
+ */
+class AsyncLogSink final : public spdlog::sinks::sink {
+  public:
+    using Stats = LogQueue<AsyncLogRecord>::Stats;
+    struct Lane; // the queue of a logging thread
+
+  private:
+    static std::atomic<uint64_t> s_generation;
+
+    std::vector<spdlog::sink_ptr> m_sinks;
+    AsyncLogOptions m_options;
+    uint64_t m_generation; // the key of the thread-local queues
+    mutable std::mutex m_lanesMtx;
+    std::vector<std::shared_ptr<Lane>> m_lanes{};
+    Stats m_retired{};    // the queues of the exited threads
+    std::mutex m_mtx;     // the wrapped sinks and the merge
+    int64_t m_watermark = INT64_MIN;
+    std::vector<std::shared_ptr<Lane>> m_snapshot{};
+    std::vector<std::pair<int64_t, size_t>> m_heap{};
+    // the writer thread
+    std::atomic<uint32_t> m_pushed{0};
+    std::atomic<bool> m_sleeping{false};
+    std::atomic<bool> m_closed{false};
+    std::thread m_writer{};
+
+    Lane& local_lane() noexcept(false);
+    void run() noexcept;
+    /// @pre `m_mtx` is locked
+    size_t drain(int64_t watermark) noexcept;
+    /// @return true if the writer must not sleep
+    bool pending() noexcept;
+    /// @brief Wake the writer if it is sleeping
+    void notify() noexcept;
+
+  public:
+    AsyncLogSink(std::vector<spdlog::sink_ptr> sinks, AsyncLogOptions options) noexcept(false);
+    /// @note The messages in the queues are written before the writer thread is joined
+    ~AsyncLogSink() noexcept;
+    AsyncLogSink(const AsyncLogSink&) = delete;
+    AsyncLogSink& operator=(const AsyncLogSink&) = delete;
+
+    void log(const spdlog::details::log_msg& msg) override;
+    void flush() override;
+    void set_pattern(const std::string& pattern) override;
+    void set_formatter(std::unique_ptr<spdlog::formatter> formatter) override;
+
+    /// @brief Forward the next messages to the sink too. Its formatter is not changed
+    void add_sink(spdlog::sink_ptr sink) noexcept(false);
+
+    /// @note The sum of the threads
+    Stats stats() const noexcept;
+    /// @return the queues of the live threads
+    size_t lanes() const noexcept;
+};
+
+} // namespace winrt::App1
@@ -7,14 +7,56 @@
 #include "BasicItem.h"
 
 #define SPDLOG_WCHAR_TO_UTF8_SUPPORT
+#include <spdlog/sinks/dist_sink.h>
 #include <spdlog/spdlog.h>
 
+#include "AsyncLogSink.h"
+#include "FlightRecorder.h"
+#include "LogCounterSink.h"
+#include "RotatingFileSink.h"
+#include "TextConvert.h"
+
 using namespace winrt::Windows::Foundation;
 using namespace winrt::Windows::Foundation::Collections;
 using namespace winrt::Windows::Storage;
 
 namespace winrt::Shared1::implementation {
 
+/// @brief The log folder and the items are in the ViewModel channel
+static std::shared_ptr<spdlog::logger> get_logger() noexcept(false) {
+    return App1::get_channel_logger(App1::LogChannel::ViewModel);
+}
+
+/**
+ * @brief Add the segment files in the folder to the default logger. Only once in the process
+ * @details The sinks of the published logger are not changed, because the other threads are using them.
+ *          The file sink is added to the AsyncLogSink or the `dist_sink_mt` which the logger has for the late sinks.
+ * @throws std::logic_error if the default logger has neither of them
+ */
+static void add_log_file_sink(const std::filesystem::path& folder) noexcept(false) {
+    static std::once_flag once{};
+    std::call_once(once, [&folder]() {
+        App1::RotatingFileOptions options{folder, "App"};
+        options.maxSegments = 64; // the archives are small, so the folder can keep the longer history
+        options.compress = true;
+        auto sink = std::make_shared<App1::RotatingFileSink>(std::move(options));
+        // the layout of LogArchive.h. The queries use the time, the level and the channel
+        sink->set_pattern("%Y-%m-%d %T.%e [%L] [%n] %t %v");
+        std::shared_ptr logger = spdlog::default_logger();
+        for (const spdlog::sink_ptr& item : logger->sinks()) {
+            if (auto async = std::dynamic_pointer_cast<App1::AsyncLogSink>(item)) {
+                async->add_sink(std::move(sink));
+                return;
+            }
+            if (auto late = std::dynamic_pointer_cast<spdlog::sinks::dist_sink_mt>(item)) {
+                late->add_sink(std::move(sink));
+                return;
+            }
+        }
+        throw std::logic_error{"the default logger has no sink for the log files"};
+    });
+}
+
 BasicViewModel::BasicViewModel() {
     m_items = winrt::single_threaded_observable_vector<Shared1::BasicItem>();
     InitializeItems();
@@ -38,9 +80,14 @@ IAsyncAction BasicViewModel::CreateLogFolderAsync() {
     try {
         StorageFolder appdata = ApplicationData::Current().LocalFolder();
         m_log_folder = co_await appdata.CreateFolderAsync(L"logs", CreationCollisionOption::OpenIfExists);
-        spdlog::info(L"Log folder created: {}", static_cast<std::wstring_view>(GetLogFolderPath()));
+        const winrt::hstring path = GetLogFolderPath(); // each call of StorageFolder::Path makes a new HSTRING
+        App1::log_buffered(*get_logger(), spdlog::level::info, "Log folder created: {}", path);
+        add_log_file_sink(std::wstring_view{path});
+        App1::set_flight_recorder_folder(std::wstring_view{path});
     } catch (const winrt::hresult_error& ex) {
-        spdlog::error(L"Failed to create logs folder: {}", static_cast<std::wstring_view>(ex.message()));
+        App1::log_buffered(*get_logger(), spdlog::level::err, "Failed to create logs folder: {}", ex.message());
+    } catch (const std::exception& ex) {
+        App1::log_buffered(*get_logger(), spdlog::level::err, "Failed to open the log file: {}", ex.what());
     }
 }
 
@@ -0,0 +1,342 @@
+#include "pch.h"
+
+#include "BinaryLog.h"
+#include "TextConvert.h"
+
+#include <deque>
+#include <format>
+#include <stdexcept>
+#include <variant>
+
+namespace winrt::App1 {
+
+enum class RecordKind : uint8_t {
+    Descriptor = 1,
+    Event = 2,
+};
+
+static constexpr size_t c_HeaderSize = 16;
+
+static std::mutex g_descriptors_mtx{};
+static std::deque<BinaryLogDescriptor> g_descriptors{}; // the elements are not moved
+
+uint32_t register_log_descriptor(const BinaryLogDescriptor& descriptor) noexcept(false) {
+    std::lock_guard lck{g_descriptors_mtx};
+    g_descriptors.emplace_back(descriptor);
+    return static_cast<uint32_t>(g_descriptors.size() - 1);
+}
+
+static const BinaryLogDescriptor& get_log_descriptor(uint32_t id) noexcept(false) {
+    std::lock_guard lck{g_descriptors_mtx};
+    return g_descriptors.at(id);
+}
+
+template <typename T>
+static void put(std::vector<std::byte>& out, T value) noexcept(false) {
+    const auto ptr = reinterpret_cast<const std::byte*>(&value);
+    out.insert(out.end(), ptr, ptr + sizeof(T));
+}
+
+static void put_varint(std::vector<std::byte>& out, uint64_t value) noexcept(false) {
+    for (; value >= 0x80; value >>= 7)
+        out.emplace_back(static_cast<std::byte>(value | 0x80));
+    out.emplace_back(static_cast<std::byte>(value));
+}
+
+static uint64_t to_zigzag(int64_t value) noexcept {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t from_zigzag(uint64_t value) noexcept {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+static void put_string(std::vector<std::byte>& out, std::string_view value) noexcept(false) {
+    const auto size = static_cast<uint16_t>((std::min<size_t>)(value.size(), UINT16_MAX));
+    put(out, size);
+    const auto ptr = reinterpret_cast<const std::byte*>(value.data());
+    out.insert(out.end(), ptr, ptr + size);
+}
+
+BinaryLogWriter::BinaryLogWriter(std::ostream& out, size_t batchSize) noexcept(false)
+    : m_out{out}, m_batchSize{batchSize}, m_start{Clock::now()} {
+    m_batch.reserve(m_batchSize + BinaryLogPayload::capacity);
+    const auto start = std::chrono::system_clock::now().time_since_epoch();
+    put(m_batch, magic);
+    put(m_batch, format_version);
+    put(m_batch, static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(start).count()));
+    m_bytes = m_batch.size();
+}
+
+BinaryLogWriter::~BinaryLogWriter() noexcept {
+    try {
+        flush();
+    } catch (...) {
+        // Ignore stream errors in logging
+    }
+}
+
+void BinaryLogWriter::write_descriptor(uint32_t id) noexcept(false) {
+    const BinaryLogDescriptor& descriptor = get_log_descriptor(id);
+    put(m_batch, RecordKind::Descriptor);
+    put(m_batch, id);
+    put(m_batch, descriptor.level);
+    put(m_batch, descriptor.line);
+    put_string(m_batch, descriptor.file);
+    put_string(m_batch, descriptor.format);
+    if (m_written.size() <= id)
+        m_written.resize(id + 1, false);
+    m_written[id] = true;
+}
+
+void BinaryLogWriter::append(uint32_t id, Clock::time_point time, std::span<const std::byte> payload) noexcept(false) {
+    const auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(time - m_start).count();
+    std::lock_guard lck{m_mtx};
+    const size_t before = m_batch.size();
+    if (id >= m_written.size() || m_written[id] == false)
+        write_descriptor(id);
+    put(m_batch, RecordKind::Event);
+    put_varint(m_batch, id);
+    put_varint(m_batch, to_zigzag(timestamp - m_last)); // the other thread may have taken the lock first
+    put_varint(m_batch, payload.size());
+    m_last = timestamp;
+    m_batch.insert(m_batch.end(), payload.begin(), payload.end());
+    m_bytes += m_batch.size() - before;
+    ++m_events;
+    if (m_batch.size() >= m_batchSize) {
+        m_out.write(reinterpret_cast<const char*>(m_batch.data()), static_cast<std::streamsize>(m_batch.size()));
+        m_batch.clear();
+    }
+}
+
+void BinaryLogWriter::flush() noexcept(false) {
+    std::lock_guard lck{m_mtx};
+    m_out.write(reinterpret_cast<const char*>(m_batch.data()), static_cast<std::streamsize>(m_batch.size()));
+    m_out.flush();
+    m_batch.clear();
+}
+
+uint64_t BinaryLogWriter::size() const noexcept {
+    std::lock_guard lck{m_mtx};
+    return m_bytes;
+}
+
+uint64_t BinaryLogWriter::event_count() const noexcept {
+    std::lock_guard lck{m_mtx};
+    return m_events;
+}
+
+/// @brief Sequential reader of the stream. `ok` becomes false at the end of the data
+class RecordReader final {
+    std::span<const std::byte> m_data;
+    size_t m_offset;
+
+  public:
+    bool ok = true;
+
+    RecordReader(std::span<const std::byte> data, size_t offset) noexcept : m_data{data}, m_offset{offset} {
+    }
+
+    template <typename T>
+    T read() noexcept {
+        T value{};
+        if (ok == false || m_data.size() - m_offset < sizeof(T)) {
+            ok = false;
+            return value;
+        }
+        std::memcpy(&value, m_data.data() + m_offset, sizeof(T));
+        m_offset += sizeof(T);
+        return value;
+    }
+    std::span<const std::byte> read_bytes(size_t size) noexcept {
+        if (ok == false || m_data.size() - m_offset < size) {
+            ok = false;
+            return {};
+        }
+        std::span<const std::byte> bytes = m_data.subspan(m_offset, size);
+        m_offset += size;
+        return bytes;
+    }
+    uint64_t read_varint() noexcept {
+        uint64_t value = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7) {
+            const auto b = static_cast<uint8_t>(read<std::byte>());
+            value |= uint64_t{b & 0x7Fu} << shift;
+            if ((b & 0x80) == 0)
+                return value;
+        }
+        ok = false;
+        return value;
+    }
+    std::string_view read_string() noexcept {
+        const uint16_t size = read<uint16_t>();
+        std::span<const std::byte> bytes = read_bytes(size);
+        return {reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+    }
+    bool done() const noexcept {
+        return m_offset == m_data.size();
+    }
+};
+
+/// @note The unpaired surrogates become U+FFFD
+static std::string decode_utf16(std::span<const std::byte> units) noexcept(false) {
+    std::u16string text(units.size() / 2, u'\0');
+    std::memcpy(text.data(), units.data(), text.size() * 2);
+    return to_utf8(text);
+}
+
+using DecodedArg = std::variant<int64_t, uint64_t, double, bool, std::string>;
+
+static std::vector<DecodedArg> decode_args(std::span<const std::byte> payload) noexcept(false) {
+    using Tag = BinaryLogPayload::Tag;
+    std::vector<DecodedArg> args{};
+    RecordReader reader{payload, 0};
+    while (reader.done() == false) {
+        const auto tag = reader.read<Tag>();
+        switch (tag) {
+        case Tag::Int:
+            args.emplace_back(from_zigzag(reader.read_varint()));
+            break;
+        case Tag::UInt:
+            args.emplace_back(reader.read_varint());
+            break;
+        case Tag::Float:
+            args.emplace_back(reader.read<double>());
+            break;
+        case Tag::Bool:
+            args.emplace_back(reader.read<uint8_t>() != 0);
+            break;
+        case Tag::String: {
+            std::span<const std::byte> units = reader.read_bytes(reader.read_varint());
+            args.emplace_back(std::string{reinterpret_cast<const char*>(units.data()), units.size()});
+            break;
+        }
+        case Tag::WString:
+            args.emplace_back(decode_utf16(reader.read_bytes(reader.read_varint() * 2)));
+            break;
+        default:
+            throw std::invalid_argument{"binary log argument tag is unknown"};
+        }
+        if (reader.ok == false)
+            throw std::invalid_argument{"binary log arguments are truncated"};
+    }
+    return args;
+}
+
+/// @brief std::format for each replacement field. The arguments are known at runtime only
+static std::string render(std::string_view format, const std::vector<DecodedArg>& args) noexcept(false) {
+    std::string out{};
+    size_t next = 0;
+    for (size_t i = 0; i < format.size(); ++i) {
+        const char c = format[i];
+        if (c == '}' && i + 1 < format.size() && format[i + 1] == '}') {
+            out += '}';
+            ++i;
+            continue;
+        }
+        if (c != '{') {
+            out += c;
+            continue;
+        }
+        if (i + 1 < format.size() && format[i + 1] == '{') {
+            out += '{';
+            ++i;
+            continue;
+        }
+        const size_t end = format.find('}', i);
+        if (end == std::string_view::npos) {
+            out.append(format.substr(i));
+            break;
+        }
+        const std::string_view field = format.substr(i + 1, end - i - 1);
+        const size_t colon = field.find(':');
+        const std::string_view index = field.substr(0, colon);
+        const size_t position = index.empty() ? next++ : static_cast<size_t>(std::stoul(std::string{index}));
+        i = end;
+        if (position >= args.size()) {
+            out += "{?}";
+            continue;
+        }
+        const std::string spec = colon == std::string_view::npos ? "{}" : std::format("{{{}}}", field.substr(colon));
+        try {
+            std::visit([&out, &spec](const auto& value) { out += std::vformat(spec, std::make_format_args(value)); },
+                       args[position]);
+        } catch (const std::format_error&) {
+            out += "{?}";
+        }
+    }
+    return out;
+}
+
+DecodedLog decode_binary_log(std::span<const std::byte> data) noexcept(false) {
+    RecordReader header{data, 0};
+    if (header.read<uint32_t>() != BinaryLogWriter::magic)
+        throw std::invalid_argument{"binary log magic mismatch"};
+    if (header.read<uint32_t>() != BinaryLogWriter::format_version)
+        throw std::invalid_argument{"binary log version mismatch"};
+    const auto start = std::chrono::nanoseconds{header.read<int64_t>()};
+    if (header.ok == false)
+        throw std::invalid_argument{"binary log is too small"};
+
+    struct Descriptor {
+        BinaryLogLevel level;
+        uint32_t line;
+        std::string_view file;
+        std::string_view format;
+    };
+    std::vector<Descriptor> descriptors{};
+    DecodedLog log{};
+    log.start = std::chrono::system_clock::time_point{
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(start)};
+    RecordReader reader{data, c_HeaderSize};
+    int64_t timestamp = 0;
+    // a truncated record at the end is ignored. The writer may have stopped in the middle
+    while (reader.done() == false) {
+        const auto kind = reader.read<RecordKind>();
+        if (kind == RecordKind::Descriptor) {
+            const auto id = reader.read<uint32_t>();
+            Descriptor descriptor{};
+            descriptor.level = reader.read<BinaryLogLevel>();
+            descriptor.line = reader.read<uint32_t>();
+            descriptor.file = reader.read_string();
+            descriptor.format = reader.read_string();
+            if (reader.ok == false)
+                break;
+            if (descriptors.size() <= id)
+                descriptors.resize(id + 1);
+            descriptors[id] = descriptor;
+        } else if (kind == RecordKind::Event) {
+            const uint64_t id = reader.read_varint();
+            const int64_t delta = from_zigzag(reader.read_varint());
+            std::span<const std::byte> payload = reader.read_bytes(reader.read_varint());
+            if (reader.ok == false)
+                break;
+            if (id >= descriptors.size() || descriptors[id].format.data() == nullptr)
+                throw std::invalid_argument{"binary log event has no descriptor"};
+            const Descriptor& descriptor = descriptors[id];
+            timestamp += delta;
+            log.records.emplace_back(DecodedLogRecord{std::chrono::nanoseconds{timestamp}, descriptor.level,
+                                                      std::string{descriptor.file}, descriptor.line,
+                                                      render(descriptor.format, decode_args(payload))});
+        } else {
+            throw std::invalid_argument{"binary log record kind is unknown"};
+        }
+    }
+    return log;
+}
+
+std::string render_binary_log(std::span<const std::byte> data) noexcept(false) {
+    static constexpr char levels[] = "TDIWEC";
+    const DecodedLog log = decode_binary_log(data);
+    std::string text{};
+    for (const DecodedLogRecord& record : log.records) {
+        const auto time = std::chrono::floor<std::chrono::milliseconds>(
+            log.start + std::chrono::duration_cast<std::chrono::system_clock::duration>(record.timestamp));
+        const auto level = static_cast<size_t>(record.level);
+        std::format_to(std::back_inserter(text), "{:%T} [{}] {}\n", time, level < 6 ? levels[level] : '?',
+                       record.text);
+    }
+    return text;
+}
+
+} // namespace winrt::App1
@@ -0,0 +1,259 @@
+/**
+ * @file BinaryLog.h
+ * @brief Structured binary log. The call sites emit the raw arguments, and the text is rendered offline
+ * @details The format string of a call site is registered once as a descriptor. Each log call writes only
+ *          the descriptor id, the timestamp and the arguments. `render_binary_log` (or scripts/decode-binlog.ps1)
+ *          formats them later.
+ *
+ *  The stream layout is (little endian. "var" is LEB128, "zvar" is zigzag LEB128)
+ *  - header: magic "BLOG"(u32), format version(u32), start time(i64, nanoseconds since the UNIX epoch)
+ *  - descriptor record: kind 1(u8), id(u32), level(u8), line(u32), file size(u16), file, format size(u16), format
+ *  - event record: kind 2(u8), id(var), timestamp(zvar, nanoseconds from the previous event), payload size(var),
+ *                  payload
+ *  - payload: the arguments. tag(u8) and the value
+ *    - 1 int(zvar), 2 unsigned(var), 3 f64, 4 bool(u8), 5 UTF-8 string, 6 UTF-16 string
+ *    - string: count(var) and the code units
+ *
+ *  A descriptor record is written before the first event of the id, so the stream is self-contained.
+ * @note Standard C++ only
+ */
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace winrt::App1 {
+
+/// @note Same values as `spdlog::level::level_enum`
+enum class BinaryLogLevel : uint8_t {
+    Trace,
+    Debug,
+    Info,
+    Warn,
+    Error,
+    Critical,
+};
+
+/// @brief Static information of a call site. Must outlive the process's log calls
+struct BinaryLogDescriptor {
+    BinaryLogLevel level;
+    std::string_view format; // std::format syntax
+    std::string_view file;
+    uint32_t line;
+};
+
+/**
+ * @brief Register the call site in the process-wide table
+ * @return id of the descriptor. Use `BINLOG_ID` instead of calling this directly
+ */
+uint32_t register_log_descriptor(const BinaryLogDescriptor& descriptor) noexcept(false);
+
+/// @brief Descriptor id of the call site. The registration happens once
+#define BINLOG_ID(level, format)                                                                                       \
+    []() -> uint32_t {                                                                                                 \
+        static const uint32_t id = ::winrt::App1::register_log_descriptor(                                             \
+            ::winrt::App1::BinaryLogDescriptor{level, format, __FILE__, __LINE__});                                    \
+        return id;                                                                                                     \
+    }()
+
+/**
+ * @brief Raw arguments of an event in a fixed buffer. No allocation
+ * @details The strings are truncated when the payload is full. The arguments after that are dropped
+ * @tparam Capacity bytes of the buffer
+ */
+template <size_t Capacity>
+class BasicBinaryLogPayload final {
+  public:
+    static constexpr size_t capacity = Capacity;
+    static_assert(capacity >= 16 && capacity < 16384, "the string count must fit in 2 bytes of LEB128");
+
+    enum class Tag : uint8_t {
+        Int = 1,
+        UInt = 2,
+        Float = 3,
+        Bool = 4,
+        String = 5,
+        WString = 6,
+    };
+
+  private:
+    std::byte m_data[capacity];
+    size_t m_size = 0;
+
+    bool fits(size_t size) const noexcept {
+        return m_size + size <= capacity;
+    }
+    void put_varint(uint64_t value) noexcept {
+        for (; value >= 0x80; value >>= 7)
+            m_data[m_size++] = static_cast<std::byte>(value | 0x80);
+        m_data[m_size++] = static_cast<std::byte>(value);
+    }
+    void put_tag(Tag tag) noexcept {
+        m_data[m_size++] = static_cast<std::byte>(tag);
+    }
+    template <typename CharT>
+    void put_string(Tag tag, std::basic_string_view<CharT> value) noexcept {
+        constexpr size_t unit = sizeof(char16_t) < sizeof(CharT) ? sizeof(char16_t) : sizeof(CharT);
+        if (fits(3) == false) // tag and count. The count is less than 2^14
+            return;
+        const size_t count = (std::min)(value.size(), (capacity - m_size - 3) / unit);
+        put_tag(tag);
+        put_varint(count);
+        if constexpr (sizeof(CharT) == unit) {
+            std::memcpy(m_data + m_size, value.data(), count * unit);
+            m_size += count * unit;
+        } else {
+            // wchar_t is UTF-32 on the other platforms. The code points over U+FFFF are not preserved
+            for (size_t i = 0; i < count; ++i) {
+                const auto c = static_cast<char16_t>(value[i]);
+                std::memcpy(m_data + m_size, &c, unit);
+                m_size += unit;
+            }
+        }
+    }
+
+  public:
+    void append(bool value) noexcept {
+        if (fits(2) == false)
+            return;
+        put_tag(Tag::Bool);
+        m_data[m_size++] = static_cast<std::byte>(value);
+    }
+    template <typename T>
+        requires std::is_integral_v<T>
+    void append(T value) noexcept {
+        if (fits(11) == false)
+            return;
+        if constexpr (std::is_signed_v<T>) {
+            const auto v = static_cast<int64_t>(value);
+            put_tag(Tag::Int);
+            put_varint((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63)); // zigzag
+        } else {
+            put_tag(Tag::UInt);
+            put_varint(static_cast<uint64_t>(value));
+        }
+    }
+    template <typename T>
+        requires std::is_floating_point_v<T>
+    void append(T value) noexcept {
+        if (fits(9) == false)
+            return;
+        const auto v = static_cast<double>(value);
+        put_tag(Tag::Float);
+        std::memcpy(m_data + m_size, &v, sizeof(v));
+        m_size += sizeof(v);
+    }
+    template <typename T>
+        requires std::is_enum_v<T>
+    void append(T value) noexcept {
+        append(static_cast<std::underlying_type_t<T>>(value));
+    }
+    void append(std::string_view value) noexcept {
+        put_string(Tag::String, value);
+    }
+    void append(const char* value) noexcept {
+        put_string(Tag::String, std::string_view{value});
+    }
+    void append(std::wstring_view value) noexcept {
+        put_string(Tag::WString, value);
+    }
+    void append(const wchar_t* value) noexcept {
+        put_string(Tag::WString, std::wstring_view{value});
+    }
+    void append(const void* value) noexcept {
+        append(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value)));
+    }
+
+    std::span<const std::byte> bytes() const noexcept {
+        return {m_data, m_size};
+    }
+};
+
+using BinaryLogPayload = BasicBinaryLogPayload<512>;
+
+/**
+ * @brief Writes the records to a stream in batches
+ * @details The arguments are encoded without the lock. The lock only covers the copy to the batch buffer
+ */
+class BinaryLogWriter final {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+  private:
+    std::ostream& m_out;
+    size_t m_batchSize;
+    Clock::time_point m_start;
+    mutable std::mutex m_mtx;
+    std::vector<std::byte> m_batch{};
+    std::vector<bool> m_written{}; // descriptors in the stream
+    int64_t m_last = 0;            // timestamp of the previous event
+    uint64_t m_bytes = 0;
+    uint64_t m_events = 0;
+
+    void write_descriptor(uint32_t id) noexcept(false);
+
+  public:
+    static constexpr uint32_t magic = 0x474F4C42; // "BLOG"
+    static constexpr uint32_t format_version = 1;
+
+    /// @param batchSize bytes. The batch is written to the stream when it grows over
+    BinaryLogWriter(std::ostream& out, size_t batchSize = 64 * 1024) noexcept(false);
+    /// @note The remaining batch is written
+    ~BinaryLogWriter() noexcept;
+    BinaryLogWriter(const BinaryLogWriter&) = delete;
+    BinaryLogWriter& operator=(const BinaryLogWriter&) = delete;
+
+    template <typename... Args>
+    void write(uint32_t id, const Args&... args) noexcept(false) {
+        const Clock::time_point time = Clock::now();
+        BinaryLogPayload payload;
+        (payload.append(args), ...);
+        append(id, time, payload.bytes());
+    }
+
+    /**
+     * @brief Write an event which is encoded already
+     * @param time when the event happened. It can be older than the writer, like the records of FlightRecorder
+     */
+    void append(uint32_t id, Clock::time_point time, std::span<const std::byte> payload) noexcept(false);
+
+    void flush() noexcept(false);
+
+    /// @return bytes written to the stream and the batch
+    uint64_t size() const noexcept;
+    uint64_t event_count() const noexcept;
+};
+
+/// @brief Event with the text rendered from the descriptor
+struct DecodedLogRecord {
+    std::chrono::nanoseconds timestamp; // since the start of the writer
+    BinaryLogLevel level;
+    std::string file;
+    uint32_t line;
+    std::string text;
+};
+
+struct DecodedLog {
+    std::chrono::system_clock::time_point start;
+    std::vector<DecodedLogRecord> records;
+};
+
+/**
+ * @brief Decode the stream of BinaryLogWriter and format the events
+ * @throws std::invalid_argument if the data is not a valid stream. A truncated tail record is ignored
+ */
+DecodedLog decode_binary_log(std::span<const std::byte> data) noexcept(false);
+
+/// @brief Text lines like the spdlog pattern "%T.%e [%L] %v"
+std::string render_binary_log(std::span<const std::byte> data) noexcept(false);
+
+} // namespace winrt::App1
@@ -17,6 +17,7 @@
 #include "pch.h"
 
 #include "DeviceResources.h"
+#include "FlightRecorder.h"
 
 #include <dxgidebug.h>
 #include <format>
@@ -38,6 +39,10 @@ bool DeviceResources::IsTearingSupported() const noexcept {
     return m_options & c_AllowTearing;
 }
 
+bool DeviceResources::IsOffscreen() const noexcept {
+    return m_options & c_Offscreen;
+}
+
 IDXGIAdapter1* DeviceResources::GetAdapter() const noexcept {
     return m_adapter.get();
 }
@@ -332,8 +337,10 @@ void DeviceResources::CreateWindowSizeDependentResources(UINT width, UINT height
     UINT backBufferHeight = max(m_outputSize.bottom - m_outputSize.top, 1);
     DXGI_FORMAT backBufferFormat = NoSRGB(m_backBufferFormat);
 
-    // If the swap chain already exists, resize it, otherwise create one.
-    if (m_swapChain) {
+    // The offscreen mode uses textures. If the swap chain already exists, resize it, otherwise create one.
+    if (m_options & c_Offscreen) {
+        CreateOffscreenTargets(backBufferWidth, backBufferHeight);
+    } else if (m_swapChain) {
         // If the swap chain already exists, resize it.
         HRESULT hr = m_swapChain->ResizeBuffers(m_backBufferCount, backBufferWidth, backBufferHeight, backBufferFormat,
                                                 (m_options & c_AllowTearing) ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0);
@@ -345,6 +352,8 @@ void DeviceResources::CreateWindowSizeDependentResources(UINT width, UINT height
                        (hr == DXGI_ERROR_DEVICE_REMOVED) ? m_d3dDevice->GetDeviceRemovedReason() : hr);
             OutputDebugStringW(buff);
 #endif
+            FLIGHT_RECORD(winrt::App1::BinaryLogLevel::Error, "Device Lost on ResizeBuffers: {:#010x}",
+                          static_cast<uint32_t>(hr));
             // If the device was removed for any reason, a new device and swap chain will need to be created.
             HandleDeviceLost();
 
@@ -387,7 +396,8 @@ void DeviceResources::CreateWindowSizeDependentResources(UINT width, UINT height
     // Obtain the back buffers for this window which will be the final render targets
     // and create render target views for each of them.
     for (UINT n = 0; n < m_backBufferCount; n++) {
-        winrt::check_hresult(m_swapChain->GetBuffer(n, __uuidof(ID3D12Resource), m_renderTargets[n].put_void()));
+        if (m_swapChain)
+            winrt::check_hresult(m_swapChain->GetBuffer(n, __uuidof(ID3D12Resource), m_renderTargets[n].put_void()));
 
         std::wstring name = std::format(L"Render Target {}", n);
         m_renderTargets[n]->SetName(name.c_str());
@@ -401,8 +411,8 @@ void DeviceResources::CreateWindowSizeDependentResources(UINT width, UINT height
         m_d3dDevice->CreateRenderTargetView(m_renderTargets[n].get(), &rtvDesc, rtvDescriptor);
     }
 
-    // Reset the index to the current back buffer.
-    m_backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+    // Reset the index to the current back buffer. The offscreen targets start from the first one
+    m_backBufferIndex = m_swapChain ? m_swapChain->GetCurrentBackBufferIndex() : 0;
 
     if (m_depthBufferFormat != DXGI_FORMAT_UNKNOWN) {
         // Allocate a 2-D surface as the depth/stencil buffer and create a depth/stencil view
@@ -447,7 +457,24 @@ void DeviceResources::CreateWindowSizeDependentResources(UINT width, UINT height
     m_scissorRect.bottom = backBufferHeight;
 }
 
+// Creates the textures which replace the swap chain buffers. They are in the PRESENT(COMMON) state like the buffers.
+void DeviceResources::CreateOffscreenTargets(UINT width, UINT height) noexcept(false) {
+    // Unlike the swap chain buffers, the view format must be same with the resource format.
+    CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+    D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Tex2D(m_backBufferFormat, width, height, 1, 1);
+    desc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+
+    for (UINT n = 0; n < m_backBufferCount; n++) {
+        winrt::check_hresult(m_d3dDevice->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &desc,
+                                                                  D3D12_RESOURCE_STATE_PRESENT, nullptr,
+                                                                  __uuidof(ID3D12Resource),
+                                                                  m_renderTargets[n].put_void()));
+    }
+}
+
 void DeviceResources::HandleDeviceLost() {
+    // the records before the removal. The device is recreated below
+    winrt::App1::dump_flight_recorder("device-lost");
     if (m_deviceNotify) {
         m_deviceNotify->OnDeviceLost();
     }
@@ -489,6 +516,7 @@ void DeviceResources::HandleDeviceLost() {
 }
 
 void DeviceResources::Prepare(D3D12_RESOURCE_STATES beforeState) noexcept {
+    winrt::App1::get_flight_recorder().mark_frame(m_fenceValues[m_backBufferIndex]);
     // Reset command list and allocator.
     winrt::check_hresult(m_commandAllocators[m_backBufferIndex]->Reset());
     winrt::check_hresult(m_commandList->Reset(m_commandAllocators[m_backBufferIndex].get(), nullptr));
@@ -512,7 +540,10 @@ void DeviceResources::Present(D3D12_RESOURCE_STATES beforeState) noexcept(false)
     ExecuteCommandList();
 
     HRESULT hr;
-    if (m_options & c_AllowTearing) {
+    if (m_options & c_Offscreen) {
+        // Nothing to show. Without Present, the device removal is reported by the device.
+        hr = m_d3dDevice->GetDeviceRemovedReason();
+    } else if (m_options & c_AllowTearing) {
         // Recommended to always use tearing if supported when using a sync interval of 0.
         // Note this will fail if in true 'fullscreen' mode.
         hr = m_swapChain->Present(0, DXGI_PRESENT_ALLOW_TEARING);
@@ -531,6 +562,8 @@ void DeviceResources::Present(D3D12_RESOURCE_STATES beforeState) noexcept(false)
                    (hr == DXGI_ERROR_DEVICE_REMOVED) ? m_d3dDevice->GetDeviceRemovedReason() : hr);
         OutputDebugStringW(buff);
 #endif
+        FLIGHT_RECORD(winrt::App1::BinaryLogLevel::Error, "Device Lost on Present: {:#010x}",
+                      static_cast<uint32_t>(hr));
         HandleDeviceLost();
     } else {
         winrt::check_hresult(hr);
@@ -567,8 +600,12 @@ void DeviceResources::MoveToNextFrame() {
     const UINT64 currentFenceValue = m_fenceValues[m_backBufferIndex];
     winrt::check_hresult(m_commandQueue->Signal(m_fence.get(), currentFenceValue));
 
-    // Update the back buffer index.
-    m_backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+    // Update the back buffer index. The offscreen targets are used in round-robin.
+    if (m_swapChain) {
+        m_backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+    } else {
+        m_backBufferIndex = (m_backBufferIndex + 1) % m_backBufferCount;
+    }
 
     // If the next frame is not ready to be rendered yet, wait until it is ready.
     if (m_fence->GetCompletedValue() < m_fenceValues[m_backBufferIndex]) {
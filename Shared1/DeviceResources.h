@@ -39,6 +39,10 @@ class DeviceResources {
   public:
     static constexpr UINT c_AllowTearing = 0x1;
     static constexpr UINT c_RequireTearingSupport = 0x2;
+    /// @brief No swap chain. Render into a ring of textures, for the batch or headless output
+    /// @details `Present` submits the frame and moves to the next texture without showing it.
+    ///          Frames are pipelined up to the back buffer count. Same value with Shared2
+    static constexpr UINT c_Offscreen = 0x8;
 
     DeviceResources(DXGI_FORMAT backBufferFormat, DXGI_FORMAT depthBufferFormat, UINT backBufferCount,
                     D3D_FEATURE_LEVEL minFeatureLevel = D3D_FEATURE_LEVEL_12_0, UINT flags = 0) noexcept(false);
@@ -47,6 +51,7 @@ class DeviceResources {
     // Configures the Direct3D device, and stores handles to it and the device context.
     void CreateDeviceResources() noexcept(false);
     // These resources need to be recreated every time the window size is changed.
+    // With c_Offscreen, the render targets are textures of the given size.
     void CreateWindowSizeDependentResources(UINT width, UINT height) noexcept(false);
     // Recreate all device resources and set them back to the current state.
     void HandleDeviceLost();
@@ -54,7 +59,7 @@ class DeviceResources {
 
     // Prepare the command list and render target for rendering.
     void Prepare(D3D12_RESOURCE_STATES beforeState = D3D12_RESOURCE_STATE_PRESENT) noexcept;
-    // Present the contents of the swap chain to the screen.
+    // Present the contents of the swap chain to the screen. With c_Offscreen, submit the frame only.
     void Present(D3D12_RESOURCE_STATES beforeState = D3D12_RESOURCE_STATE_RENDER_TARGET) noexcept(false);
     // Send the command list off to the GPU for processing.
     void ExecuteCommandList() noexcept;
@@ -64,6 +69,7 @@ class DeviceResources {
     RECT GetOutputSize() const noexcept;
     bool IsWindowVisible() const noexcept;
     bool IsTearingSupported() const noexcept;
+    bool IsOffscreen() const noexcept;
 
     // Direct3D Accessors.
     IDXGIAdapter1* GetAdapter() const noexcept;
@@ -91,6 +97,7 @@ class DeviceResources {
   private:
     // Prepare to render the next frame.
     void MoveToNextFrame();
+    void CreateOffscreenTargets(UINT width, UINT height) noexcept(false);
     void InitializeDXGIAdapter();
     void InitializeAdapter(IDXGIAdapter1** ppAdapter,
                            DXGI_GPU_PREFERENCE preference = DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE) noexcept(false);
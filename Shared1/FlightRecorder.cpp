@@ -0,0 +1,120 @@
+#include "pch.h"
+
+#include "FlightRecorder.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <mutex>
+
+namespace winrt::App1 {
+
+FlightRecorder::FlightRecorder(size_t capacity) noexcept(false)
+    : m_slots{std::make_unique<Slot[]>(std::bit_ceil((std::max)(capacity, size_t{2})))},
+      m_mask{std::bit_ceil((std::max)(capacity, size_t{2})) - 1} {
+}
+
+void FlightRecorder::append(uint32_t id, Clock::time_point time, std::span<const std::byte> payload) noexcept {
+    const uint64_t index = m_next.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = m_slots[index & m_mask];
+    // the writer of the previous lap may be still in the slot, or the next lap may have taken it. Don't wait
+    uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    if ((sequence & 1) != 0 || sequence > 2 * index ||
+        slot.sequence.compare_exchange_strong(sequence, 2 * index + 1, std::memory_order_relaxed) == false) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const size_t size = (std::min)(payload.size(), payload_capacity);
+    const size_t count = 2 + (size + sizeof(uint64_t) - 1) / sizeof(uint64_t); // only the used words
+    uint64_t words[word_count];
+    words[0] = static_cast<uint64_t>(time.time_since_epoch().count());
+    words[1] = id | (uint64_t{size} << 32);
+    if (size > 0)
+        words[count - 1] = 0; // the tail of the last payload word. Not `words[1]` of the empty payload
+    std::memcpy(words + 2, payload.data(), size);
+    for (size_t i = 0; i < count; ++i)
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+void FlightRecorder::mark_frame(uint64_t frame) noexcept {
+    record(BINLOG_ID(BinaryLogLevel::Trace, "frame {}"), frame);
+}
+
+size_t FlightRecorder::capacity() const noexcept {
+    return m_mask + 1;
+}
+
+FlightRecorder::Stats FlightRecorder::stats() const noexcept {
+    const uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+    return Stats{m_next.load(std::memory_order_relaxed) - dropped, dropped};
+}
+
+size_t FlightRecorder::dump(std::ostream& out) const noexcept(false) {
+    const uint64_t end = m_next.load(std::memory_order_acquire);
+    const uint64_t begin = end > capacity() ? end - capacity() : 0;
+    BinaryLogWriter writer{out};
+    size_t count = 0;
+    for (uint64_t index = begin; index < end; ++index) {
+        const Slot& slot = m_slots[index & m_mask];
+        const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before != 2 * index + 2) // being written, or overwritten by the next lap
+            continue;
+        uint64_t words[word_count]{};
+        words[0] = slot.words[0].load(std::memory_order_relaxed);
+        words[1] = slot.words[1].load(std::memory_order_relaxed);
+        const size_t size = (std::min)(static_cast<size_t>(words[1] >> 32), payload_capacity);
+        for (size_t i = 2; i < 2 + (size + sizeof(uint64_t) - 1) / sizeof(uint64_t); ++i)
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != before)
+            continue;
+        const Clock::time_point time{Clock::duration{static_cast<Clock::rep>(words[0])}};
+        writer.append(static_cast<uint32_t>(words[1]), time, {reinterpret_cast<const std::byte*>(words + 2), size});
+        ++count;
+    }
+    writer.flush();
+    return count;
+}
+
+static std::mutex g_folder_mtx{};
+static std::filesystem::path g_folder{};
+
+FlightRecorder& get_flight_recorder() noexcept(false) {
+    static FlightRecorder recorder{};
+    return recorder;
+}
+
+void set_flight_recorder_folder(const std::filesystem::path& folder) noexcept(false) {
+    std::lock_guard lck{g_folder_mtx};
+    g_folder = folder;
+}
+
+std::filesystem::path dump_flight_recorder(std::string_view reason) noexcept {
+    try {
+        std::filesystem::path folder{};
+        {
+            std::lock_guard lck{g_folder_mtx};
+            folder = g_folder;
+        }
+        if (folder.empty())
+            folder = std::filesystem::temp_directory_path();
+        const auto now = std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now());
+        std::filesystem::path path = folder / std::format("flight-{:%Y%m%d-%H%M%S}-{}.binlog", now, reason);
+        std::ofstream out{path, std::ios::binary | std::ios::trunc};
+        if (out.is_open() == false)
+            return {};
+        get_flight_recorder().dump(out);
+        if (out.good() == false)
+            return {};
+        return path;
+    } catch (...) {
+        return {}; // the caller is handling the other failure already
+    }
+}
+
+} // namespace winrt::App1
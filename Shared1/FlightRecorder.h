@@ -0,0 +1,109 @@
+/**
+ * @file FlightRecorder.h
+ * @brief Always-on ring of the recent binary log records and the frame markers
+ * @details The records are kept in memory only, and written to a file when something goes wrong.
+ *          A record is the descriptor id, the timestamp and the payload of BinaryLog.h. So the dump is a binary log
+ *          stream, and `render_binary_log` or scripts/decode-binlog.ps1 can read it.
+ *
+ *  The writers don't take a lock. Each one claims a slot with `fetch_add` and publishes it with the sequence of the
+ *  slot, like SeqLock. When the ring wraps, the oldest records are overwritten.
+ * @note Standard C++ only
+ */
+#pragma once
+#include "BinaryLog.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string_view>
+
+namespace winrt::App1 {
+
+class FlightRecorder final {
+  public:
+    using Clock = BinaryLogWriter::Clock;
+
+    static constexpr size_t slot_size = 256;
+    static constexpr size_t header_size = 16;         // timestamp(i64), id(u32), payload size(u16), reserved(u16)
+    static constexpr size_t word_count = (slot_size - sizeof(uint64_t)) / sizeof(uint64_t); // without the sequence
+    static constexpr size_t payload_capacity = word_count * sizeof(uint64_t) - header_size;
+
+    using Payload = BasicBinaryLogPayload<payload_capacity>;
+
+    struct Stats {
+        uint64_t recorded = 0;
+        uint64_t dropped = 0; // another writer was still in the slot. Only when the ring wraps that fast
+    };
+
+  private:
+    /// @note The words are atomic so the reader can copy a slot which is being overwritten
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> sequence{0}; // 2 * index + 1: writing, 2 * index + 2: record of the index
+        std::atomic<uint64_t> words[word_count]{};
+    };
+    static_assert(sizeof(Slot) == slot_size);
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_mask;
+    alignas(64) std::atomic<uint64_t> m_next{0};
+    std::atomic<uint64_t> m_dropped{0};
+
+  public:
+    /// @param capacity records. Rounded up to the power of 2
+    explicit FlightRecorder(size_t capacity = 4096) noexcept(false);
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+    /**
+     * @brief Keep the arguments of a `BINLOG_ID` call site
+     * @details The strings are truncated to fit in `payload_capacity`
+     */
+    template <typename... Args>
+    void record(uint32_t id, const Args&... args) noexcept {
+        const Clock::time_point time = Clock::now();
+        Payload payload;
+        (payload.append(args), ...);
+        append(id, time, payload.bytes());
+    }
+
+    /// @param payload truncated at `payload_capacity`. Use `Payload` to keep the arguments decodable
+    void append(uint32_t id, Clock::time_point time, std::span<const std::byte> payload) noexcept;
+
+    /// @brief Record the start of a frame. The dump shows "frame {}" with the number
+    void mark_frame(uint64_t frame) noexcept;
+
+    size_t capacity() const noexcept;
+    Stats stats() const noexcept;
+
+    /**
+     * @brief Write the records in the ring as a binary log stream. The recording continues while this runs
+     * @details The slots overwritten during the copy are skipped
+     * @return the number of records written
+     */
+    size_t dump(std::ostream& out) const noexcept(false);
+};
+
+/// @brief The recorder of the process. Created in the first use
+FlightRecorder& get_flight_recorder() noexcept(false);
+
+/// @brief Folder of the dump files. The temporary folder is used until this is called
+void set_flight_recorder_folder(const std::filesystem::path& folder) noexcept(false);
+
+/**
+ * @brief Write the process's recorder to "flight-{time}-{reason}.binlog" in the folder
+ * @param reason short word for the file name. For example, "crash", "device-lost", "manual"
+ * @return the path of the file. Empty if the dump failed
+ * @note This can be called in the unhandled exception handlers. The errors are not thrown
+ */
+std::filesystem::path dump_flight_recorder(std::string_view reason) noexcept;
+
+} // namespace winrt::App1
+
+/// @brief Record the arguments in the process's recorder. The format is rendered when the dump is decoded
+#define FLIGHT_RECORD(level, format, ...)                                                                              \
+    ::winrt::App1::get_flight_recorder().record(BINLOG_ID(level, format) __VA_OPT__(, ) __VA_ARGS__)
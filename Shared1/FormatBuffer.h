@@ -0,0 +1,123 @@
+/**
+ * @file FormatBuffer.h
+ * @brief Format a log message without the heap allocation
+ * @details The message is formatted in the inline array. Only the message longer than the array goes to the heap,
+ *          and the heap memory is kept for the next `format` of the same buffer.
+ *
+ *  The text is always null-terminated. So `view()` of a wide buffer can be passed to the projected
+ *  ILoggingChannel as a fast-pass HSTRING reference, and `view()` of a narrow buffer to spdlog as it is.
+ * @note Standard C++ only
+ */
+#pragma once
+#include <cstddef>
+#include <format>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace winrt::App1 {
+
+/**
+ * @brief Small buffer for `std::format`
+ * @tparam N characters of the inline array, including the null terminator
+ * @code
+ * WFormatBuffer message{};
+ * logging.LogMessage(message.format(L"size {}x{}", width, height), LoggingLevel::Information); // ILoggingChannel
+ * @endcode
+ */
+template <typename CharT, size_t N = 256>
+class BasicFormatBuffer final {
+    static_assert(N >= 2, "the inline array needs a character and the null terminator");
+
+  public:
+    using view_type = std::basic_string_view<CharT>;
+
+  private:
+    CharT m_inline[N];
+    std::unique_ptr<CharT[]> m_heap{};
+    size_t m_capacity = 0; // of m_heap, including the null terminator
+    CharT* m_data = m_inline;
+    size_t m_size = 0;
+
+  public:
+    BasicFormatBuffer() noexcept {
+        m_inline[0] = CharT{};
+    }
+    BasicFormatBuffer(const BasicFormatBuffer&) = delete;
+    BasicFormatBuffer& operator=(const BasicFormatBuffer&) = delete;
+
+    /**
+     * @brief Replace the text with the formatted one
+     * @details The arguments are formatted twice when the text doesn't fit in the inline array
+     * @return same as `view()`
+     */
+    template <typename... Args>
+    view_type format(std::basic_format_string<CharT, std::type_identity_t<Args>...> fmt,
+                     Args&&... args) noexcept(false) {
+        // the formatting doesn't move from the arguments, so they can be forwarded again for the spillover
+        const auto result = std::format_to_n(m_inline, N - 1, fmt, std::forward<Args>(args)...);
+        const size_t size = static_cast<size_t>(result.size);
+        if (size < N) {
+            *result.out = CharT{};
+            m_data = m_inline;
+            m_size = size;
+            return view();
+        }
+        if (m_capacity <= size) {
+            m_heap = std::make_unique_for_overwrite<CharT[]>(size + 1);
+            m_capacity = size + 1;
+        }
+        *std::format_to(m_heap.get(), fmt, std::forward<Args>(args)...) = CharT{};
+        m_data = m_heap.get();
+        m_size = size;
+        return view();
+    }
+
+    void clear() noexcept {
+        m_inline[0] = CharT{};
+        m_data = m_inline;
+        m_size = 0;
+    }
+
+    view_type view() const noexcept {
+        return view_type{m_data, m_size};
+    }
+    const CharT* c_str() const noexcept {
+        return m_data;
+    }
+    size_t size() const noexcept {
+        return m_size;
+    }
+    bool empty() const noexcept {
+        return m_size == 0;
+    }
+    /// @brief The last text didn't fit in the inline array
+    bool spilled() const noexcept {
+        return m_data != m_inline;
+    }
+    static constexpr size_t inline_capacity() noexcept {
+        return N - 1;
+    }
+};
+
+using FormatBuffer = BasicFormatBuffer<char>;
+using WFormatBuffer = BasicFormatBuffer<wchar_t>;
+
+/**
+ * @brief Format the message in FormatBuffer, and pass it to the logger as the plain text
+ * @details The arguments are not formatted when the level is disabled
+ * @tparam Logger has `should_log(level)` and `log(level, std::string_view)`, like `spdlog::logger`
+ * @code
+ * log_buffered(*spdlog::default_logger_raw(), spdlog::level::info, "{}: visibility {}", "MainWindow", visible);
+ * @endcode
+ */
+template <typename Logger, typename Level, typename... Args>
+void log_buffered(Logger& logger, Level level, std::format_string<Args...> fmt, Args&&... args) noexcept(false) {
+    if (logger.should_log(level) == false)
+        return;
+    FormatBuffer message{};
+    logger.log(level, message.format(fmt, std::forward<Args>(args)...));
+}
+
+} // namespace winrt::App1
@@ -0,0 +1,436 @@
+#include "pch.h"
+
+#include "FrameReadback.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace DX {
+
+// DXGI_FORMAT values. This file doesn't include the DXGI headers
+constexpr uint32_t c_FormatR32G32B32A32Float = 2;
+constexpr uint32_t c_FormatR16G16B16A16Float = 10;
+constexpr uint32_t c_FormatR10G10B10A2Unorm = 24;
+constexpr uint32_t c_FormatR8G8B8A8Unorm = 28;
+constexpr uint32_t c_FormatR8G8B8A8UnormSRGB = 29;
+constexpr uint32_t c_FormatB8G8R8A8Unorm = 87;
+constexpr uint32_t c_FormatB8G8R8X8Unorm = 88;
+constexpr uint32_t c_FormatB8G8R8A8UnormSRGB = 91;
+constexpr uint32_t c_FormatB8G8R8X8UnormSRGB = 93;
+
+uint32_t get_bytes_per_pixel(uint32_t format) noexcept {
+    switch (format) {
+    case c_FormatR32G32B32A32Float:
+        return 16;
+    case c_FormatR16G16B16A16Float:
+        return 8;
+    case c_FormatR10G10B10A2Unorm:
+    case c_FormatR8G8B8A8Unorm:
+    case c_FormatR8G8B8A8UnormSRGB:
+    case c_FormatB8G8R8A8Unorm:
+    case c_FormatB8G8R8X8Unorm:
+    case c_FormatB8G8R8A8UnormSRGB:
+    case c_FormatB8G8R8X8UnormSRGB:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+FrameEncoderPool::FrameEncoderPool(uint32_t threadCount, size_t capacity, EncodeFn encode) noexcept(false)
+    : m_encode{std::move(encode)}, m_capacity{capacity} {
+    if (threadCount == 0 || capacity == 0 || m_encode == nullptr)
+        throw std::invalid_argument{"FrameEncoderPool requires threads, capacity and EncodeFn"};
+    for (uint32_t i = 0; i < threadCount; ++i)
+        m_threads.emplace_back(&FrameEncoderPool::run, this);
+}
+
+FrameEncoderPool::~FrameEncoderPool() noexcept {
+    {
+        std::lock_guard lck{m_mtx};
+        m_stop = true;
+    }
+    m_changed.notify_all();
+    for (std::thread& t : m_threads)
+        t.join();
+}
+
+void FrameEncoderPool::run() noexcept {
+    std::unique_lock lck{m_mtx};
+    while (true) {
+        m_changed.wait(lck, [this]() { return m_stop || m_queue.empty() == false; });
+        if (m_queue.empty())
+            return; // stopped and drained
+        ReadbackFrame frame = std::move(m_queue.front());
+        m_queue.pop_front();
+        ++m_busy;
+        lck.unlock();
+
+        bool succeeded = true;
+        try {
+            m_encode(frame);
+        } catch (...) {
+            succeeded = false;
+        }
+        const auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(ReadbackFrame::Clock::now() -
+                                                                                  frame.requested);
+
+        lck.lock();
+        --m_busy;
+        if (succeeded) {
+            ++m_stats.encoded;
+            m_stats.totalLatency += latency;
+            m_stats.maxLatency = (std::max)(m_stats.maxLatency, latency);
+        } else {
+            ++m_stats.failed;
+        }
+        m_buffers.emplace_back(std::move(frame.pixels));
+        m_changed.notify_all(); // for `flush`
+    }
+}
+
+ReadbackFrame FrameEncoderPool::acquire() noexcept(false) {
+    ReadbackFrame frame{};
+    std::lock_guard lck{m_mtx};
+    if (m_buffers.empty() == false) {
+        frame.pixels = std::move(m_buffers.back());
+        m_buffers.pop_back();
+    }
+    return frame;
+}
+
+bool FrameEncoderPool::submit(ReadbackFrame&& frame) noexcept(false) {
+    {
+        std::lock_guard lck{m_mtx};
+        if (m_queue.size() >= m_capacity) {
+            ++m_stats.dropped;
+            m_buffers.emplace_back(std::move(frame.pixels));
+            return false;
+        }
+        m_queue.emplace_back(std::move(frame));
+    }
+    m_changed.notify_all(); // `flush` waits on the same variable
+    return true;
+}
+
+void FrameEncoderPool::flush() noexcept {
+    std::unique_lock lck{m_mtx};
+    m_changed.wait(lck, [this]() { return m_queue.empty() && m_busy == 0; });
+}
+
+FrameEncoderPool::Stats FrameEncoderPool::stats() const noexcept {
+    std::lock_guard lck{m_mtx};
+    return m_stats;
+}
+
+ReadbackRing::ReadbackRing(ReadbackDevice& device, uint32_t slotCount) noexcept(false)
+    : m_device{device}, m_slots(slotCount) {
+    if (slotCount == 0)
+        throw std::invalid_argument{"ReadbackRing requires 1 or more buffers"};
+}
+
+void ReadbackRing::resize(uint32_t width, uint32_t height, uint32_t format) noexcept(false) {
+    m_layout = m_device.allocate(static_cast<uint32_t>(m_slots.size()), width, height, format);
+    for (Slot& slot : m_slots)
+        slot = Slot{};
+}
+
+bool ReadbackRing::capture(uint64_t frameNumber) noexcept(false) {
+    if (m_layout.rowPitch == 0)
+        throw std::logic_error{"ReadbackRing::resize is required"};
+    auto it = std::find_if(m_slots.begin(), m_slots.end(),
+                           [](const Slot& slot) { return slot.state == SlotState::Free; });
+    if (it == m_slots.end()) {
+        ++m_stats.dropped;
+        return false;
+    }
+    m_device.copy(static_cast<uint32_t>(it - m_slots.begin()));
+    it->state = SlotState::Copied;
+    it->frameNumber = frameNumber;
+    it->requested = ReadbackFrame::Clock::now();
+    ++m_stats.captured;
+    return true;
+}
+
+/// @note Signals every frame, even without the copy. The fence value moves like the frame fence of the device
+void ReadbackRing::submit() noexcept(false) {
+    const uint64_t value = m_device.signal();
+    for (Slot& slot : m_slots) {
+        if (slot.state != SlotState::Copied)
+            continue;
+        slot.state = SlotState::Pending;
+        slot.fenceValue = value;
+    }
+}
+
+size_t ReadbackRing::poll(FrameEncoderPool& encoders) noexcept(false) {
+    const uint64_t completed = m_device.completed_value();
+    m_ready.clear();
+    for (uint32_t i = 0; i < m_slots.size(); ++i)
+        if (m_slots[i].state == SlotState::Pending && m_slots[i].fenceValue <= completed)
+            m_ready.emplace_back(i);
+    // the encoders receive the frames in the capture order
+    std::sort(m_ready.begin(), m_ready.end(),
+              [this](uint32_t lhs, uint32_t rhs) { return m_slots[lhs].frameNumber < m_slots[rhs].frameNumber; });
+
+    const uint32_t bytesPerPixel = get_bytes_per_pixel(m_layout.format);
+    const uint32_t packedPitch = bytesPerPixel ? m_layout.width * bytesPerPixel : m_layout.rowPitch;
+    for (uint32_t index : m_ready) {
+        Slot& slot = m_slots[index];
+        ReadbackFrame frame = encoders.acquire();
+        frame.frameNumber = slot.frameNumber;
+        frame.layout = m_layout;
+        frame.layout.rowPitch = packedPitch;
+        frame.requested = slot.requested;
+        frame.pixels.resize(frame.layout.size());
+
+        std::span<const std::byte> mapped = m_device.map(index);
+        for (uint32_t y = 0; y < m_layout.height; ++y)
+            std::memcpy(frame.pixels.data() + uint64_t{y} * packedPitch,
+                        mapped.data() + uint64_t{y} * m_layout.rowPitch, packedPitch);
+        m_device.unmap(index);
+        frame.mapped = ReadbackFrame::Clock::now();
+
+        slot.state = SlotState::Free;
+        ++m_stats.completed;
+        encoders.submit(std::move(frame));
+    }
+    return m_ready.size();
+}
+
+const ReadbackLayout& ReadbackRing::layout() const noexcept {
+    return m_layout;
+}
+
+uint32_t ReadbackRing::in_flight() const noexcept {
+    return static_cast<uint32_t>(std::count_if(m_slots.begin(), m_slots.end(),
+                                               [](const Slot& slot) { return slot.state != SlotState::Free; }));
+}
+
+ReadbackRing::Stats ReadbackRing::stats() const noexcept {
+    return m_stats;
+}
+
+bool convert_to_rgba8(ReadbackFrame& frame) noexcept {
+    uint32_t format = frame.layout.format;
+    const bool opaque = format == c_FormatB8G8R8X8Unorm || format == c_FormatB8G8R8X8UnormSRGB;
+    switch (format) {
+    case c_FormatR8G8B8A8Unorm:
+    case c_FormatR8G8B8A8UnormSRGB:
+        return true;
+    case c_FormatB8G8R8A8Unorm:
+    case c_FormatB8G8R8X8Unorm:
+        format = c_FormatR8G8B8A8Unorm;
+        break;
+    case c_FormatB8G8R8A8UnormSRGB:
+    case c_FormatB8G8R8X8UnormSRGB:
+        format = c_FormatR8G8B8A8UnormSRGB;
+        break;
+    default:
+        return false;
+    }
+    const size_t count = frame.pixels.size() / 4;
+    std::byte* pixel = frame.pixels.data();
+    for (size_t i = 0; i < count; ++i, pixel += 4) {
+        std::swap(pixel[0], pixel[2]);
+        if (opaque)
+            pixel[3] = std::byte{0xFF};
+    }
+    frame.layout.format = format;
+    return true;
+}
+
+static void append_u32_le(std::vector<std::byte>& output, uint32_t value) {
+    for (int i = 0; i < 4; ++i)
+        output.emplace_back(static_cast<std::byte>(value >> (8 * i)));
+}
+
+static void append_u32_be(std::vector<std::byte>& output, uint32_t value) {
+    for (int i = 3; i >= 0; --i)
+        output.emplace_back(static_cast<std::byte>(value >> (8 * i)));
+}
+
+std::vector<std::byte> encode_raw(const ReadbackFrame& frame) noexcept(false) {
+    std::vector<std::byte> output{};
+    output.reserve(28 + frame.pixels.size());
+    append_u32_le(output, 0x46574152); // "RAWF"
+    append_u32_le(output, frame.layout.width);
+    append_u32_le(output, frame.layout.height);
+    append_u32_le(output, frame.layout.format);
+    append_u32_le(output, frame.layout.rowPitch);
+    append_u32_le(output, static_cast<uint32_t>(frame.frameNumber));
+    append_u32_le(output, static_cast<uint32_t>(frame.frameNumber >> 32));
+    output.insert(output.end(), frame.pixels.begin(), frame.pixels.end());
+    return output;
+}
+
+static constexpr std::array<uint32_t, 256> make_crc32_table() noexcept {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table[i] = c;
+    }
+    return table;
+}
+
+static uint32_t update_crc32(uint32_t crc, const std::byte* data, size_t size) noexcept {
+    static constexpr std::array<uint32_t, 256> table = make_crc32_table();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+/// @see https://www.rfc-editor.org/rfc/rfc1950 "ZLIB Compressed Data Format Specification"
+static uint32_t compute_adler32(const std::byte* data, size_t size) noexcept {
+    constexpr uint32_t modulo = 65521;
+    constexpr size_t block = 5552; // the sums don't overflow in this length
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        const size_t length = (std::min)(size, block);
+        for (size_t i = 0; i < length; ++i) {
+            a += static_cast<uint8_t>(data[i]);
+            b += a;
+        }
+        a %= modulo;
+        b %= modulo;
+        data += length;
+        size -= length;
+    }
+    return (b << 16) | a;
+}
+
+static void append_chunk(std::vector<std::byte>& output, const char (&type)[5], std::span<const std::byte> data) {
+    append_u32_be(output, static_cast<uint32_t>(data.size()));
+    const size_t begin = output.size();
+    for (int i = 0; i < 4; ++i)
+        output.emplace_back(static_cast<std::byte>(type[i]));
+    output.insert(output.end(), data.begin(), data.end());
+    append_u32_be(output, update_crc32(0, output.data() + begin, output.size() - begin));
+}
+
+std::vector<std::byte> encode_png(const ReadbackFrame& frame) noexcept(false) {
+    const ReadbackLayout& layout = frame.layout;
+    if (layout.format != c_FormatR8G8B8A8Unorm && layout.format != c_FormatR8G8B8A8UnormSRGB)
+        throw std::invalid_argument{"encode_png requires R8G8B8A8 format"};
+    if (layout.rowPitch != layout.width * 4 || frame.pixels.size() < layout.size())
+        throw std::invalid_argument{"encode_png requires packed rows"};
+
+    // scanlines with the filter type 0 (None)
+    std::vector<std::byte> scanlines{};
+    scanlines.reserve((size_t{layout.rowPitch} + 1) * layout.height);
+    for (uint32_t y = 0; y < layout.height; ++y) {
+        scanlines.emplace_back(std::byte{0});
+        const auto row = frame.pixels.begin() + size_t{y} * layout.rowPitch;
+        scanlines.insert(scanlines.end(), row, row + layout.rowPitch);
+    }
+
+    // zlib stream of the stored deflate blocks
+    constexpr size_t block = 65535;
+    std::vector<std::byte> stream{};
+    stream.reserve(2 + scanlines.size() + (scanlines.size() / block + 1) * 5 + 4);
+    stream.emplace_back(std::byte{0x78});
+    stream.emplace_back(std::byte{0x01});
+    for (size_t offset = 0; offset < scanlines.size() || offset == 0; offset += block) {
+        const size_t length = (std::min)(block, scanlines.size() - offset);
+        const bool last = offset + length >= scanlines.size();
+        stream.emplace_back(std::byte{last ? uint8_t{1} : uint8_t{0}});
+        stream.emplace_back(static_cast<std::byte>(length & 0xFF));
+        stream.emplace_back(static_cast<std::byte>(length >> 8));
+        stream.emplace_back(static_cast<std::byte>(~length & 0xFF));
+        stream.emplace_back(static_cast<std::byte>((~length >> 8) & 0xFF));
+        stream.insert(stream.end(), scanlines.begin() + offset, scanlines.begin() + offset + length);
+        if (last)
+            break;
+    }
+    append_u32_be(stream, compute_adler32(scanlines.data(), scanlines.size()));
+
+    std::vector<std::byte> output{};
+    output.reserve(64 + stream.size());
+    for (uint8_t value : {0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A})
+        output.emplace_back(std::byte{value});
+    std::vector<std::byte> header{};
+    append_u32_be(header, layout.width);
+    append_u32_be(header, layout.height);
+    for (uint8_t value : {8, 6, 0, 0, 0}) // 8-bit, RGBA, deflate, adaptive filter, no interlace
+        header.emplace_back(std::byte{value});
+    append_chunk(output, "IHDR", header);
+    if (layout.format == c_FormatR8G8B8A8UnormSRGB) {
+        const std::byte intent[1]{std::byte{0}}; // perceptual
+        append_chunk(output, "sRGB", intent);
+    }
+    append_chunk(output, "IDAT", stream);
+    append_chunk(output, "IEND", {});
+    return output;
+}
+
+FrameEncoderPool::EncodeFn make_image_writer(std::filesystem::path folder) noexcept(false) {
+    std::filesystem::create_directories(folder);
+    return [folder = std::move(folder)](ReadbackFrame& frame) {
+        const bool png = convert_to_rgba8(frame);
+        const std::vector<std::byte> bytes = png ? encode_png(frame) : encode_raw(frame);
+        const auto filepath = folder / ("frame_" + std::to_string(frame.frameNumber) + (png ? ".png" : ".raw"));
+        std::ofstream fout{filepath, std::ios::binary | std::ios::trunc};
+        fout.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        if (fout.fail())
+            throw std::runtime_error{"failed to write " + filepath.string()};
+    };
+}
+
+CpuReadbackDevice::CpuReadbackDevice(uint32_t latency) noexcept : m_latency{latency} {
+}
+
+ReadbackLayout CpuReadbackDevice::allocate(uint32_t count, uint32_t width, uint32_t height,
+                                           uint32_t format) noexcept(false) {
+    const uint32_t bytesPerPixel = get_bytes_per_pixel(format);
+    if (bytesPerPixel == 0)
+        throw std::invalid_argument{"unsupported format: " + std::to_string(format)};
+    const uint32_t packedPitch = width * bytesPerPixel;
+    const uint32_t rowPitch = (packedPitch + row_alignment - 1) / row_alignment * row_alignment;
+    m_layout = ReadbackLayout{width, height, format, rowPitch};
+    m_source.assign(size_t{packedPitch} * height, std::byte{0});
+    m_buffers.assign(count, std::vector<std::byte>(m_layout.size()));
+    return m_layout;
+}
+
+void CpuReadbackDevice::copy(uint32_t slot) noexcept(false) {
+    std::vector<std::byte>& buffer = m_buffers.at(slot);
+    const uint32_t packedPitch = m_layout.width * get_bytes_per_pixel(m_layout.format);
+    for (uint32_t y = 0; y < m_layout.height; ++y)
+        std::memcpy(buffer.data() + uint64_t{y} * m_layout.rowPitch, m_source.data() + uint64_t{y} * packedPitch,
+                    packedPitch);
+}
+
+uint64_t CpuReadbackDevice::signal() noexcept(false) {
+    ++m_signaled;
+    if (m_signaled > m_latency)
+        m_completed = (std::max)(m_completed, m_signaled - m_latency);
+    return m_signaled;
+}
+
+uint64_t CpuReadbackDevice::completed_value() noexcept(false) {
+    return m_completed;
+}
+
+std::span<const std::byte> CpuReadbackDevice::map(uint32_t slot) noexcept(false) {
+    return m_buffers.at(slot);
+}
+
+void CpuReadbackDevice::unmap(uint32_t) noexcept {
+}
+
+std::span<std::byte> CpuReadbackDevice::source() noexcept {
+    return m_source;
+}
+
+void CpuReadbackDevice::drain() noexcept {
+    m_completed = m_signaled;
+}
+
+} // namespace DX
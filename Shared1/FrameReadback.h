@@ -0,0 +1,230 @@
+/**
+ * @file FrameReadback.h
+ * @brief Asynchronous readback of the rendered frames. Copy now, map some frames later, encode in the workers
+ * @details The render thread never waits for the GPU or the encoders. When every buffer is in flight (or the
+ *          encoder queue is full), the capture is dropped and counted instead.
+ * @note Standard C++ only. The Direct3D 12 device is in FrameReadbackD3D12.h.
+ *       `CpuReadbackDevice` stands in for the GPU, so the throughput and the latency can be measured without it
+ */
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace DX {
+
+/// @brief Memory layout of a readback buffer. The rows may have padding. For example, D3D12 aligns them to 256 bytes
+struct ReadbackLayout {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t format = 0;   // DXGI_FORMAT value
+    uint32_t rowPitch = 0; // bytes. includes the padding
+
+    uint64_t size() const noexcept {
+        return uint64_t{rowPitch} * height;
+    }
+};
+
+/// @return bytes per pixel of the 8/16/32-bit color formats. 0 if not supported
+uint32_t get_bytes_per_pixel(uint32_t format) noexcept;
+
+/**
+ * @brief Captured frame for the encoders
+ * @details The rows are tightly packed. `layout.rowPitch` is width * bytes per pixel
+ */
+struct ReadbackFrame {
+    using Clock = std::chrono::steady_clock;
+
+    uint64_t frameNumber = 0;
+    ReadbackLayout layout{};
+    std::vector<std::byte> pixels{};
+    Clock::time_point requested{}; // `ReadbackRing::capture`
+    Clock::time_point mapped{};    // `ReadbackRing::poll`
+};
+
+/**
+ * @brief The GPU side of ReadbackRing
+ * @details `copy` records the copy of the current render target. After the copies are submitted, `signal` returns
+ *          the fence value for them. The buffer can be mapped when `completed_value` reaches the value.
+ */
+class ReadbackDevice {
+  public:
+    virtual ~ReadbackDevice() = default;
+
+    /// @brief Create the buffers for the texture. The existing buffers are not in flight
+    /// @return layout of each buffer
+    virtual ReadbackLayout allocate(uint32_t count, uint32_t width, uint32_t height,
+                                    uint32_t format) noexcept(false) = 0;
+    virtual void copy(uint32_t slot) noexcept(false) = 0;
+    virtual uint64_t signal() noexcept(false) = 0;
+    virtual uint64_t completed_value() noexcept(false) = 0;
+    /// @note The memory is valid until `unmap`
+    virtual std::span<const std::byte> map(uint32_t slot) noexcept(false) = 0;
+    virtual void unmap(uint32_t slot) noexcept = 0;
+};
+
+/**
+ * @brief Worker threads which convert and encode the captured frames
+ * @details `submit` never blocks. The frame is dropped when the queue is full.
+ *          The pixel vectors are recycled by `acquire` after the encoding.
+ */
+class FrameEncoderPool final {
+  public:
+    using EncodeFn = std::function<void(ReadbackFrame&)>;
+
+    struct Stats {
+        uint64_t encoded = 0;
+        uint64_t dropped = 0; // the queue was full
+        uint64_t failed = 0;  // EncodeFn has thrown
+        std::chrono::nanoseconds totalLatency{}; // from `requested` to the end of EncodeFn
+        std::chrono::nanoseconds maxLatency{};
+    };
+
+  private:
+    EncodeFn m_encode;
+    size_t m_capacity;
+    mutable std::mutex m_mtx;
+    std::condition_variable m_changed;
+    std::deque<ReadbackFrame> m_queue{};
+    std::vector<std::vector<std::byte>> m_buffers{}; // recycled pixels
+    uint32_t m_busy = 0;
+    bool m_stop = false;
+    Stats m_stats{};
+    std::vector<std::thread> m_threads{};
+
+    void run() noexcept;
+
+  public:
+    /// @param capacity maximum number of the frames waiting for the workers. Must be larger than 0
+    FrameEncoderPool(uint32_t threadCount, size_t capacity, EncodeFn encode) noexcept(false);
+    /// @note The frames in the queue are encoded before the threads are joined
+    ~FrameEncoderPool() noexcept;
+    FrameEncoderPool(const FrameEncoderPool&) = delete;
+    FrameEncoderPool& operator=(const FrameEncoderPool&) = delete;
+
+    /// @return frame with a recycled pixel buffer. The content of the buffer is not specified
+    ReadbackFrame acquire() noexcept(false);
+    /// @return false if the frame was dropped
+    bool submit(ReadbackFrame&& frame) noexcept(false);
+    /// @brief Wait until the queue is empty and the workers are idle
+    void flush() noexcept;
+    Stats stats() const noexcept;
+};
+
+/**
+ * @brief Ring of the readback buffers on the render thread
+ * @details For each frame,
+ *  1. `capture` in the command recording. Records the copy to a free buffer
+ *  2. `submit` after the command list is executed. Signals the fence for the copies
+ *  3. `poll` once per frame. Hands the completed buffers to the encoders
+ *
+ *  A buffer is mapped after the fence has passed, so nothing waits for the GPU.
+ *  (GPU latency in frames + 1) buffers are enough to capture every frame.
+ */
+class ReadbackRing final {
+  public:
+    struct Stats {
+        uint64_t captured = 0;
+        uint64_t dropped = 0;   // no free buffer
+        uint64_t completed = 0; // mapped and given to the encoders
+    };
+
+  private:
+    enum class SlotState : uint8_t {
+        Free,
+        Copied, // before `submit`
+        Pending // waiting for the fence
+    };
+    struct Slot {
+        SlotState state = SlotState::Free;
+        uint64_t fenceValue = 0;
+        uint64_t frameNumber = 0;
+        ReadbackFrame::Clock::time_point requested{};
+    };
+
+    ReadbackDevice& m_device;
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_ready{}; // completed slots in `poll`
+    ReadbackLayout m_layout{};
+    Stats m_stats{};
+
+  public:
+    ReadbackRing(ReadbackDevice& device, uint32_t slotCount) noexcept(false);
+
+    /// @brief Create the buffers for the render target. Call after the GPU is idle, like the swap chain resize
+    /// @note The captures in flight are discarded
+    void resize(uint32_t width, uint32_t height, uint32_t format) noexcept(false);
+    /// @return false if every buffer is in flight. The capture is dropped
+    bool capture(uint64_t frameNumber) noexcept(false);
+    void submit() noexcept(false);
+    /// @return number of the frames given to the encoders. Includes the frames they dropped
+    size_t poll(FrameEncoderPool& encoders) noexcept(false);
+
+    const ReadbackLayout& layout() const noexcept;
+    uint32_t in_flight() const noexcept;
+    Stats stats() const noexcept;
+};
+
+/**
+ * @brief Convert the 8-bit BGRA/RGBA pixels to RGBA in place
+ * @return false if the format is not supported
+ */
+bool convert_to_rgba8(ReadbackFrame& frame) noexcept;
+
+/**
+ * @brief Raw image with a small header
+ * @details "RAWF"(u32), width(u32), height(u32), format(u32), row pitch(u32), frame number(u64), pixels (little endian)
+ */
+std::vector<std::byte> encode_raw(const ReadbackFrame& frame) noexcept(false);
+
+/**
+ * @brief PNG image of the RGBA8 frame. Use `convert_to_rgba8` first
+ * @details The image data uses the stored (not compressed) deflate blocks.
+ *          The encoding cost is CRC32/Adler-32 only, so the workers can keep up with the render loop
+ * @throw std::invalid_argument if the format is not 8-bit RGBA
+ * @see https://www.w3.org/TR/png/
+ */
+std::vector<std::byte> encode_png(const ReadbackFrame& frame) noexcept(false);
+
+/// @brief EncodeFn which writes "frame_<number>.png" (or ".raw" for the other formats) in the folder
+FrameEncoderPool::EncodeFn make_image_writer(std::filesystem::path folder) noexcept(false);
+
+/**
+ * @brief CPU stand-in of the GPU for the tests and the benchmarks
+ * @details `copy` copies `source()` with the padded rows, like CopyTextureRegion.
+ *          The fence completes `latency` signals later, as if the GPU was that much behind. `drain` completes all.
+ */
+class CpuReadbackDevice final : public ReadbackDevice {
+    uint32_t m_latency;
+    ReadbackLayout m_layout{};
+    std::vector<std::byte> m_source{};
+    std::vector<std::vector<std::byte>> m_buffers{};
+    uint64_t m_signaled = 0;
+    uint64_t m_completed = 0;
+
+  public:
+    static constexpr uint32_t row_alignment = 256; // D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+
+    explicit CpuReadbackDevice(uint32_t latency) noexcept;
+
+    ReadbackLayout allocate(uint32_t count, uint32_t width, uint32_t height, uint32_t format) noexcept(false) override;
+    void copy(uint32_t slot) noexcept(false) override;
+    uint64_t signal() noexcept(false) override;
+    uint64_t completed_value() noexcept(false) override;
+    std::span<const std::byte> map(uint32_t slot) noexcept(false) override;
+    void unmap(uint32_t slot) noexcept override;
+
+    /// @brief The render target. Tightly packed rows
+    std::span<std::byte> source() noexcept;
+    void drain() noexcept;
+};
+
+} // namespace DX
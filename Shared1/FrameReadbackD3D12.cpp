@@ -0,0 +1,90 @@
+#include "pch.h"
+
+#include "FrameReadbackD3D12.h"
+
+namespace DX {
+
+D3D12ReadbackDevice::D3D12ReadbackDevice(ID3D12Device* device, ID3D12CommandQueue* queue) noexcept(false) {
+    if (device == nullptr || queue == nullptr)
+        throw winrt::hresult_invalid_argument{};
+    m_device.copy_from(device);
+    m_queue.copy_from(queue);
+    winrt::check_hresult(
+        m_device->CreateFence(m_fenceValue, D3D12_FENCE_FLAG_NONE, __uuidof(ID3D12Fence), m_fence.put_void()));
+    m_fence->SetName(L"Readback Fence");
+}
+
+void D3D12ReadbackDevice::SetSource(ID3D12GraphicsCommandList* commandList, ID3D12Resource* target,
+                                    D3D12_RESOURCE_STATES state) noexcept {
+    m_commandList = commandList;
+    m_source = target;
+    m_sourceState = state;
+}
+
+ReadbackLayout D3D12ReadbackDevice::allocate(uint32_t count, uint32_t width, uint32_t height,
+                                             uint32_t format) noexcept(false) {
+    const D3D12_RESOURCE_DESC textureDesc =
+        CD3DX12_RESOURCE_DESC::Tex2D(static_cast<DXGI_FORMAT>(format), width, height, 1, 1);
+    UINT64 totalSize = 0;
+    m_device->GetCopyableFootprints(&textureDesc, 0, 1, 0, &m_footprint, nullptr, nullptr, &totalSize);
+    if (totalSize == UINT64_MAX)
+        throw winrt::hresult_invalid_argument{L"GetCopyableFootprints failed"};
+
+    m_buffers.clear();
+    m_buffers.resize(count);
+    const CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_READBACK);
+    const D3D12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(totalSize);
+    for (uint32_t i = 0; i < count; ++i) {
+        winrt::check_hresult(m_device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+                                                               D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+                                                               __uuidof(ID3D12Resource), m_buffers[i].put_void()));
+        std::wstring name = std::format(L"Readback Buffer {}", i);
+        m_buffers[i]->SetName(name.c_str());
+    }
+    return ReadbackLayout{width, height, format, m_footprint.Footprint.RowPitch};
+}
+
+void D3D12ReadbackDevice::copy(uint32_t slot) noexcept(false) {
+    if (m_commandList == nullptr || m_source == nullptr)
+        throw winrt::hresult_illegal_method_call{L"SetSource is required"};
+    if (m_sourceState != D3D12_RESOURCE_STATE_COPY_SOURCE) {
+        D3D12_RESOURCE_BARRIER barrier =
+            CD3DX12_RESOURCE_BARRIER::Transition(m_source, m_sourceState, D3D12_RESOURCE_STATE_COPY_SOURCE);
+        m_commandList->ResourceBarrier(1, &barrier);
+    }
+    const CD3DX12_TEXTURE_COPY_LOCATION dst(m_buffers.at(slot).get(), m_footprint);
+    const CD3DX12_TEXTURE_COPY_LOCATION src(m_source, 0);
+    m_commandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+    if (m_sourceState != D3D12_RESOURCE_STATE_COPY_SOURCE) {
+        D3D12_RESOURCE_BARRIER barrier =
+            CD3DX12_RESOURCE_BARRIER::Transition(m_source, D3D12_RESOURCE_STATE_COPY_SOURCE, m_sourceState);
+        m_commandList->ResourceBarrier(1, &barrier);
+    }
+}
+
+uint64_t D3D12ReadbackDevice::signal() noexcept(false) {
+    winrt::check_hresult(m_queue->Signal(m_fence.get(), ++m_fenceValue));
+    return m_fenceValue;
+}
+
+uint64_t D3D12ReadbackDevice::completed_value() noexcept(false) {
+    const UINT64 value = m_fence->GetCompletedValue();
+    if (value == UINT64_MAX) // the device is removed
+        winrt::check_hresult(m_device->GetDeviceRemovedReason());
+    return value;
+}
+
+std::span<const std::byte> D3D12ReadbackDevice::map(uint32_t slot) noexcept(false) {
+    ID3D12Resource* buffer = m_buffers.at(slot).get();
+    const D3D12_RANGE range{0, static_cast<SIZE_T>(buffer->GetDesc().Width)};
+    void* ptr = nullptr;
+    winrt::check_hresult(buffer->Map(0, &range, &ptr));
+    return {static_cast<const std::byte*>(ptr), range.End};
+}
+
+void D3D12ReadbackDevice::unmap(uint32_t slot) noexcept {
+    const D3D12_RANGE written{0, 0}; // the CPU didn't write
+    m_buffers[slot]->Unmap(0, &written);
+}
+
+} // namespace DX
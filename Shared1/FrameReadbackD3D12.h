@@ -0,0 +1,52 @@
+/**
+ * @file FrameReadbackD3D12.h
+ * @brief Direct3D 12 device of ReadbackRing. The buffers are in the readback heap
+ */
+#pragma once
+#include "FrameReadback.h"
+
+#include <winrt/windows.foundation.h>
+// clang-format off
+#include <Windows.h>
+#include <d3d12.h>
+// clang-format on
+
+namespace DX {
+
+/**
+ * @brief Copies the render target to the readback buffers and signals its own fence
+ * @details The fence is signaled on the queue after the frame's command list, so the value of a copy is reached
+ *          when the GPU has finished the frame. The frame loop is
+ *          `DeviceResources::Prepare` -> `SetSource` -> ... `ReadbackRing::capture` -> `DeviceResources::Present`
+ *          -> `ReadbackRing::submit` -> `ReadbackRing::poll`
+ */
+class D3D12ReadbackDevice final : public ReadbackDevice {
+    winrt::com_ptr<ID3D12Device> m_device;
+    winrt::com_ptr<ID3D12CommandQueue> m_queue;
+    winrt::com_ptr<ID3D12Fence> m_fence;
+    uint64_t m_fenceValue = 0;
+    ID3D12GraphicsCommandList* m_commandList = nullptr;
+    ID3D12Resource* m_source = nullptr;
+    D3D12_RESOURCE_STATES m_sourceState = D3D12_RESOURCE_STATE_RENDER_TARGET;
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_footprint{};
+    std::vector<winrt::com_ptr<ID3D12Resource>> m_buffers{};
+
+  public:
+    D3D12ReadbackDevice(ID3D12Device* device, ID3D12CommandQueue* queue) noexcept(false);
+
+    /**
+     * @brief The render target and the command list of the current frame
+     * @param state of the render target when `ReadbackRing::capture` is called. It is restored after the copy
+     */
+    void SetSource(ID3D12GraphicsCommandList* commandList, ID3D12Resource* target,
+                   D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_RENDER_TARGET) noexcept;
+
+    ReadbackLayout allocate(uint32_t count, uint32_t width, uint32_t height, uint32_t format) noexcept(false) override;
+    void copy(uint32_t slot) noexcept(false) override;
+    uint64_t signal() noexcept(false) override;
+    uint64_t completed_value() noexcept(false) override;
+    std::span<const std::byte> map(uint32_t slot) noexcept(false) override;
+    void unmap(uint32_t slot) noexcept override;
+};
+
+} // namespace DX
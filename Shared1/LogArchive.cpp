@@ -0,0 +1,247 @@
+#include "pch.h"
+
+#include "LogArchive.h"
+
+#include <lz4.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+namespace winrt::App1 {
+
+static constexpr uint32_t c_IndexMagic = 0x5844494C; // "LIDX"
+static constexpr uint32_t c_IndexVersion = 1;
+
+/// @return the number in `text`. Empty if it has a non-digit character
+static std::optional<int> parse_digits(std::string_view text) noexcept {
+    int value = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9')
+            return std::nullopt;
+        value = value * 10 + (c - '0');
+    }
+    return value;
+}
+
+std::optional<int64_t> parse_log_time(std::string_view text) noexcept {
+    // "YYYY-MM-DD HH:MM:SS" and ".mmm"
+    if (text.size() < 19 || text[4] != '-' || text[7] != '-' || (text[10] != ' ' && text[10] != 'T') ||
+        text[13] != ':' || text[16] != ':')
+        return std::nullopt;
+    const auto year = parse_digits(text.substr(0, 4));
+    const auto month = parse_digits(text.substr(5, 2));
+    const auto day = parse_digits(text.substr(8, 2));
+    const auto hour = parse_digits(text.substr(11, 2));
+    const auto minute = parse_digits(text.substr(14, 2));
+    const auto second = parse_digits(text.substr(17, 2));
+    if (!year || !month || !day || !hour || !minute || !second)
+        return std::nullopt;
+    int millisecond = 0;
+    if (text.size() >= 23 && text[19] == '.') {
+        const auto value = parse_digits(text.substr(20, 3));
+        if (!value)
+            return std::nullopt;
+        millisecond = *value;
+    }
+    const std::chrono::year_month_day date{std::chrono::year{*year}, std::chrono::month{static_cast<unsigned>(*month)},
+                                           std::chrono::day{static_cast<unsigned>(*day)}};
+    if (date.ok() == false || *hour > 23 || *minute > 59 || *second > 60)
+        return std::nullopt;
+    const auto time = std::chrono::sys_days{date} + std::chrono::hours{*hour} + std::chrono::minutes{*minute} +
+                      std::chrono::seconds{*second} + std::chrono::milliseconds{millisecond};
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+}
+
+std::optional<LogRecordHeader> parse_log_record(std::string_view line) noexcept {
+    // "YYYY-MM-DD HH:MM:SS.mmm [L] [name] "
+    static constexpr std::string_view levels = "TDIWECO"; // the short names of spdlog
+    if (line.size() < 27 || line[23] != ' ' || line[24] != '[' || line[26] != ']')
+        return std::nullopt;
+    const auto time = parse_log_time(line.substr(0, 23));
+    const size_t level = levels.find(line[25]);
+    if (!time || level == std::string_view::npos)
+        return std::nullopt;
+    LogRecordHeader header{*time, static_cast<uint8_t>(level), LogChannel::Core};
+    if (line.size() > 29 && line[27] == ' ' && line[28] == '[') {
+        const std::string_view rest = line.substr(29);
+        if (const size_t end = rest.find(']'); end != std::string_view::npos)
+            header.channel = find_log_channel(rest.substr(0, end));
+    }
+    return header;
+}
+
+static std::string read_file(const std::filesystem::path& path) noexcept(false) {
+    std::ifstream fin{path, std::ios::binary};
+    if (fin.is_open() == false)
+        throw std::system_error{std::make_error_code(std::errc::no_such_file_or_directory), path.string()};
+    return std::string{std::istreambuf_iterator<char>{fin}, std::istreambuf_iterator<char>{}};
+}
+
+/// @brief Visit each line with its newline. The last line may not have one
+template <typename Fn>
+static void for_each_line(std::string_view text, Fn&& fn) {
+    while (text.empty() == false) {
+        const size_t end = text.find('\n');
+        const size_t size = end == std::string_view::npos ? text.size() : end + 1;
+        fn(text.substr(0, size));
+        text.remove_prefix(size);
+    }
+}
+
+static std::filesystem::path get_index_path(std::filesystem::path archive) noexcept(false) {
+    return archive.replace_extension(".idx");
+}
+
+std::filesystem::path compress_log_segment(const std::filesystem::path& segment, size_t blockSize) noexcept(false) {
+    if (blockSize == 0 || blockSize > LZ4_MAX_INPUT_SIZE)
+        throw std::invalid_argument{"blockSize is out of range"};
+    const std::string text = read_file(segment);
+    std::filesystem::path archive = segment;
+    archive.replace_extension(".lz4");
+    std::ofstream fout{archive, std::ios::binary | std::ios::trunc};
+    if (fout.is_open() == false)
+        throw std::system_error{std::make_error_code(std::errc::permission_denied), archive.string()};
+
+    std::vector<LogBlockInfo> blocks{};
+    std::vector<char> buffer{};
+    uint64_t offset = 0;
+    size_t begin = 0; // of the current block in `text`
+    LogBlockInfo block{};
+    auto reset = [&block]() {
+        block = LogBlockInfo{};
+        block.first = INT64_MAX;
+        block.last = INT64_MIN;
+    };
+    auto finish = [&](size_t end) {
+        const int size = static_cast<int>(end - begin);
+        if (size == 0)
+            return;
+        buffer.resize(static_cast<size_t>(LZ4_compressBound(size)));
+        const int stored =
+            LZ4_compress_default(text.data() + begin, buffer.data(), size, static_cast<int>(buffer.size()));
+        if (stored <= 0)
+            throw std::runtime_error{"LZ4_compress_default failed"};
+        fout.write(buffer.data(), stored);
+        block.offset = offset;
+        block.stored = static_cast<uint32_t>(stored);
+        block.size = static_cast<uint32_t>(size);
+        blocks.emplace_back(block);
+        offset += static_cast<uint64_t>(stored);
+        begin = end;
+        reset();
+    };
+    reset();
+    size_t position = 0;
+    for_each_line(text, [&](std::string_view line) {
+        if (const auto header = parse_log_record(line)) {
+            // the blocks are split only before a record
+            if (position - begin >= blockSize)
+                finish(position);
+            block.first = (std::min)(block.first, header->time);
+            block.last = (std::max)(block.last, header->time);
+            block.levels |= static_cast<uint8_t>(1u << header->level);
+            block.channels |= static_cast<uint8_t>(1u << static_cast<uint8_t>(header->channel));
+            ++block.records;
+        }
+        position += line.size();
+    });
+    finish(position);
+    fout.close();
+    if (fout.fail())
+        throw std::system_error{std::make_error_code(std::errc::io_error), archive.string()};
+
+    // the index is the last, so a query never sees the index without the blocks
+    const std::filesystem::path index = get_index_path(archive);
+    std::ofstream iout{index, std::ios::binary | std::ios::trunc};
+    const uint32_t header[4]{c_IndexMagic, c_IndexVersion, static_cast<uint32_t>(blocks.size()),
+                             static_cast<uint32_t>(blockSize)};
+    iout.write(reinterpret_cast<const char*>(header), sizeof(header));
+    iout.write(reinterpret_cast<const char*>(blocks.data()),
+               static_cast<std::streamsize>(blocks.size() * sizeof(LogBlockInfo)));
+    iout.close();
+    if (iout.fail())
+        throw std::system_error{std::make_error_code(std::errc::io_error), index.string()};
+    return archive;
+}
+
+std::vector<LogBlockInfo> read_log_index(const std::filesystem::path& archive) noexcept(false) {
+    const std::string data = read_file(get_index_path(archive));
+    uint32_t header[4]{};
+    if (data.size() < sizeof(header))
+        throw std::invalid_argument{"log index is too small"};
+    std::memcpy(header, data.data(), sizeof(header));
+    if (header[0] != c_IndexMagic)
+        throw std::invalid_argument{"log index magic mismatch"};
+    if (header[1] != c_IndexVersion)
+        throw std::invalid_argument{"log index version mismatch"};
+    if (data.size() != sizeof(header) + size_t{header[2]} * sizeof(LogBlockInfo))
+        throw std::invalid_argument{"log index size mismatch"};
+    std::vector<LogBlockInfo> blocks(header[2]);
+    std::memcpy(blocks.data(), data.data() + sizeof(header), blocks.size() * sizeof(LogBlockInfo));
+    return blocks;
+}
+
+bool LogQuery::matches(const LogBlockInfo& block) const noexcept {
+    return block.records != 0 && (block.levels & levels) != 0 && (block.channels & channels) != 0 &&
+           block.last >= from && block.first <= to;
+}
+
+bool LogQuery::matches(const LogRecordHeader& record) const noexcept {
+    return (levels & (1u << record.level)) != 0 && (channels & (1u << static_cast<uint8_t>(record.channel))) != 0 &&
+           record.time >= from && record.time <= to;
+}
+
+LogQueryStats query_log_archive(const std::filesystem::path& archive, const LogQuery& query,
+                                const std::function<void(std::string_view)>& output) noexcept(false) {
+    const std::vector<LogBlockInfo> blocks = read_log_index(archive);
+    LogQueryStats stats{};
+    stats.blocks = blocks.size();
+    std::ifstream fin{archive, std::ios::binary};
+    if (fin.is_open() == false)
+        throw std::system_error{std::make_error_code(std::errc::no_such_file_or_directory), archive.string()};
+    std::vector<char> stored{};
+    std::string text{};
+    for (const LogBlockInfo& block : blocks) {
+        if (query.matches(block) == false)
+            continue;
+        stored.resize(block.stored);
+        text.resize(block.size);
+        fin.seekg(static_cast<std::streamoff>(block.offset));
+        fin.read(stored.data(), static_cast<std::streamsize>(stored.size()));
+        if (fin.gcount() != static_cast<std::streamsize>(stored.size()))
+            throw std::invalid_argument{"log archive is truncated"};
+        const int size = LZ4_decompress_safe(stored.data(), text.data(), static_cast<int>(block.stored),
+                                             static_cast<int>(block.size));
+        if (size != static_cast<int>(block.size))
+            throw std::invalid_argument{"log archive block is corrupted"};
+        ++stats.decompressed;
+
+        // a record and its continuation lines
+        std::string_view record{};
+        bool matched = false;
+        auto emit = [&]() {
+            if (matched && record.empty() == false) {
+                output(record);
+                ++stats.records;
+            }
+        };
+        for_each_line(text, [&](std::string_view line) {
+            if (const auto header = parse_log_record(line)) {
+                emit();
+                record = line;
+                matched = query.matches(*header);
+            } else if (record.empty() == false) {
+                record = std::string_view{record.data(), record.size() + line.size()};
+            }
+        });
+        emit();
+    }
+    return stats;
+}
+
+} // namespace winrt::App1
@@ -0,0 +1,100 @@
+/**
+ * @file LogArchive.h
+ * @brief Compressed log segments and the index for the queries
+ * @details A closed text segment of RotatingFileLog is split into blocks at the record boundaries, and each block is
+ *          compressed with LZ4. The sidecar index keeps the time range, the levels and the channels of each block.
+ *          A query reads the index first, and decompresses only the blocks which can match.
+ *
+ *  The files are "{stem}.lz4" and "{stem}.idx" next to the segment "{stem}.log". (little endian)
+ *  - lz4: the blocks in the LZ4 block format. No header
+ *  - idx header: magic "LIDX"(u32), format version(u32), block count(u32), block size(u32)
+ *  - idx block: offset(u64), stored size(u32), text size(u32), first time(i64), last time(i64), records(u32),
+ *               levels(u8), channels(u8), reserved(u16)
+ *
+ *  The record is a line in the pattern "%Y-%m-%d %T.%e [%L] [%n] %t %v", and the lines which don't start with the time
+ *  belong to the previous record. The time is the text as it is, in milliseconds since 1970-01-01 without a time zone.
+ *  scripts/query-logs.ps1 reads the same files on Windows and Linux.
+ * @note Standard C++ and LZ4 only
+ */
+#pragma once
+#include "LogCounters.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace winrt::App1 {
+
+/// @brief Entry of the index. Same layout as the file
+struct LogBlockInfo {
+    uint64_t offset; // in the lz4 file
+    uint32_t stored; // compressed bytes
+    uint32_t size;   // text bytes
+    int64_t first;   // milliseconds of the first record
+    int64_t last;    // milliseconds of the last record
+    uint32_t records;
+    uint8_t levels;   // bit of spdlog::level::level_enum
+    uint8_t channels; // bit of LogChannel
+    uint16_t reserved;
+};
+static_assert(sizeof(LogBlockInfo) == 40);
+
+/// @brief The head of a record line
+struct LogRecordHeader {
+    int64_t time; // milliseconds
+    uint8_t level;
+    LogChannel channel;
+};
+
+/**
+ * @brief Parse "2025-01-02 03:04:05.678 [I] [App1.DX] ..."
+ * @return empty if the line is not the start of a record
+ * @note Without "[%n]", the channel is `LogChannel::Core`
+ */
+std::optional<LogRecordHeader> parse_log_record(std::string_view line) noexcept;
+
+/// @brief Parse "2025-01-02 03:04:05.678" or "2025-01-02T03:04:05". The milliseconds are optional
+std::optional<int64_t> parse_log_time(std::string_view text) noexcept;
+
+/**
+ * @brief Compress the text segment to "{stem}.lz4" and "{stem}.idx"
+ * @param blockSize text bytes of a block. A record larger than this makes a larger block
+ * @return the path of the lz4 file. The segment is not removed
+ */
+std::filesystem::path compress_log_segment(const std::filesystem::path& segment,
+                                           size_t blockSize = 64 * 1024) noexcept(false);
+
+/**
+ * @param archive path of the lz4 file
+ * @throws std::invalid_argument if the index is not valid
+ */
+std::vector<LogBlockInfo> read_log_index(const std::filesystem::path& archive) noexcept(false);
+
+struct LogQuery {
+    int64_t from = INT64_MIN; // milliseconds. Inclusive
+    int64_t to = INT64_MAX;   // milliseconds. Inclusive
+    uint8_t levels = 0xFF;
+    uint8_t channels = 0xFF;
+
+    bool matches(const LogBlockInfo& block) const noexcept;
+    bool matches(const LogRecordHeader& record) const noexcept;
+};
+
+struct LogQueryStats {
+    size_t blocks = 0;       // in the index
+    size_t decompressed = 0; // blocks which were read
+    size_t records = 0;      // matched
+};
+
+/**
+ * @brief Find the records in the archive
+ * @param output receives each record with its continuation lines and the last newline
+ */
+LogQueryStats query_log_archive(const std::filesystem::path& archive, const LogQuery& query,
+                                const std::function<void(std::string_view)>& output) noexcept(false);
+
+} // namespace winrt::App1
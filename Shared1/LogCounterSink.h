@@ -0,0 +1,72 @@
+/**
+ * @file LogCounterSink.h
+ * @brief spdlog sink for LogCounters, and the loggers of the log channels
+ */
+#pragma once
+#include "LogCounters.h"
+
+#include <spdlog/logger.h>
+#include <spdlog/sinks/sink.h>
+#include <spdlog/spdlog.h>
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace winrt::App1 {
+
+/**
+ * @brief Counts the messages of a channel in the calling thread
+ * @see count_log
+ */
+class LogCounterSink final : public spdlog::sinks::sink {
+    LogChannel m_channel;
+
+  public:
+    explicit LogCounterSink(LogChannel channel) noexcept : m_channel{channel} {
+    }
+
+    void log(const spdlog::details::log_msg& msg) override {
+        count_log(m_channel, static_cast<uint8_t>(msg.level), msg.payload.size());
+    }
+    void flush() override {
+    }
+    void set_pattern(const std::string&) override {
+    }
+    void set_formatter(std::unique_ptr<spdlog::formatter>) override {
+    }
+};
+
+using ChannelLoggers = std::array<std::shared_ptr<spdlog::logger>, log_channel_count>;
+
+/**
+ * @brief A logger for each channel. They share the sinks, and each one counts its messages in its channel
+ * @details The names are `to_string(channel)`, so the `%n` of the pattern is the channel.
+ *          The LogCounterSink is before the other sinks, so the count is taken in the caller's thread
+ * @note The loggers are not registered
+ */
+inline ChannelLoggers make_channel_loggers(const std::vector<spdlog::sink_ptr>& sinks) noexcept(false) {
+    ChannelLoggers loggers{};
+    for (size_t i = 0; i < log_channel_count; ++i) {
+        const auto channel = static_cast<LogChannel>(i);
+        std::vector<spdlog::sink_ptr> items{};
+        items.reserve(sinks.size() + 1);
+        items.emplace_back(std::make_shared<LogCounterSink>(channel));
+        items.insert(items.end(), sinks.begin(), sinks.end());
+        loggers[i] = std::make_shared<spdlog::logger>(std::string{to_string(channel)}, items.begin(), items.end());
+    }
+    return loggers;
+}
+
+/**
+ * @return the registered logger of the channel. The default logger if there is no such logger
+ * @note Takes the lock of the spdlog registry. Keep the logger for the frequent messages
+ */
+inline std::shared_ptr<spdlog::logger> get_channel_logger(LogChannel channel) noexcept(false) {
+    if (std::shared_ptr logger = spdlog::get(std::string{to_string(channel)}))
+        return logger;
+    return spdlog::default_logger();
+}
+
+} // namespace winrt::App1
@@ -0,0 +1,156 @@
+#include "pch.h"
+
+#include "LogCounters.h"
+
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace winrt::App1 {
+
+/// @brief Counters of a thread. Only the thread writes them, so the increment is a load and a store
+struct alignas(64) ThreadLogCounters final {
+    std::atomic<uint64_t> messages[log_channel_count][log_level_count]{};
+    std::atomic<uint64_t> bytes[log_channel_count][log_level_count]{};
+};
+
+static std::mutex g_counters_mtx{};
+static std::vector<ThreadLogCounters*> g_counters{};
+static LogCounterValue g_retired[log_channel_count][log_level_count]{}; // the exited threads
+
+/// @brief Moves the counts to `g_retired` when the thread exits
+struct LocalLogCounters final {
+    ThreadLogCounters* counters = nullptr;
+
+    ~LocalLogCounters() noexcept {
+        if (counters == nullptr)
+            return;
+        std::lock_guard lck{g_counters_mtx};
+        for (size_t c = 0; c < log_channel_count; ++c) {
+            for (size_t l = 0; l < log_level_count; ++l) {
+                g_retired[c][l].messages += counters->messages[c][l].load(std::memory_order_relaxed);
+                g_retired[c][l].bytes += counters->bytes[c][l].load(std::memory_order_relaxed);
+            }
+        }
+        std::erase(g_counters, counters);
+        delete counters;
+    }
+};
+
+static thread_local LocalLogCounters t_counters{};
+
+static constexpr std::string_view g_channel_names[log_channel_count]{
+    "App1.Core",
+    "App1.ViewModel",
+    "App1.DX",
+    "App1.Persistence",
+};
+
+static constexpr std::string_view g_level_names[log_level_count]{
+    "trace", "debug", "info", "warning", "error", "critical",
+};
+
+std::string_view to_string(LogChannel channel) noexcept {
+    const auto index = static_cast<size_t>(channel);
+    if (index >= log_channel_count)
+        return {};
+    return g_channel_names[index];
+}
+
+LogChannel find_log_channel(std::string_view name) noexcept {
+    for (size_t i = 0; i < log_channel_count; ++i)
+        if (g_channel_names[i] == name)
+            return static_cast<LogChannel>(i);
+    return LogChannel::Core;
+}
+
+const LogCounterValue& LogCountersSnapshot::at(LogChannel channel, uint8_t level) const noexcept(false) {
+    const auto index = static_cast<size_t>(channel);
+    if (index >= log_channel_count || level >= log_level_count)
+        throw std::out_of_range{"channel or level is out of range"};
+    return values[index][level];
+}
+
+LogCounterValue LogCountersSnapshot::total(LogChannel channel) const noexcept {
+    LogCounterValue sum{};
+    const auto index = static_cast<size_t>(channel);
+    if (index >= log_channel_count)
+        return sum;
+    for (const LogCounterValue& value : values[index]) {
+        sum.messages += value.messages;
+        sum.bytes += value.bytes;
+    }
+    return sum;
+}
+
+LogCountersSnapshot LogCountersSnapshot::operator-(const LogCountersSnapshot& rhs) const noexcept {
+    LogCountersSnapshot result{};
+    result.threads = threads;
+    for (size_t c = 0; c < log_channel_count; ++c) {
+        for (size_t l = 0; l < log_level_count; ++l) {
+            result.values[c][l].messages = values[c][l].messages - rhs.values[c][l].messages;
+            result.values[c][l].bytes = values[c][l].bytes - rhs.values[c][l].bytes;
+        }
+    }
+    return result;
+}
+
+void count_log(LogChannel channel, uint8_t level, size_t bytes) noexcept {
+    const auto index = static_cast<size_t>(channel);
+    if (index >= log_channel_count || level >= log_level_count)
+        return;
+    ThreadLogCounters* counters = t_counters.counters;
+    if (counters == nullptr) {
+        try {
+            auto item = std::make_unique<ThreadLogCounters>();
+            std::lock_guard lck{g_counters_mtx};
+            g_counters.emplace_back(item.get());
+            counters = t_counters.counters = item.release();
+        } catch (...) {
+            return; // not counted
+        }
+    }
+    // single writer. The readers only need the atomicity of each value
+    auto& messages = counters->messages[index][level];
+    messages.store(messages.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    auto& size = counters->bytes[index][level];
+    size.store(size.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+}
+
+LogCountersSnapshot snapshot_log_counters() noexcept {
+    LogCountersSnapshot snapshot{};
+    std::lock_guard lck{g_counters_mtx};
+    for (size_t c = 0; c < log_channel_count; ++c) {
+        for (size_t l = 0; l < log_level_count; ++l) {
+            LogCounterValue& value = snapshot.values[c][l];
+            value = g_retired[c][l];
+            for (const ThreadLogCounters* counters : g_counters) {
+                value.messages += counters->messages[c][l].load(std::memory_order_relaxed);
+                value.bytes += counters->bytes[c][l].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    snapshot.threads = g_counters.size();
+    return snapshot;
+}
+
+std::string export_log_counters(const LogCountersSnapshot& snapshot) noexcept(false) {
+    std::string csv{"channel,level,messages,bytes\n"};
+    for (size_t c = 0; c < log_channel_count; ++c) {
+        for (size_t l = 0; l < log_level_count; ++l) {
+            const LogCounterValue& value = snapshot.values[c][l];
+            if (value.messages == 0)
+                continue;
+            std::format_to(std::back_inserter(csv), "{},{},{},{}\n", g_channel_names[c], g_level_names[l],
+                           value.messages, value.bytes);
+        }
+    }
+    return csv;
+}
+
+} // namespace winrt::App1
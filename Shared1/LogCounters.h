@@ -0,0 +1,62 @@
+/**
+ * @file LogCounters.h
+ * @brief Message and byte counts of the log channels for each level
+ * @details Each thread increments its own padded counters without a read-modify-write instruction.
+ *          The counts are summed when they are read. The threads which have exited are kept in the totals.
+ * @note Standard C++ only. The spdlog sink and the loggers of the channels are in LogCounterSink.h
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace winrt::App1 {
+
+/// @see developer-concerns.md "Logging Channel Strategy"
+enum class LogChannel : uint8_t {
+    Core,
+    ViewModel,
+    DX,
+    Persistence,
+};
+
+constexpr size_t log_channel_count = 4;
+constexpr size_t log_level_count = 6; // spdlog::level::trace ~ critical
+
+/// @return "App1.Core" style name
+std::string_view to_string(LogChannel channel) noexcept;
+
+/// @return the channel of the name. `LogChannel::Core` if the name is unknown
+LogChannel find_log_channel(std::string_view name) noexcept;
+
+struct LogCounterValue {
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+};
+
+struct LogCountersSnapshot {
+    LogCounterValue values[log_channel_count][log_level_count]{};
+    size_t threads = 0; // live threads which have logged
+
+    const LogCounterValue& at(LogChannel channel, uint8_t level) const noexcept(false);
+    /// @return the sum of the levels
+    LogCounterValue total(LogChannel channel) const noexcept;
+    /// @return the counts between 2 snapshots. `threads` is from the left one
+    LogCountersSnapshot operator-(const LogCountersSnapshot& rhs) const noexcept;
+};
+
+/**
+ * @brief Count a message of the current thread
+ * @param level spdlog::level::level_enum value. `off` and the larger values are ignored
+ * @note The first call in a thread registers its counters with a lock
+ */
+void count_log(LogChannel channel, uint8_t level, size_t bytes) noexcept;
+
+/// @brief Sum the counters of all threads
+LogCountersSnapshot snapshot_log_counters() noexcept;
+
+/// @return CSV with the header "channel,level,messages,bytes". The zero rows are omitted
+std::string export_log_counters(const LogCountersSnapshot& snapshot) noexcept(false);
+
+} // namespace winrt::App1
@@ -0,0 +1,95 @@
+#include "pch.h"
+
+#include "LogLimit.h"
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+namespace winrt::App1 {
+
+/// @brief Head of the call sites. The lock is taken only for the registration and the report
+static std::mutex g_sites_mtx{};
+static LogSite* g_sites = nullptr;
+
+static int64_t now_ns() noexcept {
+    const auto time = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+}
+
+LogSite::LogSite(std::string_view file, uint32_t line, uint8_t level) noexcept(false)
+    : m_file{file}, m_line{line}, m_level{level} {
+    if (const size_t pos = m_file.find_last_of("/\\"); pos != std::string_view::npos)
+        m_file.remove_prefix(pos + 1);
+    std::lock_guard lck{g_sites_mtx};
+    m_next = std::exchange(g_sites, this);
+}
+
+LogSite::~LogSite() noexcept {
+    std::lock_guard lck{g_sites_mtx};
+    for (LogSite** site = &g_sites; *site != nullptr; site = &(*site)->m_next) {
+        if (*site == this) {
+            *site = m_next;
+            return;
+        }
+    }
+}
+
+std::string_view LogSite::file() const noexcept {
+    return m_file;
+}
+
+uint32_t LogSite::line() const noexcept {
+    return m_line;
+}
+
+uint8_t LogSite::level() const noexcept {
+    return m_level;
+}
+
+uint64_t LogSite::take_suppressed() noexcept {
+    return m_suppressed.exchange(0, std::memory_order_relaxed);
+}
+
+LogRateLimit::LogRateLimit(std::string_view file, uint32_t line, uint8_t level, double rate,
+                           uint32_t burst) noexcept(false)
+    : LogSite{file, line, level}, m_interval{static_cast<int64_t>(1e9 / (std::max)(rate, 1e-9))},
+      m_tolerance{m_interval * static_cast<int64_t>((std::max)(burst, 1u))} {
+}
+
+bool LogRateLimit::acquire() noexcept {
+    return acquire(now_ns());
+}
+
+bool LogRateLimit::acquire(int64_t now) noexcept {
+    int64_t tat = m_tat.load(std::memory_order_relaxed);
+    while (true) {
+        const int64_t next = (std::max)(tat, now) + m_interval;
+        if (next - now > m_tolerance) {
+            m_suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (m_tat.compare_exchange_weak(tat, next, std::memory_order_relaxed))
+            return true;
+    }
+}
+
+LogSampler::LogSampler(std::string_view file, uint32_t line, uint8_t level, uint64_t period) noexcept(false)
+    : LogSite{file, line, level}, m_period{(std::max)(period, uint64_t{1})} {
+}
+
+bool LogSampler::acquire() noexcept {
+    if (m_count.fetch_add(1, std::memory_order_relaxed) % m_period == 0)
+        return true;
+    m_suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void report_suppressed_logs(const std::function<void(const LogSite&, uint64_t)>& report) noexcept(false) {
+    std::lock_guard lck{g_sites_mtx};
+    for (LogSite* site = g_sites; site != nullptr; site = site->m_next)
+        if (const uint64_t count = site->take_suppressed(); count != 0)
+            report(*site, count);
+}
+
+} // namespace winrt::App1
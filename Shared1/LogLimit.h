@@ -0,0 +1,101 @@
+/**
+ * @file LogLimit.h
+ * @brief Rate limiting and sampling of the chatty log call sites
+ * @details Each call site has its own static state. A suppressed call costs an atomic update. It doesn't format.
+ *          The sites are registered once with a lock.
+ *          The suppressed counts are reported by `report_suppressed_logs`, which the application calls periodically.
+ * @note Standard C++ only. The macros expect the caller to include spdlog
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+namespace winrt::App1 {
+
+/// @brief Call site with a suppressed counter. Registered in the process-wide list while it lives
+class LogSite {
+    std::string_view m_file;
+    uint32_t m_line;
+    uint8_t m_level; // spdlog::level::level_enum value
+    LogSite* m_next = nullptr;
+
+  protected:
+    std::atomic<uint64_t> m_suppressed{0};
+
+  public:
+    LogSite(std::string_view file, uint32_t line, uint8_t level) noexcept(false);
+    ~LogSite() noexcept;
+    LogSite(const LogSite&) = delete;
+    LogSite& operator=(const LogSite&) = delete;
+
+    /// @return the file name without the directories
+    std::string_view file() const noexcept;
+    uint32_t line() const noexcept;
+    uint8_t level() const noexcept;
+    /// @return the count since the last call
+    uint64_t take_suppressed() noexcept;
+
+    friend void report_suppressed_logs(const std::function<void(const LogSite&, uint64_t)>& report) noexcept(false);
+};
+
+/**
+ * @brief Token bucket of a call site. `burst` calls can pass at once, then `rate` calls per second
+ * @details GCRA (virtual scheduling) with one atomic. No lock
+ */
+class LogRateLimit final : public LogSite {
+    int64_t m_interval; // nanoseconds between the tokens
+    int64_t m_tolerance;
+    std::atomic<int64_t> m_tat{0}; // theoretical arrival time
+
+  public:
+    /// @param rate tokens per second. Must be positive
+    LogRateLimit(std::string_view file, uint32_t line, uint8_t level, double rate, uint32_t burst) noexcept(false);
+
+    bool acquire() noexcept;
+    /// @param now nanoseconds of steady_clock
+    bool acquire(int64_t now) noexcept;
+};
+
+/// @brief Pass 1 of N calls. The first call passes
+class LogSampler final : public LogSite {
+    uint64_t m_period;
+    std::atomic<uint64_t> m_count{0};
+
+  public:
+    LogSampler(std::string_view file, uint32_t line, uint8_t level, uint64_t period) noexcept(false);
+
+    bool acquire() noexcept;
+};
+
+/**
+ * @brief Take the suppressed counts of all call sites
+ * @param report called for the sites which have suppressed some calls
+ */
+void report_suppressed_logs(const std::function<void(const LogSite&, uint64_t)>& report) noexcept(false);
+
+} // namespace winrt::App1
+
+/**
+ * @brief spdlog call limited to `rate` per second after `burst` calls
+ * @details The arguments are not evaluated when the call is suppressed or the level is disabled
+ * @code
+ * LOG_RATE_LIMITED(spdlog::default_logger_raw(), spdlog::level::info, 2, 5, "size {}", size);
+ * @endcode
+ */
+#define LOG_RATE_LIMITED(logger, level, rate, burst, ...)                                                              \
+    do {                                                                                                               \
+        static ::winrt::App1::LogRateLimit log_site_{__FILE__, __LINE__, static_cast<uint8_t>(level), rate, burst};    \
+        if (auto&& log_logger_ = (logger); log_logger_->should_log(level) && log_site_.acquire())                      \
+            log_logger_->log(level, __VA_ARGS__);                                                                      \
+    } while (false)
+
+/// @brief spdlog call which passes 1 of `period` calls
+#define LOG_SAMPLED(logger, level, period, ...)                                                                        \
+    do {                                                                                                               \
+        static ::winrt::App1::LogSampler log_site_{__FILE__, __LINE__, static_cast<uint8_t>(level), period};           \
+        if (auto&& log_logger_ = (logger); log_logger_->should_log(level) && log_site_.acquire())                      \
+            log_logger_->log(level, __VA_ARGS__);                                                                      \
+    } while (false)
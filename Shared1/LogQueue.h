@@ -0,0 +1,222 @@
+/**
+ * @file LogQueue.h
+ * @brief Bounded lock-free queue between the logging threads and the writer thread
+ * @note Standard C++ only. The spdlog sink is in AsyncLogSink.h
+ */
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace winrt::App1 {
+
+/// @brief What a producer does when the queue is full
+enum class OverflowPolicy : uint8_t {
+    Block,      // wait for the consumer
+    DropNewest, // discard the new item
+    DropOldest, // discard the oldest item and retry. Counted as `overwritten`
+};
+
+/**
+ * @brief Preallocated ring of the items with per-cell sequence numbers
+ * @details Multiple producers and multiple consumers. Only `DropOldest` dequeues on the producer side,
+ *          so the logger uses it as a MPSC queue. The items are assigned in place, so the cells keep their capacity.
+ *          The waiting consumer/producers are notified only when they are sleeping.
+ * @see https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ */
+template <typename T>
+class LogQueue final {
+  public:
+    struct Stats {
+        uint64_t pushed = 0;      // includes the overwritten items
+        uint64_t dropped = 0;     // DropNewest
+        uint64_t overwritten = 0; // DropOldest
+        uint64_t blocked = 0;     // Block. The number of waits
+    };
+
+  private:
+    struct Cell {
+        std::atomic<size_t> sequence{};
+        T value{};
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask;
+    OverflowPolicy m_policy;
+    alignas(64) std::atomic<size_t> m_enqueue{0};
+    alignas(64) std::atomic<size_t> m_dequeue{0};
+    // for the sleeping consumer
+    alignas(64) std::atomic<uint32_t> m_pushed{0};
+    std::atomic<bool> m_sleeping{false};
+    std::atomic<bool> m_closed{false};
+    // for the blocked producers
+    alignas(64) std::atomic<uint32_t> m_popped{0};
+    std::atomic<uint32_t> m_waiters{0};
+    alignas(64) std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_overwritten{0};
+    std::atomic<uint64_t> m_blocked{0};
+
+    template <typename U>
+    bool enqueue(U&& value) {
+        size_t pos = m_enqueue.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = m_cells[pos & m_mask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::forward<U>(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // full
+            } else {
+                pos = m_enqueue.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool dequeue(T& value) {
+        size_t pos = m_dequeue.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = m_cells[pos & m_mask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (m_dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    std::swap(value, cell.value); // both keep their buffers
+                    cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // empty
+            } else {
+                pos = m_dequeue.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void notify_consumer() noexcept {
+        m_pushed.fetch_add(1);
+        if (m_sleeping.load())
+            m_pushed.notify_one();
+    }
+
+  public:
+    /// @param capacity rounded up to the power of 2. Must be larger than 1
+    LogQueue(size_t capacity, OverflowPolicy policy) noexcept(false) : m_policy{policy} {
+        if (capacity < 2)
+            throw std::invalid_argument{"capacity must be larger than 1"};
+        size_t count = 2;
+        while (count < capacity)
+            count <<= 1;
+        m_cells = std::make_unique<Cell[]>(count);
+        for (size_t i = 0; i < count; ++i)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        m_mask = count - 1;
+    }
+    LogQueue(const LogQueue&) = delete;
+    LogQueue& operator=(const LogQueue&) = delete;
+
+    /**
+     * @brief Enqueue with the overflow policy
+     * @return false if the item was dropped (DropNewest)
+     */
+    template <typename U>
+    bool push(U&& value) noexcept(false) {
+        switch (m_policy) {
+        case OverflowPolicy::DropNewest:
+            if (enqueue(std::forward<U>(value)) == false) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            break;
+        case OverflowPolicy::DropOldest: {
+            T oldest{};
+            while (enqueue(value) == false) {
+                if (dequeue(oldest))
+                    m_overwritten.fetch_add(1, std::memory_order_relaxed);
+            }
+            break;
+        }
+        case OverflowPolicy::Block:
+            if (enqueue(value))
+                break;
+            m_waiters.fetch_add(1);
+            while (true) {
+                const uint32_t popped = m_popped.load();
+                if (enqueue(value))
+                    break;
+                m_blocked.fetch_add(1, std::memory_order_relaxed);
+                notify_consumer(); // it may be sleeping with the full queue
+                m_popped.wait(popped);
+            }
+            m_waiters.fetch_sub(1);
+            break;
+        }
+        notify_consumer();
+        return true;
+    }
+
+    /// @note The previous content of `value` is recycled by the queue
+    bool try_pop(T& value) noexcept(false) {
+        if (dequeue(value) == false)
+            return false;
+        if (m_policy == OverflowPolicy::Block) {
+            m_popped.fetch_add(1);
+            if (m_waiters.load())
+                m_popped.notify_all();
+        }
+        return true;
+    }
+
+    /**
+     * @brief Sleep until an item is pushed or the queue is closed
+     * @note Returns immediately if the queue is not empty
+     */
+    void wait() noexcept {
+        m_sleeping.store(true);
+        const uint32_t pushed = m_pushed.load();
+        if (size() == 0 && m_closed.load() == false)
+            m_pushed.wait(pushed);
+        m_sleeping.store(false);
+    }
+
+    /// @brief Wake the consumer in `wait`. The remaining items can be popped
+    void close() noexcept {
+        m_closed.store(true);
+        m_pushed.fetch_add(1);
+        m_pushed.notify_all();
+    }
+    bool closed() const noexcept {
+        return m_closed.load();
+    }
+
+    size_t capacity() const noexcept {
+        return m_mask + 1;
+    }
+    OverflowPolicy policy() const noexcept {
+        return m_policy;
+    }
+    /// @note The value is not exact while the other threads are running
+    size_t size() const noexcept {
+        const size_t head = m_dequeue.load();
+        const size_t tail = m_enqueue.load();
+        return tail > head ? tail - head : 0;
+    }
+
+    Stats stats() const noexcept {
+        Stats stats{};
+        stats.dropped = m_dropped.load(std::memory_order_relaxed);
+        stats.overwritten = m_overwritten.load(std::memory_order_relaxed);
+        stats.blocked = m_blocked.load(std::memory_order_relaxed);
+        stats.pushed = m_enqueue.load(std::memory_order_relaxed);
+        return stats;
+    }
+};
+
+} // namespace winrt::App1
@@ -0,0 +1,208 @@
+#include "pch.h"
+
+#include "PipelineCache.h"
+
+#include <d3dcommon.h>
+
+namespace DX {
+
+static void HashShader(StableHasher& hasher, const D3D12_SHADER_BYTECODE& shader) noexcept {
+    hasher.update(static_cast<uint64_t>(shader.BytecodeLength));
+    if (shader.pShaderBytecode)
+        hasher.update(shader.pShaderBytecode, shader.BytecodeLength);
+}
+
+static void HashText(StableHasher& hasher, LPCSTR text) noexcept {
+    hasher.update(std::string_view{text ? text : ""});
+}
+
+static void HashStreamOutput(StableHasher& hasher, const D3D12_STREAM_OUTPUT_DESC& desc) noexcept {
+    hasher.update(desc.NumEntries);
+    for (UINT i = 0; desc.pSODeclaration && i < desc.NumEntries; ++i) {
+        const D3D12_SO_DECLARATION_ENTRY& entry = desc.pSODeclaration[i];
+        hasher.update(entry.Stream);
+        HashText(hasher, entry.SemanticName);
+        hasher.update(entry.SemanticIndex);
+        hasher.update(entry.StartComponent);
+        hasher.update(entry.ComponentCount);
+        hasher.update(entry.OutputSlot);
+    }
+    hasher.update(desc.NumStrides);
+    for (UINT i = 0; desc.pBufferStrides && i < desc.NumStrides; ++i)
+        hasher.update(desc.pBufferStrides[i]);
+    hasher.update(desc.RasterizedStream);
+}
+
+/// @note The struct has padding after RenderTargetWriteMask. Don't hash it as bytes
+static void HashBlend(StableHasher& hasher, const D3D12_BLEND_DESC& desc) noexcept {
+    hasher.update(desc.AlphaToCoverageEnable);
+    hasher.update(desc.IndependentBlendEnable);
+    for (const D3D12_RENDER_TARGET_BLEND_DESC& rt : desc.RenderTarget) {
+        hasher.update(rt.BlendEnable);
+        hasher.update(rt.LogicOpEnable);
+        hasher.update(rt.SrcBlend);
+        hasher.update(rt.DestBlend);
+        hasher.update(rt.BlendOp);
+        hasher.update(rt.SrcBlendAlpha);
+        hasher.update(rt.DestBlendAlpha);
+        hasher.update(rt.BlendOpAlpha);
+        hasher.update(rt.LogicOp);
+        hasher.update(rt.RenderTargetWriteMask);
+    }
+}
+
+static void HashRasterizer(StableHasher& hasher, const D3D12_RASTERIZER_DESC& desc) noexcept {
+    hasher.update(desc.FillMode);
+    hasher.update(desc.CullMode);
+    hasher.update(desc.FrontCounterClockwise);
+    hasher.update(desc.DepthBias);
+    hasher.update(desc.DepthBiasClamp);
+    hasher.update(desc.SlopeScaledDepthBias);
+    hasher.update(desc.DepthClipEnable);
+    hasher.update(desc.MultisampleEnable);
+    hasher.update(desc.AntialiasedLineEnable);
+    hasher.update(desc.ForcedSampleCount);
+    hasher.update(desc.ConservativeRaster);
+}
+
+static void HashStencilOp(StableHasher& hasher, const D3D12_DEPTH_STENCILOP_DESC& desc) noexcept {
+    hasher.update(desc.StencilFailOp);
+    hasher.update(desc.StencilDepthFailOp);
+    hasher.update(desc.StencilPassOp);
+    hasher.update(desc.StencilFunc);
+}
+
+static void HashDepthStencil(StableHasher& hasher, const D3D12_DEPTH_STENCIL_DESC& desc) noexcept {
+    hasher.update(desc.DepthEnable);
+    hasher.update(desc.DepthWriteMask);
+    hasher.update(desc.DepthFunc);
+    hasher.update(desc.StencilEnable);
+    hasher.update(desc.StencilReadMask);
+    hasher.update(desc.StencilWriteMask);
+    HashStencilOp(hasher, desc.FrontFace);
+    HashStencilOp(hasher, desc.BackFace);
+}
+
+static void HashInputLayout(StableHasher& hasher, const D3D12_INPUT_LAYOUT_DESC& desc) noexcept {
+    hasher.update(desc.NumElements);
+    for (UINT i = 0; desc.pInputElementDescs && i < desc.NumElements; ++i) {
+        const D3D12_INPUT_ELEMENT_DESC& element = desc.pInputElementDescs[i];
+        HashText(hasher, element.SemanticName);
+        hasher.update(element.SemanticIndex);
+        hasher.update(element.Format);
+        hasher.update(element.InputSlot);
+        hasher.update(element.AlignedByteOffset);
+        hasher.update(element.InputSlotClass);
+        hasher.update(element.InstanceDataStepRate);
+    }
+}
+
+uint64_t HashPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureKey) noexcept {
+    StableHasher hasher{};
+    hasher.update(std::string_view{"graphics"});
+    hasher.update(rootSignatureKey);
+    HashShader(hasher, desc.VS);
+    HashShader(hasher, desc.PS);
+    HashShader(hasher, desc.DS);
+    HashShader(hasher, desc.HS);
+    HashShader(hasher, desc.GS);
+    HashStreamOutput(hasher, desc.StreamOutput);
+    HashBlend(hasher, desc.BlendState);
+    hasher.update(desc.SampleMask);
+    HashRasterizer(hasher, desc.RasterizerState);
+    HashDepthStencil(hasher, desc.DepthStencilState);
+    HashInputLayout(hasher, desc.InputLayout);
+    hasher.update(desc.IBStripCutValue);
+    hasher.update(desc.PrimitiveTopologyType);
+    hasher.update(desc.NumRenderTargets);
+    for (DXGI_FORMAT format : desc.RTVFormats)
+        hasher.update(format);
+    hasher.update(desc.DSVFormat);
+    hasher.update(desc.SampleDesc.Count);
+    hasher.update(desc.SampleDesc.Quality);
+    hasher.update(desc.Flags);
+    return hasher.value();
+}
+
+uint64_t HashPipelineDesc(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureKey) noexcept {
+    StableHasher hasher{};
+    hasher.update(std::string_view{"compute"});
+    hasher.update(rootSignatureKey);
+    HashShader(hasher, desc.CS);
+    hasher.update(desc.Flags);
+    return hasher.value();
+}
+
+uint64_t MakeDeviceSignature(IDXGIAdapter1* adapter) noexcept(false) {
+    if (adapter == nullptr)
+        throw winrt::hresult_invalid_argument{};
+    DXGI_ADAPTER_DESC1 desc{};
+    winrt::check_hresult(adapter->GetDesc1(&desc));
+    LARGE_INTEGER version{};
+    if (FAILED(adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &version)))
+        version.QuadPart = 0;
+
+    StableHasher hasher{};
+    hasher.update(c_PipelineSchemaVersion);
+    hasher.update(desc.VendorId);
+    hasher.update(desc.DeviceId);
+    hasher.update(desc.SubSysId);
+    hasher.update(desc.Revision);
+    hasher.update(version.QuadPart);
+    return hasher.value();
+}
+
+/// @return true if the failure means the blob can't be used with the current driver
+static bool IsRejectedBlob(HRESULT hr) noexcept {
+    return hr == D3D12_ERROR_DRIVER_VERSION_MISMATCH || hr == D3D12_ERROR_ADAPTER_NOT_FOUND || hr == E_INVALIDARG;
+}
+
+static PipelineBlob GetCachedBlob(ID3D12PipelineState* pipeline) noexcept(false) {
+    winrt::com_ptr<ID3DBlob> blob = nullptr;
+    winrt::check_hresult(pipeline->GetCachedBlob(blob.put()));
+    auto bytes = static_cast<const std::byte*>(blob->GetBufferPointer());
+    return PipelineBlob{bytes, bytes + blob->GetBufferSize()};
+}
+
+template <typename Desc, typename CreateFn>
+static std::optional<PipelineCompileResult<winrt::com_ptr<ID3D12PipelineState>>>
+CreatePipeline(Desc& desc, const PipelineBlob* cached, CreateFn&& create) noexcept(false) {
+    desc.CachedPSO = D3D12_CACHED_PIPELINE_STATE{};
+    if (cached) {
+        desc.CachedPSO.pCachedBlob = cached->data();
+        desc.CachedPSO.CachedBlobSizeInBytes = cached->size();
+    }
+    winrt::com_ptr<ID3D12PipelineState> pipeline = nullptr;
+    if (HRESULT hr = create(desc, pipeline); FAILED(hr)) {
+        if (cached && IsRejectedBlob(hr))
+            return std::nullopt;
+        winrt::throw_hresult(hr);
+    }
+    // the blob is already in the library when it was accepted
+    PipelineBlob blob = cached ? PipelineBlob{} : GetCachedBlob(pipeline.get());
+    return PipelineCompileResult<winrt::com_ptr<ID3D12PipelineState>>{std::move(pipeline), std::move(blob)};
+}
+
+std::optional<PipelineCompileResult<winrt::com_ptr<ID3D12PipelineState>>>
+CreateGraphicsPipeline(ID3D12Device* device, D3D12_GRAPHICS_PIPELINE_STATE_DESC desc,
+                       const PipelineBlob* cached) noexcept(false) {
+    if (device == nullptr)
+        throw winrt::hresult_invalid_argument{};
+    auto create = [device](const auto& pipelineDesc, winrt::com_ptr<ID3D12PipelineState>& pipeline) {
+        return device->CreateGraphicsPipelineState(&pipelineDesc, __uuidof(ID3D12PipelineState), pipeline.put_void());
+    };
+    return CreatePipeline(desc, cached, create);
+}
+
+std::optional<PipelineCompileResult<winrt::com_ptr<ID3D12PipelineState>>>
+CreateComputePipeline(ID3D12Device* device, D3D12_COMPUTE_PIPELINE_STATE_DESC desc,
+                      const PipelineBlob* cached) noexcept(false) {
+    if (device == nullptr)
+        throw winrt::hresult_invalid_argument{};
+    auto create = [device](const auto& pipelineDesc, winrt::com_ptr<ID3D12PipelineState>& pipeline) {
+        return device->CreateComputePipelineState(&pipelineDesc, __uuidof(ID3D12PipelineState), pipeline.put_void());
+    };
+    return CreatePipeline(desc, cached, create);
+}
+
+} // namespace DX
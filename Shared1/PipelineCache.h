@@ -0,0 +1,54 @@
+/**
+ * @file PipelineCache.h
+ * @brief Direct3D 12 glue of PipelineLibrary. Hashing of the pipeline desc and creation with the cached blob
+ */
+#pragma once
+#include "PipelineLibrary.h"
+
+#include <winrt/windows.foundation.h>
+// clang-format off
+#include <Windows.h>
+#include <d3d12.h>
+#include <dxgi1_6.h>
+// clang-format on
+
+namespace DX {
+
+using D3D12PipelineCache = PipelineCache<winrt::com_ptr<ID3D12PipelineState>>;
+
+/// @brief Increase when the application changes the meaning of the pipeline keys
+constexpr uint32_t c_PipelineSchemaVersion = 1;
+
+/**
+ * @brief Stable key of the graphics pipeline
+ * @details The fields are hashed one by one. The pointers (shader bytecode, input layout, ...) are followed,
+ *          so the key doesn't change between the processes. The cached blob and the node mask are excluded.
+ * @param rootSignatureKey The root signature can't be hashed from the object. Use the hash of its serialized blob
+ */
+uint64_t HashPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureKey) noexcept;
+
+/// @see HashPipelineDesc
+uint64_t HashPipelineDesc(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureKey) noexcept;
+
+/**
+ * @brief Signature of the PipelineLibrary for the adapter and its driver
+ * @details Vendor/Device/SubSys/Revision of the adapter, the user mode driver version, and c_PipelineSchemaVersion.
+ *          The cached blobs are discarded when one of them is changed
+ */
+uint64_t MakeDeviceSignature(IDXGIAdapter1* adapter) noexcept(false);
+
+/**
+ * @brief Create a graphics pipeline with the cached blob
+ * @return `std::nullopt` if the driver rejected the blob. See `PipelineCache`
+ * @throws winrt::hresult_error for the other failures
+ */
+std::optional<PipelineCompileResult<winrt::com_ptr<ID3D12PipelineState>>>
+CreateGraphicsPipeline(ID3D12Device* device, D3D12_GRAPHICS_PIPELINE_STATE_DESC desc,
+                       const PipelineBlob* cached) noexcept(false);
+
+/// @see CreateGraphicsPipeline
+std::optional<PipelineCompileResult<winrt::com_ptr<ID3D12PipelineState>>>
+CreateComputePipeline(ID3D12Device* device, D3D12_COMPUTE_PIPELINE_STATE_DESC desc,
+                      const PipelineBlob* cached) noexcept(false);
+
+} // namespace DX
@@ -0,0 +1,169 @@
+#include "pch.h"
+
+#include "PipelineLibrary.h"
+#include "SettingsStore.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace DX {
+
+void StableHasher::update(const void* data, size_t size) noexcept {
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        m_value ^= bytes[i];
+        m_value *= 1099511628211ull;
+    }
+}
+
+void StableHasher::update(std::string_view text) noexcept {
+    update(static_cast<uint64_t>(text.size()));
+    update(text.data(), text.size());
+}
+
+uint64_t StableHasher::value() const noexcept {
+    return m_value;
+}
+
+static uint32_t make_checksum(std::span<const std::byte> bytes) noexcept {
+    StableHasher hasher{};
+    hasher.update(bytes.data(), bytes.size());
+    const uint64_t value = hasher.value();
+    return static_cast<uint32_t>(value ^ (value >> 32));
+}
+
+PipelineLibrary::PipelineLibrary(uint64_t signature) noexcept : m_signature{signature} {
+}
+
+uint64_t PipelineLibrary::signature() const noexcept {
+    return m_signature;
+}
+
+size_t PipelineLibrary::size() const noexcept {
+    return m_entries.size();
+}
+
+bool PipelineLibrary::dirty() const noexcept {
+    return m_dirty;
+}
+
+const PipelineBlob* PipelineLibrary::find(uint64_t key) const noexcept {
+    if (auto it = m_entries.find(key); it != m_entries.end())
+        return &it->second;
+    return nullptr;
+}
+
+void PipelineLibrary::store(uint64_t key, PipelineBlob blob) noexcept(false) {
+    if (blob.size() > UINT32_MAX)
+        throw std::length_error{"pipeline blob is too large"};
+    m_entries.insert_or_assign(key, std::move(blob));
+    m_dirty = true;
+}
+
+bool PipelineLibrary::erase(uint64_t key) noexcept {
+    if (m_entries.erase(key) == 0)
+        return false;
+    m_dirty = true;
+    return true;
+}
+
+void PipelineLibrary::clear() noexcept {
+    m_dirty = m_dirty || m_entries.empty() == false;
+    m_entries.clear();
+}
+
+template <typename T>
+static void write_value(std::vector<std::byte>& output, T value) {
+    const auto offset = output.size();
+    output.resize(offset + sizeof(T));
+    std::memcpy(output.data() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+static bool read_value(std::span<const std::byte>& input, T& value) noexcept {
+    if (input.size() < sizeof(T))
+        return false;
+    std::memcpy(&value, input.data(), sizeof(T));
+    input = input.subspan(sizeof(T));
+    return true;
+}
+
+std::vector<std::byte> PipelineLibrary::serialize() const noexcept(false) {
+    std::vector<std::byte> output{};
+    size_t capacity = 4 + 4 + 8 + 4;
+    for (const auto& [key, blob] : m_entries)
+        capacity += 8 + 4 + 4 + blob.size();
+    output.reserve(capacity);
+
+    write_value(output, magic);
+    write_value(output, format_version);
+    write_value(output, m_signature);
+    write_value(output, static_cast<uint32_t>(m_entries.size()));
+    for (const auto& [key, blob] : m_entries) {
+        write_value(output, key);
+        write_value(output, static_cast<uint32_t>(blob.size()));
+        write_value(output, make_checksum(blob));
+        output.insert(output.end(), blob.begin(), blob.end());
+    }
+    return output;
+}
+
+bool PipelineLibrary::deserialize(std::span<const std::byte> data) noexcept(false) {
+    m_entries.clear();
+    m_dirty = false;
+
+    uint32_t header_magic = 0, version = 0, count = 0;
+    uint64_t signature = 0;
+    if (!read_value(data, header_magic) || !read_value(data, version) || !read_value(data, signature) ||
+        !read_value(data, count))
+        return false;
+    if (header_magic != magic || version != format_version || signature != m_signature) {
+        m_dirty = true; // the file must be replaced
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        uint64_t key = 0;
+        uint32_t size = 0, checksum = 0;
+        if (!read_value(data, key) || !read_value(data, size) || !read_value(data, checksum) || data.size() < size) {
+            m_dirty = true; // truncated. keep the entries before
+            break;
+        }
+        auto bytes = data.first(size);
+        data = data.subspan(size);
+        if (make_checksum(bytes) != checksum) {
+            m_dirty = true;
+            continue;
+        }
+        m_entries.insert_or_assign(key, PipelineBlob{bytes.begin(), bytes.end()});
+    }
+    return true;
+}
+
+bool PipelineLibrary::load(const std::filesystem::path& filepath) noexcept(false) {
+    std::ifstream fin{filepath, std::ios::binary | std::ios::ate};
+    if (fin.is_open() == false) {
+        m_entries.clear();
+        return false;
+    }
+    std::vector<std::byte> data(static_cast<size_t>(fin.tellg()));
+    fin.seekg(0);
+    if (!fin.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()))) {
+        m_entries.clear();
+        return false;
+    }
+    return deserialize(data);
+}
+
+void PipelineLibrary::save(const std::filesystem::path& filepath) noexcept(false) {
+    const std::vector<std::byte> data = serialize();
+    std::filesystem::path temp = filepath;
+    temp += ".tmp";
+    // the bytes must be on the disk before the rename. See MappedSettingsStore::commit
+    winrt::App1::write_file_synced(temp, data, false);
+    std::filesystem::rename(temp, filepath);
+    winrt::App1::sync_directory(filepath.parent_path());
+    m_dirty = false;
+}
+
+} // namespace DX
@@ -0,0 +1,232 @@
+/**
+ * @file PipelineLibrary.h
+ * @brief Content-hashed cache of the compiled pipeline state blobs and its on-disk container
+ * @note Standard C++ only. The Direct3D 12 part is in PipelineCache.h
+ */
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace DX {
+
+/**
+ * @brief 64-bit FNV-1a hash
+ * @details The value is stable across processes and builds, so it can be used as a persistent key.
+ *          Multi-byte values are hashed in the memory order. x64 and ARM64 are little endian
+ */
+class StableHasher final {
+    uint64_t m_value = 14695981039346656037ull;
+
+  public:
+    void update(const void* data, size_t size) noexcept;
+
+    template <typename T>
+        requires std::is_arithmetic_v<T> || std::is_enum_v<T>
+    void update(T value) noexcept {
+        update(&value, sizeof(T));
+    }
+
+    /// @note Length is hashed together. ("ab", "c") and ("a", "bc") are different
+    void update(std::string_view text) noexcept;
+
+    uint64_t value() const noexcept;
+};
+
+using PipelineBlob = std::vector<std::byte>;
+
+/**
+ * @brief Versioned container of the compiled pipeline blobs
+ * @details The file layout is (little endian)
+ *  - header: magic "PSOL"(u32), format version(u32), signature(u64), entry count(u32)
+ *  - entries: key(u64), size(u32), checksum(u32), bytes
+ *
+ *  The signature identifies the producer of the blobs (adapter, driver, application schema...).
+ *  The whole file is discarded when the format version or the signature doesn't match.
+ *  An entry with the wrong checksum is dropped. Truncated file keeps the entries before the broken one.
+ */
+class PipelineLibrary final {
+  public:
+    static constexpr uint32_t magic = 0x4C4F5350; // "PSOL"
+    static constexpr uint32_t format_version = 1;
+
+  private:
+    uint64_t m_signature = 0;
+    std::unordered_map<uint64_t, PipelineBlob> m_entries{};
+    bool m_dirty = false;
+
+  public:
+    explicit PipelineLibrary(uint64_t signature) noexcept;
+
+    uint64_t signature() const noexcept;
+    size_t size() const noexcept;
+    /// @return true if the entries were changed after the last load/save
+    bool dirty() const noexcept;
+
+    const PipelineBlob* find(uint64_t key) const noexcept;
+    void store(uint64_t key, PipelineBlob blob) noexcept(false);
+    bool erase(uint64_t key) noexcept;
+    void clear() noexcept;
+
+    std::vector<std::byte> serialize() const noexcept(false);
+    /// @return false if the data is invalidated. The library is empty in the case
+    bool deserialize(std::span<const std::byte> data) noexcept(false);
+
+    /// @return false if the file is missing or invalidated
+    bool load(const std::filesystem::path& filepath) noexcept(false);
+    /// @note Writes a temporary file, flushes it to the disk and replaces the target. The readers never see a partial
+    ///       file, and a crash never leaves an empty one
+    void save(const std::filesystem::path& filepath) noexcept(false);
+};
+
+/// @brief The compiled pipeline and the blob to persist in PipelineLibrary
+template <typename Pipeline>
+struct PipelineCompileResult {
+    Pipeline pipeline;
+    PipelineBlob blob;
+};
+
+/**
+ * @brief Thread-safe front of PipelineLibrary which keeps the compiled pipelines
+ * @tparam Pipeline runtime object. For example, `winrt::com_ptr<ID3D12PipelineState>`
+ * @details The compile function receives the cached blob (nullptr if there is none).
+ *          It must return `std::nullopt` when the blob is rejected (driver update, ...).
+ *          Then the entry is erased and the function is called again without the blob.
+ */
+template <typename Pipeline>
+class PipelineCache final {
+  public:
+    using Result = PipelineCompileResult<Pipeline>;
+    using CompileFn = std::function<std::optional<Result>(const PipelineBlob* cached)>;
+
+    struct Statistics {
+        uint32_t hits;     // the pipeline was already created
+        uint32_t warm;     // created with the blob from the library
+        uint32_t cold;     // created without the blob
+        uint32_t rejected; // the blob was rejected by the compile function
+    };
+
+  private:
+    mutable std::mutex m_lock;
+    PipelineLibrary m_library;
+    std::unordered_map<uint64_t, std::shared_future<Pipeline>> m_pipelines{};
+    std::atomic<uint32_t> m_hits{0}, m_warm{0}, m_cold{0}, m_rejected{0};
+
+    Pipeline compile(uint64_t key, const CompileFn& fn) noexcept(false) {
+        std::optional<PipelineBlob> cached{};
+        {
+            std::lock_guard lck{m_lock};
+            if (const PipelineBlob* blob = m_library.find(key); blob != nullptr)
+                cached = *blob;
+        }
+        std::optional<Result> result{};
+        if (cached.has_value()) {
+            if (result = fn(&cached.value()); result.has_value()) {
+                m_warm.fetch_add(1);
+                return std::move(result->pipeline);
+            }
+            m_rejected.fetch_add(1);
+            std::lock_guard lck{m_lock};
+            m_library.erase(key);
+        }
+        if (result = fn(nullptr); result.has_value() == false)
+            throw std::runtime_error{"pipeline compilation failed"};
+        m_cold.fetch_add(1);
+        {
+            std::lock_guard lck{m_lock};
+            m_library.store(key, std::move(result->blob));
+        }
+        return std::move(result->pipeline);
+    }
+
+  public:
+    explicit PipelineCache(PipelineLibrary library) noexcept : m_library{std::move(library)} {
+    }
+
+    /// @note Concurrent requests of the same key wait for the first one
+    Pipeline get_or_create(uint64_t key, const CompileFn& fn) noexcept(false) {
+        std::promise<Pipeline> promise{};
+        std::shared_future<Pipeline> pending{};
+        {
+            std::lock_guard lck{m_lock};
+            if (auto it = m_pipelines.find(key); it != m_pipelines.end())
+                pending = it->second;
+            else
+                m_pipelines.emplace(key, promise.get_future().share());
+        }
+        if (pending.valid()) {
+            m_hits.fetch_add(1);
+            return pending.get();
+        }
+        try {
+            Pipeline pipeline = compile(key, fn);
+            promise.set_value(pipeline);
+            return pipeline;
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+            std::lock_guard lck{m_lock};
+            m_pipelines.erase(key); // allow retry
+            throw;
+        }
+    }
+
+    /**
+     * @brief Create the pipelines in the background. For example, at startup before the first frame
+     * @return number of the pipelines created without error
+     */
+    std::future<size_t> prewarm(std::vector<std::pair<uint64_t, CompileFn>> requests) noexcept(false) {
+        return std::async(std::launch::async, [this, requests = std::move(requests)]() {
+            size_t count = 0;
+            for (const auto& [key, fn] : requests) {
+                try {
+                    get_or_create(key, fn);
+                    ++count;
+                } catch (...) {
+                    // the foreground request will see the error again
+                }
+            }
+            return count;
+        });
+    }
+
+    Statistics statistics() const noexcept {
+        return Statistics{m_hits.load(), m_warm.load(), m_cold.load(), m_rejected.load()};
+    }
+
+    /// @note Drop the runtime pipelines. The library keeps the blobs. Use after device lost
+    void reset() noexcept {
+        std::lock_guard lck{m_lock};
+        m_pipelines.clear();
+    }
+
+    void save(const std::filesystem::path& filepath) noexcept(false) {
+        std::lock_guard lck{m_lock};
+        if (m_library.dirty())
+            m_library.save(filepath);
+    }
+
+    /// @see MakeDeviceSignature
+    uint64_t signature() const noexcept {
+        std::lock_guard lck{m_lock};
+        return m_library.signature();
+    }
+
+    size_t library_size() const noexcept {
+        std::lock_guard lck{m_lock};
+        return m_library.size();
+    }
+};
+
+} // namespace DX
@@ -0,0 +1,457 @@
+#include "pch.h"
+
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace DX {
+
+std::string to_string(ResourceState state) noexcept(false) {
+    static constexpr std::pair<ResourceState, std::string_view> names[]{
+        {ResourceState::RenderTarget, "RenderTarget"}, {ResourceState::UnorderedAccess, "UnorderedAccess"},
+        {ResourceState::DepthWrite, "DepthWrite"},     {ResourceState::DepthRead, "DepthRead"},
+        {ResourceState::ShaderResource, "ShaderResource"}, {ResourceState::CopyDest, "CopyDest"},
+        {ResourceState::CopySource, "CopySource"},
+    };
+    std::string text{};
+    for (const auto& [bit, name] : names) {
+        if ((static_cast<uint32_t>(state) & static_cast<uint32_t>(bit)) == 0)
+            continue;
+        if (text.empty() == false)
+            text += '|';
+        text += name;
+    }
+    return text.empty() ? std::string{"Common"} : text;
+}
+
+std::vector<uint32_t> CompiledGraph::order() const noexcept(false) {
+    std::vector<uint32_t> passes{};
+    for (const Level& level : levels)
+        passes.insert(passes.end(), level.passes.begin(), level.passes.end());
+    return passes;
+}
+
+size_t CompiledGraph::batch_count() const noexcept {
+    size_t count = finalBarriers.empty() ? 0 : 1;
+    for (const Level& level : levels)
+        count += level.barriers.empty() ? 0 : 1;
+    return count;
+}
+
+RenderPassContext::RenderPassContext(RenderGraphBackend& backend, std::span<void* const> natives) noexcept
+    : m_backend{backend}, m_natives{natives} {
+}
+
+RenderGraphBackend& RenderPassContext::backend() const noexcept {
+    return m_backend;
+}
+
+void* RenderPassContext::native(RenderGraphHandle handle) const noexcept(false) {
+    if (handle.index >= m_natives.size())
+        throw std::out_of_range{"invalid render graph handle"};
+    return m_natives[handle.index];
+}
+
+RenderGraph::PassBuilder::PassBuilder(RenderGraph& graph, uint32_t pass) noexcept : m_graph{graph}, m_pass{pass} {
+}
+
+RenderGraphHandle RenderGraph::PassBuilder::read(RenderGraphHandle handle, ResourceState state) noexcept(false) {
+    if (is_write_state(state) && state != ResourceState::UnorderedAccess)
+        throw std::invalid_argument{"read access with a write state"};
+    m_graph.add_access(m_pass, handle, state, false);
+    return handle;
+}
+
+RenderGraphHandle RenderGraph::PassBuilder::write(RenderGraphHandle handle, ResourceState state) noexcept(false) {
+    if (is_write_state(state) == false)
+        throw std::invalid_argument{"write access with a read state"};
+    m_graph.add_access(m_pass, handle, state, true);
+    return handle;
+}
+
+void RenderGraph::PassBuilder::side_effect() noexcept {
+    m_graph.m_passes[m_pass].sideEffect = true;
+}
+
+void RenderGraph::add_access(uint32_t pass, RenderGraphHandle handle, ResourceState state, bool write) noexcept(false) {
+    if (handle.index >= m_resources.size())
+        throw std::out_of_range{"invalid render graph handle"};
+    std::vector<Access>& accesses = m_passes[pass].accesses;
+    for (const Access& access : accesses)
+        if (access.resource == handle.index)
+            throw std::logic_error{"the resource is already used in the pass"};
+    accesses.emplace_back(Access{handle.index, state, write});
+}
+
+RenderGraphHandle RenderGraph::create_texture(std::string name, const TextureDesc& desc) noexcept(false) {
+    const auto index = static_cast<uint32_t>(m_resources.size());
+    m_resources.emplace_back(
+        Resource{std::move(name), desc, false, nullptr, ResourceState::Common, ResourceState::Common});
+    m_isCompiled = false;
+    return RenderGraphHandle{index};
+}
+
+RenderGraphHandle RenderGraph::import_texture(std::string name, const TextureDesc& desc, void* native,
+                                              ResourceState initialState, ResourceState finalState) noexcept(false) {
+    const auto index = static_cast<uint32_t>(m_resources.size());
+    m_resources.emplace_back(Resource{std::move(name), desc, true, native, initialState, finalState});
+    m_isCompiled = false;
+    return RenderGraphHandle{index};
+}
+
+void RenderGraph::bind_import(RenderGraphHandle handle, void* native) noexcept(false) {
+    if (handle.index >= m_resources.size())
+        throw std::out_of_range{"invalid render graph handle"};
+    Resource& resource = m_resources[handle.index];
+    if (resource.imported == false)
+        throw std::invalid_argument{"the resource is not imported"};
+    resource.native = native; // the barriers and the allocations don't depend on the object
+}
+
+/// @note Reference counting from the resources nobody reads. The writes to the imported resources are the roots
+std::vector<bool> RenderGraph::cull() const noexcept(false) {
+    const size_t passCount = m_passes.size();
+    std::vector<uint32_t> passRefs(passCount), resourceRefs(m_resources.size());
+    std::vector<bool> roots(passCount), culled(passCount);
+    for (size_t p = 0; p < passCount; ++p) {
+        roots[p] = m_passes[p].sideEffect;
+        for (const Access& access : m_passes[p].accesses) {
+            if (access.write == false) {
+                ++resourceRefs[access.resource];
+                continue;
+            }
+            ++passRefs[p];
+            if (m_resources[access.resource].imported)
+                roots[p] = true;
+        }
+    }
+
+    std::vector<uint32_t> unused{};
+    auto cull_pass = [&](size_t p) {
+        culled[p] = true;
+        for (const Access& access : m_passes[p].accesses)
+            if (access.write == false && --resourceRefs[access.resource] == 0 &&
+                m_resources[access.resource].imported == false)
+                unused.emplace_back(access.resource);
+    };
+    for (uint32_t r = 0; r < m_resources.size(); ++r)
+        if (resourceRefs[r] == 0 && m_resources[r].imported == false)
+            unused.emplace_back(r);
+    for (size_t p = 0; p < passCount; ++p)
+        if (passRefs[p] == 0 && roots[p] == false)
+            cull_pass(p);
+
+    while (unused.empty() == false) {
+        const uint32_t resource = unused.back();
+        unused.pop_back();
+        for (size_t p = 0; p < passCount; ++p) {
+            if (culled[p])
+                continue;
+            for (const Access& access : m_passes[p].accesses) {
+                if (access.resource != resource || access.write == false)
+                    continue;
+                if (--passRefs[p] == 0 && roots[p] == false)
+                    cull_pass(p);
+            }
+        }
+    }
+    return culled;
+}
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) noexcept {
+    return alignment ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+const CompiledGraph& RenderGraph::compile(RenderGraphBackend& backend) noexcept(false) {
+    m_compiled = CompiledGraph{};
+    const std::vector<bool> culled = cull();
+    const auto resourceCount = static_cast<uint32_t>(m_resources.size());
+
+    // dependency levels. read-after-write, write-after-read, write-after-write
+    struct Tracking {
+        int32_t lastWrite = -1;
+        int32_t lastRead = -1;
+    };
+    std::vector<Tracking> tracking(resourceCount);
+    for (uint32_t p = 0; p < m_passes.size(); ++p) {
+        if (culled[p]) {
+            ++m_compiled.culledPassCount;
+            continue;
+        }
+        int32_t level = 0;
+        for (const Access& access : m_passes[p].accesses) {
+            const Tracking& t = tracking[access.resource];
+            const int32_t dependency = access.write ? (std::max)(t.lastWrite, t.lastRead) : t.lastWrite;
+            level = (std::max)(level, dependency + 1);
+        }
+        for (const Access& access : m_passes[p].accesses) {
+            Tracking& t = tracking[access.resource];
+            if (access.write) {
+                t.lastWrite = level;
+                t.lastRead = -1;
+            } else {
+                t.lastRead = (std::max)(t.lastRead, level);
+            }
+        }
+        if (static_cast<size_t>(level) >= m_compiled.levels.size())
+            m_compiled.levels.resize(level + 1);
+        m_compiled.levels[level].passes.emplace_back(p);
+    }
+
+    // lifetimes of the transient resources
+    constexpr uint32_t unused = UINT32_MAX;
+    const TransientAllocation empty{0, 0, 0, unused, 0, ResourceState::Common, ResourceState::Common};
+    std::vector<TransientAllocation> lifetimes(resourceCount, empty);
+    for (uint32_t level = 0; level < m_compiled.levels.size(); ++level) {
+        for (uint32_t p : m_compiled.levels[level].passes) {
+            for (const Access& access : m_passes[p].accesses) {
+                TransientAllocation& lifetime = lifetimes[access.resource];
+                if (lifetime.firstLevel == unused) {
+                    lifetime.firstLevel = level;
+                    lifetime.initialState = access.state;
+                }
+                lifetime.lastLevel = level;
+                lifetime.usage = lifetime.usage | access.state;
+            }
+        }
+    }
+
+    // memory aliasing. first fit, larger resources first
+    std::vector<TransientAllocation> candidates{};
+    std::vector<uint64_t> alignments(resourceCount);
+    for (uint32_t r = 0; r < resourceCount; ++r) {
+        if (m_resources[r].imported || lifetimes[r].firstLevel == unused)
+            continue;
+        TransientAllocation allocation = lifetimes[r];
+        const auto requirement = backend.query(m_resources[r].desc, allocation.usage);
+        allocation.resource = r;
+        allocation.size = requirement.size;
+        alignments[r] = requirement.alignment;
+        candidates.emplace_back(allocation);
+    }
+    auto larger = [](const TransientAllocation& lhs, const TransientAllocation& rhs) { return lhs.size > rhs.size; };
+    std::stable_sort(candidates.begin(), candidates.end(), larger);
+    for (TransientAllocation& allocation : candidates) {
+        uint64_t offset = 0;
+        for (bool moved = true; moved;) {
+            moved = false;
+            for (const TransientAllocation& placed : m_compiled.allocations) {
+                const bool alive =
+                    placed.firstLevel <= allocation.lastLevel && allocation.firstLevel <= placed.lastLevel;
+                const bool overlap = placed.offset < offset + allocation.size && offset < placed.offset + placed.size;
+                if (alive && overlap) {
+                    offset = align_up(placed.offset + placed.size, alignments[allocation.resource]);
+                    moved = true;
+                }
+            }
+        }
+        allocation.offset = offset;
+        m_compiled.heapSize = (std::max)(m_compiled.heapSize, offset + allocation.size);
+        m_compiled.allocations.emplace_back(allocation);
+    }
+    auto by_index = [](const TransientAllocation& lhs, const TransientAllocation& rhs) {
+        return lhs.resource < rhs.resource;
+    };
+    std::sort(m_compiled.allocations.begin(), m_compiled.allocations.end(), by_index);
+
+    // barriers. the read states in a level are merged, so 1 batch per level is enough
+    std::vector<ResourceState> states(resourceCount, ResourceState::Common);
+    std::vector<bool> initialized(resourceCount), written(resourceCount);
+    for (uint32_t r = 0; r < resourceCount; ++r) {
+        states[r] = m_resources[r].initialState;
+        initialized[r] = m_resources[r].imported;
+    }
+    for (uint32_t level = 0; level < m_compiled.levels.size(); ++level) {
+        CompiledGraph::Level& current = m_compiled.levels[level];
+        for (const TransientAllocation& allocation : m_compiled.allocations) {
+            if (allocation.firstLevel != level)
+                continue;
+            for (const TransientAllocation& previous : m_compiled.allocations) {
+                const bool overlap = previous.offset < allocation.offset + allocation.size &&
+                                     allocation.offset < previous.offset + previous.size;
+                if (previous.lastLevel < level && overlap) {
+                    current.barriers.emplace_back(
+                        GraphBarrier{GraphBarrier::Type::Aliasing, allocation.resource, {}, allocation.initialState});
+                    break;
+                }
+            }
+        }
+
+        std::vector<Access> required{};
+        for (uint32_t p : current.passes) {
+            for (const Access& access : m_passes[p].accesses) {
+                auto it = std::find_if(required.begin(), required.end(),
+                                       [&access](const Access& item) { return item.resource == access.resource; });
+                if (it == required.end())
+                    required.emplace_back(access);
+                else // only reads can share a level
+                    it->state = it->state | access.state;
+            }
+        }
+        for (const Access& access : required) {
+            const uint32_t r = access.resource;
+            if (initialized[r] == false) {
+                initialized[r] = true; // created in the state
+            } else if (states[r] != access.state) {
+                current.barriers.emplace_back(GraphBarrier{GraphBarrier::Type::Transition, r, states[r], access.state});
+            } else if (access.state == ResourceState::UnorderedAccess && (access.write || written[r])) {
+                current.barriers.emplace_back(GraphBarrier{GraphBarrier::Type::UnorderedAccess, r, access.state,
+                                                           access.state});
+            }
+            states[r] = access.state;
+            written[r] = access.write;
+        }
+    }
+    for (uint32_t r = 0; r < resourceCount; ++r) {
+        const Resource& resource = m_resources[r];
+        if (resource.imported && states[r] != resource.finalState)
+            m_compiled.finalBarriers.emplace_back(
+                GraphBarrier{GraphBarrier::Type::Transition, r, states[r], resource.finalState});
+    }
+    m_isCompiled = true;
+    return m_compiled;
+}
+
+void RenderGraph::execute(RenderGraphBackend& backend) noexcept(false) {
+    if (m_isCompiled == false)
+        compile(backend);
+    backend.begin(m_compiled.heapSize);
+    std::vector<void*> natives(m_resources.size());
+    for (uint32_t r = 0; r < m_resources.size(); ++r)
+        natives[r] = m_resources[r].native;
+    for (const TransientAllocation& allocation : m_compiled.allocations)
+        natives[allocation.resource] = backend.create_transient(allocation, m_resources[allocation.resource].desc);
+
+    RenderPassContext context{backend, natives};
+    for (const CompiledGraph::Level& level : m_compiled.levels) {
+        if (level.barriers.empty() == false)
+            backend.barrier(level.barriers, natives);
+        for (uint32_t p : level.passes) {
+            backend.begin_pass(m_passes[p].name);
+            if (m_passes[p].execute)
+                m_passes[p].execute(context);
+            backend.end_pass();
+        }
+    }
+    if (m_compiled.finalBarriers.empty() == false)
+        backend.barrier(m_compiled.finalBarriers, natives);
+    backend.end();
+}
+
+void RenderGraph::reset() noexcept {
+    m_resources.clear();
+    m_passes.clear();
+    m_isCompiled = false;
+}
+
+size_t RenderGraph::pass_count() const noexcept {
+    return m_passes.size();
+}
+
+std::string_view RenderGraph::pass_name(uint32_t pass) const noexcept(false) {
+    return m_passes.at(pass).name;
+}
+
+std::string_view RenderGraph::resource_name(uint32_t resource) const noexcept(false) {
+    return m_resources.at(resource).name;
+}
+
+/// @note 4 bytes per sample, aligned to 64KB. Used by the CPU-only backends
+static RenderGraphBackend::MemoryRequirement make_fake_requirement(const TextureDesc& desc) noexcept {
+    constexpr uint64_t alignment = 64 * 1024;
+    const uint64_t size = uint64_t{desc.width} * desc.height * desc.sampleCount * 4;
+    return RenderGraphBackend::MemoryRequirement{align_up(size, alignment), alignment};
+}
+
+RenderGraphBackend::MemoryRequirement RecordingBackend::query(const TextureDesc& desc, ResourceState) noexcept(false) {
+    return make_fake_requirement(desc);
+}
+
+void RecordingBackend::begin(uint64_t heapSize) noexcept(false) {
+    m_commands.emplace_back("heap " + std::to_string(heapSize));
+}
+
+void* RecordingBackend::create_transient(const TransientAllocation& allocation, const TextureDesc&) noexcept(false) {
+    m_commands.emplace_back("create " + std::to_string(allocation.resource) + " @" +
+                            std::to_string(allocation.offset) + " " + to_string(allocation.initialState));
+    return reinterpret_cast<void*>(static_cast<uintptr_t>(0x1000 + allocation.resource));
+}
+
+void RecordingBackend::barrier(std::span<const GraphBarrier> barriers, std::span<void* const>) noexcept(false) {
+    std::string line{"barrier"};
+    for (const GraphBarrier& barrier : barriers) {
+        const std::string resource = std::to_string(barrier.resource);
+        switch (barrier.type) {
+        case GraphBarrier::Type::Transition:
+            line += " T" + resource + ":" + to_string(barrier.before) + "->" + to_string(barrier.after);
+            break;
+        case GraphBarrier::Type::Aliasing:
+            line += " A" + resource;
+            break;
+        case GraphBarrier::Type::UnorderedAccess:
+            line += " U" + resource;
+            break;
+        }
+    }
+    m_commands.emplace_back(std::move(line));
+}
+
+void RecordingBackend::begin_pass(std::string_view name) noexcept(false) {
+    m_commands.emplace_back("pass " + std::string{name});
+}
+
+void RecordingBackend::end_pass() noexcept(false) {
+}
+
+void RecordingBackend::end() noexcept(false) {
+    m_commands.emplace_back("end");
+}
+
+const std::vector<std::string>& RecordingBackend::commands() const noexcept {
+    return m_commands;
+}
+
+void RecordingBackend::clear() noexcept {
+    m_commands.clear();
+}
+
+RenderGraphBackend::MemoryRequirement NullBackend::query(const TextureDesc& desc, ResourceState) noexcept(false) {
+    return make_fake_requirement(desc);
+}
+
+void NullBackend::begin(uint64_t) noexcept(false) {
+}
+
+void* NullBackend::create_transient(const TransientAllocation& allocation, const TextureDesc&) noexcept(false) {
+    return reinterpret_cast<void*>(static_cast<uintptr_t>(0x1000 + allocation.resource));
+}
+
+void NullBackend::barrier(std::span<const GraphBarrier> barriers, std::span<void* const>) noexcept(false) {
+    m_barrierCount += barriers.size();
+}
+
+void NullBackend::begin_pass(std::string_view) noexcept(false) {
+    ++m_passCount;
+}
+
+void NullBackend::end_pass() noexcept(false) {
+}
+
+void NullBackend::end() noexcept(false) {
+    ++m_frameCount;
+}
+
+uint64_t NullBackend::frame_count() const noexcept {
+    return m_frameCount;
+}
+
+uint64_t NullBackend::pass_count() const noexcept {
+    return m_passCount;
+}
+
+uint64_t NullBackend::barrier_count() const noexcept {
+    return m_barrierCount;
+}
+
+} // namespace DX
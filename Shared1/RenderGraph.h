@@ -0,0 +1,286 @@
+/**
+ * @file RenderGraph.h
+ * @brief Frame graph over DeviceResources. Passes declare the reads and writes, the graph does the rest
+ * @details The compilation is CPU only and doesn't depend on Direct3D.
+ *          `RecordingBackend` records the commands for the tests. `NullBackend` does nothing, for the benchmarks.
+ *          The Direct3D 12 backend is in RenderGraphD3D12.h
+ * @see https://www.gdcvault.com/play/1024612/FrameGraph-Extensible-Rendering-Architecture-in "FrameGraph: Extensible Rendering Architecture in Frostbite"
+ */
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace DX {
+
+/// @note Same meaning with D3D12_RESOURCE_STATES. The read states can be combined
+enum class ResourceState : uint32_t {
+    Common = 0, // also used for Present
+    RenderTarget = 1 << 0,
+    UnorderedAccess = 1 << 1,
+    DepthWrite = 1 << 2,
+    DepthRead = 1 << 3,
+    ShaderResource = 1 << 4,
+    CopyDest = 1 << 5,
+    CopySource = 1 << 6,
+};
+
+constexpr ResourceState operator|(ResourceState lhs, ResourceState rhs) noexcept {
+    return static_cast<ResourceState>(static_cast<uint32_t>(lhs) | static_cast<uint32_t>(rhs));
+}
+
+/// @return true if the state allows only one writer
+constexpr bool is_write_state(ResourceState state) noexcept {
+    constexpr uint32_t mask = static_cast<uint32_t>(ResourceState::RenderTarget | ResourceState::UnorderedAccess |
+                                                    ResourceState::DepthWrite | ResourceState::CopyDest);
+    return (static_cast<uint32_t>(state) & mask) != 0;
+}
+
+/// @return names of the state bits joined with '|'. "Common" for 0
+std::string to_string(ResourceState state) noexcept(false);
+
+/// @brief 2D texture. The format is DXGI_FORMAT value
+struct TextureDesc {
+    uint32_t width = 1;
+    uint32_t height = 1;
+    uint32_t format = 0;
+    uint16_t mipLevels = 1;
+    uint16_t sampleCount = 1;
+
+    bool operator==(const TextureDesc&) const noexcept = default;
+};
+
+struct RenderGraphHandle {
+    uint32_t index = UINT32_MAX;
+
+    bool valid() const noexcept {
+        return index != UINT32_MAX;
+    }
+};
+
+struct GraphBarrier {
+    enum class Type : uint8_t {
+        Transition,
+        Aliasing,       // the memory of the resource was used by other transient resources
+        UnorderedAccess // UAV write after UAV access
+    };
+    Type type = Type::Transition;
+    uint32_t resource = UINT32_MAX;
+    ResourceState before = ResourceState::Common;
+    ResourceState after = ResourceState::Common;
+};
+
+struct TransientAllocation {
+    uint32_t resource;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t firstLevel; // lifetime in CompiledGraph::levels
+    uint32_t lastLevel;
+    ResourceState initialState; // state of the first access
+    ResourceState usage;        // all states in the lifetime. For the resource flags
+};
+
+/**
+ * @brief Result of RenderGraph::compile
+ * @details The passes in a level don't depend on each other. All barriers for a level are issued in 1 batch.
+ */
+struct CompiledGraph {
+    struct Level {
+        std::vector<GraphBarrier> barriers; // before the passes
+        std::vector<uint32_t> passes;       // indices of RenderGraph passes
+    };
+    std::vector<Level> levels{};
+    std::vector<GraphBarrier> finalBarriers{}; // imported resources to their final states
+    std::vector<TransientAllocation> allocations{};
+    uint64_t heapSize = 0;
+    uint32_t culledPassCount = 0;
+
+    /// @return pass indices in the execution order
+    std::vector<uint32_t> order() const noexcept(false);
+    /// @return number of the barrier batches. For example, count of ResourceBarrier calls
+    size_t batch_count() const noexcept;
+};
+
+class RenderGraphBackend {
+  public:
+    struct MemoryRequirement {
+        uint64_t size;
+        uint64_t alignment;
+    };
+
+    virtual ~RenderGraphBackend() = default;
+
+    virtual MemoryRequirement query(const TextureDesc& desc, ResourceState usage) noexcept(false) = 0;
+    /// @brief Make the heap for the transient resources ready. Called before `create_transient`
+    virtual void begin(uint64_t heapSize) noexcept(false) = 0;
+    /**
+     * @brief Create (or reuse) a resource at the offset of the heap
+     * @return native object. For example, ID3D12Resource*
+     * @note The first writer must overwrite (clear) the whole resource. The memory is shared with other resources
+     */
+    virtual void* create_transient(const TransientAllocation& allocation, const TextureDesc& desc) noexcept(false) = 0;
+    /// @param natives the objects of the resources. `GraphBarrier::resource` is the index
+    virtual void barrier(std::span<const GraphBarrier> barriers, std::span<void* const> natives) noexcept(false) = 0;
+    virtual void begin_pass(std::string_view name) noexcept(false) = 0;
+    virtual void end_pass() noexcept(false) = 0;
+    virtual void end() noexcept(false) = 0;
+};
+
+class RenderPassContext final {
+    RenderGraphBackend& m_backend;
+    std::span<void* const> m_natives;
+
+  public:
+    RenderPassContext(RenderGraphBackend& backend, std::span<void* const> natives) noexcept;
+
+    RenderGraphBackend& backend() const noexcept;
+    void* native(RenderGraphHandle handle) const noexcept(false);
+
+    template <typename T>
+    T* get(RenderGraphHandle handle) const noexcept(false) {
+        return static_cast<T*>(native(handle));
+    }
+};
+
+/**
+ * @brief Per-frame graph of the render passes
+ * @details
+ *  - Culling: passes which don't contribute to the imported resources (or side effects) are removed
+ *  - Ordering: live passes are grouped in dependency levels. The declaration order is kept in a level
+ *  - Barriers: state transitions are computed per level and issued in 1 batch
+ *  - Aliasing: transient resources with disjoint lifetimes share the memory of 1 heap
+ *
+ *  Build the graph once and execute it every frame. The imported resources which change every frame
+ *  (the back buffer) are replaced with `bind_import`. Rebuild with `reset` when the passes or the descs are changed.
+ *  The vectors keep their capacity.
+ */
+class RenderGraph final {
+  public:
+    using ExecuteFn = std::function<void(RenderPassContext&)>;
+
+  private:
+    struct Resource {
+        std::string name;
+        TextureDesc desc;
+        bool imported;
+        void* native;
+        ResourceState initialState;
+        ResourceState finalState;
+    };
+    struct Access {
+        uint32_t resource;
+        ResourceState state;
+        bool write;
+    };
+    struct Pass {
+        std::string name;
+        std::vector<Access> accesses;
+        ExecuteFn execute;
+        bool sideEffect;
+    };
+
+    std::vector<Resource> m_resources{};
+    std::vector<Pass> m_passes{};
+    CompiledGraph m_compiled{};
+    bool m_isCompiled = false;
+
+    void add_access(uint32_t pass, RenderGraphHandle handle, ResourceState state, bool write) noexcept(false);
+    std::vector<bool> cull() const noexcept(false);
+
+  public:
+    class PassBuilder final {
+        RenderGraph& m_graph;
+        uint32_t m_pass;
+
+      public:
+        PassBuilder(RenderGraph& graph, uint32_t pass) noexcept;
+
+        RenderGraphHandle read(RenderGraphHandle handle,
+                               ResourceState state = ResourceState::ShaderResource) noexcept(false);
+        RenderGraphHandle write(RenderGraphHandle handle,
+                                ResourceState state = ResourceState::RenderTarget) noexcept(false);
+        /// @brief Never cull the pass. For example, readback or UI overlay
+        void side_effect() noexcept;
+    };
+
+    RenderGraphHandle create_texture(std::string name, const TextureDesc& desc) noexcept(false);
+    /// @param native the object for RenderPassContext::get. For example, the back buffer
+    RenderGraphHandle import_texture(std::string name, const TextureDesc& desc, void* native,
+                                     ResourceState initialState, ResourceState finalState) noexcept(false);
+
+    /**
+     * @brief Replace the native object of the imported resource. The compiled graph is kept
+     * @throws std::invalid_argument if the resource is not imported
+     */
+    void bind_import(RenderGraphHandle handle, void* native) noexcept(false);
+
+    template <typename SetupFn>
+    uint32_t add_pass(std::string name, SetupFn&& setup, ExecuteFn execute) noexcept(false) {
+        const auto index = static_cast<uint32_t>(m_passes.size());
+        m_passes.emplace_back(Pass{std::move(name), {}, std::move(execute), false});
+        PassBuilder builder{*this, index};
+        setup(builder);
+        m_isCompiled = false;
+        return index;
+    }
+
+    const CompiledGraph& compile(RenderGraphBackend& backend) noexcept(false);
+    /// @note `compile` is called if the graph was changed after the last one
+    void execute(RenderGraphBackend& backend) noexcept(false);
+    void reset() noexcept;
+
+    size_t pass_count() const noexcept;
+    std::string_view pass_name(uint32_t pass) const noexcept(false);
+    std::string_view resource_name(uint32_t resource) const noexcept(false);
+};
+
+/**
+ * @brief Backend which records the commands as text lines
+ * @details The memory requirement is width * height * samples * 4 bytes, aligned to 64KB.
+ *          The native objects are fake addresses. Don't dereference them
+ */
+class RecordingBackend final : public RenderGraphBackend {
+    std::vector<std::string> m_commands{};
+
+  public:
+    MemoryRequirement query(const TextureDesc& desc, ResourceState usage) noexcept(false) override;
+    void begin(uint64_t heapSize) noexcept(false) override;
+    void* create_transient(const TransientAllocation& allocation, const TextureDesc& desc) noexcept(false) override;
+    void barrier(std::span<const GraphBarrier> barriers, std::span<void* const> natives) noexcept(false) override;
+    void begin_pass(std::string_view name) noexcept(false) override;
+    void end_pass() noexcept(false) override;
+    void end() noexcept(false) override;
+
+    const std::vector<std::string>& commands() const noexcept;
+    void clear() noexcept;
+};
+
+/**
+ * @brief Backend which only counts the commands
+ * @details Same memory requirement with RecordingBackend. Use it to measure the CPU cost of the graph,
+ *          or with the offscreen DeviceResources when the GPU work is not the interest
+ */
+class NullBackend final : public RenderGraphBackend {
+    uint64_t m_frameCount = 0;
+    uint64_t m_passCount = 0;
+    uint64_t m_barrierCount = 0;
+
+  public:
+    MemoryRequirement query(const TextureDesc& desc, ResourceState usage) noexcept(false) override;
+    void begin(uint64_t heapSize) noexcept(false) override;
+    void* create_transient(const TransientAllocation& allocation, const TextureDesc& desc) noexcept(false) override;
+    void barrier(std::span<const GraphBarrier> barriers, std::span<void* const> natives) noexcept(false) override;
+    void begin_pass(std::string_view name) noexcept(false) override;
+    void end_pass() noexcept(false) override;
+    void end() noexcept(false) override;
+
+    /// @return number of `end` calls
+    uint64_t frame_count() const noexcept;
+    uint64_t pass_count() const noexcept;
+    uint64_t barrier_count() const noexcept;
+};
+
+} // namespace DX
@@ -0,0 +1,183 @@
+#include "pch.h"
+
+#include "RenderGraphD3D12.h"
+
+namespace DX {
+
+static bool HasState(ResourceState state, ResourceState bit) noexcept {
+    return (static_cast<uint32_t>(state) & static_cast<uint32_t>(bit)) != 0;
+}
+
+D3D12_RESOURCE_STATES ToResourceStates(ResourceState state) noexcept {
+    D3D12_RESOURCE_STATES states = D3D12_RESOURCE_STATE_COMMON;
+    if (HasState(state, ResourceState::RenderTarget))
+        states |= D3D12_RESOURCE_STATE_RENDER_TARGET;
+    if (HasState(state, ResourceState::UnorderedAccess))
+        states |= D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+    if (HasState(state, ResourceState::DepthWrite))
+        states |= D3D12_RESOURCE_STATE_DEPTH_WRITE;
+    if (HasState(state, ResourceState::DepthRead))
+        states |= D3D12_RESOURCE_STATE_DEPTH_READ;
+    if (HasState(state, ResourceState::ShaderResource))
+        states |= D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+    if (HasState(state, ResourceState::CopyDest))
+        states |= D3D12_RESOURCE_STATE_COPY_DEST;
+    if (HasState(state, ResourceState::CopySource))
+        states |= D3D12_RESOURCE_STATE_COPY_SOURCE;
+    return states;
+}
+
+D3D12RenderGraphBackend::D3D12RenderGraphBackend(ID3D12Device* device) noexcept(false) {
+    if (device == nullptr)
+        throw winrt::hresult_invalid_argument{};
+    m_device.copy_from(device);
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options{};
+    if (SUCCEEDED(m_device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))))
+        m_heapTier = options.ResourceHeapTier;
+}
+
+void D3D12RenderGraphBackend::SetCommandList(ID3D12GraphicsCommandList* commandList) noexcept {
+    m_commandList = commandList;
+}
+
+void D3D12RenderGraphBackend::Reset() noexcept {
+    m_placed.clear();
+    m_retired.clear();
+    m_current.clear();
+    m_pending.clear();
+    m_heap = nullptr;
+    m_heapSize = 0;
+}
+
+D3D12_RESOURCE_DESC D3D12RenderGraphBackend::MakeResourceDesc(const TextureDesc& desc,
+                                                              ResourceState usage) const noexcept {
+    D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE;
+    if (HasState(usage, ResourceState::RenderTarget))
+        flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+    if (HasState(usage, ResourceState::DepthWrite) || HasState(usage, ResourceState::DepthRead))
+        flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+    if (HasState(usage, ResourceState::UnorderedAccess))
+        flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+    return CD3DX12_RESOURCE_DESC::Tex2D(static_cast<DXGI_FORMAT>(desc.format), desc.width, desc.height, 1,
+                                        desc.mipLevels, desc.sampleCount, 0, flags);
+}
+
+RenderGraphBackend::MemoryRequirement D3D12RenderGraphBackend::query(const TextureDesc& desc,
+                                                                     ResourceState usage) noexcept(false) {
+    const D3D12_RESOURCE_DESC resourceDesc = MakeResourceDesc(desc, usage);
+    const D3D12_RESOURCE_ALLOCATION_INFO info = m_device->GetResourceAllocationInfo(0, 1, &resourceDesc);
+    if (info.SizeInBytes == UINT64_MAX)
+        throw winrt::hresult_invalid_argument{L"GetResourceAllocationInfo failed"};
+    return MemoryRequirement{info.SizeInBytes, info.Alignment};
+}
+
+void D3D12RenderGraphBackend::begin(uint64_t heapSize) noexcept(false) {
+    ++m_frame;
+    std::erase_if(m_retired, [this](const Retired& item) { return item.frame + c_RetireFrameCount <= m_frame; });
+    for (PlacedResource& placed : m_placed)
+        placed.used = false;
+    m_current.clear();
+    m_pending.clear();
+    if (heapSize <= m_heapSize)
+        return;
+
+    // the GPU may still use the resources of the previous frames
+    if (m_heap)
+        m_retired.emplace_back(Retired{m_frame, std::move(m_heap), std::move(m_placed)});
+    m_placed.clear();
+    D3D12_HEAP_DESC desc{};
+    desc.SizeInBytes = heapSize;
+    desc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    desc.Alignment = D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT;
+    desc.Flags = m_heapTier == D3D12_RESOURCE_HEAP_TIER_1 ? D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES
+                                                          : D3D12_HEAP_FLAG_ALLOW_ALL_BUFFERS_AND_TEXTURES;
+    winrt::check_hresult(m_device->CreateHeap(&desc, __uuidof(ID3D12Heap), m_heap.put_void()));
+    m_heap->SetName(L"RenderGraph Transient Heap");
+    m_heapSize = heapSize;
+}
+
+void* D3D12RenderGraphBackend::create_transient(const TransientAllocation& allocation,
+                                                const TextureDesc& desc) noexcept(false) {
+    if (m_current.size() <= allocation.resource)
+        m_current.resize(allocation.resource + 1, SIZE_MAX);
+    const D3D12_RESOURCE_STATES initial = ToResourceStates(allocation.initialState);
+    for (size_t i = 0; i < m_placed.size(); ++i) {
+        PlacedResource& placed = m_placed[i];
+        if (placed.used || placed.offset != allocation.offset)
+            continue;
+        if (placed.desc != desc || placed.usage != allocation.usage)
+            continue;
+        placed.used = true;
+        if (placed.state != initial)
+            m_pending.emplace_back(
+                CD3DX12_RESOURCE_BARRIER::Transition(placed.resource.get(), placed.state, initial));
+        placed.state = initial;
+        m_current[allocation.resource] = i;
+        return placed.resource.get();
+    }
+
+    const bool renderTargetOrDepth = HasState(allocation.usage, ResourceState::RenderTarget) ||
+                                     HasState(allocation.usage, ResourceState::DepthWrite) ||
+                                     HasState(allocation.usage, ResourceState::DepthRead);
+    if (m_heapTier == D3D12_RESOURCE_HEAP_TIER_1 && renderTargetOrDepth == false)
+        throw winrt::hresult_not_implemented{L"Resource heap tier 1 supports transient RT/DS textures only"};
+
+    const D3D12_RESOURCE_DESC resourceDesc = MakeResourceDesc(desc, allocation.usage);
+    PlacedResource placed{desc, allocation.usage, allocation.offset, nullptr, initial, true};
+    winrt::check_hresult(m_device->CreatePlacedResource(m_heap.get(), allocation.offset, &resourceDesc, initial,
+                                                        nullptr, __uuidof(ID3D12Resource),
+                                                        placed.resource.put_void()));
+    m_current[allocation.resource] = m_placed.size();
+    m_placed.emplace_back(std::move(placed));
+    return m_placed.back().resource.get();
+}
+
+void D3D12RenderGraphBackend::FlushPending() noexcept {
+    if (m_pending.empty())
+        return;
+    m_commandList->ResourceBarrier(static_cast<UINT>(m_pending.size()), m_pending.data());
+    m_pending.clear();
+}
+
+void D3D12RenderGraphBackend::barrier(std::span<const GraphBarrier> barriers,
+                                      std::span<void* const> natives) noexcept(false) {
+    // the fixes of the reused resources go together in the same batch
+    m_barriers.assign(m_pending.begin(), m_pending.end());
+    m_pending.clear();
+    for (const GraphBarrier& barrier : barriers) {
+        auto resource = static_cast<ID3D12Resource*>(natives[barrier.resource]);
+        switch (barrier.type) {
+        case GraphBarrier::Type::Transition: {
+            const D3D12_RESOURCE_STATES after = ToResourceStates(barrier.after);
+            m_barriers.emplace_back(
+                CD3DX12_RESOURCE_BARRIER::Transition(resource, ToResourceStates(barrier.before), after));
+            if (barrier.resource < m_current.size() && m_current[barrier.resource] != SIZE_MAX)
+                m_placed[m_current[barrier.resource]].state = after;
+            break;
+        }
+        case GraphBarrier::Type::Aliasing:
+            m_barriers.emplace_back(CD3DX12_RESOURCE_BARRIER::Aliasing(nullptr, resource));
+            break;
+        case GraphBarrier::Type::UnorderedAccess:
+            m_barriers.emplace_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+            break;
+        }
+    }
+    if (m_barriers.empty() == false)
+        m_commandList->ResourceBarrier(static_cast<UINT>(m_barriers.size()), m_barriers.data());
+}
+
+void D3D12RenderGraphBackend::begin_pass(std::string_view) noexcept(false) {
+    if (m_commandList == nullptr)
+        throw winrt::hresult_illegal_method_call{L"SetCommandList is required"};
+    FlushPending();
+}
+
+void D3D12RenderGraphBackend::end_pass() noexcept(false) {
+}
+
+void D3D12RenderGraphBackend::end() noexcept(false) {
+    FlushPending();
+}
+
+} // namespace DX
@@ -0,0 +1,74 @@
+/**
+ * @file RenderGraphD3D12.h
+ * @brief Direct3D 12 backend of RenderGraph. Transient textures are placed resources in 1 heap
+ */
+#pragma once
+#include "RenderGraph.h"
+
+#include <winrt/windows.foundation.h>
+// clang-format off
+#include <Windows.h>
+#include <d3d12.h>
+// clang-format on
+
+namespace DX {
+
+D3D12_RESOURCE_STATES ToResourceStates(ResourceState state) noexcept;
+
+/**
+ * @brief Records the barriers to the command list and keeps the placed resources between the frames
+ * @details The placed resources are reused when the graph allocates the same texture at the same offset.
+ *          When the heap grows, the old one is retired and released after `c_RetireFrameCount` frames.
+ * @note Call `SetCommandList` after DeviceResources::Prepare of each frame
+ */
+class D3D12RenderGraphBackend final : public RenderGraphBackend {
+  public:
+    static constexpr uint32_t c_RetireFrameCount = 4; // DeviceResources::MAX_BACK_BUFFER_COUNT + 1
+
+  private:
+    struct PlacedResource {
+        TextureDesc desc;
+        ResourceState usage;
+        uint64_t offset;
+        winrt::com_ptr<ID3D12Resource> resource;
+        D3D12_RESOURCE_STATES state; // after the last barrier
+        bool used;                   // by the current frame
+    };
+    struct Retired {
+        uint64_t frame;
+        winrt::com_ptr<ID3D12Heap> heap;
+        std::vector<PlacedResource> resources;
+    };
+
+    winrt::com_ptr<ID3D12Device> m_device;
+    ID3D12GraphicsCommandList* m_commandList = nullptr;
+    D3D12_RESOURCE_HEAP_TIER m_heapTier = D3D12_RESOURCE_HEAP_TIER_1;
+    winrt::com_ptr<ID3D12Heap> m_heap;
+    uint64_t m_heapSize = 0;
+    uint64_t m_frame = 0;
+    std::vector<PlacedResource> m_placed{};
+    std::vector<Retired> m_retired{};
+    std::vector<size_t> m_current{};                // resource index -> m_placed index
+    std::vector<D3D12_RESOURCE_BARRIER> m_pending{}; // state fix for the reused resources
+    std::vector<D3D12_RESOURCE_BARRIER> m_barriers{};
+
+    D3D12_RESOURCE_DESC MakeResourceDesc(const TextureDesc& desc, ResourceState usage) const noexcept;
+    void FlushPending() noexcept;
+
+  public:
+    explicit D3D12RenderGraphBackend(ID3D12Device* device) noexcept(false);
+
+    void SetCommandList(ID3D12GraphicsCommandList* commandList) noexcept;
+    /// @note Use after device lost. Releases all heaps and resources
+    void Reset() noexcept;
+
+    MemoryRequirement query(const TextureDesc& desc, ResourceState usage) noexcept(false) override;
+    void begin(uint64_t heapSize) noexcept(false) override;
+    void* create_transient(const TransientAllocation& allocation, const TextureDesc& desc) noexcept(false) override;
+    void barrier(std::span<const GraphBarrier> barriers, std::span<void* const> natives) noexcept(false) override;
+    void begin_pass(std::string_view name) noexcept(false) override;
+    void end_pass() noexcept(false) override;
+    void end() noexcept(false) override;
+};
+
+} // namespace DX
@@ -0,0 +1,382 @@
+#include "pch.h"
+
+#include "RotatingFileLog.h"
+#include "LogArchive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <map>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace winrt::App1 {
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(std::filesystem::path path, size_t capacity) noexcept(false)
+    : m_path{std::move(path)}, m_capacity{capacity} {
+    HANDLE file = CreateFileW(m_path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                              nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::system_error{static_cast<int>(GetLastError()), std::system_category(), "CreateFileW"};
+    m_file = file;
+    // the mapping extends the file to the capacity
+    const auto size = static_cast<uint64_t>(capacity);
+    m_mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32),
+                                   static_cast<DWORD>(size), nullptr);
+    if (m_mapping == nullptr) {
+        const DWORD ec = GetLastError();
+        CloseHandle(file);
+        throw std::system_error{static_cast<int>(ec), std::system_category(), "CreateFileMappingW"};
+    }
+    m_data = static_cast<std::byte*>(MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, capacity));
+    if (m_data == nullptr) {
+        const DWORD ec = GetLastError();
+        CloseHandle(m_mapping);
+        CloseHandle(file);
+        throw std::system_error{static_cast<int>(ec), std::system_category(), "MapViewOfFile"};
+    }
+}
+
+void MappedFile::flush(size_t size) noexcept(false) {
+    if (m_data == nullptr || size == 0)
+        return;
+    if (FlushViewOfFile(m_data, size) == FALSE)
+        throw std::system_error{static_cast<int>(GetLastError()), std::system_category(), "FlushViewOfFile"};
+}
+
+void MappedFile::close(size_t size) noexcept(false) {
+    if (m_file == nullptr)
+        return;
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    m_data = nullptr;
+    m_mapping = nullptr;
+    HANDLE file = std::exchange(m_file, nullptr);
+    LARGE_INTEGER offset{};
+    offset.QuadPart = static_cast<LONGLONG>((std::min)(size, m_capacity));
+    const bool cut = SetFilePointerEx(file, offset, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+    const DWORD ec = GetLastError();
+    CloseHandle(file);
+    if (cut == false)
+        throw std::system_error{static_cast<int>(ec), std::system_category(), "SetEndOfFile"};
+}
+
+#else
+
+MappedFile::MappedFile(std::filesystem::path path, size_t capacity) noexcept(false)
+    : m_path{std::move(path)}, m_capacity{capacity} {
+    m_file = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_file < 0)
+        throw std::system_error{errno, std::system_category(), "open"};
+    const auto size = static_cast<off_t>(capacity);
+#if defined(__linux__)
+    // reserve the blocks. A write to a sparse page fails with SIGBUS when the disk is full
+    int ec = ::posix_fallocate(m_file, 0, size);
+#else
+    int ec = ::ftruncate(m_file, size) == 0 ? 0 : errno;
+#endif
+    if (ec != 0) {
+        ::close(m_file);
+        throw std::system_error{ec, std::system_category(), "posix_fallocate"};
+    }
+    void* data = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+    if (data == MAP_FAILED) {
+        ec = errno;
+        ::close(m_file);
+        throw std::system_error{ec, std::system_category(), "mmap"};
+    }
+    m_data = static_cast<std::byte*>(data);
+}
+
+void MappedFile::flush(size_t size) noexcept(false) {
+    if (m_data == nullptr || size == 0)
+        return;
+    if (::msync(m_data, size, MS_ASYNC) != 0)
+        throw std::system_error{errno, std::system_category(), "msync"};
+}
+
+void MappedFile::close(size_t size) noexcept(false) {
+    if (m_file < 0)
+        return;
+    ::munmap(m_data, m_capacity);
+    m_data = nullptr;
+    const int file = std::exchange(m_file, -1);
+    const int ec = ::ftruncate(file, static_cast<off_t>((std::min)(size, m_capacity))) == 0 ? 0 : errno;
+    ::close(file);
+    if (ec != 0)
+        throw std::system_error{ec, std::system_category(), "ftruncate"};
+}
+
+#endif
+
+MappedFile::~MappedFile() noexcept {
+    try {
+        close(m_capacity);
+    } catch (...) {
+        // Ignore file errors in logging
+    }
+}
+
+std::byte* MappedFile::data() const noexcept {
+    return m_data;
+}
+
+size_t MappedFile::capacity() const noexcept {
+    return m_capacity;
+}
+
+const std::filesystem::path& MappedFile::path() const noexcept {
+    return m_path;
+}
+
+/// @return index of the segment file or its archive. 0 if the name doesn't match
+static uint64_t get_segment_index(const std::filesystem::path& path, std::string_view basename) noexcept {
+    if (path.extension() != ".log" && path.extension() != ".lz4")
+        return 0;
+    const std::string stem = path.stem().string(); // "{basename}.{index}"
+    if (stem.size() <= basename.size() + 1 || stem.starts_with(basename) == false || stem[basename.size()] != '.')
+        return 0;
+    uint64_t index = 0;
+    for (char c : std::string_view{stem}.substr(basename.size() + 1)) {
+        if (c < '0' || c > '9')
+            return 0;
+        index = index * 10 + static_cast<uint64_t>(c - '0');
+    }
+    return index;
+}
+
+RotatingFileLog::RotatingFileLog(RotatingFileOptions options) noexcept(false) : m_options{std::move(options)} {
+    if (m_options.maxSegments < 2)
+        throw std::invalid_argument{"maxSegments must be larger than 1"};
+    if (m_options.segmentSize == 0)
+        throw std::invalid_argument{"segmentSize must be positive"};
+    if (m_options.basename.empty())
+        throw std::invalid_argument{"basename is required"};
+    std::filesystem::create_directories(m_options.directory);
+
+    // continue the numbers of the previous run
+    std::map<uint64_t, std::filesystem::path> files{};
+    for (const auto& entry : std::filesystem::directory_iterator{m_options.directory})
+        if (uint64_t index = get_segment_index(entry.path(), m_options.basename); index != 0 && entry.is_regular_file())
+            files.emplace(index, entry.path());
+    for (auto& [index, path] : files) {
+        if (m_options.compress && path.extension() == ".log") // the previous run has stopped before the compressor
+            m_pending.emplace_back(path);
+        m_files.emplace_back(std::move(path));
+    }
+    m_index = files.empty() ? 1 : files.rbegin()->first + 1;
+
+    m_current = create_segment();
+    remove_old_segments();
+    if (m_options.compress)
+        m_compressor = std::thread{&RotatingFileLog::run_compression, this};
+    m_worker = std::thread{&RotatingFileLog::run, this};
+}
+
+RotatingFileLog::~RotatingFileLog() noexcept {
+    {
+        std::lock_guard lck{m_mtx};
+        m_stop = true;
+    }
+    m_changed.notify_all();
+    if (m_worker.joinable())
+        m_worker.join();
+    {
+        // the remaining segments are compressed in the next run
+        std::lock_guard lck{m_compressMtx};
+        m_compressStop = true;
+    }
+    m_compressChanged.notify_all();
+    if (m_compressor.joinable())
+        m_compressor.join();
+    try {
+        for (auto& [file, size] : m_retired)
+            file->close(size);
+        if (m_current)
+            m_current->close(m_used);
+        if (m_next) {
+            const std::filesystem::path path = m_next->path();
+            m_next->close(0);
+            std::filesystem::remove(path);
+        }
+    } catch (...) {
+        // Ignore file errors in logging
+    }
+}
+
+std::unique_ptr<MappedFile> RotatingFileLog::create_segment() noexcept(false) {
+    const std::string name = std::format("{}.{:06}.log", m_options.basename, m_index);
+    auto file = std::make_unique<MappedFile>(m_options.directory / name, m_options.segmentSize);
+    ++m_index;
+    m_files.emplace_back(file->path());
+    // fault in the pages here, not in the caller of `write`
+    constexpr size_t page_size = 4096;
+    for (size_t offset = 0; offset < file->capacity(); offset += page_size)
+        *reinterpret_cast<volatile std::byte*>(file->data() + offset) = std::byte{0};
+    return file;
+}
+
+static void remove_segment_files(std::filesystem::path path) noexcept {
+    std::error_code ec{};
+    for (const char* extension : {".log", ".lz4", ".idx"})
+        std::filesystem::remove(path.replace_extension(extension), ec);
+}
+
+void RotatingFileLog::remove_old_segments() noexcept {
+    // the last 2 are the current and the next segment. They are never removed
+    while (m_files.size() > m_options.maxSegments) {
+        const std::filesystem::path path = m_files.front();
+        m_files.pop_front();
+        {
+            std::lock_guard lck{m_compressMtx};
+            std::erase(m_pending, path);
+            if (m_compressing == path) { // the compressor removes it after the archive is written
+                m_compressingRemoved = true;
+                continue;
+            }
+        }
+        remove_segment_files(path);
+    }
+}
+
+void RotatingFileLog::enqueue_compression(std::filesystem::path path) noexcept(false) {
+    {
+        std::lock_guard lck{m_compressMtx};
+        m_pending.emplace_back(std::move(path));
+    }
+    m_compressChanged.notify_one();
+}
+
+void RotatingFileLog::run_compression() noexcept {
+#if defined(_WIN32)
+    SetThreadDescription(GetCurrentThread(), L"RotatingFileLog Compression");
+    // the lower CPU and I/O priority than the logging threads and the worker
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+#elif defined(__linux__)
+    const sched_param param{};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+    std::unique_lock lck{m_compressMtx};
+    while (true) {
+        m_compressChanged.wait(lck, [this]() { return m_compressStop || m_pending.empty() == false; });
+        if (m_compressStop)
+            return;
+        m_compressing = std::move(m_pending.front());
+        m_pending.pop_front();
+        lck.unlock();
+
+        bool compressed = false;
+        try {
+            compress_log_segment(m_compressing);
+            std::filesystem::remove(m_compressing);
+            compressed = true;
+        } catch (...) {
+            // Ignore file errors in logging. The segment stays as the text
+        }
+
+        lck.lock();
+        if (m_compressingRemoved)
+            remove_segment_files(m_compressing);
+        else if (compressed)
+            m_compressed.fetch_add(1, std::memory_order_relaxed);
+        m_compressing.clear();
+        m_compressingRemoved = false;
+    }
+}
+
+void RotatingFileLog::run() noexcept {
+#if defined(_WIN32)
+    SetThreadDescription(GetCurrentThread(), L"RotatingFileLog");
+#endif
+    std::vector<std::pair<std::unique_ptr<MappedFile>, size_t>> retired{};
+    bool failed = false; // retry the next segment after the interval
+    std::unique_lock lck{m_mtx};
+    while (true) {
+        m_changed.wait_for(lck, m_options.interval, [this, failed]() {
+            return m_stop || (m_next == nullptr && failed == false) || m_retired.empty() == false || m_flushRequested;
+        });
+        if (m_stop)
+            return;
+        retired.swap(m_retired);
+        const bool prepare = m_next == nullptr;
+        // only this thread closes the segments. The current one stays mapped without the lock
+        MappedFile* current = m_current.get();
+        const size_t used = m_used;
+        m_flushRequested = false;
+        failed = false;
+        lck.unlock();
+
+        try {
+            for (auto& [file, size] : retired) {
+                file->close(size);
+                if (m_options.compress)
+                    enqueue_compression(file->path());
+            }
+            retired.clear();
+            current->flush(used);
+            if (prepare) {
+                auto next = create_segment();
+                remove_old_segments();
+                lck.lock();
+                m_next = std::move(next);
+                continue;
+            }
+        } catch (...) {
+            // Ignore file errors in logging. The records are dropped until the next segment is ready
+            retired.clear();
+            failed = prepare;
+        }
+        lck.lock();
+    }
+}
+
+bool RotatingFileLog::write(std::string_view text) noexcept {
+    std::unique_lock lck{m_mtx};
+    if (m_used + text.size() > m_current->capacity()) {
+        if (m_next == nullptr || text.size() > m_next->capacity()) {
+            lck.unlock();
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        // the worker closes the segment and prepares the next one
+        m_retired.emplace_back(std::move(m_current), m_used);
+        m_current = std::move(m_next);
+        m_used = 0;
+        m_rotations.fetch_add(1, std::memory_order_relaxed);
+        m_changed.notify_one();
+    }
+    std::memcpy(m_current->data() + m_used, text.data(), text.size());
+    m_used += text.size();
+    lck.unlock();
+    m_written.fetch_add(text.size(), std::memory_order_relaxed);
+    return true;
+}
+
+void RotatingFileLog::flush() noexcept {
+    {
+        std::lock_guard lck{m_mtx};
+        m_flushRequested = true;
+    }
+    m_changed.notify_one();
+}
+
+RotatingFileLog::Stats RotatingFileLog::stats() const noexcept {
+    return Stats{m_written.load(), m_dropped.load(), m_rotations.load(), m_compressed.load()};
+}
+
+const RotatingFileOptions& RotatingFileLog::options() const noexcept {
+    return m_options;
+}
+
+} // namespace winrt::App1
@@ -0,0 +1,136 @@
+/**
+ * @file RotatingFileLog.h
+ * @brief Log file segments written through the memory mapping. Rotated by the size
+ * @details The caller only copies the text into the mapped memory. A worker thread creates and preallocates the
+ *          next segment before the current one is full, and closes, truncates and removes the old segments.
+ *          With `RotatingFileOptions::compress`, another worker in the background priority replaces the closed
+ *          segments with LogArchive files, so the compression never delays the next segment.
+ * @note Standard C++ only except the mapping in RotatingFileLog.cpp, which has the Windows and the POSIX versions
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace winrt::App1 {
+
+/**
+ * @brief Preallocated file and its writable view
+ * @note The file is shared for reading while it is mapped
+ */
+class MappedFile final {
+    std::filesystem::path m_path;
+    std::byte* m_data = nullptr;
+    size_t m_capacity = 0;
+#if defined(_WIN32)
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#else
+    int m_file = -1;
+#endif
+
+  public:
+    /// @brief Create (or truncate) the file with `capacity` bytes and map it
+    MappedFile(std::filesystem::path path, size_t capacity) noexcept(false);
+    /// @note Same as `close(capacity())` but the errors are ignored
+    ~MappedFile() noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::byte* data() const noexcept;
+    size_t capacity() const noexcept;
+    const std::filesystem::path& path() const noexcept;
+
+    /// @brief Write the dirty pages in `[0, size)` to the file
+    void flush(size_t size) noexcept(false);
+    /// @brief Unmap and cut the file to `size` bytes, so the readers don't see the unused tail
+    void close(size_t size) noexcept(false);
+};
+
+struct RotatingFileOptions {
+    std::filesystem::path directory;
+    std::string basename = "App";             // the segments are "{basename}.{index:06}.log"
+    size_t segmentSize = 4 * 1024 * 1024;     // bytes. A record is never split across the segments
+    size_t maxSegments = 8;                   // including the current and the preallocated one. At least 2
+    std::chrono::milliseconds interval{1000}; // the worker writes the dirty pages of the current segment
+    bool compress = false;                    // the closed segments become the archives of LogArchive.h
+};
+
+/**
+ * @brief Writes the records to the mapped segments and rotates them in the background
+ * @details `write` takes a short lock for the copy and never waits for the disk.
+ *          When the current segment is full and the next one is not ready yet, the record is dropped and counted.
+ *          The oldest segments are removed so the folder keeps `maxSegments` files.
+ *          The segment numbers continue from the files of the previous run.
+ */
+class RotatingFileLog final {
+  public:
+    struct Stats {
+        uint64_t written = 0; // bytes
+        uint64_t dropped = 0; // records
+        uint64_t rotations = 0;
+        uint64_t compressed = 0; // segments
+    };
+
+  private:
+    RotatingFileOptions m_options;
+    // the caller side
+    std::mutex m_mtx;
+    std::condition_variable m_changed;
+    std::unique_ptr<MappedFile> m_current{};
+    size_t m_used = 0;
+    std::unique_ptr<MappedFile> m_next{};
+    std::vector<std::pair<std::unique_ptr<MappedFile>, size_t>> m_retired{};
+    bool m_flushRequested = false;
+    bool m_stop = false;
+    std::atomic<uint64_t> m_written{0};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_rotations{0};
+    std::atomic<uint64_t> m_compressed{0};
+    // the worker side
+    std::deque<std::filesystem::path> m_files{}; // oldest first
+    uint64_t m_index = 0;                        // of the next segment
+    std::thread m_worker{};
+    // the compressor side
+    std::mutex m_compressMtx;
+    std::condition_variable m_compressChanged;
+    std::deque<std::filesystem::path> m_pending{}; // closed segments to compress
+    std::filesystem::path m_compressing{};
+    bool m_compressingRemoved = false; // the segment became old during the compression
+    bool m_compressStop = false;
+    std::thread m_compressor{};
+
+    std::unique_ptr<MappedFile> create_segment() noexcept(false);
+    void remove_old_segments() noexcept;
+    void enqueue_compression(std::filesystem::path path) noexcept(false);
+    void run() noexcept;
+    void run_compression() noexcept;
+
+  public:
+    /// @throws std::invalid_argument if the options can't keep a segment and the preallocated next one
+    explicit RotatingFileLog(RotatingFileOptions options) noexcept(false);
+    /// @note The current segment is cut to its size, and the preallocated one is removed
+    ~RotatingFileLog() noexcept;
+    RotatingFileLog(const RotatingFileLog&) = delete;
+    RotatingFileLog& operator=(const RotatingFileLog&) = delete;
+
+    /// @return false if the record is dropped
+    bool write(std::string_view text) noexcept;
+    /// @brief Request the worker to write the dirty pages. Doesn't wait
+    void flush() noexcept;
+
+    Stats stats() const noexcept;
+    const RotatingFileOptions& options() const noexcept;
+};
+
+} // namespace winrt::App1
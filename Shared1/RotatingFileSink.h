@@ -0,0 +1,40 @@
+/**
+ * @file RotatingFileSink.h
+ * @brief spdlog sink for RotatingFileLog
+ */
+#pragma once
+#include "RotatingFileLog.h"
+
+#include <spdlog/sinks/base_sink.h>
+
+#include <mutex>
+
+namespace winrt::App1 {
+
+/**
+ * @brief Formats the message and copies it to the mapped segment
+ * @details The records are dropped while the next segment is not ready. See `RotatingFileLog::stats`
+ */
+class RotatingFileSink final : public spdlog::sinks::base_sink<std::mutex> {
+    RotatingFileLog m_log;
+
+  protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override {
+        spdlog::memory_buf_t buf{};
+        formatter_->format(msg, buf);
+        m_log.write(std::string_view{buf.data(), buf.size()});
+    }
+    void flush_() override {
+        m_log.flush();
+    }
+
+  public:
+    explicit RotatingFileSink(RotatingFileOptions options) noexcept(false) : m_log{std::move(options)} {
+    }
+
+    RotatingFileLog::Stats stats() const noexcept {
+        return m_log.stats();
+    }
+};
+
+} // namespace winrt::App1
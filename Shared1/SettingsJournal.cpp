@@ -0,0 +1,312 @@
+#include "pch.h"
+
+#include "SettingsJournal.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace winrt::App1 {
+
+template <typename T>
+static T read_value(const std::byte* data) noexcept {
+    T value{};
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+template <typename T>
+static void write_value(std::vector<std::byte>& output, const T& value) {
+    const auto bytes = std::as_bytes(std::span{&value, 1});
+    output.insert(output.end(), bytes.begin(), bytes.end());
+}
+
+static uint64_t make_checksum(uint64_t sequence, std::span<const std::byte> entries) noexcept {
+    uint64_t value = 14695981039346656037ull;
+    for (auto bytes : {std::as_bytes(std::span{&sequence, 1}), entries}) {
+        for (std::byte b : bytes) {
+            value ^= static_cast<uint8_t>(b);
+            value *= 1099511628211ull;
+        }
+    }
+    return value;
+}
+
+/// @return false if the entries are broken
+template <typename Fn>
+static bool for_each_entry(std::span<const std::byte> entries, uint32_t count, Fn&& fn) {
+    size_t position = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (entries.size() - position < sizeof(uint64_t) + sizeof(uint32_t))
+            return false;
+        const auto hash = read_value<uint64_t>(entries.data() + position);
+        const auto size = read_value<uint32_t>(entries.data() + position + 8);
+        position += sizeof(uint64_t) + sizeof(uint32_t);
+        if (size > entries.size() - position)
+            return false;
+        fn(hash, entries.subspan(position, size));
+        position += size;
+    }
+    return position == entries.size();
+}
+
+struct JournalBatch {
+    uint64_t sequence;
+    uint32_t count;
+    std::span<const std::byte> bytes; // with the batch header
+    std::span<const std::byte> entries;
+};
+
+/// @return the valid batches. Stops at the first broken one
+static std::vector<JournalBatch> scan_journal(std::span<const std::byte> data) noexcept(false) {
+    std::vector<JournalBatch> batches{};
+    if (data.size() < JournaledSettingsStore::header_size ||
+        read_value<uint32_t>(data.data()) != JournaledSettingsStore::magic ||
+        read_value<uint32_t>(data.data() + 4) != JournaledSettingsStore::format_version)
+        return batches;
+    size_t offset = JournaledSettingsStore::header_size;
+    uint64_t last = 0;
+    while (data.size() - offset >= JournaledSettingsStore::batch_header_size) {
+        const std::byte* header = data.data() + offset;
+        const auto sequence = read_value<uint64_t>(header);
+        const auto count = read_value<uint32_t>(header + 8);
+        const auto size = read_value<uint32_t>(header + 12);
+        if (size > data.size() - offset - JournaledSettingsStore::batch_header_size)
+            break;
+        const auto entries = data.subspan(offset + JournaledSettingsStore::batch_header_size, size);
+        if (sequence <= last || make_checksum(sequence, entries) != read_value<uint64_t>(header + 16) ||
+            for_each_entry(entries, count, [](uint64_t, std::span<const std::byte>) {}) == false)
+            break;
+        batches.emplace_back(JournalBatch{sequence, count,
+                                          data.subspan(offset, JournaledSettingsStore::batch_header_size + size),
+                                          entries});
+        offset += JournaledSettingsStore::batch_header_size + size;
+        last = sequence;
+    }
+    return batches;
+}
+
+JournaledSettingsStore::JournaledSettingsStore(std::filesystem::path path,
+                                               SettingsJournalOptions options) noexcept(false)
+    : m_options{options} {
+    if (path.empty())
+        throw std::invalid_argument{"path is required"};
+    if (m_options.compactBytes == 0)
+        throw std::invalid_argument{"compactBytes must be positive"};
+    m_journal = path;
+    m_journal += ".journal";
+    m_snapshot = std::make_unique<MappedSettingsStore>(std::move(path));
+    replay();
+}
+
+JournaledSettingsStore::~JournaledSettingsStore() noexcept {
+    std::thread compactor{};
+    {
+        std::lock_guard lck{m_mtx};
+        compactor = std::move(m_compactor);
+    }
+    if (compactor.joinable())
+        compactor.join();
+}
+
+void JournaledSettingsStore::replay() noexcept(false) {
+    const uint64_t base = m_snapshot->get<uint64_t>(sequence_key).value_or(0);
+    m_sequence = base;
+    m_journal_size = 0;
+    std::error_code ec{};
+    if (std::filesystem::exists(m_journal, ec) == false)
+        return;
+    const ReadOnlyMappedFile file{m_journal};
+    const auto batches = scan_journal(file.bytes());
+    if (batches.empty()) {
+        // only the header is valid. The next commit keeps it
+        const auto data = file.bytes();
+        if (data.size() >= header_size && read_value<uint32_t>(data.data()) == magic &&
+            read_value<uint32_t>(data.data() + 4) == format_version)
+            m_journal_size = header_size;
+        return;
+    }
+    for (const JournalBatch& batch : batches) {
+        if (batch.sequence <= base) // in the snapshot already
+            continue;
+        for_each_entry(batch.entries, batch.count, [this, &batch](uint64_t hash, std::span<const std::byte> value) {
+            m_values.insert_or_assign(hash, Value{{value.begin(), value.end()}, batch.sequence});
+        });
+    }
+    m_sequence = (std::max)(base, batches.back().sequence);
+    m_journal_size = static_cast<uint64_t>(batches.back().bytes.data() + batches.back().bytes.size() -
+                                           file.bytes().data());
+}
+
+bool JournaledSettingsStore::read(const SettingsKey& key, std::span<std::byte> value) const noexcept(false) {
+    if (key.hash == sequence_key.hash)
+        return false;
+    {
+        std::lock_guard lck{m_mtx};
+        const std::vector<std::byte>* bytes = nullptr;
+        if (auto it = m_staged.find(key.hash); it != m_staged.end())
+            bytes = &it->second;
+        else if (auto found = m_values.find(key.hash); found != m_values.end())
+            bytes = &found->second.bytes;
+        if (bytes != nullptr) {
+            if (bytes->size() != value.size())
+                return false;
+            std::memcpy(value.data(), bytes->data(), bytes->size());
+            return true;
+        }
+    }
+    // the compaction moves the values to the snapshot before it removes them from m_values
+    return m_snapshot->read(key, value);
+}
+
+void JournaledSettingsStore::write(const SettingsKey& key, std::span<const std::byte> value) noexcept(false) {
+    if (key.hash == sequence_key.hash)
+        throw std::invalid_argument{"the key is reserved for the journal"};
+    if (value.size() > UINT32_MAX)
+        throw std::length_error{"setting value is too large"};
+    std::lock_guard lck{m_mtx};
+    m_staged.insert_or_assign(key.hash, std::vector<std::byte>{value.begin(), value.end()});
+}
+
+void JournaledSettingsStore::commit() noexcept(false) {
+    std::lock_guard lck{m_mtx};
+    if (m_staged.empty())
+        return;
+    std::error_code ec{};
+    const uint64_t size = std::filesystem::file_size(m_journal, ec);
+    if (ec || size < m_journal_size) {
+        m_journal_size = 0; // removed or truncated by others. Write the values in the journal again
+    } else if (size > m_journal_size) {
+        std::filesystem::resize_file(m_journal, m_journal_size); // the torn batch
+    }
+    const bool rewrite = m_journal_size == 0;
+
+    std::map<uint64_t, std::span<const std::byte>> values{};
+    if (rewrite)
+        for (const auto& [key, value] : m_values)
+            values.emplace(key, value.bytes);
+    for (const auto& [key, value] : m_staged)
+        values.insert_or_assign(key, std::span<const std::byte>{value});
+    std::vector<std::byte> entries{};
+    for (const auto& [key, value] : values) {
+        write_value(entries, key);
+        write_value(entries, static_cast<uint32_t>(value.size()));
+        entries.insert(entries.end(), value.begin(), value.end());
+    }
+    if (entries.size() > UINT32_MAX)
+        throw std::length_error{"settings are too large"};
+
+    const uint64_t sequence = m_sequence + 1;
+    std::vector<std::byte> output{};
+    output.reserve(header_size + batch_header_size + entries.size());
+    if (rewrite) {
+        write_value(output, magic);
+        write_value(output, format_version);
+    }
+    write_value(output, sequence);
+    write_value(output, static_cast<uint32_t>(values.size()));
+    write_value(output, static_cast<uint32_t>(entries.size()));
+    write_value(output, make_checksum(sequence, entries));
+    output.insert(output.end(), entries.begin(), entries.end());
+    // the commit is durable when this returns
+    write_file_synced(m_journal, output, rewrite == false);
+    if (rewrite) // the journal may be a new file
+        sync_directory(m_journal.parent_path());
+    m_journal_size += output.size();
+    m_sequence = sequence;
+    if (rewrite)
+        for (auto& [key, value] : m_values)
+            value.sequence = sequence;
+    for (auto& [key, value] : m_staged)
+        m_values.insert_or_assign(key, Value{std::move(value), sequence});
+    m_staged.clear();
+
+    if (m_journal_size < m_options.compactBytes || m_compacting.exchange(true))
+        return;
+    if (m_compactor.joinable()) // the last one is done
+        m_compactor.join();
+    m_compactor = std::thread{&JournaledSettingsStore::run_compaction, this};
+}
+
+void JournaledSettingsStore::run_compaction() noexcept {
+#if defined(_WIN32)
+    SetThreadDescription(GetCurrentThread(), L"SettingsCompaction");
+#endif
+    try {
+        compact();
+    } catch (...) {
+        // the journal is still valid. The next commit retries
+        m_compact_failures.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_compacting = false;
+}
+
+void JournaledSettingsStore::compact() noexcept(false) {
+    std::lock_guard compacting{m_compact_mtx};
+    uint64_t sequence = 0;
+    {
+        std::lock_guard lck{m_mtx};
+        if (m_values.empty())
+            return;
+        for (const auto& [key, value] : m_values)
+            m_snapshot->write(SettingsKey{key}, value.bytes);
+        sequence = m_sequence;
+    }
+    // the commits append to the journal while the snapshot is written
+    m_snapshot->set(sequence_key, sequence);
+    m_snapshot->commit();
+
+    std::lock_guard lck{m_mtx};
+    std::vector<std::byte> output{};
+    write_value(output, magic);
+    write_value(output, format_version);
+    if (m_journal_size != 0) {
+        const ReadOnlyMappedFile file{m_journal};
+        const auto data = file.bytes();
+        for (const JournalBatch& batch : scan_journal(data.first((std::min)(data.size(), size_t{m_journal_size}))))
+            if (batch.sequence > sequence)
+                output.insert(output.end(), batch.bytes.begin(), batch.bytes.end());
+    }
+    std::filesystem::path temp = m_journal;
+    temp += ".tmp";
+    write_file_synced(temp, output, false);
+    std::filesystem::rename(temp, m_journal);
+    sync_directory(m_journal.parent_path());
+    m_journal_size = output.size();
+    std::erase_if(m_values, [sequence](const auto& item) { return item.second.sequence <= sequence; });
+    m_compactions.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool JournaledSettingsStore::empty() const noexcept {
+    {
+        std::lock_guard lck{m_mtx};
+        if (m_values.empty() == false || m_staged.empty() == false)
+            return false;
+    }
+    return m_snapshot->size() == 0;
+}
+
+uint64_t JournaledSettingsStore::sequence() const noexcept {
+    std::lock_guard lck{m_mtx};
+    return m_sequence;
+}
+
+uint64_t JournaledSettingsStore::journal_size() const noexcept {
+    std::lock_guard lck{m_mtx};
+    return m_journal_size;
+}
+
+uint64_t JournaledSettingsStore::compactions() const noexcept {
+    return m_compactions.load(std::memory_order_relaxed);
+}
+
+uint64_t JournaledSettingsStore::compact_failures() const noexcept {
+    return m_compact_failures.load(std::memory_order_relaxed);
+}
+
+const std::filesystem::path& JournaledSettingsStore::path() const noexcept {
+    return m_snapshot->path();
+}
+
+} // namespace winrt::App1
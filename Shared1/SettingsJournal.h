@@ -0,0 +1,107 @@
+/**
+ * @file SettingsJournal.h
+ * @brief Settings in a snapshot file and a write-ahead journal of the changes
+ * @details `commit` appends the staged values to "{path}.journal" as one batch, instead of rewriting the whole file.
+ *          The journal is replayed over the snapshot at the load. When it grows past `compactBytes`, a background
+ *          thread writes the values to the snapshot and drops the batches in it from the journal.
+ * @note Standard C++ only
+ * @see MappedSettingsStore
+ */
+#pragma once
+#include "SettingsStore.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace winrt::App1 {
+
+struct SettingsJournalOptions {
+    uint64_t compactBytes = 64 * 1024; // the journal size which starts the compaction
+};
+
+/**
+ * @brief `SettingsBackend` with the appended changes
+ * @details The journal layout is (little endian)
+ *  - header: magic "SETJ"(u32), format version(u32)
+ *  - batches: sequence(u64), entry count(u32), entry bytes(u32), checksum(u64) of the entries and the sequence
+ *  - entries of a batch: key hash(u64), size(u32), value
+ *
+ *  The snapshot is a `MappedSettingsStore` file. It keeps the sequence of the last batch in it, so the replay skips
+ *  the batches which are compacted already. The replay stops at the first broken batch, which is the torn append of
+ *  a crash, and the next `commit` overwrites it.
+ *  The compaction commits the snapshot before it rewrites the journal. A crash between them keeps the old journal,
+ *  and its batches are skipped by the sequence.
+ *  Each batch is on the disk before `commit` returns, and the rewritten journal is on the disk before the rename.
+ *  See `write_file_synced`
+ */
+class JournaledSettingsStore final : public SettingsBackend {
+  public:
+    static constexpr uint32_t magic = 0x4A544553; // "SETJ"
+    static constexpr uint32_t format_version = 1;
+    static constexpr size_t header_size = 8;
+    static constexpr size_t batch_header_size = 24;
+    /// @brief The last sequence in the snapshot. Not a setting
+    static constexpr SettingsKey sequence_key{"#journal-sequence"};
+
+  private:
+    struct Value {
+        std::vector<std::byte> bytes;
+        uint64_t sequence; // of the batch which has written it
+    };
+
+    std::filesystem::path m_journal;
+    SettingsJournalOptions m_options;
+    std::unique_ptr<MappedSettingsStore> m_snapshot;
+    mutable std::mutex m_mtx;
+    std::map<uint64_t, Value> m_values{}; // in the journal. Newer than the snapshot
+    std::map<uint64_t, std::vector<std::byte>> m_staged{};
+    uint64_t m_sequence = 0;     // of the last batch
+    uint64_t m_journal_size = 0; // the valid bytes in the file
+    std::mutex m_compact_mtx;    // only one compaction at a time
+    std::atomic<bool> m_compacting = false;
+    std::atomic<uint64_t> m_compactions{0};
+    std::atomic<uint64_t> m_compact_failures{0};
+    std::thread m_compactor{};
+
+    void replay() noexcept(false);
+    void run_compaction() noexcept;
+
+  public:
+    /**
+     * @param path the snapshot. The journal is "{path}.journal"
+     * @note The missing or broken files are same as the empty settings
+     */
+    explicit JournaledSettingsStore(std::filesystem::path path, SettingsJournalOptions options = {}) noexcept(false);
+    /// @note Waits for the compaction
+    ~JournaledSettingsStore() noexcept;
+    JournaledSettingsStore(const JournaledSettingsStore&) = delete;
+    JournaledSettingsStore& operator=(const JournaledSettingsStore&) = delete;
+
+    bool read(const SettingsKey& key, std::span<std::byte> value) const noexcept(false) override;
+    void write(const SettingsKey& key, std::span<const std::byte> value) noexcept(false) override;
+    /**
+     * @brief Append the staged values as one batch. Starts the compaction in the background if the journal is large
+     * @throws std::system_error if the append failed. The values are kept staged, and the torn batch is overwritten
+     */
+    void commit() noexcept(false) override;
+
+    /// @brief Move the journal to the snapshot on the caller thread
+    void compact() noexcept(false);
+
+    /// @return true if neither the snapshot nor the journal has a value
+    bool empty() const noexcept;
+    uint64_t sequence() const noexcept;
+    uint64_t journal_size() const noexcept;
+    uint64_t compactions() const noexcept;
+    /// @note The failed compaction is retried by the next `commit`
+    uint64_t compact_failures() const noexcept;
+    const std::filesystem::path& path() const noexcept;
+};
+
+} // namespace winrt::App1
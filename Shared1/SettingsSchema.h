@@ -0,0 +1,283 @@
+/**
+ * @file SettingsSchema.h
+ * @brief Compile-time declaration of the settings
+ * @details Each setting declares its key, type, default value and validation once, as a constexpr variable.
+ *          The key hashes are computed by the compiler, so the accessors don't touch the names at runtime.
+ *          The persisted layout follows the schema. Each setting is an entry of its key hash with `sizeof(T)` bytes.
+ * @code
+ * inline constexpr Setting<uint32_t> counter{SettingsKey{"Counter"}, 0};
+ * using Schema = SettingsSchema<counter>;
+ * SettingsState<Schema> state{};
+ * state.set<counter>(3);
+ *
+ * auto update = state.begin(); // many changes, one notification
+ * update.set<counter>(4);
+ * SettingsMask changed = state.commit(update);
+ * @endcode
+ * @note Standard C++ only
+ */
+#pragma once
+#include "SettingsStore.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace winrt::App1 {
+
+template <typename T>
+constexpr bool accept_setting(const T&) noexcept {
+    return true;
+}
+
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+struct Setting {
+    using value_type = T;
+
+    SettingsKey key;
+    T fallback; // the default value
+    bool (*valid)(const T&) noexcept = &accept_setting<T>;
+
+    /// @return `fallback` if the value is not valid
+    constexpr T sanitize(const T& value) const noexcept {
+        return valid(value) ? value : fallback;
+    }
+};
+
+/// @brief A bit for each setting in the schema, in the declaration order
+using SettingsMask = uint64_t;
+
+template <const auto&... Settings>
+class SettingsSchema final {
+    static consteval bool has_unique_keys() noexcept {
+        const uint64_t hashes[]{Settings.key.hash...};
+        for (size_t i = 0; i < sizeof...(Settings); ++i)
+            for (size_t j = i + 1; j < sizeof...(Settings); ++j)
+                if (hashes[i] == hashes[j])
+                    return false;
+        return true;
+    }
+    static_assert(sizeof...(Settings) > 0, "the schema needs a setting");
+    static_assert(has_unique_keys(), "the key hashes must be unique");
+    static_assert(sizeof...(Settings) <= 64, "SettingsMask has 64 bits");
+
+    static constexpr auto indices = std::make_index_sequence<sizeof...(Settings)>{};
+
+  public:
+    /// @brief The values in the declaration order
+    using Values = std::tuple<typename std::remove_cvref_t<decltype(Settings)>::value_type...>;
+
+    static constexpr size_t size() noexcept {
+        return sizeof...(Settings);
+    }
+
+    template <const auto& S>
+    static constexpr size_t index_of() noexcept {
+        // the keys are unique in the schema. The setting with a same key and a different type is not in it
+        using T = typename std::remove_cvref_t<decltype(S)>::value_type;
+        const bool matches[]{
+            (S.key.hash == Settings.key.hash &&
+             std::is_same_v<T, typename std::remove_cvref_t<decltype(Settings)>::value_type>)...};
+        size_t index = 0;
+        while (index < sizeof...(Settings) && matches[index] == false)
+            ++index;
+        return index;
+    }
+
+    template <const auto& S>
+    static constexpr bool contains() noexcept {
+        return index_of<S>() < sizeof...(Settings);
+    }
+
+    template <const auto& S>
+        requires(contains<S>())
+    static constexpr SettingsMask bit() noexcept {
+        return SettingsMask{1} << index_of<S>();
+    }
+
+    static constexpr SettingsMask all() noexcept {
+        return (bit<Settings>() | ...);
+    }
+
+    static constexpr Values defaults() noexcept {
+        return Values{Settings.fallback...};
+    }
+
+    /// @return the invalid values are replaced by the defaults
+    static constexpr Values sanitize(const Values& values) noexcept {
+        return std::apply([](const auto&... value) { return Values{Settings.sanitize(value)...}; }, values);
+    }
+
+    /// @return the bits of the values which are different
+    static constexpr SettingsMask compare(const Values& lhs, const Values& rhs) noexcept {
+        return [&]<size_t... I>(std::index_sequence<I...>) {
+            return ((std::get<I>(lhs) == std::get<I>(rhs) ? SettingsMask{0} : SettingsMask{1} << I) | ...);
+        }(indices);
+    }
+
+    /// @brief Copy the values of the bits in `mask` only
+    static constexpr void merge(Values& values, const Values& source, SettingsMask mask) noexcept {
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            ((mask & (SettingsMask{1} << I) ? void(std::get<I>(values) = std::get<I>(source)) : void()), ...);
+        }(indices);
+    }
+
+    template <const auto& S>
+    static auto load(const SettingsBackend& backend) noexcept(false) {
+        using T = typename std::remove_cvref_t<decltype(S)>::value_type;
+        return S.sanitize(backend.get<T>(S.key).value_or(S.fallback));
+    }
+
+    /// @brief Read the values. The missing, wrong sized or invalid ones are the defaults
+    static Values load(const SettingsBackend& backend) noexcept(false) {
+        return Values{load<Settings>(backend)...};
+    }
+
+    /// @brief Stage all values in the backend. The caller commits them
+    static void save(SettingsBackend& backend, const Values& values) noexcept(false) {
+        std::apply([&backend](const auto&... value) { (backend.set(Settings.key, value), ...); }, values);
+    }
+};
+
+/**
+ * @brief The staged changes of a SettingsState. See `SettingsState::commit`
+ * @note Not thread-safe. The values which are not staged are the ones of `SettingsState::begin`
+ */
+template <typename Schema>
+class SettingsTransaction final {
+  public:
+    using Values = typename Schema::Values;
+
+  private:
+    Values m_values;
+    SettingsMask m_staged = 0;
+
+  public:
+    constexpr explicit SettingsTransaction(const Values& values) noexcept : m_values{values} {
+    }
+
+    template <const auto& S>
+        requires(Schema::template contains<S>())
+    constexpr auto get() const noexcept {
+        return std::get<Schema::template index_of<S>()>(m_values);
+    }
+
+    /// @param value replaced by the default if it is not valid
+    template <const auto& S>
+        requires(Schema::template contains<S>())
+    constexpr void set(const typename std::remove_cvref_t<decltype(S)>::value_type& value) noexcept {
+        std::get<Schema::template index_of<S>()>(m_values) = S.sanitize(value);
+        m_staged |= Schema::template bit<S>();
+    }
+
+    /// @brief Stage all values. For the reset or the import of a profile
+    constexpr void assign(const Values& values) noexcept {
+        m_values = Schema::sanitize(values);
+        m_staged = Schema::all();
+    }
+
+    constexpr SettingsMask staged() const noexcept {
+        return m_staged;
+    }
+
+    constexpr const Values& values() const noexcept {
+        return m_values;
+    }
+};
+
+/**
+ * @brief The current values of a schema, shared by the UI thread and the writer thread
+ * @note The accessors take a short lock. The values are copied, not boxed
+ * @details The changes before `load` are kept in a mask. `load` doesn't overwrite them with the stored values
+ */
+template <typename Schema>
+class SettingsState final {
+  public:
+    using Values = typename Schema::Values;
+
+  private:
+    mutable std::mutex m_mtx;
+    Values m_values = Schema::defaults();
+    SettingsMask m_edited = 0; // by `set` and `commit` before `load`
+    bool m_loaded = false;
+
+  public:
+    template <const auto& S>
+        requires(Schema::template contains<S>())
+    auto get() const noexcept {
+        std::lock_guard lck{m_mtx};
+        return std::get<Schema::template index_of<S>()>(m_values);
+    }
+
+    /**
+     * @param value replaced by the default if it is not valid
+     * @return false if the value is same as the current one
+     */
+    template <const auto& S>
+        requires(Schema::template contains<S>())
+    bool set(const typename std::remove_cvref_t<decltype(S)>::value_type& value) noexcept {
+        const auto sanitized = S.sanitize(value);
+        std::lock_guard lck{m_mtx};
+        if (m_loaded == false)
+            m_edited |= Schema::template bit<S>();
+        auto& current = std::get<Schema::template index_of<S>()>(m_values);
+        if (current == sanitized)
+            return false;
+        current = sanitized;
+        return true;
+    }
+
+    Values snapshot() const noexcept {
+        std::lock_guard lck{m_mtx};
+        return m_values;
+    }
+
+    void assign(const Values& values) noexcept {
+        std::lock_guard lck{m_mtx};
+        if (m_loaded == false)
+            m_edited = Schema::all();
+        m_values = values;
+    }
+
+    /**
+     * @brief Apply the stored values once. The ones which are set or committed before the call are not overwritten
+     * @param values the stored values. The invalid ones are replaced by the defaults
+     * @return the bits of the changed values
+     */
+    SettingsMask load(const Values& values) noexcept {
+        const Values sanitized = Schema::sanitize(values);
+        std::lock_guard lck{m_mtx};
+        if (std::exchange(m_loaded, true))
+            return 0;
+        Values merged = m_values;
+        Schema::merge(merged, sanitized, Schema::all() & ~m_edited);
+        const SettingsMask changed = Schema::compare(m_values, merged);
+        m_values = merged;
+        return changed;
+    }
+
+    SettingsTransaction<Schema> begin() const noexcept {
+        return SettingsTransaction<Schema>{snapshot()};
+    }
+
+    /**
+     * @brief Apply the staged values at once. The other threads see all of them or none
+     * @return the bits of the changed values. 0 if the staged values are same as the current ones
+     */
+    SettingsMask commit(const SettingsTransaction<Schema>& update) noexcept {
+        std::lock_guard lck{m_mtx};
+        Values values = m_values;
+        Schema::merge(values, update.values(), update.staged());
+        if (m_loaded == false)
+            m_edited |= update.staged();
+        const SettingsMask changed = Schema::compare(m_values, values);
+        m_values = values;
+        return changed;
+    }
+};
+
+} // namespace winrt::App1
@@ -0,0 +1,337 @@
+#include "pch.h"
+
+#include "SettingsStore.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace winrt::App1 {
+
+#if defined(_WIN32)
+
+ReadOnlyMappedFile::ReadOnlyMappedFile(const std::filesystem::path& path) noexcept(false) {
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::system_error{static_cast<int>(GetLastError()), std::system_category(), "CreateFileW"};
+    m_file = file;
+    LARGE_INTEGER size{};
+    if (GetFileSizeEx(file, &size) == FALSE) {
+        const DWORD ec = GetLastError();
+        CloseHandle(std::exchange(m_file, nullptr));
+        throw std::system_error{static_cast<int>(ec), std::system_category(), "GetFileSizeEx"};
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+    if (m_size == 0) // CreateFileMappingW fails for the empty file
+        return;
+    m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping == nullptr) {
+        const DWORD ec = GetLastError();
+        CloseHandle(std::exchange(m_file, nullptr));
+        throw std::system_error{static_cast<int>(ec), std::system_category(), "CreateFileMappingW"};
+    }
+    m_data = static_cast<const std::byte*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr) {
+        const DWORD ec = GetLastError();
+        CloseHandle(std::exchange(m_mapping, nullptr));
+        CloseHandle(std::exchange(m_file, nullptr));
+        throw std::system_error{static_cast<int>(ec), std::system_category(), "MapViewOfFile"};
+    }
+}
+
+ReadOnlyMappedFile::~ReadOnlyMappedFile() noexcept {
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+}
+
+void write_file_synced(const std::filesystem::path& path, std::span<const std::byte> bytes,
+                       bool append) noexcept(false) {
+    HANDLE file = CreateFileW(path.c_str(), append ? FILE_APPEND_DATA : GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                              append ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::system_error{static_cast<int>(GetLastError()), std::system_category(), "CreateFileW"};
+    const char* failed = nullptr;
+    for (size_t offset = 0; offset < bytes.size();) {
+        const DWORD size = static_cast<DWORD>((std::min)(bytes.size() - offset, size_t{1} << 30));
+        DWORD written = 0;
+        if (WriteFile(file, bytes.data() + offset, size, &written, nullptr) == FALSE) {
+            failed = "WriteFile";
+            break;
+        }
+        offset += written;
+    }
+    if (failed == nullptr && FlushFileBuffers(file) == FALSE)
+        failed = "FlushFileBuffers";
+    const DWORD ec = GetLastError();
+    CloseHandle(file);
+    if (failed)
+        throw std::system_error{static_cast<int>(ec), std::system_category(), failed};
+}
+
+void sync_directory(const std::filesystem::path&) noexcept(false) {
+}
+
+#else
+
+ReadOnlyMappedFile::ReadOnlyMappedFile(const std::filesystem::path& path) noexcept(false) {
+    m_file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_file < 0)
+        throw std::system_error{errno, std::system_category(), "open"};
+    struct stat info{};
+    if (::fstat(m_file, &info) != 0) {
+        const int ec = errno;
+        ::close(std::exchange(m_file, -1));
+        throw std::system_error{ec, std::system_category(), "fstat"};
+    }
+    m_size = static_cast<size_t>(info.st_size);
+    if (m_size == 0) // mmap fails for the empty file
+        return;
+    void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_file, 0);
+    if (data == MAP_FAILED) {
+        const int ec = errno;
+        ::close(std::exchange(m_file, -1));
+        throw std::system_error{ec, std::system_category(), "mmap"};
+    }
+    m_data = static_cast<const std::byte*>(data);
+}
+
+ReadOnlyMappedFile::~ReadOnlyMappedFile() noexcept {
+    if (m_data)
+        ::munmap(const_cast<std::byte*>(m_data), m_size);
+    if (m_file >= 0)
+        ::close(m_file);
+}
+
+void write_file_synced(const std::filesystem::path& path, std::span<const std::byte> bytes,
+                       bool append) noexcept(false) {
+    const int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+    const int file = ::open(path.c_str(), flags, 0644);
+    if (file < 0)
+        throw std::system_error{errno, std::system_category(), "open"};
+    const char* failed = nullptr;
+    for (size_t offset = 0; offset < bytes.size();) {
+        const ssize_t written = ::write(file, bytes.data() + offset, bytes.size() - offset);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            failed = "write";
+            break;
+        }
+        offset += static_cast<size_t>(written);
+    }
+    if (failed == nullptr && ::fsync(file) != 0)
+        failed = "fsync";
+    const int ec = errno;
+    ::close(file);
+    if (failed)
+        throw std::system_error{ec, std::system_category(), failed};
+}
+
+void sync_directory(const std::filesystem::path& directory) noexcept(false) {
+    const int file = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (file < 0)
+        throw std::system_error{errno, std::system_category(), "open"};
+    const int result = ::fsync(file);
+    const int ec = errno;
+    ::close(file);
+    if (result != 0)
+        throw std::system_error{ec, std::system_category(), "fsync"};
+}
+
+#endif
+
+std::span<const std::byte> ReadOnlyMappedFile::bytes() const noexcept {
+    if (m_data == nullptr)
+        return {};
+    return {m_data, m_size};
+}
+
+static uint64_t make_checksum(std::span<const std::byte> entries, std::span<const std::byte> values) noexcept {
+    uint64_t value = 14695981039346656037ull;
+    for (auto bytes : {entries, values}) {
+        for (std::byte b : bytes) {
+            value ^= static_cast<uint8_t>(b);
+            value *= 1099511628211ull;
+        }
+    }
+    return value;
+}
+
+template <typename T>
+static T read_value(const std::byte* data) noexcept {
+    T value{};
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+template <typename T>
+static void write_value(std::vector<std::byte>& output, const T& value) {
+    const auto bytes = std::as_bytes(std::span{&value, 1});
+    output.insert(output.end(), bytes.begin(), bytes.end());
+}
+
+MappedSettingsStore::MappedSettingsStore(std::filesystem::path path) noexcept(false) : m_path{std::move(path)} {
+    if (m_path.empty())
+        throw std::invalid_argument{"path is required"};
+    map();
+}
+
+bool MappedSettingsStore::map() noexcept(false) {
+    m_entries = {};
+    m_values = {};
+    m_generation = 0;
+    m_file.reset();
+    std::error_code ec{};
+    if (std::filesystem::exists(m_path, ec) == false)
+        return false;
+    auto file = std::make_unique<ReadOnlyMappedFile>(m_path);
+    const std::span<const std::byte> data = file->bytes();
+    if (data.size() < header_size)
+        return false;
+    const auto count = read_value<uint32_t>(data.data() + 8);
+    const auto size = read_value<uint32_t>(data.data() + 12);
+    if (read_value<uint32_t>(data.data()) != magic || read_value<uint32_t>(data.data() + 4) != format_version ||
+        data.size() != header_size + size_t{count} * entry_size + size)
+        return false;
+    const auto entries = data.subspan(header_size, size_t{count} * entry_size);
+    const auto values = data.subspan(header_size + entries.size());
+    if (make_checksum(entries, values) != read_value<uint64_t>(data.data() + 24))
+        return false;
+    m_file = std::move(file);
+    m_entries = entries;
+    m_values = values;
+    m_generation = read_value<uint64_t>(data.data() + 16);
+    return true;
+}
+
+bool MappedSettingsStore::load() noexcept(false) {
+    std::lock_guard lck{m_mtx};
+    return map();
+}
+
+std::optional<std::span<const std::byte>> MappedSettingsStore::find(uint64_t hash) const noexcept {
+    size_t first = 0;
+    size_t last = m_entries.size() / entry_size;
+    while (first < last) {
+        const size_t middle = first + (last - first) / 2;
+        const std::byte* entry = m_entries.data() + middle * entry_size;
+        const auto key = read_value<uint64_t>(entry);
+        if (key < hash) {
+            first = middle + 1;
+        } else if (key > hash) {
+            last = middle;
+        } else {
+            const auto offset = read_value<uint32_t>(entry + 8);
+            const auto size = read_value<uint32_t>(entry + 12);
+            if (size_t{offset} + size > m_values.size())
+                return std::nullopt;
+            return m_values.subspan(offset, size);
+        }
+    }
+    return std::nullopt;
+}
+
+bool MappedSettingsStore::read(const SettingsKey& key, std::span<std::byte> value) const noexcept(false) {
+    std::lock_guard lck{m_mtx};
+    std::span<const std::byte> bytes{};
+    if (auto it = m_staged.find(key.hash); it != m_staged.end()) {
+        bytes = it->second;
+    } else if (auto found = find(key.hash)) {
+        bytes = *found;
+    } else {
+        return false;
+    }
+    if (bytes.size() != value.size())
+        return false;
+    std::memcpy(value.data(), bytes.data(), bytes.size());
+    return true;
+}
+
+void MappedSettingsStore::write(const SettingsKey& key, std::span<const std::byte> value) noexcept(false) {
+    if (value.size() > UINT32_MAX)
+        throw std::length_error{"setting value is too large"};
+    std::lock_guard lck{m_mtx};
+    m_staged.insert_or_assign(key.hash, std::vector<std::byte>{value.begin(), value.end()});
+}
+
+void MappedSettingsStore::commit() noexcept(false) {
+    std::lock_guard lck{m_mtx};
+    if (m_staged.empty())
+        return;
+    // merge the file and the staged values. std::map keeps them sorted by the hash
+    std::map<uint64_t, std::span<const std::byte>> merged{};
+    for (size_t offset = 0; offset < m_entries.size(); offset += entry_size) {
+        const auto key = read_value<uint64_t>(m_entries.data() + offset);
+        if (auto value = find(key))
+            merged.emplace(key, *value);
+    }
+    for (const auto& [key, value] : m_staged)
+        merged.insert_or_assign(key, std::span<const std::byte>{value});
+
+    std::vector<std::byte> entries{};
+    std::vector<std::byte> values{};
+    entries.reserve(merged.size() * entry_size);
+    for (const auto& [key, value] : merged) {
+        if (values.size() + value.size() > UINT32_MAX)
+            throw std::length_error{"settings are too large"};
+        write_value(entries, key);
+        write_value(entries, static_cast<uint32_t>(values.size()));
+        write_value(entries, static_cast<uint32_t>(value.size()));
+        values.insert(values.end(), value.begin(), value.end());
+    }
+    std::vector<std::byte> output{};
+    output.reserve(header_size + entries.size() + values.size());
+    write_value(output, magic);
+    write_value(output, format_version);
+    write_value(output, static_cast<uint32_t>(merged.size()));
+    write_value(output, static_cast<uint32_t>(values.size()));
+    write_value(output, m_generation + 1);
+    write_value(output, make_checksum(entries, values));
+    output.insert(output.end(), entries.begin(), entries.end());
+    output.insert(output.end(), values.begin(), values.end());
+
+    std::filesystem::path temp = m_path;
+    temp += ".tmp";
+    // on the disk before the rename, so a crash leaves the old or the new file. Never the renamed empty one
+    write_file_synced(temp, output, false);
+    // the mapped file can't be replaced on Windows. `merged` doesn't refer to the mapping after this
+    m_file.reset();
+    std::error_code ec{};
+    std::filesystem::rename(temp, m_path, ec);
+    map();
+    if (ec)
+        throw std::system_error{ec, m_path.string()};
+    sync_directory(m_path.parent_path());
+    m_staged.clear();
+}
+
+size_t MappedSettingsStore::size() const noexcept {
+    std::lock_guard lck{m_mtx};
+    return m_entries.size() / entry_size;
+}
+
+uint64_t MappedSettingsStore::generation() const noexcept {
+    std::lock_guard lck{m_mtx};
+    return m_generation;
+}
+
+const std::filesystem::path& MappedSettingsStore::path() const noexcept {
+    return m_path;
+}
+
+} // namespace winrt::App1
@@ -0,0 +1,170 @@
+/**
+ * @file SettingsStore.h
+ * @brief Pluggable storage of the settings and the memory-mapped implementation
+ * @details The settings are the bytes of trivially copyable values, found by the 64-bit hash of the key name.
+ *          `MappedSettingsStore` maps the whole file once, and each lookup is a binary search in the mapped entries.
+ *          The changes are staged in memory, and `commit` replaces the file with the temporary one.
+ * @note Standard C++ only except the mapping and the synced writes in SettingsStore.cpp, which have the Windows and
+ *       the POSIX versions
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace winrt::App1 {
+
+/// @brief 64-bit FNV-1a of the name. Stable across the processes and the builds
+constexpr uint64_t hash_settings_key(std::string_view name) noexcept {
+    uint64_t value = 14695981039346656037ull;
+    for (char c : name) {
+        value ^= static_cast<uint8_t>(c);
+        value *= 1099511628211ull;
+    }
+    return value;
+}
+
+struct SettingsKey {
+    uint64_t hash;
+    std::string_view name; // for the backends which store the names. Must outlive the key
+
+    constexpr explicit SettingsKey(std::string_view name) noexcept : hash{hash_settings_key(name)}, name{name} {
+    }
+    /// @note for the backends which keep the hashes only. The name is empty
+    constexpr explicit SettingsKey(uint64_t hash) noexcept : hash{hash}, name{} {
+    }
+};
+
+/**
+ * @brief Storage of the settings
+ * @note The implementations must be safe to use from multiple threads
+ */
+class SettingsBackend {
+  public:
+    virtual ~SettingsBackend() noexcept = default;
+
+    /// @return false if the key is not found or the size is different. `value` is not changed then
+    virtual bool read(const SettingsKey& key, std::span<std::byte> value) const noexcept(false) = 0;
+    /// @brief Stage the value. `read` returns it before the commit
+    virtual void write(const SettingsKey& key, std::span<const std::byte> value) noexcept(false) = 0;
+    /// @brief Persist the staged values
+    virtual void commit() noexcept(false) = 0;
+
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    std::optional<T> get(const SettingsKey& key) const noexcept(false) {
+        T value{};
+        if (read(key, std::as_writable_bytes(std::span{&value, 1})) == false)
+            return std::nullopt;
+        return value;
+    }
+
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    void set(const SettingsKey& key, const T& value) noexcept(false) {
+        write(key, std::as_bytes(std::span{&value, 1}));
+    }
+};
+
+/**
+ * @brief Read-only view of a whole file
+ * @note The file is shared for reading and deletion, so it can be replaced after the unmap
+ */
+class ReadOnlyMappedFile final {
+    const std::byte* m_data = nullptr;
+    size_t m_size = 0;
+#if defined(_WIN32)
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#else
+    int m_file = -1;
+#endif
+
+  public:
+    /// @throws std::system_error if the file can't be opened. An empty file is not mapped
+    explicit ReadOnlyMappedFile(const std::filesystem::path& path) noexcept(false);
+    ~ReadOnlyMappedFile() noexcept;
+    ReadOnlyMappedFile(const ReadOnlyMappedFile&) = delete;
+    ReadOnlyMappedFile& operator=(const ReadOnlyMappedFile&) = delete;
+
+    std::span<const std::byte> bytes() const noexcept;
+};
+
+/**
+ * @brief Write the bytes, and flush them to the disk before it returns
+ * @details FlushFileBuffers on Windows, fsync on POSIX. The caller can rename the file after this
+ * @param append add to the end of the file instead of replacing it
+ * @throws std::system_error
+ */
+void write_file_synced(const std::filesystem::path& path, std::span<const std::byte> bytes,
+                       bool append) noexcept(false);
+
+/**
+ * @brief Flush the entries of the directory, so a rename in it survives a crash
+ * @note fsync of the directory on POSIX. No-op on Windows, where the rename is journaled by NTFS
+ * @throws std::system_error
+ */
+void sync_directory(const std::filesystem::path& directory) noexcept(false);
+
+/**
+ * @brief Settings in a versioned, checksummed file which is read through the memory mapping
+ * @details The file layout is (little endian)
+ *  - header: magic "SETS"(u32), format version(u32), entry count(u32), value bytes(u32), generation(u64),
+ *            checksum(u64) of the entries and the values
+ *  - entries: key hash(u64), offset(u32) in the values, size(u32). Sorted by the hash
+ *  - values
+ *
+ *  The whole file is ignored when the magic, the version, the sizes or the checksum don't match.
+ *  `commit` writes "{path}.tmp" and renames it over the file, so the readers see the old or the new file only.
+ *  The temporary file is flushed to the disk before the rename.
+ */
+class MappedSettingsStore final : public SettingsBackend {
+  public:
+    static constexpr uint32_t magic = 0x53544553; // "SETS"
+    static constexpr uint32_t format_version = 1;
+    static constexpr size_t header_size = 32;
+    static constexpr size_t entry_size = 16;
+
+  private:
+    std::filesystem::path m_path;
+    mutable std::mutex m_mtx;
+    std::unique_ptr<ReadOnlyMappedFile> m_file{};
+    std::span<const std::byte> m_entries{}; // in the mapping. Empty if the file is not valid
+    std::span<const std::byte> m_values{};
+    uint64_t m_generation = 0;
+    std::map<uint64_t, std::vector<std::byte>> m_staged{};
+
+    bool map() noexcept(false);
+    /// @return the value in the mapping. Empty if not found
+    std::optional<std::span<const std::byte>> find(uint64_t hash) const noexcept;
+
+  public:
+    /// @note The missing or broken file is same as the empty settings. See `load`
+    explicit MappedSettingsStore(std::filesystem::path path) noexcept(false);
+
+    /**
+     * @brief Map the file again. The staged values are kept
+     * @return false if the file doesn't exist or is not valid
+     */
+    bool load() noexcept(false);
+
+    bool read(const SettingsKey& key, std::span<std::byte> value) const noexcept(false) override;
+    void write(const SettingsKey& key, std::span<const std::byte> value) noexcept(false) override;
+    void commit() noexcept(false) override;
+
+    /// @return the number of the entries in the file
+    size_t size() const noexcept;
+    /// @return incremented by each commit. 0 if the file is not valid
+    uint64_t generation() const noexcept;
+    const std::filesystem::path& path() const noexcept;
+};
+
+} // namespace winrt::App1
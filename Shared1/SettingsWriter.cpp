@@ -0,0 +1,160 @@
+#include "pch.h"
+
+#include "SettingsWriter.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace winrt::App1 {
+
+SettingsWriter::SettingsWriter(WriteFn write, SettingsWriterOptions options) noexcept(false)
+    : m_write{std::move(write)}, m_options{options} {
+    if (m_write == nullptr)
+        throw std::invalid_argument{"write function is required"};
+    if (m_options.delay.count() < 0 || m_options.maxDelay < m_options.delay)
+        throw std::invalid_argument{"maxDelay must be longer than delay"};
+    if (m_options.retryDelay.count() <= 0 || m_options.maxRetryDelay < m_options.retryDelay)
+        throw std::invalid_argument{"maxRetryDelay must be longer than retryDelay"};
+    m_worker = std::thread{&SettingsWriter::run, this};
+}
+
+SettingsWriter::~SettingsWriter() noexcept {
+    {
+        std::lock_guard lck{m_mtx};
+        m_stop = true;
+    }
+    m_changed.notify_all();
+    if (m_worker.joinable())
+        m_worker.join();
+    flush();
+}
+
+void SettingsWriter::mark_dirty() noexcept {
+    m_changes.fetch_add(1, std::memory_order_relaxed);
+    const Clock::time_point now = Clock::now();
+    std::unique_lock lck{m_mtx};
+    m_last = now;
+    if (m_dirty)
+        return;
+    m_dirty = true;
+    m_first = now;
+    lck.unlock();
+    m_changed.notify_one();
+}
+
+bool SettingsWriter::write() noexcept {
+    const Clock::time_point start = Clock::now();
+    bool succeeded = false;
+    try {
+        succeeded = m_write();
+    } catch (...) {
+        // the function should report its error. Count it as a failure
+    }
+    m_writeTime.fetch_add((Clock::now() - start).count(), std::memory_order_relaxed);
+    m_writes.fetch_add(1, std::memory_order_relaxed);
+    if (succeeded == false)
+        m_failures.fetch_add(1, std::memory_order_relaxed);
+    return succeeded;
+}
+
+void SettingsWriter::schedule_retry() noexcept {
+    const Clock::time_point now = Clock::now();
+    if (m_backoff == Clock::duration::zero())
+        m_backoff = m_options.retryDelay;
+    else
+        m_backoff = (std::min)(m_backoff * 2, Clock::duration{m_options.maxRetryDelay});
+    m_retry = now + m_backoff;
+    if (m_dirty)
+        return;
+    m_dirty = true;
+    m_first = now;
+    m_last = now;
+}
+
+void SettingsWriter::run() noexcept {
+#if defined(_WIN32)
+    SetThreadDescription(GetCurrentThread(), L"SettingsWriter");
+#endif
+    std::unique_lock lck{m_mtx};
+    while (true) {
+        m_changed.wait(lck, [this]() { return m_stop || m_dirty; });
+        // the new changes push the deadline until maxDelay. The backoff is not shortened by them
+        while (m_stop == false && m_dirty && m_urgent == false) {
+            const Clock::time_point deadline =
+                (std::max)((std::min)(m_last + m_options.delay, m_first + m_options.maxDelay), m_retry);
+            if (Clock::now() >= deadline)
+                break;
+            m_changed.wait_until(lck, deadline);
+        }
+        if (m_stop)
+            return;
+        if (m_dirty == false)
+            continue; // `flush` has taken the changes
+        m_dirty = false;
+        m_urgent = false;
+        ++m_taken;
+        const bool retrying = m_backoff != Clock::duration::zero();
+        // hold this before the unlock, so `flush` waits for the write
+        std::unique_lock writing{m_write_mtx};
+        lck.unlock();
+        if (retrying)
+            m_retries.fetch_add(1, std::memory_order_relaxed);
+        const bool succeeded = write();
+        writing.unlock();
+        lck.lock();
+        complete(succeeded);
+    }
+}
+
+void SettingsWriter::complete(bool succeeded) noexcept {
+    ++m_done;
+    m_succeeded = succeeded;
+    if (succeeded)
+        m_backoff = Clock::duration::zero();
+    else if (m_stop == false) // the destructor doesn't retry
+        schedule_retry();
+    m_written.notify_all();
+}
+
+bool SettingsWriter::flush() noexcept {
+    std::unique_lock lck{m_mtx};
+    std::unique_lock writing{m_write_mtx}; // the worker may be writing the last changes
+    if (m_dirty == false)
+        return true;
+    m_dirty = false;
+    m_urgent = false;
+    ++m_taken;
+    lck.unlock();
+    const bool succeeded = write();
+    writing.unlock();
+    lck.lock();
+    complete(succeeded);
+    lck.unlock();
+    if (succeeded == false)
+        m_changed.notify_one();
+    return succeeded;
+}
+
+bool SettingsWriter::request_flush(Clock::duration timeout) noexcept {
+    std::unique_lock lck{m_mtx};
+    // the pending changes, or the write which has taken them
+    const uint64_t target = m_dirty ? m_taken + 1 : m_taken;
+    if (m_done == target)
+        return m_succeeded;
+    if (m_dirty && m_urgent == false) {
+        m_urgent = true;
+        m_changed.notify_one();
+    }
+    if (m_written.wait_for(lck, timeout, [this, target]() { return m_done >= target; }) == false)
+        return false;
+    // a later write may have completed. It has written these changes as well
+    return m_succeeded;
+}
+
+SettingsWriter::Stats SettingsWriter::stats() const noexcept {
+    return Stats{m_changes.load(std::memory_order_relaxed), m_writes.load(std::memory_order_relaxed),
+                 m_failures.load(std::memory_order_relaxed), m_retries.load(std::memory_order_relaxed),
+                 Clock::duration{m_writeTime.load(std::memory_order_relaxed)}};
+}
+
+} // namespace winrt::App1
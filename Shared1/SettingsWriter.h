@@ -0,0 +1,104 @@
+/**
+ * @file SettingsWriter.h
+ * @brief Coalesce the settings changes and persist them in the background
+ * @details The setters only mark the settings dirty. A worker thread waits until the changes stop for `delay`,
+ *          or `maxDelay` since the first change, and calls the write function once for all of them.
+ *          `flush` writes the pending changes on the caller thread. Use it before the process exits.
+ *          `request_flush` lets the worker write them now, and waits for it until a timeout. Use it on the UI thread.
+ *          A failed write is retried by the worker after `retryDelay`, doubled for each failure until `maxRetryDelay`.
+ * @note Standard C++ only
+ */
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace winrt::App1 {
+
+struct SettingsWriterOptions {
+    std::chrono::milliseconds delay{500};           // quiet time after the last change
+    std::chrono::milliseconds maxDelay{3000};       // since the first change. The writes are not starved by the changes
+    std::chrono::milliseconds retryDelay{1000};     // after the first failure
+    std::chrono::milliseconds maxRetryDelay{60000}; // the backoff stops growing
+};
+
+class SettingsWriter final {
+  public:
+    using Clock = std::chrono::steady_clock;
+    /// @return false if the write failed. The function reports its own error
+    using WriteFn = std::function<bool()>;
+
+    struct Stats {
+        uint64_t changes = 0; // `mark_dirty` calls
+        uint64_t writes = 0;  // the calls of the write function, including the failed ones
+        uint64_t failures = 0;
+        uint64_t retries = 0;        // the writes of the worker after a failure
+        Clock::duration writeTime{}; // spent in the write function. Off the caller thread except `flush`
+    };
+
+  private:
+    WriteFn m_write;
+    SettingsWriterOptions m_options;
+    std::mutex m_mtx;
+    std::condition_variable m_changed;
+    std::condition_variable m_written; // `request_flush` waits for it. The worker never does
+    bool m_dirty = false;
+    bool m_stop = false;
+    bool m_urgent = false;       // `request_flush`. The worker doesn't wait for the delay
+    uint64_t m_taken = 0;        // the pending changes taken by a write
+    uint64_t m_done = 0;         // the completed writes. Equal to m_taken if nothing is being written
+    bool m_succeeded = true;     // of the last write
+    Clock::time_point m_first{}; // of the pending changes
+    Clock::time_point m_last{};
+    Clock::time_point m_retry{}; // not before this after a failure
+    Clock::duration m_backoff{}; // zero after a success
+    std::mutex m_write_mtx;      // only one write at a time
+    std::atomic<uint64_t> m_changes{0};
+    std::atomic<uint64_t> m_writes{0};
+    std::atomic<uint64_t> m_failures{0};
+    std::atomic<uint64_t> m_retries{0};
+    std::atomic<Clock::rep> m_writeTime{0};
+    std::thread m_worker{};
+
+    /// @note with m_write_mtx
+    bool write() noexcept;
+    /// @note with m_mtx. Keep the changes dirty and delay the next write
+    void schedule_retry() noexcept;
+    /// @note with m_mtx. After a write of `run` or `flush`
+    void complete(bool succeeded) noexcept;
+    void run() noexcept;
+
+  public:
+    /// @throws std::invalid_argument if the function is empty, `maxDelay` is shorter than `delay`,
+    ///         `retryDelay` is not positive or `maxRetryDelay` is shorter than `retryDelay`
+    explicit SettingsWriter(WriteFn write, SettingsWriterOptions options = {}) noexcept(false);
+    /// @note The pending changes are written before the return
+    ~SettingsWriter() noexcept;
+    SettingsWriter(const SettingsWriter&) = delete;
+    SettingsWriter& operator=(const SettingsWriter&) = delete;
+
+    /// @brief Schedule a write. Doesn't wait
+    void mark_dirty() noexcept;
+
+    /**
+     * @brief Write the pending changes now, on the caller thread
+     * @details Waits for the write of the worker if it is running. Doesn't wait for the backoff
+     * @return false if the write failed. The worker retries it
+     */
+    bool flush() noexcept;
+
+    /**
+     * @brief Let the worker write the pending changes now, and wait for it until the timeout
+     * @details The caller thread doesn't write. Doesn't wait for the backoff. A zero timeout only wakes the worker
+     * @return false if the write failed or didn't complete before the timeout
+     */
+    bool request_flush(Clock::duration timeout) noexcept;
+
+    Stats stats() const noexcept;
+};
+
+} // namespace winrt::App1
@@ -0,0 +1,130 @@
+#include "pch.h"
+
+#include "ShaderPack.h"
+
+#include <cstring>
+
+namespace DX {
+
+static constexpr size_t c_HeaderSize = 16;
+static constexpr size_t c_EntrySize = 32;
+
+static uint32_t read_u32(std::span<const std::byte> data, size_t offset) noexcept {
+    uint32_t value = 0;
+    std::memcpy(&value, data.data() + offset, sizeof(value));
+    return value;
+}
+
+static uint64_t read_u64(std::span<const std::byte> data, size_t offset) noexcept {
+    uint64_t value = 0;
+    std::memcpy(&value, data.data() + offset, sizeof(value));
+    return value;
+}
+
+static bool in_range(std::span<const std::byte> data, uint64_t offset, uint64_t size) noexcept {
+    return offset <= data.size() && size <= data.size() - offset;
+}
+
+ShaderPack::ShaderPack(std::shared_ptr<const void> owner, std::span<const std::byte> data) noexcept(false)
+    : m_owner{std::move(owner)}, m_data{data} {
+    if (m_data.size() < c_HeaderSize)
+        throw std::invalid_argument{"shader pack is too small"};
+    if (read_u32(m_data, 0) != magic)
+        throw std::invalid_argument{"shader pack magic mismatch"};
+    if (read_u32(m_data, 4) != format_version)
+        throw std::invalid_argument{"shader pack version mismatch"};
+    const uint32_t count = read_u32(m_data, 8);
+    if (in_range(m_data, c_HeaderSize, uint64_t{count} * c_EntrySize) == false)
+        throw std::invalid_argument{"shader pack entry table is truncated"};
+
+    // validate once, so the lookup doesn't need the checks
+    std::string_view previous{};
+    for (uint32_t i = 0; i < count; ++i) {
+        const size_t offset = c_HeaderSize + i * c_EntrySize;
+        const uint32_t nameOffset = read_u32(m_data, offset + 8), nameSize = read_u32(m_data, offset + 12);
+        const uint32_t codeOffset = read_u32(m_data, offset + 16), codeSize = read_u32(m_data, offset + 20);
+        const uint32_t reflOffset = read_u32(m_data, offset + 24), reflSize = read_u32(m_data, offset + 28);
+        if (!in_range(m_data, nameOffset, nameSize) || !in_range(m_data, codeOffset, codeSize) ||
+            !in_range(m_data, reflOffset, reflSize))
+            throw std::invalid_argument{"shader pack entry is out of range"};
+        if (codeSize == 0 || codeOffset % 4 != 0)
+            throw std::invalid_argument{"shader pack bytecode is not aligned"};
+        std::string_view name{reinterpret_cast<const char*>(m_data.data() + nameOffset), nameSize};
+        if (i > 0 && previous >= name)
+            throw std::invalid_argument{"shader pack entries are not sorted"};
+        previous = name;
+    }
+    m_count = count;
+}
+
+ShaderPack ShaderPack::open(const std::filesystem::path& filepath) noexcept(false) {
+    winrt::file_handle file{CreateFileW(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr)};
+    if (!file)
+        winrt::throw_last_error();
+    LARGE_INTEGER size{};
+    winrt::check_bool(GetFileSizeEx(file.get(), &size));
+    if (size.QuadPart < static_cast<LONGLONG>(c_HeaderSize))
+        throw std::invalid_argument{"shader pack is too small"};
+
+    winrt::handle mapping{CreateFileMappingW(file.get(), nullptr, PAGE_READONLY, 0, 0, nullptr)};
+    if (!mapping)
+        winrt::throw_last_error();
+    const void* view = MapViewOfFile(mapping.get(), FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr)
+        winrt::throw_last_error();
+    // the view keeps the mapping alive. the handles can be closed
+    std::shared_ptr<const void> owner{view, [](const void* ptr) { UnmapViewOfFile(ptr); }};
+    auto bytes = static_cast<const std::byte*>(view);
+    return ShaderPack{std::move(owner), std::span{bytes, static_cast<size_t>(size.QuadPart)}};
+}
+
+ShaderPack ShaderPack::from_bytes(std::vector<std::byte> bytes) noexcept(false) {
+    auto owner = std::make_shared<std::vector<std::byte>>(std::move(bytes));
+    std::span<const std::byte> data{*owner};
+    return ShaderPack{std::move(owner), data};
+}
+
+size_t ShaderPack::size() const noexcept {
+    return m_count;
+}
+
+bool ShaderPack::empty() const noexcept {
+    return m_count == 0;
+}
+
+ShaderPackEntry ShaderPack::entry(uint32_t index) const noexcept {
+    const size_t offset = c_HeaderSize + index * c_EntrySize;
+    ShaderPackEntry result{};
+    result.key = read_u64(m_data, offset);
+    result.name = std::string_view{reinterpret_cast<const char*>(m_data.data() + read_u32(m_data, offset + 8)),
+                                   read_u32(m_data, offset + 12)};
+    result.bytecode = m_data.subspan(read_u32(m_data, offset + 16), read_u32(m_data, offset + 20));
+    result.reflection = m_data.subspan(read_u32(m_data, offset + 24), read_u32(m_data, offset + 28));
+    return result;
+}
+
+std::optional<ShaderPackEntry> ShaderPack::find(std::string_view name) const noexcept {
+    uint32_t first = 0, last = m_count;
+    while (first < last) {
+        const uint32_t middle = first + (last - first) / 2;
+        ShaderPackEntry candidate = entry(middle);
+        if (candidate.name == name)
+            return candidate;
+        if (candidate.name < name)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+    return std::nullopt;
+}
+
+std::vector<ShaderPackEntry> ShaderPack::entries() const noexcept(false) {
+    std::vector<ShaderPackEntry> results{};
+    results.reserve(m_count);
+    for (uint32_t i = 0; i < m_count; ++i)
+        results.emplace_back(entry(i));
+    return results;
+}
+
+} // namespace DX
@@ -0,0 +1,67 @@
+/**
+ * @file ShaderPack.h
+ * @brief Read-only view of the precompiled shaders. The pack is generated by scripts/build-shaders.ps1
+ * @note Standard C++ only except `ShaderPack::open`, which maps the file with Win32 API
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace DX {
+
+/// @brief Compiled shader in the pack. The spans are valid while the ShaderPack is alive
+struct ShaderPackEntry {
+    std::string_view name;
+    uint64_t key; // leading 8 bytes of the content hash. Usable as a part of the pipeline key
+    std::span<const std::byte> bytecode;   // DXIL container without reflection
+    std::span<const std::byte> reflection; // DXC reflection blob. Can be empty
+};
+
+/**
+ * @brief Memory-mapped pack of DXIL blobs
+ * @details The file layout is (little endian)
+ *  - header: magic "SHPK"(u32), format version(u32), entry count(u32), reserved(u32)
+ *  - entries: key(u64), name offset(u32), name size(u32),
+ *             bytecode offset(u32), bytecode size(u32), reflection offset(u32), reflection size(u32)
+ *  - data: names and blobs. The offsets are from the beginning of the file, and the blobs are 16 byte aligned
+ *
+ *  The entries are sorted by the name, so `find` is a binary search. Nothing is copied from the file.
+ */
+class ShaderPack final {
+  public:
+    static constexpr uint32_t magic = 0x4B504853; // "SHPK"
+    static constexpr uint32_t format_version = 1;
+
+  private:
+    std::shared_ptr<const void> m_owner{};
+    std::span<const std::byte> m_data{};
+    uint32_t m_count = 0;
+
+    ShaderPackEntry entry(uint32_t index) const noexcept;
+
+  public:
+    ShaderPack() noexcept = default;
+    /**
+     * @param owner keeps `data` alive. For example, the mapped view of the file
+     * @throws std::invalid_argument if the data is not a valid pack
+     */
+    ShaderPack(std::shared_ptr<const void> owner, std::span<const std::byte> data) noexcept(false);
+
+    /// @brief Map the file for read. The view is released with the last copy of the ShaderPack
+    static ShaderPack open(const std::filesystem::path& filepath) noexcept(false);
+    /// @brief Pack in the memory. For tests and the embedded data
+    static ShaderPack from_bytes(std::vector<std::byte> bytes) noexcept(false);
+
+    size_t size() const noexcept;
+    bool empty() const noexcept;
+    std::optional<ShaderPackEntry> find(std::string_view name) const noexcept;
+    std::vector<ShaderPackEntry> entries() const noexcept(false);
+};
+
+} // namespace DX
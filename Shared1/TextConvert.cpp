@@ -0,0 +1,189 @@
+#include "pch.h"
+
+#include "TextConvert.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TEXT_CONVERT_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define TEXT_CONVERT_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(TEXT_CONVERT_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TEXT_CONVERT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TEXT_CONVERT_TARGET_AVX2
+#endif
+
+namespace winrt::App1 {
+
+/**
+ * @brief Convert 1 code point at `in[i]`
+ * @return the code units consumed. 2 for a surrogate pair
+ */
+static size_t convert_code_point(const char16_t* in, size_t i, size_t count, char*& out) noexcept {
+    const uint32_t c = in[i];
+    if (c < 0x80) {
+        *out++ = static_cast<char>(c);
+        return 1;
+    }
+    if (c < 0x800) {
+        *out++ = static_cast<char>(0xC0 | (c >> 6));
+        *out++ = static_cast<char>(0x80 | (c & 0x3F));
+        return 1;
+    }
+    if (c >= 0xD800 && c <= 0xDBFF && i + 1 < count && in[i + 1] >= 0xDC00 && in[i + 1] <= 0xDFFF) {
+        const uint32_t cp = 0x10000 + ((c - 0xD800) << 10) + (in[i + 1] - 0xDC00);
+        *out++ = static_cast<char>(0xF0 | (cp >> 18));
+        *out++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    const uint32_t cp = (c >= 0xD800 && c <= 0xDFFF) ? 0xFFFD : c; // unpaired surrogate
+    *out++ = static_cast<char>(0xE0 | (cp >> 12));
+    *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+    return 1;
+}
+
+/// @brief Convert `[i, end)`. A surrogate pair at the end can consume 1 more unit
+static size_t convert_scalar(const char16_t* in, size_t i, size_t end, size_t count, char*& out) noexcept {
+    while (i < end)
+        i += convert_code_point(in, i, count, out);
+    return i;
+}
+
+#if defined(TEXT_CONVERT_X86)
+
+static size_t convert_sse2(const char16_t* in, size_t count, char* out) noexcept {
+    const char* const begin = out;
+    const __m128i non_ascii = _mm_set1_epi16(static_cast<short>(0xFF80));
+    size_t i = 0;
+    while (i + 8 <= count) {
+        const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, non_ascii), _mm_setzero_si128())) == 0xFFFF) {
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(units, units));
+            out += 8;
+            i += 8;
+            continue;
+        }
+        i = convert_scalar(in, i, i + 8, count, out);
+    }
+    convert_scalar(in, i, count, count, out);
+    return static_cast<size_t>(out - begin);
+}
+
+TEXT_CONVERT_TARGET_AVX2 static size_t convert_avx2(const char16_t* in, size_t count, char* out) noexcept {
+    const char* const begin = out;
+    const __m256i non_ascii = _mm256_set1_epi16(static_cast<short>(0xFF80));
+    size_t i = 0;
+    while (i + 16 <= count) {
+        const __m256i units = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        if (_mm256_testz_si256(units, non_ascii)) {
+            // the pack works in each 128-bit lane. Move the low halves of the lanes together
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(units, units), 0b1000);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(packed));
+            out += 16;
+            i += 16;
+            continue;
+        }
+        i = convert_scalar(in, i, i + 16, count, out);
+    }
+    convert_scalar(in, i, count, count, out);
+    return static_cast<size_t>(out - begin);
+}
+
+static bool has_avx2() noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4]{};
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (osxsave == false || (_xgetbv(0) & 0x6) != 0x6) // the OS saves the YMM registers
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#elif defined(TEXT_CONVERT_NEON)
+
+static size_t convert_neon(const char16_t* in, size_t count, char* out) noexcept {
+    const char* const begin = out;
+    size_t i = 0;
+    while (i + 8 <= count) {
+        const uint16x8_t units = vld1q_u16(reinterpret_cast<const uint16_t*>(in + i));
+        if (vmaxvq_u16(units) < 0x80) {
+            vst1_u8(reinterpret_cast<uint8_t*>(out), vmovn_u16(units));
+            out += 8;
+            i += 8;
+            continue;
+        }
+        i = convert_scalar(in, i, i + 8, count, out);
+    }
+    convert_scalar(in, i, count, count, out);
+    return static_cast<size_t>(out - begin);
+}
+
+#endif
+
+TextConvertIsa get_text_convert_isa() noexcept {
+#if defined(TEXT_CONVERT_X86)
+    static const TextConvertIsa isa = has_avx2() ? TextConvertIsa::AVX2 : TextConvertIsa::SSE2;
+    return isa;
+#elif defined(TEXT_CONVERT_NEON)
+    return TextConvertIsa::NEON;
+#else
+    return TextConvertIsa::Scalar;
+#endif
+}
+
+size_t convert_utf16_to_utf8(std::u16string_view in, char* out, TextConvertIsa isa) noexcept {
+    switch (isa) {
+#if defined(TEXT_CONVERT_X86)
+    case TextConvertIsa::AVX2:
+        if (get_text_convert_isa() == TextConvertIsa::AVX2)
+            return convert_avx2(in.data(), in.size(), out);
+        [[fallthrough]];
+    case TextConvertIsa::SSE2:
+        return convert_sse2(in.data(), in.size(), out);
+#elif defined(TEXT_CONVERT_NEON)
+    case TextConvertIsa::NEON:
+        return convert_neon(in.data(), in.size(), out);
+#endif
+    default: {
+        char* end = out;
+        convert_scalar(in.data(), 0, in.size(), in.size(), end);
+        return static_cast<size_t>(end - out);
+    }
+    }
+}
+
+size_t convert_utf16_to_utf8(std::u16string_view in, char* out) noexcept {
+    return convert_utf16_to_utf8(in, out, get_text_convert_isa());
+}
+
+void append_utf8(std::string& out, std::u16string_view in) noexcept(false) {
+    const size_t offset = out.size();
+    out.resize(offset + get_utf8_capacity(in.size()));
+    out.resize(offset + convert_utf16_to_utf8(in, out.data() + offset));
+}
+
+std::string to_utf8(std::u16string_view in) noexcept(false) {
+    std::string out{};
+    append_utf8(out, in);
+    return out;
+}
+
+} // namespace winrt::App1
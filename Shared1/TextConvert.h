@@ -0,0 +1,101 @@
+/**
+ * @file TextConvert.h
+ * @brief UTF-16 to UTF-8 conversion for the wide string logging
+ * @details The ASCII blocks are converted with SSE2/AVX2 on x86 and NEON on ARM64. The other blocks use the scalar
+ *          path. The unpaired surrogates become U+FFFD, like `WideCharToMultiByte` without flags.
+ * @note Standard C++ only
+ */
+#pragma once
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cwchar>
+#include <format>
+#include <string>
+#include <string_view>
+
+namespace winrt::App1 {
+
+enum class TextConvertIsa : uint8_t {
+    Scalar,
+    SSE2,
+    AVX2,
+    NEON,
+};
+
+/// @return the best instruction set of this CPU. Checked once
+TextConvertIsa get_text_convert_isa() noexcept;
+
+/// @return the bytes for `count` UTF-16 code units in the worst case
+constexpr size_t get_utf8_capacity(size_t count) noexcept {
+    return count * 3;
+}
+
+/**
+ * @brief Convert with the given instruction set. For the tests and the benchmarks
+ * @param out must have `get_utf8_capacity(in.size())` bytes
+ * @return the bytes written. The result is same for all instruction sets
+ * @note Falls back to the scalar path if the CPU doesn't support `isa`
+ */
+size_t convert_utf16_to_utf8(std::u16string_view in, char* out, TextConvertIsa isa) noexcept;
+
+/// @brief Convert with `get_text_convert_isa()`
+size_t convert_utf16_to_utf8(std::u16string_view in, char* out) noexcept;
+
+void append_utf8(std::string& out, std::u16string_view in) noexcept(false);
+std::string to_utf8(std::u16string_view in) noexcept(false);
+
+#if WCHAR_MAX == 0xFFFF
+inline std::u16string_view to_u16string_view(std::wstring_view in) noexcept {
+    return {reinterpret_cast<const char16_t*>(in.data()), in.size()};
+}
+inline void append_utf8(std::string& out, std::wstring_view in) noexcept(false) {
+    append_utf8(out, to_u16string_view(in));
+}
+inline std::string to_utf8(std::wstring_view in) noexcept(false) {
+    return to_utf8(to_u16string_view(in));
+}
+#endif
+
+/**
+ * @brief UTF-16 text for the narrow format strings
+ * @code
+ * spdlog::info("path: {}", Utf8Text{path.native()});
+ * @endcode
+ */
+struct Utf8Text {
+    std::u16string_view text;
+
+    Utf8Text(std::u16string_view text) noexcept : text{text} {
+    }
+#if WCHAR_MAX == 0xFFFF
+    Utf8Text(std::wstring_view text) noexcept : text{to_u16string_view(text)} {
+    }
+#endif
+};
+
+} // namespace winrt::App1
+
+/// @note The short text is converted in the stack
+template <>
+struct std::formatter<winrt::App1::Utf8Text, char> : std::formatter<std::string_view, char> {
+    auto format(const winrt::App1::Utf8Text& value, std::format_context& ctx) const {
+        char buf[512];
+        if (winrt::App1::get_utf8_capacity(value.text.size()) <= sizeof(buf)) {
+            const size_t size = winrt::App1::convert_utf16_to_utf8(value.text, buf);
+            return std::formatter<std::string_view, char>::format(std::string_view{buf, size}, ctx);
+        }
+        const std::string text = winrt::App1::to_utf8(value.text);
+        return std::formatter<std::string_view, char>::format(text, ctx);
+    }
+};
+
+#if defined(WINRT_BASE_H)
+/// @brief `hstring` for the narrow format strings
+template <>
+struct std::formatter<winrt::hstring, char> : std::formatter<winrt::App1::Utf8Text, char> {
+    auto format(const winrt::hstring& value, std::format_context& ctx) const {
+        return std::formatter<winrt::App1::Utf8Text, char>::format(std::wstring_view{value}, ctx);
+    }
+};
+#endif
@@ -3,9 +3,108 @@
 // @file: Shared1 PCH implementation
 // Contains any implementation details for PCH-defined types
 
+#include <csignal>
+#include <cstdlib>
+#include <exception>
+#include <fcntl.h>
+#include <io.h>
+#include <share.h>
+#include <sys/stat.h>
+
 namespace winrt::App1 {
 
 // Implementation details for ILoggingChannel implementations are already inline in pch.h
-// This file serves as the PCH compilation unit and placeholder for future shared implementations
+// except the registry of BufferedStreamLoggingChannel for the crash paths
+
+static std::mutex g_channels_mtx{};
+static std::atomic<std::thread::id> g_channels_owner{}; // of g_channels_mtx
+static std::vector<BufferedStreamLoggingChannel*> g_channels{};
+using SignalHandler = void (*)(int);
+static SignalHandler g_next_abort = SIG_DFL;
+static LPTOP_LEVEL_EXCEPTION_FILTER g_next_filter = nullptr;
+static std::atomic<int> g_abort_file{-1}; // opened before the abort. See set_abort_log_file
+static char g_abort_buffer[64 * 1024]{};  // the signal handler doesn't allocate
+
+/// @note Only `_write` on the file opened before. The streams and the heap may be in the middle of the abort
+static void write_logging_channels() noexcept {
+    const int file = g_abort_file.load();
+    if (file < 0)
+        return;
+    if (g_channels_owner.load(std::memory_order_relaxed) == std::this_thread::get_id())
+        return;
+    std::unique_lock lck{g_channels_mtx, std::try_to_lock};
+    if (lck.owns_lock() == false)
+        return;
+    for (BufferedStreamLoggingChannel* channel : g_channels)
+        if (const size_t count = channel->TryCopy(g_abort_buffer); count > 0)
+            std::ignore = _write(file, g_abort_buffer, static_cast<unsigned int>(count));
+}
+
+/// @note `std::set_terminate` is per thread in MSVC. The default terminate handler of every thread raises SIGABRT
+static void on_abort(int signal) {
+    write_logging_channels();
+    if (g_next_abort != SIG_DFL && g_next_abort != SIG_IGN && g_next_abort != SIG_ERR)
+        g_next_abort(signal);
+}
+
+static LONG WINAPI on_unhandled_exception(EXCEPTION_POINTERS* info) {
+    flush_logging_channels();
+    if (g_next_filter)
+        return g_next_filter(info);
+    return EXCEPTION_CONTINUE_SEARCH;
+}
+
+/// @note once per process. The hooks are process-wide
+static void install_crash_handlers() noexcept(false) {
+    static const bool installed = []() {
+        if (g_abort_file.load() < 0 && _fileno(stderr) >= 0) {
+            int expected = -1;
+            const int file = _dup(_fileno(stderr)); // -1 if the process has no stderr
+            if (file >= 0 && g_abort_file.compare_exchange_strong(expected, file) == false)
+                _close(file); // set_abort_log_file was faster
+        }
+        g_next_abort = std::signal(SIGABRT, &on_abort);
+        g_next_filter = SetUnhandledExceptionFilter(&on_unhandled_exception);
+        std::atexit(&flush_logging_channels);
+        return true;
+    }();
+    std::ignore = installed;
+}
+
+void set_abort_log_file(const std::filesystem::path& filepath) noexcept(false) {
+    int file = -1;
+    if (auto ec = _wsopen_s(&file, filepath.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _SH_DENYNO,
+                            _S_IREAD | _S_IWRITE);
+        ec != 0)
+        throw std::system_error{ec, std::generic_category(), filepath.string()};
+    if (int previous = g_abort_file.exchange(file); previous >= 0)
+        _close(previous);
+}
+
+void BufferedStreamLoggingChannel::register_channel(BufferedStreamLoggingChannel* channel) noexcept(false) {
+    install_crash_handlers();
+    std::lock_guard lck{g_channels_mtx};
+    g_channels_owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    g_channels.emplace_back(channel);
+    g_channels_owner.store(std::thread::id{}, std::memory_order_relaxed);
+}
+
+void BufferedStreamLoggingChannel::unregister_channel(BufferedStreamLoggingChannel* channel) noexcept {
+    std::lock_guard lck{g_channels_mtx};
+    g_channels_owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    std::erase(g_channels, channel);
+    g_channels_owner.store(std::thread::id{}, std::memory_order_relaxed);
+}
+
+void flush_logging_channels() noexcept {
+    // the crashing thread may be in the middle of the registration. The vector can be torn then
+    if (g_channels_owner.load(std::memory_order_relaxed) == std::this_thread::get_id())
+        return;
+    std::unique_lock lck{g_channels_mtx, std::try_to_lock};
+    if (lck.owns_lock() == false)
+        return;
+    for (BufferedStreamLoggingChannel* channel : g_channels)
+        channel->TryFlush();
+}
 
-} // namespace winrt::App1
\ No newline at end of file
+} // namespace winrt::App1
@@ -39,12 +39,20 @@
 #include <stdexcept>
 #include <format>
 #include <chrono>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <span>
+
+#include "FormatBuffer.h"
 
 namespace winrt::App1 {
 
 // Forward declarations
 struct NullLoggingChannel;
 struct StreamLoggingChannel;
+struct BufferedStreamLoggingChannel;
+struct FilteringLoggingChannel;
 
 /**
  * @brief Null object implementation of ILoggingChannel
@@ -166,6 +174,416 @@ public:
     void LoggingEnabled(winrt::event_token const&) const noexcept {}
 };
 
+/**
+ * @brief When BufferedStreamLoggingChannel writes its buffer to the stream
+ */
+struct BufferedLoggingOptions {
+    size_t capacity = 16 * 1024;              // characters. The buffer is flushed before it grows over
+    std::chrono::milliseconds interval{1000}; // checked at each record. There is no timer thread
+    Windows::Foundation::Diagnostics::LoggingLevel flushLevel =
+        Windows::Foundation::Diagnostics::LoggingLevel::Error; // this level or higher is written immediately
+};
+
+/**
+ * @brief Flush the buffers of all BufferedStreamLoggingChannel
+ * @details The process-wide hooks are installed once, when the first channel is created: the unhandled SEH
+ *          exceptions, `SIGABRT` (`std::terminate` on any thread ends with `std::abort`) and `std::atexit`.
+ *          They flush every registered channel, regardless of the thread which created it.
+ *          Call it from the other crash paths, like `UnhandledException` of the XAML Application
+ * @note The channels which are being used by the other threads are skipped.
+ *       On the thread which crashed in the middle of a record, the complete records are written without the record.
+ *       `SIGABRT` doesn't use the streams. See `set_abort_log_file`
+ */
+void flush_logging_channels() noexcept;
+
+/**
+ * @brief File for the records of BufferedStreamLoggingChannel when the process aborts
+ * @details The stream I/O is not async-signal-safe, so the `SIGABRT` handler copies the complete records as UTF-8
+ *          to a preallocated buffer and writes it with `_write` to this file. The file is opened here, not in the
+ *          handler. Until this is called, the handle of stderr duplicated at the startup is used
+ * @throws std::system_error if the file can't be opened
+ */
+void set_abort_log_file(const std::filesystem::path& filepath) noexcept(false);
+
+/**
+ * @brief Buffered version of StreamLoggingChannel
+ * @details The records are batched in a preallocated buffer, and written to the stream with one `flush` when
+ *          the buffer is full, `interval` has passed, or the record's level is `flushLevel` or higher.
+ *          The text of the records is the same as StreamLoggingChannel.
+ *          The buffer is flushed when the channel is destroyed and by `flush_logging_channels`.
+ */
+struct BufferedStreamLoggingChannel
+    : winrt::implements<BufferedStreamLoggingChannel, Windows::Foundation::Diagnostics::ILoggingChannel> {
+  private:
+    using LoggingLevel = Windows::Foundation::Diagnostics::LoggingLevel;
+
+    std::wostream* m_stream;
+    winrt::hstring m_name;
+    BufferedLoggingOptions m_options;
+    mutable std::mutex m_mtx;
+    mutable std::atomic<std::thread::id> m_owner{}; // of m_mtx. The crash path must not lock it again
+    mutable std::atomic<bool> m_appending = false;  // a record is partially in m_buffer
+    mutable std::wstring m_buffer{};
+    mutable size_t m_committed = 0; // the complete records in m_buffer
+    mutable std::chrono::steady_clock::time_point m_lastFlush;
+
+    /// @pre `m_mtx` is locked
+    void write(size_t count) const noexcept {
+        try {
+            m_stream->write(m_buffer.data(), static_cast<std::streamsize>(count));
+            m_stream->flush();
+        } catch (...) {
+            // Ignore stream errors in logging
+        }
+        m_buffer.erase(0, count);
+        m_committed -= count;
+        m_lastFlush = std::chrono::steady_clock::now();
+    }
+
+    template <typename... Args>
+    void append(LoggingLevel level, std::wformat_string<Args...> fmt, Args&&... args) const noexcept {
+        std::lock_guard lck{m_mtx};
+        m_owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+        const size_t used = m_buffer.size();
+        m_appending.store(true, std::memory_order_relaxed);
+        try {
+            std::format_to(std::back_inserter(m_buffer), fmt, std::forward<Args>(args)...);
+        } catch (...) {
+            m_buffer.resize(used); // Ignore format errors in logging. Drop the partial record
+        }
+        m_committed = m_buffer.size();
+        m_appending.store(false, std::memory_order_relaxed);
+        if (level >= m_options.flushLevel || std::chrono::steady_clock::now() - m_lastFlush >= m_options.interval)
+            write(m_buffer.size());
+        else if (m_buffer.size() > m_options.capacity && used > 0)
+            write(used); // the new record goes to the next batch
+        else if (m_buffer.size() >= m_options.capacity)
+            write(m_buffer.size());
+        m_owner.store(std::thread::id{}, std::memory_order_relaxed);
+    }
+
+    static void register_channel(BufferedStreamLoggingChannel* channel) noexcept(false);
+    static void unregister_channel(BufferedStreamLoggingChannel* channel) noexcept;
+
+  public:
+    BufferedStreamLoggingChannel(std::wostream& stream, BufferedLoggingOptions options,
+                                 winrt::hstring const& name = L"BufferedStreamChannel") noexcept(false)
+        : m_stream(&stream), m_name(name), m_options(options), m_lastFlush(std::chrono::steady_clock::now()) {
+        m_buffer.reserve(m_options.capacity);
+        register_channel(this);
+    }
+    ~BufferedStreamLoggingChannel() noexcept {
+        unregister_channel(this);
+        Flush();
+    }
+
+    /// @brief Write the buffered records to the stream
+    void Flush() const noexcept {
+        std::lock_guard lck{m_mtx};
+        if (m_buffer.empty() == false)
+            write(m_buffer.size());
+    }
+
+    /**
+     * @brief Flush for the crash paths. Never waits
+     * @return false if the buffer is in use by another thread, or this thread is in the middle of `write`
+     */
+    bool TryFlush() const noexcept {
+        if (m_owner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+            // this thread has crashed while it holds m_mtx. It won't return to `append`
+            if (m_appending.load(std::memory_order_relaxed) == false)
+                return false; // the stream is being written
+            if (m_committed != 0)
+                write(m_committed); // without the partial record
+            return true;
+        }
+        std::unique_lock lck{m_mtx, std::try_to_lock};
+        if (lck.owns_lock() == false)
+            return false;
+        if (m_buffer.empty() == false)
+            write(m_buffer.size());
+        return true;
+    }
+
+    /**
+     * @brief Copy the complete records as UTF-8 for the signal handler. Never allocates nor waits
+     * @return the number of bytes in `output`. The records which don't fit are dropped. 0 if the buffer is in use
+     * @note The buffer is kept. If the process continues, the records are written to the stream again
+     */
+    size_t TryCopy(std::span<char> output) const noexcept {
+        if (m_owner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+            if (m_appending.load(std::memory_order_relaxed) == false)
+                return 0; // the buffer is being erased
+            return encode_utf8(std::wstring_view{m_buffer.data(), m_committed}, output);
+        }
+        std::unique_lock lck{m_mtx, std::try_to_lock};
+        if (lck.owns_lock() == false)
+            return 0;
+        return encode_utf8(m_buffer, output);
+    }
+
+    /// @return the number of bytes. A code point which doesn't fit is not written
+    static size_t encode_utf8(std::wstring_view text, std::span<char> output) noexcept {
+        size_t count = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            uint32_t c = static_cast<uint16_t>(text[i]);
+            if (c >= 0xD800 && c < 0xDC00 && i + 1 < text.size()) {
+                const uint32_t low = static_cast<uint16_t>(text[i + 1]);
+                if (low >= 0xDC00 && low < 0xE000) {
+                    c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                    ++i;
+                }
+            }
+            if (c >= 0xD800 && c < 0xE000)
+                c = 0xFFFD; // unpaired surrogate
+            const size_t length = c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+            if (output.size() - count < length)
+                break;
+            char* out = output.data() + count;
+            switch (length) {
+            case 1:
+                out[0] = static_cast<char>(c);
+                break;
+            case 2:
+                out[0] = static_cast<char>(0xC0 | (c >> 6));
+                out[1] = static_cast<char>(0x80 | (c & 0x3F));
+                break;
+            case 3:
+                out[0] = static_cast<char>(0xE0 | (c >> 12));
+                out[1] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                out[2] = static_cast<char>(0x80 | (c & 0x3F));
+                break;
+            default:
+                out[0] = static_cast<char>(0xF0 | (c >> 18));
+                out[1] = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+                out[2] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                out[3] = static_cast<char>(0x80 | (c & 0x3F));
+                break;
+            }
+            count += length;
+        }
+        return count;
+    }
+
+    void LogMessage(winrt::hstring const& message) const noexcept {
+        append(LoggingLevel::Verbose, L"{}\n", std::wstring_view{message});
+    }
+
+    void LogMessage(winrt::hstring const& message, LoggingLevel level) const noexcept {
+        append(level, L"[{}] {}\n", static_cast<int>(level), std::wstring_view{message});
+    }
+
+    void LogMessage(winrt::hstring const& message, LoggingLevel level,
+                    Windows::Foundation::Diagnostics::LoggingOptions const&) const noexcept {
+        LogMessage(message, level);
+    }
+
+    void LogValuePair(winrt::hstring const& key, int32_t value) const noexcept {
+        append(LoggingLevel::Verbose, L"{}={}\n", std::wstring_view{key}, value);
+    }
+
+    void LogValuePair(winrt::hstring const& key, int32_t value, LoggingLevel level) const noexcept {
+        append(level, L"[{}] {}={}\n", static_cast<int>(level), std::wstring_view{key}, value);
+    }
+
+    void StartActivity(winrt::hstring const& activityName) const noexcept {
+        append(LoggingLevel::Verbose, L"START: {}\n", std::wstring_view{activityName});
+    }
+
+    void StopActivity(winrt::hstring const& activityName) const noexcept {
+        append(LoggingLevel::Verbose, L"STOP: {}\n", std::wstring_view{activityName});
+    }
+
+    // ILoggingChannel required properties
+    winrt::hstring Name() const noexcept { return m_name; }
+    bool Enabled() const noexcept { return m_stream != nullptr; }
+    LoggingLevel Level() const noexcept { 
+        return LoggingLevel::Verbose; 
+    }
+
+    // Events (no-op for stream implementation)
+    winrt::event_token LoggingEnabled(Windows::Foundation::TypedEventHandler<Windows::Foundation::Diagnostics::ILoggingChannel, winrt::Windows::Foundation::IInspectable> const&) const noexcept { return {}; }
+    void LoggingEnabled(winrt::event_token const&) const noexcept {}
+};
+
+/**
+ * @brief Level and keyword mask of FilteringLoggingChannel in one atomic word
+ * @details bit 0~4 are the enabled levels (Verbose ~ Critical), bit 5~63 are the enabled keywords 0~58.
+ *          A record is written when its level and all of its keywords are enabled.
+ *          The keywords 59~63 have no bit, so the records with them are never written.
+ *          The check is one load and one branch when the level and the keywords are constants.
+ */
+class LoggingFilter final {
+  public:
+    using LoggingLevel = Windows::Foundation::Diagnostics::LoggingLevel;
+    static constexpr uint32_t keyword_count = 59;
+    static constexpr uint64_t all_keywords = ~uint64_t{0} >> 5;
+
+  private:
+    std::atomic<uint64_t> m_state;
+
+    static constexpr uint64_t level_mask = 0b11111;
+
+    /// @return the bits of `minimum` and the higher levels
+    static constexpr uint64_t get_level_bits(LoggingLevel minimum) noexcept {
+        return level_mask & ~((uint64_t{1} << static_cast<uint32_t>(minimum)) - 1);
+    }
+
+  public:
+    explicit LoggingFilter(LoggingLevel minimum = LoggingLevel::Verbose, uint64_t keywords = all_keywords) noexcept
+        : m_state{get_level_bits(minimum) | ((keywords & all_keywords) << 5)} {
+    }
+
+    /// @pre `keywords` is in `all_keywords`
+    static constexpr uint64_t get_required_bits(LoggingLevel level, uint64_t keywords) noexcept {
+        return (uint64_t{1} << static_cast<uint32_t>(level)) | (keywords << 5);
+    }
+
+    bool IsEnabled(LoggingLevel level, uint64_t keywords = 0) const noexcept {
+        if ((keywords & ~all_keywords) != 0) // the shift would drop them
+            return false;
+        const uint64_t required = get_required_bits(level, keywords);
+        return (m_state.load(std::memory_order_relaxed) & required) == required;
+    }
+
+    /// @brief Disable the levels lower than `minimum`
+    void SetLevel(LoggingLevel minimum) noexcept {
+        uint64_t state = m_state.load(std::memory_order_relaxed);
+        while (m_state.compare_exchange_weak(state, (state & ~level_mask) | get_level_bits(minimum),
+                                             std::memory_order_relaxed) == false)
+            continue;
+    }
+    /// @return the lowest enabled level. Critical if every level is disabled
+    LoggingLevel Level() const noexcept {
+        const uint64_t levels = m_state.load(std::memory_order_relaxed) & level_mask;
+        for (uint32_t i = 0; i < 5; ++i)
+            if (levels & (uint64_t{1} << i))
+                return static_cast<LoggingLevel>(i);
+        return LoggingLevel::Critical;
+    }
+
+    void EnableKeywords(uint64_t keywords) noexcept {
+        m_state.fetch_or((keywords & all_keywords) << 5, std::memory_order_relaxed);
+    }
+    void DisableKeywords(uint64_t keywords) noexcept {
+        m_state.fetch_and(~((keywords & all_keywords) << 5), std::memory_order_relaxed);
+    }
+    uint64_t Keywords() const noexcept {
+        return m_state.load(std::memory_order_relaxed) >> 5;
+    }
+};
+
+/**
+ * @brief ILoggingChannel decorator which drops the records of the disabled levels and keywords
+ * @details The calls through ILoggingChannel are filtered by the level only. Check `IsEnabled` at the call site,
+ *          or use `LOGGING_CHANNEL_MESSAGE`, to skip the construction of the message.
+ */
+struct FilteringLoggingChannel
+    : winrt::implements<FilteringLoggingChannel, Windows::Foundation::Diagnostics::ILoggingChannel> {
+  private:
+    using LoggingLevel = Windows::Foundation::Diagnostics::LoggingLevel;
+
+    Windows::Foundation::Diagnostics::ILoggingChannel m_inner;
+    LoggingFilter m_filter;
+
+  public:
+    FilteringLoggingChannel(Windows::Foundation::Diagnostics::ILoggingChannel inner, LoggingLevel minimum,
+                            uint64_t keywords = LoggingFilter::all_keywords) noexcept(false)
+        : m_inner{std::move(inner)}, m_filter{minimum, keywords} {
+        if (m_inner == nullptr)
+            throw std::invalid_argument{"inner channel is required"};
+    }
+
+    LoggingFilter& Filter() noexcept { return m_filter; }
+    bool IsEnabled(LoggingLevel level, uint64_t keywords = 0) const noexcept {
+        return m_filter.IsEnabled(level, keywords);
+    }
+
+    void LogMessage(winrt::hstring const& message) const {
+        if (m_filter.IsEnabled(LoggingLevel::Verbose))
+            m_inner.LogMessage(message);
+    }
+
+    void LogMessage(winrt::hstring const& message, LoggingLevel level) const {
+        if (m_filter.IsEnabled(level))
+            m_inner.LogMessage(message, level);
+    }
+
+    void LogMessage(winrt::hstring const& message, LoggingLevel level,
+                    Windows::Foundation::Diagnostics::LoggingOptions const& options) const {
+        if (m_filter.IsEnabled(level))
+            m_inner.LogMessage(message, level, options);
+    }
+
+    /// @brief The text is passed to the inner channel as a fast-pass HSTRING. No copy
+    template <size_t N>
+    void LogMessage(BasicFormatBuffer<wchar_t, N> const& message, LoggingLevel level) const {
+        if (m_filter.IsEnabled(level))
+            m_inner.LogMessage(message.view(), level);
+    }
+
+    void LogValuePair(winrt::hstring const& key, int32_t value) const {
+        if (m_filter.IsEnabled(LoggingLevel::Verbose))
+            m_inner.LogValuePair(key, value);
+    }
+
+    void LogValuePair(winrt::hstring const& key, int32_t value, LoggingLevel level) const {
+        if (m_filter.IsEnabled(level))
+            m_inner.LogValuePair(key, value, level);
+    }
+
+    void StartActivity(winrt::hstring const& activityName) const {
+        if (m_filter.IsEnabled(LoggingLevel::Verbose))
+            m_inner.StartActivity(activityName);
+    }
+
+    void StopActivity(winrt::hstring const& activityName) const {
+        if (m_filter.IsEnabled(LoggingLevel::Verbose))
+            m_inner.StopActivity(activityName);
+    }
+
+    // ILoggingChannel required properties
+    winrt::hstring Name() const { return m_inner.Name(); }
+    bool Enabled() const { return m_inner.Enabled(); }
+    LoggingLevel Level() const noexcept { return m_filter.Level(); }
+
+    winrt::event_token LoggingEnabled(Windows::Foundation::TypedEventHandler<Windows::Foundation::Diagnostics::ILoggingChannel, winrt::Windows::Foundation::IInspectable> const& handler) const {
+        return m_inner.LoggingEnabled(handler);
+    }
+    void LoggingEnabled(winrt::event_token const& token) const noexcept { m_inner.LoggingEnabled(token); }
+};
+
+/**
+ * @brief Format and log the message only when the level and the keywords are enabled
+ * @param channel FilteringLoggingChannel reference
+ * @details The arguments are not evaluated when the record is disabled.
+ *          The message is formatted in `WFormatBuffer`, so the common case doesn't allocate
+ * @code
+ * LOGGING_CHANNEL_MESSAGE(*channel, LoggingLevel::Information, 0x2, L"size {}x{}", width, height);
+ * @endcode
+ */
+#define LOGGING_CHANNEL_MESSAGE(channel, level, keywords, ...)                                                         \
+    do {                                                                                                               \
+        if (auto&& logging_channel_ = (channel); logging_channel_.IsEnabled(level, keywords)) {                        \
+            ::winrt::App1::WFormatBuffer logging_message_{};                                                           \
+            logging_message_.format(__VA_ARGS__);                                                                      \
+            logging_channel_.LogMessage(logging_message_, level);                                                      \
+        }                                                                                                              \
+    } while (false)
+
+/**
+ * @brief Template version of LOGGING_CHANNEL_MESSAGE. The arguments are evaluated, but not formatted
+ */
+template <typename... Args>
+void log_message(FilteringLoggingChannel const& channel, Windows::Foundation::Diagnostics::LoggingLevel level,
+                 uint64_t keywords, std::wformat_string<Args...> fmt, Args&&... args) {
+    if (channel.IsEnabled(level, keywords)) {
+        WFormatBuffer message{};
+        message.format(fmt, std::forward<Args>(args)...);
+        channel.LogMessage(message, level);
+    }
+}
+
 /**
  * @brief Factory functions for ILoggingChannel implementations
  */
@@ -177,4 +595,13 @@ inline Windows::Foundation::Diagnostics::ILoggingChannel make_stream_logging_cha
     return winrt::make<StreamLoggingChannel>(stream, name);
 }
 
+inline Windows::Foundation::Diagnostics::ILoggingChannel make_buffered_logging_channel(std::wostream& stream, BufferedLoggingOptions options = {}, winrt::hstring const& name = L"BufferedStreamChannel") {
+    return winrt::make<BufferedStreamLoggingChannel>(stream, options, name);
+}
+
+/// @note The implementation is returned for `Filter` and `IsEnabled`. Use `as<ILoggingChannel>()` for the interface
+inline winrt::com_ptr<FilteringLoggingChannel> make_filtering_logging_channel(Windows::Foundation::Diagnostics::ILoggingChannel inner, Windows::Foundation::Diagnostics::LoggingLevel minimum) {
+    return winrt::make_self<FilteringLoggingChannel>(std::move(inner), minimum);
+}
+
 } // namespace winrt::App1
\ No newline at end of file
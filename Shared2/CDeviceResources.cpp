@@ -8,6 +8,23 @@
 
 namespace winrt::Shared2 {
 
+CDeviceResources::CDeviceResources() noexcept {
+    PublishState();
+}
+
+/// @note Call at the end of the reconfiguration path
+void CDeviceResources::PublishState() noexcept {
+    StateSnapshot state{};
+    state.width = static_cast<UINT>(m_outputSize.right - m_outputSize.left);
+    state.height = static_cast<UINT>(m_outputSize.bottom - m_outputSize.top);
+    state.backBufferFormat = m_backBufferFormat;
+    state.depthBufferFormat = m_depthBufferFormat;
+    state.featureLevel = m_d3dFeatureLevel;
+    state.options = m_options;
+    state.hasRenderTargets = m_renderTargets[0] ? TRUE : FALSE;
+    m_state.store(state);
+}
+
 // Helper function for DXGI format conversion
 DXGI_FORMAT CDeviceResources::NoSRGB(DXGI_FORMAT fmt) noexcept {
     switch (fmt) {
@@ -101,7 +118,11 @@ void CDeviceResources::MoveToNextFrame() noexcept(false) {
     const UINT64 currentFenceValue = m_fenceValues[m_backBufferIndex];
     winrt::check_hresult(m_commandQueue->Signal(m_fence.get(), currentFenceValue));
 
-    m_backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+    // The offscreen targets are used in round-robin
+    if (m_swapChain)
+        m_backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+    else
+        m_backBufferIndex = (m_backBufferIndex + 1) % m_backBufferCount;
 
     if (m_fence->GetCompletedValue() < m_fenceValues[m_backBufferIndex]) {
         winrt::check_hresult(m_fence->SetEventOnCompletion(m_fenceValues[m_backBufferIndex], m_fenceEvent.get()));
@@ -114,23 +135,38 @@ void CDeviceResources::MoveToNextFrame() noexcept(false) {
 HRESULT __stdcall CDeviceResources::InitializeDevice(DXGI_FORMAT backBufferFormat, DXGI_FORMAT depthBufferFormat,
                                                      UINT backBufferCount, D3D_FEATURE_LEVEL minFeatureLevel,
                                                      UINT flags) noexcept {
+    ReconfigureScope scope{m_gate};
     try {
         if (backBufferCount > MAX_BACK_BUFFER_COUNT)
             return E_INVALIDARG;
         if (minFeatureLevel < D3D_FEATURE_LEVEL_11_0)
             return E_INVALIDARG;
 
+        // The instance may be recycled by CreatePoolingClassFactory. Keep the device if nothing changes
+        if (m_d3dDevice) {
+            if (m_backBufferFormat == backBufferFormat && m_depthBufferFormat == depthBufferFormat &&
+                m_backBufferCount == backBufferCount && m_d3dMinFeatureLevel == minFeatureLevel &&
+                (m_options & ~c_AllowTearing) == (flags & ~c_AllowTearing))
+                return S_FALSE;
+            WaitForGpu();
+            ReleaseDeviceResources();
+        }
+
         m_backBufferFormat = backBufferFormat;
         m_depthBufferFormat = depthBufferFormat;
         m_backBufferCount = backBufferCount;
         m_d3dMinFeatureLevel = minFeatureLevel;
         m_options = flags;
 
-        if (m_options & 0x4) { // c_RequireTearingSupport equivalent
+        if (m_options & c_RequireTearingSupport) {
             m_options |= c_AllowTearing;
         }
+        if (m_options & c_Offscreen) { // nothing is presented
+            m_options &= ~(c_AllowTearing | c_RequireTearingSupport);
+        }
 
         InitializeDXGIAdapter();
+        PublishState();
         return S_OK;
     } catch (const winrt::hresult_error& ex) {
         return ex.code();
@@ -142,7 +178,12 @@ HRESULT __stdcall CDeviceResources::InitializeDevice(DXGI_FORMAT backBufferForma
 }
 
 HRESULT __stdcall CDeviceResources::CreateDeviceResources(IDXGIAdapter1* adapter) noexcept {
+    ReconfigureScope scope{m_gate};
     try {
+        // Already created (recycled instance). Only a different adapter requires the new device
+        if (m_d3dDevice && (adapter == nullptr || adapter == m_adapter.get()))
+            return S_FALSE;
+
         // Use provided adapter if available, otherwise use member adapter
         if (adapter == nullptr) {
             if (adapter = m_adapter.get(); adapter == nullptr)
@@ -208,6 +249,8 @@ HRESULT __stdcall CDeviceResources::CreateDeviceResources(IDXGIAdapter1* adapter
             winrt::throw_last_error();
         }
 
+        NameDeviceResources();
+        PublishState();
         return S_OK;
     } catch (const winrt::hresult_error& ex) {
         return ex.code();
@@ -215,11 +258,14 @@ HRESULT __stdcall CDeviceResources::CreateDeviceResources(IDXGIAdapter1* adapter
 }
 
 HRESULT __stdcall CDeviceResources::CreateWindowSizeDependentResources(UINT width, UINT height) noexcept {
+    ReconfigureScope scope{m_gate};
     try {
         if (!m_d3dDevice)
             return E_NOT_VALID_STATE;
 
         // Wait until all previous GPU work is complete.
+        if (m_fence)
+            WaitForGpu();
         for (UINT n = 0; n < m_backBufferCount; n++) {
             m_renderTargets[n] = nullptr;
             m_fenceValues[n] = m_fenceValues[m_backBufferIndex];
@@ -232,7 +278,9 @@ HRESULT __stdcall CDeviceResources::CreateWindowSizeDependentResources(UINT widt
 
         DXGI_FORMAT backBufferFormat = NoSRGB(m_backBufferFormat);
 
-        if (m_swapChain) {
+        if (m_options & c_Offscreen) {
+            CreateOffscreenTargets(width, height);
+        } else if (m_swapChain) {
             HRESULT hr =
                 m_swapChain->ResizeBuffers(m_backBufferCount, width, height, backBufferFormat,
                                            (m_options & c_AllowTearing) ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0u);
@@ -265,17 +313,19 @@ HRESULT __stdcall CDeviceResources::CreateWindowSizeDependentResources(UINT widt
             winrt::check_hresult(swapChain.try_as(m_swapChain));
         }
 
-        // Create render target views of the swap chain back buffers.
+        // Create render target views of the swap chain back buffers (or the offscreen textures).
         D3D12_CPU_DESCRIPTOR_HANDLE rtvDescriptor = m_rtvDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
         for (UINT n = 0; n < m_backBufferCount; n++) {
-            winrt::check_hresult(m_swapChain->GetBuffer(n, __uuidof(ID3D12Resource), m_renderTargets[n].put_void()));
+            if (m_swapChain)
+                winrt::check_hresult(
+                    m_swapChain->GetBuffer(n, __uuidof(ID3D12Resource), m_renderTargets[n].put_void()));
 
             m_d3dDevice->CreateRenderTargetView(m_renderTargets[n].get(), nullptr, rtvDescriptor);
 
             rtvDescriptor.ptr += m_rtvDescriptorSize;
         }
 
-        m_backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+        m_backBufferIndex = m_swapChain ? m_swapChain->GetCurrentBackBufferIndex() : 0;
 
         if (m_depthBufferFormat != DXGI_FORMAT_UNKNOWN) {
             D3D12_HEAP_PROPERTIES depthHeapProperties = {};
@@ -325,35 +375,102 @@ HRESULT __stdcall CDeviceResources::CreateWindowSizeDependentResources(UINT widt
         m_scissorRect.left = m_scissorRect.top = 0;
         m_scissorRect.right = static_cast<LONG>(width);
         m_scissorRect.bottom = static_cast<LONG>(height);
+
+        NameWindowSizeDependentResources();
+        PublishState();
         return S_OK;
     } catch (const winrt::hresult_error& ex) {
         return ex.code();
     }
 }
 
-HRESULT __stdcall CDeviceResources::HandleDeviceLost() noexcept {
+/// @note The textures are in the PRESENT(COMMON) state like the swap chain buffers. See `Prepare`
+void CDeviceResources::CreateOffscreenTargets(UINT width, UINT height) noexcept(false) {
+    D3D12_HEAP_PROPERTIES heapProperties = {};
+    heapProperties.Type = D3D12_HEAP_TYPE_DEFAULT;
+    heapProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    heapProperties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    heapProperties.CreationNodeMask = 1;
+    heapProperties.VisibleNodeMask = 1;
+
+    // Unlike the swap chain buffers, the view format is same with the resource format. Keep the sRGB
+    D3D12_RESOURCE_DESC desc = {};
+    desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    desc.Width = width;
+    desc.Height = height;
+    desc.DepthOrArraySize = 1;
+    desc.MipLevels = 1;
+    desc.Format = m_backBufferFormat;
+    desc.SampleDesc.Count = 1;
+    desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+    desc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+
+    for (UINT n = 0; n < m_backBufferCount; n++) {
+        winrt::check_hresult(m_d3dDevice->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &desc,
+                                                                  D3D12_RESOURCE_STATE_PRESENT, nullptr,
+                                                                  __uuidof(ID3D12Resource),
+                                                                  m_renderTargets[n].put_void()));
+    }
+}
+
+void CDeviceResources::ReleaseDeviceResources() noexcept {
+    for (UINT n = 0; n < m_backBufferCount; n++) {
+        m_commandAllocators[n] = nullptr;
+        m_renderTargets[n] = nullptr;
+    }
+
+    m_depthStencil = nullptr;
+    m_commandList = nullptr;
+    m_commandQueue = nullptr;
+    m_fence = nullptr;
+    m_rtvDescriptorHeap = nullptr;
+    m_dsvDescriptorHeap = nullptr;
+    m_swapChain = nullptr;
+    m_d3dDevice = nullptr;
+    m_dxgiFactory = nullptr;
+    m_adapter = nullptr;
+
+    m_fenceEvent.close();
+}
+
+HRESULT CDeviceResources::Recycle() noexcept {
+    ReconfigureScope scope{m_gate};
     try {
+        if (m_fence)
+            WaitForGpu();
         for (UINT n = 0; n < m_backBufferCount; n++) {
-            m_commandAllocators[n] = nullptr;
             m_renderTargets[n] = nullptr;
+            m_fenceValues[n] = m_fenceValues[m_backBufferIndex]; // the fence can't go back
         }
-
         m_depthStencil = nullptr;
-        m_commandList = nullptr;
-        m_commandQueue = nullptr;
-        m_fence = nullptr;
-        m_rtvDescriptorHeap = nullptr;
-        m_dsvDescriptorHeap = nullptr;
         m_swapChain = nullptr;
-        m_d3dDevice = nullptr;
-        m_dxgiFactory = nullptr;
-        m_adapter = nullptr;
+        m_backBufferIndex = 0;
 
-        m_fenceEvent.close();
+        m_outputSize = {};
+        m_screenViewport = {};
+        m_scissorRect = {};
+        m_isWindowVisible = true;
+
+        m_resourceName = L"DeviceResources";
+        NameDeviceResources();
+        PublishState();
+        return S_OK;
+    } catch (const winrt::hresult_error& ex) {
+        return ex.code();
+    } catch (const std::exception&) {
+        return E_FAIL;
+    }
+}
+
+HRESULT __stdcall CDeviceResources::HandleDeviceLost() noexcept {
+    ReconfigureScope scope{m_gate};
+    try {
+        ReleaseDeviceResources();
 
         CreateDeviceResources();
         CreateWindowSizeDependentResources(m_outputSize.right - m_outputSize.left,
                                            m_outputSize.bottom - m_outputSize.top);
+        PublishState();
         return S_OK;
     } catch (const winrt::hresult_error& ex) {
         return ex.code();
@@ -363,23 +480,25 @@ HRESULT __stdcall CDeviceResources::HandleDeviceLost() noexcept {
 HRESULT __stdcall CDeviceResources::GetOutputSize(UINT* pWidth, UINT* pHeight) noexcept {
     if (!pWidth || !pHeight)
         return E_INVALIDARG;
-    if (m_swapChain == nullptr)
+    const StateSnapshot state = m_state.load();
+    if (state.hasRenderTargets == FALSE)
         return E_NOT_VALID_STATE;
-    *pWidth = static_cast<UINT>(m_outputSize.right - m_outputSize.left);
-    *pHeight = static_cast<UINT>(m_outputSize.bottom - m_outputSize.top);
+    *pWidth = state.width;
+    *pHeight = state.height;
     return S_OK;
 }
 
 HRESULT __stdcall CDeviceResources::IsTearingSupported(BOOL* pSupported) noexcept {
     if (!pSupported)
         return E_INVALIDARG;
-    *pSupported = (m_options & c_AllowTearing) ? TRUE : FALSE;
+    *pSupported = (m_state.load().options & c_AllowTearing) ? TRUE : FALSE;
     return S_OK;
 }
 
 HRESULT __stdcall CDeviceResources::GetD3DDevice(ID3D12Device** ppDevice) noexcept {
     if (!ppDevice)
         return E_INVALIDARG;
+    auto lck = m_gate.read_lock();
     if (!m_d3dDevice)
         return E_NOT_VALID_STATE;
     m_d3dDevice.copy_to(ppDevice);
@@ -389,6 +508,7 @@ HRESULT __stdcall CDeviceResources::GetD3DDevice(ID3D12Device** ppDevice) noexce
 HRESULT __stdcall CDeviceResources::GetDXGIFactory(IDXGIFactory4** ppFactory) noexcept {
     if (!ppFactory)
         return E_INVALIDARG;
+    auto lck = m_gate.read_lock();
     if (!m_dxgiFactory)
         return E_NOT_VALID_STATE;
     m_dxgiFactory.copy_to(ppFactory);
@@ -398,6 +518,7 @@ HRESULT __stdcall CDeviceResources::GetDXGIFactory(IDXGIFactory4** ppFactory) no
 HRESULT __stdcall CDeviceResources::GetSwapChain(IDXGISwapChain3** ppSwapChain) noexcept {
     if (!ppSwapChain)
         return E_INVALIDARG;
+    auto lck = m_gate.read_lock();
     if (!m_swapChain)
         return E_NOT_VALID_STATE;
     m_swapChain.copy_to(ppSwapChain);
@@ -407,6 +528,7 @@ HRESULT __stdcall CDeviceResources::GetSwapChain(IDXGISwapChain3** ppSwapChain)
 HRESULT __stdcall CDeviceResources::GetCommandQueue(ID3D12CommandQueue** ppCommandQueue) noexcept {
     if (!ppCommandQueue)
         return E_INVALIDARG;
+    auto lck = m_gate.read_lock();
     if (!m_commandQueue)
         return E_NOT_VALID_STATE;
     m_commandQueue.copy_to(ppCommandQueue);
@@ -416,28 +538,32 @@ HRESULT __stdcall CDeviceResources::GetCommandQueue(ID3D12CommandQueue** ppComma
 HRESULT __stdcall CDeviceResources::GetDeviceFeatureLevel(D3D_FEATURE_LEVEL* pFeatureLevel) noexcept {
     if (!pFeatureLevel)
         return E_INVALIDARG;
-    *pFeatureLevel = m_d3dFeatureLevel;
+    *pFeatureLevel = m_state.load().featureLevel;
     return S_OK;
 }
 
 HRESULT __stdcall CDeviceResources::GetBackBufferFormat(DXGI_FORMAT* pFormat) noexcept {
     if (!pFormat)
         return E_INVALIDARG;
-    *pFormat = m_backBufferFormat;
+    *pFormat = m_state.load().backBufferFormat;
     return S_OK;
 }
 
 HRESULT __stdcall CDeviceResources::GetDepthBufferFormat(DXGI_FORMAT* pFormat) noexcept {
     if (!pFormat)
         return E_INVALIDARG;
-    *pFormat = m_depthBufferFormat;
+    *pFormat = m_state.load().depthBufferFormat;
     return S_OK;
 }
 
+/// @note The frame begins here and ends in `Present`. It is ended immediately when this function fails
 HRESULT __stdcall CDeviceResources::Prepare(D3D12_RESOURCE_STATES beforeState) noexcept {
+    m_gate.begin_frame();
     try {
-        if (!m_commandList)
+        if (!m_commandList) {
+            m_gate.end_frame();
             return E_NOT_VALID_STATE;
+        }
 
         winrt::check_hresult(m_commandAllocators[m_backBufferIndex]->Reset());
         winrt::check_hresult(m_commandList->Reset(m_commandAllocators[m_backBufferIndex].get(), nullptr));
@@ -456,13 +582,21 @@ HRESULT __stdcall CDeviceResources::Prepare(D3D12_RESOURCE_STATES beforeState) n
 
         return S_OK;
     } catch (const winrt::hresult_error& ex) {
+        m_gate.end_frame();
         return ex.code();
     }
 }
 
 HRESULT __stdcall CDeviceResources::Present(D3D12_RESOURCE_STATES beforeState) noexcept {
+    FrameScope scope{m_gate}; // in case of Present without Prepare
+    HRESULT hr = PresentFrame(beforeState);
+    m_gate.end_frame();
+    return hr;
+}
+
+HRESULT CDeviceResources::PresentFrame(D3D12_RESOURCE_STATES beforeState) noexcept {
     try {
-        if (!m_swapChain)
+        if (!m_renderTargets[m_backBufferIndex])
             return E_NOT_VALID_STATE;
 
         if (beforeState != D3D12_RESOURCE_STATE_PRESENT) {
@@ -483,14 +617,17 @@ HRESULT __stdcall CDeviceResources::Present(D3D12_RESOURCE_STATES beforeState) n
         m_commandQueue->ExecuteCommandLists(commands.size(), commands.begin());
 
         HRESULT hr;
-        if (m_options & c_AllowTearing) {
+        if (!m_swapChain) {
+            // Offscreen. Without Present, the device removal is reported by the device
+            hr = m_d3dDevice->GetDeviceRemovedReason();
+        } else if (m_options & c_AllowTearing) {
             hr = m_swapChain->Present(0, DXGI_PRESENT_ALLOW_TEARING);
         } else {
             hr = m_swapChain->Present(1, 0);
         }
 
         if (hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET) {
-            HandleDeviceLost();
+            HandleDeviceLost(); // re-enters the gate as the frame owner
         } else {
             winrt::check_hresult(hr);
             MoveToNextFrame();
@@ -503,6 +640,7 @@ HRESULT __stdcall CDeviceResources::Present(D3D12_RESOURCE_STATES beforeState) n
 }
 
 HRESULT __stdcall CDeviceResources::ExecuteCommandList() noexcept {
+    FrameScope scope{m_gate};
     try {
         if (!m_commandList || !m_commandQueue)
             return E_NOT_VALID_STATE;
@@ -519,6 +657,7 @@ HRESULT __stdcall CDeviceResources::ExecuteCommandList() noexcept {
 }
 
 HRESULT __stdcall CDeviceResources::WaitForGpu() noexcept {
+    FrameScope scope{m_gate};
     try {
         if (!m_commandQueue || !m_fence)
             return E_NOT_VALID_STATE;
@@ -536,48 +675,55 @@ HRESULT __stdcall CDeviceResources::WaitForGpu() noexcept {
     }
 }
 
+void CDeviceResources::NameDeviceResources() noexcept(false) {
+    if (m_resourceName.empty())
+        return;
+    if (m_d3dDevice)
+        m_d3dDevice->SetName(m_resourceName.c_str());
+    if (m_commandQueue)
+        m_commandQueue->SetName(m_resourceName.c_str());
+    if (m_commandList)
+        m_commandList->SetName(m_resourceName.c_str());
+    if (m_fence)
+        m_fence->SetName(m_resourceName.c_str());
+
+    // Command allocators with indexed names
+    for (UINT n = 0; n < m_backBufferCount; n++) {
+        if (m_commandAllocators[n]) {
+            auto allocatorName = std::format(L"{} Command Allocator {}", m_resourceName, n);
+            m_commandAllocators[n]->SetName(allocatorName.c_str());
+        }
+    }
+}
+
+void CDeviceResources::NameWindowSizeDependentResources() noexcept(false) {
+    if (m_resourceName.empty())
+        return;
+    // Render targets with indexed names
+    for (UINT n = 0; n < m_backBufferCount; n++) {
+        if (m_renderTargets[n]) {
+            auto targetName = std::format(L"{} Render Target {}", m_resourceName, n);
+            m_renderTargets[n]->SetName(targetName.c_str());
+        }
+    }
+
+    // Depth stencil
+    if (m_depthStencil) {
+        auto depthName = std::format(L"{} Depth Stencil", m_resourceName);
+        m_depthStencil->SetName(depthName.c_str());
+    }
+}
+
+/// @note The names are applied to the existing resources, and the resources created later
 HRESULT __stdcall CDeviceResources::SetName(LPCWSTR name, UINT32 namelen) noexcept {
+    ReconfigureScope scope{m_gate};
     try {
         if (!name)
             return E_INVALIDARG;
 
         m_resourceName = {name, namelen};
-
-        // Apply names to existing D3D12 resources
-        if (m_d3dDevice)
-            m_d3dDevice->SetName(m_resourceName.c_str());
-
-        if (m_commandQueue)
-            m_commandQueue->SetName(m_resourceName.c_str());
-
-        if (m_commandList)
-            m_commandList->SetName(m_resourceName.c_str());
-
-        if (m_fence)
-            m_fence->SetName(m_resourceName.c_str());
-
-        // Command allocators with indexed names
-        for (UINT n = 0; n < m_backBufferCount; n++) {
-            if (m_commandAllocators[n]) {
-                auto allocatorName = std::format(L"{} Command Allocator {}", m_resourceName, n);
-                m_commandAllocators[n]->SetName(allocatorName.c_str());
-            }
-        }
-
-        // Render targets with indexed names
-        for (UINT n = 0; n < m_backBufferCount; n++) {
-            if (m_renderTargets[n]) {
-                auto targetName = std::format(L"{} Render Target {}", m_resourceName, n);
-                m_renderTargets[n]->SetName(targetName.c_str());
-            }
-        }
-
-        // Depth stencil
-        if (m_depthStencil) {
-            auto depthName = std::format(L"{} Depth Stencil", m_resourceName);
-            m_depthStencil->SetName(depthName.c_str());
-        }
-
+        NameDeviceResources();
+        NameWindowSizeDependentResources();
         return S_OK;
     } catch (const std::exception&) {
         return E_FAIL; // probably formatting error or string memory issue
@@ -586,4 +732,44 @@ HRESULT __stdcall CDeviceResources::SetName(LPCWSTR name, UINT32 namelen) noexce
     }
 }
 
+HRESULT __stdcall CDeviceResources::GetRenderTarget(ID3D12Resource** ppResource) noexcept {
+    if (!ppResource)
+        return E_INVALIDARG;
+    FrameScope scope{m_gate};
+    if (!m_renderTargets[m_backBufferIndex])
+        return E_NOT_VALID_STATE;
+    m_renderTargets[m_backBufferIndex].copy_to(ppResource);
+    return S_OK;
+}
+
+HRESULT __stdcall CDeviceResources::GetRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE* pHandle) noexcept {
+    if (!pHandle)
+        return E_INVALIDARG;
+    FrameScope scope{m_gate};
+    if (!m_renderTargets[m_backBufferIndex])
+        return E_NOT_VALID_STATE;
+    D3D12_CPU_DESCRIPTOR_HANDLE handle = m_rtvDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
+    handle.ptr += static_cast<SIZE_T>(m_backBufferIndex) * m_rtvDescriptorSize;
+    *pHandle = handle;
+    return S_OK;
+}
+
+HRESULT __stdcall CDeviceResources::GetCommandList(ID3D12GraphicsCommandList** ppCommandList) noexcept {
+    if (!ppCommandList)
+        return E_INVALIDARG;
+    FrameScope scope{m_gate};
+    if (!m_commandList)
+        return E_NOT_VALID_STATE;
+    m_commandList.copy_to(ppCommandList);
+    return S_OK;
+}
+
+HRESULT __stdcall CDeviceResources::GetCurrentFrameIndex(UINT* pIndex) noexcept {
+    if (!pIndex)
+        return E_INVALIDARG;
+    FrameScope scope{m_gate};
+    *pIndex = m_backBufferIndex;
+    return S_OK;
+}
+
 } // namespace winrt::Shared2
\ No newline at end of file
@@ -1,6 +1,20 @@
 /**
  * @file CDeviceResources.h - DirectX 12 Device Resources Implementation
  * @details Self-contained DirectX 12 device and resource management
+ *
+ * Threading model (free-threaded, see FrameGate)
+ *  - Per-frame path: `Prepare` ... `Present`, `ExecuteCommandList`, `WaitForGpu`.
+ *    A frame is owned by the thread which called `Prepare` until it calls `Present`.
+ *  - Reconfiguration path: `InitializeDevice`, `CreateDeviceResources`, `CreateWindowSizeDependentResources`,
+ *    `HandleDeviceLost`, `SetName`. Waits for the frame in flight and blocks the next one.
+ *  - Value getters (`GetOutputSize`, formats, ...) read a SeqLock snapshot. They never block.
+ *  - COM pointer getters (`GetD3DDevice`, `GetSwapChain`, ...) wait only while reconfiguration.
+ *  - IDeviceResourcesFrame getters are in the per-frame path.
+ *
+ * Offscreen mode (DEVICE_RESOURCES_FLAG_OFFSCREEN)
+ *  - The render targets are committed textures in the PRESENT(COMMON) state. No swap chain.
+ *  - `Present` submits the frame and moves to the next texture. It waits only when the texture is still in use,
+ *    so the frames are pipelined up to the back buffer count.
  */
 #pragma once
 // DirectX headers and libraries
@@ -14,6 +28,7 @@
 #include <winrt/Windows.Foundation.h>
 
 #include "Shared2Ifcs.h"
+#include "Synchronization.h"
 
 namespace winrt::Shared2 {
 
@@ -29,7 +44,8 @@ constexpr winrt::guid CLSID_DeviceResources{
  * @brief Implementation of IDeviceResources using winrt::implements
  * @details Self-contained DirectX 12 device and resource management
  */
-struct CDeviceResources : winrt::implements<CDeviceResources, ::IDeviceResources> {
+struct CDeviceResources
+    : winrt::implements<CDeviceResources, ::IDeviceResources, ::IDeviceResourcesFrame, winrt::no_weak_ref> {
   private:
     // Direct3D properties
     DXGI_FORMAT m_backBufferFormat = DXGI_FORMAT_B8G8R8A8_UNORM;
@@ -71,21 +87,53 @@ struct CDeviceResources : winrt::implements<CDeviceResources, ::IDeviceResources
     D3D12_RECT m_scissorRect{};
     bool m_isWindowVisible = true;
 
-    // Resource naming
-    std::wstring m_resourceName;
+    // Resource naming. Applied when the resources are created
+    std::wstring m_resourceName = L"DeviceResources";
+
+    // Synchronization. Members above are guarded by m_gate
+    FrameGate m_gate;
+
+    /// @brief Values for the getters. Published at the end of each reconfiguration
+    struct StateSnapshot {
+        UINT width;
+        UINT height;
+        DXGI_FORMAT backBufferFormat;
+        DXGI_FORMAT depthBufferFormat;
+        D3D_FEATURE_LEVEL featureLevel;
+        UINT options;
+        BOOL hasRenderTargets; // swap chain buffers or offscreen textures
+    };
+    SeqLock<StateSnapshot> m_state;
 
     // Device creation options
-    static constexpr UINT c_AllowTearing = 0x1;
-    static constexpr UINT c_EnableHDR = 0x2;
+    static constexpr UINT c_AllowTearing = DEVICE_RESOURCES_FLAG_ALLOW_TEARING;
+    static constexpr UINT c_EnableHDR = DEVICE_RESOURCES_FLAG_ENABLE_HDR;
+    static constexpr UINT c_RequireTearingSupport = DEVICE_RESOURCES_FLAG_REQUIRE_TEARING_SUPPORT;
+    static constexpr UINT c_Offscreen = DEVICE_RESOURCES_FLAG_OFFSCREEN;
 
     // Helper methods
     void InitializeDXGIAdapter(IDXGIFactory4* factory = nullptr) noexcept(false);
     void InitializeAdapter(IDXGIAdapter1** ppAdapter,
                            DXGI_GPU_PREFERENCE preference = DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE) noexcept(false);
     void MoveToNextFrame() noexcept(false);
+    void CreateOffscreenTargets(UINT width, UINT height) noexcept(false);
+    void ReleaseDeviceResources() noexcept;
+    void NameDeviceResources() noexcept(false);
+    void NameWindowSizeDependentResources() noexcept(false);
+    void PublishState() noexcept;
+    HRESULT PresentFrame(D3D12_RESOURCE_STATES beforeState) noexcept;
     static DXGI_FORMAT NoSRGB(DXGI_FORMAT fmt) noexcept;
 
   public:
+    CDeviceResources() noexcept;
+
+    /**
+     * @brief Return to the state of `CreateDeviceResources`. Used by CustomClassFactory before reusing the instance
+     * @details Drains the GPU work, then releases the swap chain and the window size dependent resources.
+     *          The output size and the resource name go back to the defaults. The device is kept
+     */
+    HRESULT Recycle() noexcept;
+
     // IDeviceResources implementation
     HRESULT __stdcall InitializeDevice(DXGI_FORMAT backBufferFormat, DXGI_FORMAT depthBufferFormat,
                                        UINT backBufferCount, D3D_FEATURE_LEVEL minFeatureLevel,
@@ -107,6 +155,12 @@ struct CDeviceResources : winrt::implements<CDeviceResources, ::IDeviceResources
     HRESULT __stdcall ExecuteCommandList() noexcept override;
     HRESULT __stdcall WaitForGpu() noexcept override;
     HRESULT __stdcall SetName(LPCWSTR name, UINT32 namelen) noexcept override;
+
+    // IDeviceResourcesFrame implementation
+    HRESULT __stdcall GetRenderTarget(ID3D12Resource** ppResource) noexcept override;
+    HRESULT __stdcall GetRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE* pHandle) noexcept override;
+    HRESULT __stdcall GetCommandList(ID3D12GraphicsCommandList** ppCommandList) noexcept override;
+    HRESULT __stdcall GetCurrentFrameIndex(UINT* pIndex) noexcept override;
 };
 
 } // namespace winrt::Shared2
\ No newline at end of file
@@ -19,11 +19,25 @@
 
 // Forward declarations
 struct IDeviceResources;
+struct IDeviceResourcesFrame;
+
+/// @brief Flags for IDeviceResources::InitializeDevice
+enum DEVICE_RESOURCES_FLAGS : UINT {
+    DEVICE_RESOURCES_FLAG_NONE = 0,
+    DEVICE_RESOURCES_FLAG_ALLOW_TEARING = 0x1,
+    DEVICE_RESOURCES_FLAG_ENABLE_HDR = 0x2,
+    DEVICE_RESOURCES_FLAG_REQUIRE_TEARING_SUPPORT = 0x4,
+    /// @brief No swap chain. `CreateWindowSizeDependentResources` creates a ring of textures,
+    ///        and `Present` submits the frame without showing it. Same value with DX::DeviceResources::c_Offscreen
+    DEVICE_RESOURCES_FLAG_OFFSCREEN = 0x8,
+};
 
 /**
  * @brief DirectX Device Resources COM interface
  * @details COM wrapper for DirectX 12 device and resource management
  * @note Designed for size-independent operations and basic resource creation
+ * @note Free-threaded. `Prepare` ... `Present` is a frame owned by the calling thread, and the (re)creation
+ *       functions wait for the frame in flight. Value getters never block. See CDeviceResources.h
  */
 MIDL_INTERFACE("23456789-2345-6789-ABCD-23456789ABCD")
 IDeviceResources : public IUnknown {
@@ -33,7 +47,7 @@ IDeviceResources : public IUnknown {
      * @param depthBufferFormat Format for depth buffer (e.g., DXGI_FORMAT_D32_FLOAT)
      * @param backBufferCount Number of back buffers (typically 2-3)
      * @param minFeatureLevel Minimum D3D feature level required
-     * @param flags Device creation flags (see DeviceResources constants)
+     * @param flags Device creation flags (see DEVICE_RESOURCES_FLAGS)
      * @return S_OK on success, error HRESULT on failure
      */
     STDMETHOD(InitializeDevice)(DXGI_FORMAT backBufferFormat, DXGI_FORMAT depthBufferFormat, UINT backBufferCount,
@@ -159,7 +173,53 @@ IDeviceResources : public IUnknown {
     STDMETHOD(SetName)(LPCWSTR name, UINT32 namelen) = 0;
 };
 
+/**
+ * @brief Access to the render target of the current frame
+ * @details Query from IDeviceResources. The values are for the frame between `Prepare` and `Present`,
+ *          so call them in the frame. With DEVICE_RESOURCES_FLAG_OFFSCREEN, this is the only way to the target
+ */
+MIDL_INTERFACE("23456789-2345-6789-ABCD-23456789ABCE")
+IDeviceResourcesFrame : public IUnknown {
+    /**
+     * @brief Get the render target of the current frame
+     * @param ppResource Pointer to receive the swap chain buffer or the offscreen texture
+     * @return S_OK on success, E_NOT_VALID_STATE before CreateWindowSizeDependentResources
+     */
+    STDMETHOD(GetRenderTarget)(ID3D12Resource * *ppResource) = 0;
+
+    /**
+     * @brief Get the render target view of the current frame
+     * @param pHandle Pointer to receive the CPU descriptor handle
+     * @return S_OK on success, E_NOT_VALID_STATE before CreateWindowSizeDependentResources
+     */
+    STDMETHOD(GetRenderTargetView)(D3D12_CPU_DESCRIPTOR_HANDLE * pHandle) = 0;
+
+    /**
+     * @brief Get the command list which is reset by `Prepare`
+     * @param ppCommandList Pointer to receive ID3D12GraphicsCommandList interface
+     * @return S_OK on success, E_NOT_VALID_STATE before CreateDeviceResources
+     */
+    STDMETHOD(GetCommandList)(ID3D12GraphicsCommandList * *ppCommandList) = 0;
+
+    /**
+     * @brief Get the index of the current back buffer (or offscreen texture)
+     * @param pIndex Pointer to receive the index. Less than the back buffer count
+     * @return S_OK on success, error HRESULT on failure
+     */
+    STDMETHOD(GetCurrentFrameIndex)(UINT * pIndex) = 0;
+};
+
 extern "C" {
 SHARED2_API HRESULT STDAPICALLTYPE CreateCustomClassFactory(::IClassFactory** output) noexcept;
+/**
+ * @brief Create a class factory which recycles the released instances
+ * @param capacity Maximum number of pooled instances for each class. Must be larger than 0
+ * @details When every reference except the factory's one is released, the instance is reused by the next
+ *          `CreateInstance`. Pooled IDeviceResources keep their device, so `InitializeDevice` with the same
+ *          parameters and `CreateDeviceResources` return S_FALSE without creating the device again.
+ *          The swap chain, the render targets and the name are released. Call `CreateWindowSizeDependentResources`
+ *          and `SetName` again. Instances which support weak references are not pooled.
+ */
+SHARED2_API HRESULT STDAPICALLTYPE CreatePoolingClassFactory(UINT32 capacity, ::IClassFactory** output) noexcept;
 SHARED2_API HRESULT STDAPICALLTYPE CreateDeviceResources(REFIID riid, void** ppv) noexcept;
 }
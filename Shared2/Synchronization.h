@@ -0,0 +1,188 @@
+/**
+ * @file Synchronization.h - Synchronization helpers for the Shared2 COM classes
+ * @details Standard C++ only. The helpers don't depend on Windows headers
+ */
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+namespace winrt::Shared2 {
+
+/**
+ * @brief Sequence lock for small, trivially copyable state
+ * @details Readers never take a lock and never block the writer. They retry when the writer was active.
+ *          The value is stored in atomic words, so the concurrent copy is not a data race.
+ * @note Single writer. Callers must serialize `store` with their own lock
+ * @see https://www.hpl.hp.com/techreports/2012/HPL-2012-68.pdf "Can Seqlocks Get Along With Programming Language Memory Models?"
+ */
+template <typename T>
+class SeqLock final {
+    static_assert(std::is_trivially_copyable_v<T>, "SeqLock requires trivially copyable type");
+    static constexpr size_t word_count = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint64_t> m_sequence{0};
+    std::atomic<uint64_t> m_words[word_count]{};
+
+  public:
+    SeqLock() noexcept : SeqLock{T{}} {
+    }
+    explicit SeqLock(const T& value) noexcept {
+        store(value);
+    }
+
+    void store(const T& value) noexcept {
+        uint64_t words[word_count]{};
+        std::memcpy(words, &value, sizeof(T));
+        const uint64_t seq = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(seq + 1, std::memory_order_relaxed); // odd: writing
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < word_count; ++i)
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        m_sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const noexcept {
+        uint64_t words[word_count]{};
+        while (true) {
+            const uint64_t before = m_sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            for (size_t i = 0; i < word_count; ++i)
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_sequence.load(std::memory_order_relaxed) == before)
+                break;
+        }
+        T value;
+        std::memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+    /// @return even number. Increased by 2 for each `store`
+    uint64_t sequence() const noexcept {
+        return m_sequence.load(std::memory_order_acquire);
+    }
+};
+
+/**
+ * @brief Separates the per-frame path and the reconfiguration path of a device wrapper
+ * @details
+ *  - Frame: from `Prepare` to `Present`. Only 1 thread owns the frame. Other frame calls wait for it
+ *  - Reconfiguration: device/swapchain (re)creation. Waits for the frame in flight, and blocks new frames
+ *  - Read: copy of COM pointers. Allowed in a frame, blocked while reconfiguration
+ *
+ *  The owner thread can re-enter. For example, `Present` may call `HandleDeviceLost` in its frame.
+ *  Waiting reconfiguration has priority over new frames, so the UI thread is not starved by the render loop.
+ */
+class FrameGate final {
+    mutable std::mutex m_lock;
+    mutable std::condition_variable m_changed;
+    std::thread::id m_frameOwner{}; // default id: no frame in flight
+    std::thread::id m_writerOwner{};
+    uint32_t m_writerDepth = 0;
+    uint32_t m_writersWaiting = 0;
+
+    bool is_writer_free(std::thread::id self) const noexcept {
+        return m_writerDepth == 0 || m_writerOwner == self;
+    }
+
+  public:
+    /// @return false if the current thread already owns the frame
+    bool begin_frame() noexcept {
+        const auto self = std::this_thread::get_id();
+        std::unique_lock lck{m_lock};
+        if (m_frameOwner == self)
+            return false;
+        m_changed.wait(lck, [this, self]() {
+            if (m_writerOwner == self && m_writerDepth)
+                return m_frameOwner == std::thread::id{};
+            return m_writerDepth == 0 && m_writersWaiting == 0 && m_frameOwner == std::thread::id{};
+        });
+        m_frameOwner = self;
+        return true;
+    }
+
+    void end_frame() noexcept {
+        {
+            std::lock_guard lck{m_lock};
+            if (m_frameOwner != std::this_thread::get_id())
+                return;
+            m_frameOwner = {};
+        }
+        m_changed.notify_all();
+    }
+
+    bool in_frame() const noexcept {
+        std::lock_guard lck{m_lock};
+        return m_frameOwner == std::this_thread::get_id();
+    }
+
+    void begin_reconfigure() noexcept {
+        const auto self = std::this_thread::get_id();
+        std::unique_lock lck{m_lock};
+        ++m_writersWaiting;
+        m_changed.wait(lck, [this, self]() {
+            const bool frame_free = m_frameOwner == std::thread::id{} || m_frameOwner == self;
+            return frame_free && is_writer_free(self);
+        });
+        --m_writersWaiting;
+        m_writerOwner = self;
+        ++m_writerDepth;
+    }
+
+    void end_reconfigure() noexcept {
+        {
+            std::lock_guard lck{m_lock};
+            if (--m_writerDepth == 0)
+                m_writerOwner = {};
+        }
+        m_changed.notify_all();
+    }
+
+    /// @note Hold the returned lock while reading the state. Keep it short
+    [[nodiscard]] std::unique_lock<std::mutex> read_lock() const noexcept {
+        const auto self = std::this_thread::get_id();
+        std::unique_lock lck{m_lock};
+        m_changed.wait(lck, [this, self]() { return is_writer_free(self); });
+        return lck;
+    }
+};
+
+/// @brief Frame scope for the calls which can be used both in and out of `Prepare`/`Present`
+class FrameScope final {
+    FrameGate& m_gate;
+    const bool m_owner;
+
+  public:
+    explicit FrameScope(FrameGate& gate) noexcept : m_gate{gate}, m_owner{gate.begin_frame()} {
+    }
+    ~FrameScope() noexcept {
+        if (m_owner)
+            m_gate.end_frame();
+    }
+    FrameScope(const FrameScope&) = delete;
+    FrameScope& operator=(const FrameScope&) = delete;
+};
+
+class ReconfigureScope final {
+    FrameGate& m_gate;
+
+  public:
+    explicit ReconfigureScope(FrameGate& gate) noexcept : m_gate{gate} {
+        m_gate.begin_reconfigure();
+    }
+    ~ReconfigureScope() noexcept {
+        m_gate.end_reconfigure();
+    }
+    ReconfigureScope(const ReconfigureScope&) = delete;
+    ReconfigureScope& operator=(const ReconfigureScope&) = delete;
+};
+
+} // namespace winrt::Shared2
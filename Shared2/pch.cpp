@@ -4,30 +4,99 @@
 
 namespace winrt::Shared2 {
 
+/// @note Pooled IDeviceResources keep their device. The swap chain and the name of the previous user are dropped
+static HRESULT RecycleDeviceResources(::IUnknown* instance) noexcept {
+    winrt::com_ptr<IDeviceResources> resources = nullptr;
+    if (auto hr = instance->QueryInterface(__uuidof(IDeviceResources), resources.put_void()); FAILED(hr))
+        return hr;
+    // the pool holds only the instances of `CreateDeviceResources`
+    return static_cast<CDeviceResources*>(resources.get())->Recycle();
+}
+
+// ... put more classes below ...
+constexpr ClassEntry g_classEntries[] = {
+    {IID_IDeviceResources, &::CreateDeviceResources, &RecycleDeviceResources},
+};
+constexpr ClassTable<CustomClassFactory::TableCapacity> g_classTable{g_classEntries};
+
+CustomClassFactory::CustomClassFactory(uint32_t poolCapacity) noexcept(false)
+    : m_poolCapacity{poolCapacity}, m_pools{std::make_unique<Pool[]>(TableCapacity)} {
+}
+
 HRESULT __stdcall CustomClassFactory::CreateInstance(IUnknown* unknown, REFIID riid, void** ppv) noexcept {
     try {
         if (ppv == nullptr)
             return E_INVALIDARG;
+        *ppv = nullptr;
         if (unknown) // No aggregation support
             return CLASS_E_NOAGGREGATION;
 
-        // note: use short-circuiting to make ease of debugging with multiple branches
-        if (IsEqualIID(riid, __uuidof(IDeviceResources)))
-            return CreateDeviceResources(riid, ppv);
-
-        // ... put more classes below ...
-        // ...
-
-        return E_NOINTERFACE;
+        const size_t index = g_classTable.find(riid);
+        if (index == g_classTable.npos)
+            return E_NOINTERFACE;
+        const ClassEntry& entry = g_classTable[index];
+        if (m_poolCapacity == 0 || entry.recycle == nullptr)
+            return entry.create(riid, ppv);
+        return CreatePooledInstance(entry, m_pools[index], riid, ppv);
+    } catch (const winrt::hresult_error& ex) {
+        return ex.code();
+    } catch (const std::bad_alloc&) {
+        return E_OUTOFMEMORY;
     } catch (...) {
         return E_UNEXPECTED;
     }
 }
 
+/// @note An instance is idle when the pool holds the only reference. New references can't be created
+///       without the pool while the mutex is locked, so checking the count is safe here
+static ULONG get_reference_count(::IUnknown* instance) noexcept {
+    instance->AddRef();
+    return instance->Release();
+}
+
+/// @note A weak reference can resolve to a strong one without the pool, and it is not in the reference count.
+///       Such instances are never pooled. See `winrt::no_weak_ref`
+static bool supports_weak_reference(::IUnknown* instance) noexcept {
+    winrt::com_ptr<::IWeakReferenceSource> source = nullptr;
+    return SUCCEEDED(instance->QueryInterface(__uuidof(::IWeakReferenceSource), source.put_void()));
+}
+
+HRESULT CustomClassFactory::CreatePooledInstance(const ClassEntry& entry, Pool& pool, REFIID riid,
+                                                 void** ppv) noexcept(false) {
+    std::unique_lock lck{pool.mtx};
+    for (winrt::com_ptr<::IUnknown>& item : pool.items) {
+        if (get_reference_count(item.get()) != 1)
+            continue;
+        if (FAILED(entry.recycle(item.get())))
+            continue; // leave it. the instance will be dropped when the pool is full
+        return item->QueryInterface(riid, ppv);
+    }
+
+    winrt::com_ptr<::IUnknown> item = nullptr;
+    if (auto hr = entry.create(__uuidof(::IUnknown), item.put_void()); FAILED(hr))
+        return hr;
+    if (supports_weak_reference(item.get()))
+        return item->QueryInterface(riid, ppv);
+    if (pool.items.size() >= m_poolCapacity) {
+        // drop an idle instance to keep the capacity. if all of them are in use, the new one won't be pooled
+        auto it = std::find_if(pool.items.begin(), pool.items.end(),
+                               [](const auto& p) { return get_reference_count(p.get()) == 1; });
+        if (it == pool.items.end())
+            return item->QueryInterface(riid, ppv);
+        pool.items.erase(it);
+    }
+    pool.items.emplace_back(item);
+    return item->QueryInterface(riid, ppv);
+}
+
 ULONG CustomClassFactory::GetLockCount() const noexcept {
     return m_lockCount.load();
 }
 
+uint32_t CustomClassFactory::GetPoolCapacity() const noexcept {
+    return m_poolCapacity;
+}
+
 HRESULT __stdcall CustomClassFactory::LockServer(BOOL fLock) noexcept {
     if (fLock) {
         m_lockCount.fetch_add(1);
@@ -46,9 +115,8 @@ HRESULT __stdcall CreateDeviceResources(REFIID riid, void** ppv) noexcept {
     try {
         if (!ppv)
             return E_INVALIDARG;
+        // note: the resources are named when they are created. See CDeviceResources::SetName
         auto res = winrt::make<CDeviceResources>();
-        std::wstring_view name = L"DeviceResources";
-        res->SetName(name.data(), static_cast<uint32_t>(name.length()));
         return res->QueryInterface(riid, ppv);
     } catch (const winrt::hresult_error& ex) {
         return ex.code();
@@ -72,6 +140,21 @@ HRESULT __stdcall CreateCustomClassFactory(IClassFactory** output) noexcept {
     }
 }
 
+HRESULT __stdcall CreatePoolingClassFactory(UINT32 capacity, IClassFactory** output) noexcept {
+    using namespace winrt::Shared2;
+    try {
+        if (!output || capacity == 0)
+            return E_INVALIDARG;
+        auto factory = winrt::make<CustomClassFactory>(capacity);
+        factory.copy_to(output);
+        return S_OK;
+    } catch (const winrt::hresult_error& ex) {
+        return ex.code();
+    } catch (const std::exception&) {
+        return E_FAIL;
+    }
+}
+
 } // extern "C"
 
 /// @see combaseapi.h
@@ -10,6 +10,7 @@
 #include <combaseapi.h>
 #include <hstring.h>
 #include <restrictederrorinfo.h>
+#include <weakreference.h>
 // clang-format on
 
 // WinRT headers
@@ -22,9 +23,12 @@
 #include "Shared2Ifcs.h"
 
 // Standard C++
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <format>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -32,21 +36,130 @@
 
 namespace winrt::Shared2 {
 
+/// @brief Signature of the exported creation functions. See `CreateDeviceResources`
+using CreateInstanceFn = HRESULT(STDAPICALLTYPE*)(REFIID riid, void** ppv) noexcept;
+
+/// @brief Prepares a pooled instance before it is handed out again. nullptr means the class is not poolable
+using RecycleInstanceFn = HRESULT (*)(::IUnknown* instance) noexcept;
+
+/**
+ * @brief An entry of the CustomClassFactory dispatch table
+ * @details `iid` is the interface which selects the class. The same interface is used for the pooled instances
+ */
+struct ClassEntry {
+    winrt::guid iid;
+    CreateInstanceFn create;
+    RecycleInstanceFn recycle;
+};
+
+/// @note FNV-1a over the GUID fields. Must be usable in constant expressions to build the ClassTable
+template <typename G>
+constexpr uint32_t hash_iid(const G& iid) noexcept {
+    uint32_t h = 2166136261u;
+    auto mix = [&h](uint32_t v, int bytes) {
+        for (int i = 0; i < bytes; ++i) {
+            h ^= (v >> (i * 8)) & 0xFFu;
+            h *= 16777619u;
+        }
+    };
+    mix(iid.Data1, 4);
+    mix(iid.Data2, 2);
+    mix(iid.Data3, 2);
+    for (auto b : iid.Data4)
+        mix(b, 1);
+    return h;
+}
+
+template <typename L, typename R>
+constexpr bool equal_iid(const L& lhs, const R& rhs) noexcept {
+    if (lhs.Data1 != rhs.Data1 || lhs.Data2 != rhs.Data2 || lhs.Data3 != rhs.Data3)
+        return false;
+    for (size_t i = 0; i < 8; ++i)
+        if (lhs.Data4[i] != rhs.Data4[i])
+            return false;
+    return true;
+}
+
+/**
+ * @brief Open addressing hash table of ClassEntry, built at compile time
+ * @details Slot count is a power of 2 and at least twice of the entry count,
+ *          so the lookup is a hash and (almost always) one comparison.
+ */
+template <size_t Capacity>
+struct ClassTable final {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+    static constexpr size_t npos = Capacity;
+
+    std::array<ClassEntry, Capacity> slots{};
+    std::array<bool, Capacity> used{};
+
+  public:
+    template <size_t N>
+    consteval explicit ClassTable(const ClassEntry (&entries)[N]) {
+        static_assert(N * 2 <= Capacity, "ClassTable is too small for the entries");
+        for (const ClassEntry& e : entries) {
+            size_t i = hash_iid(e.iid) & (Capacity - 1);
+            while (used[i]) {
+                if (equal_iid(slots[i].iid, e.iid))
+                    throw "duplicated IID in ClassTable"; // compile error in consteval context
+                i = (i + 1) & (Capacity - 1);
+            }
+            slots[i] = e;
+            used[i] = true;
+        }
+    }
+
+    /// @return index of the slot or `npos`
+    template <typename G>
+    constexpr size_t find(const G& iid) const noexcept {
+        size_t i = hash_iid(iid) & (Capacity - 1);
+        for (size_t probe = 0; probe < Capacity && used[i]; ++probe) {
+            if (equal_iid(slots[i].iid, iid))
+                return i;
+            i = (i + 1) & (Capacity - 1);
+        }
+        return npos;
+    }
+
+    constexpr const ClassEntry& operator[](size_t index) const noexcept {
+        return slots[index];
+    }
+};
+
 /**
  * @brief Implementation of ICustomClassFactory using winrt::implements
- * @details Custom class factory that creates ICustomService instances
+ * @details Custom class factory that creates instances from the ClassTable.
+ *          When `poolCapacity` is not 0, the factory keeps the instances it created and reuses them
+ *          after all other references are released. See `CreatePoolingClassFactory`
  */
 struct CustomClassFactory : winrt::implements<CustomClassFactory, ::IClassFactory> {
+    static constexpr size_t TableCapacity = 16;
+
   private:
     std::atomic<ULONG> m_lockCount{0};
 
+    /// @note The pool holds 1 reference for each instance. The instance is idle when its reference count is 1.
+    ///       The instances which support IWeakReferenceSource are not pooled
+    struct Pool {
+        std::mutex mtx;
+        std::vector<winrt::com_ptr<::IUnknown>> items;
+    };
+    const uint32_t m_poolCapacity = 0;
+    std::unique_ptr<Pool[]> m_pools;
+
+    HRESULT CreatePooledInstance(const ClassEntry& entry, Pool& pool, REFIID riid, void** ppv) noexcept(false);
+
   public:
+    CustomClassFactory() noexcept = default;
+    explicit CustomClassFactory(uint32_t poolCapacity) noexcept(false);
+
     // IClassFactory implementation
     HRESULT __stdcall CreateInstance(IUnknown* pUnkOuter, REFIID riid, void** ppvObject) noexcept override;
     HRESULT __stdcall LockServer(BOOL fLock) noexcept override;
 
     // Helper methods
     ULONG GetLockCount() const noexcept;
+    uint32_t GetPoolCapacity() const noexcept;
 };
 
-} // namespace winrt::Shared2
\ No newline at end of file
+} // namespace winrt::Shared2
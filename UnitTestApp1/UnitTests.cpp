@@ -3,9 +3,51 @@
 #include <CppUnitTest.h>
 #include <winrt/Shared1.h> // generated file from Shared1 project
 
+#include "../Shared1/pch.h"         // ILoggingChannel implementations
 #include "../Shared2/Shared2Ifcs.h" // COM interface declarations
+#include "../Shared2/Synchronization.h"
+#include "FrameReadback.h"
+#include "PipelineLibrary.h"
+#include "RenderGraph.h"
+#include "ShaderPack.h"
 #include "MainWindow.g.h"
 
+#define SPDLOG_WCHAR_TO_UTF8_SUPPORT
+#include "AsyncLogSink.h"
+#include "BinaryLog.h"
+#include "FlightRecorder.h"
+#include "FormatBuffer.h"
+#include "LogArchive.h"
+#include "LogCounterSink.h"
+#include "LogCounters.h"
+#include "LogLimit.h"
+#include "RotatingFileLog.h"
+#include "SettingsJournal.h"
+#include "SettingsSchema.h"
+#include "SettingsStore.h"
+#include "SettingsWriter.h"
+#include "TextConvert.h"
+#include <spdlog/sinks/null_sink.h>
+#include <spdlog/sinks/ostream_sink.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <crtdbg.h>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
 using namespace winrt::Microsoft::UI::Xaml::Controls;
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
@@ -91,6 +133,78 @@ class Shared2ClassFactoryTests : public TestClass<Shared2ClassFactoryTests> {
     }
 };
 
+class Shared2PoolingClassFactoryTests : public TestClass<Shared2PoolingClassFactoryTests> {
+    winrt::com_ptr<IClassFactory> factory = nullptr;
+
+  public:
+    TEST_METHOD_INITIALIZE(Initialize) {
+        HRESULT hr = ::CreatePoolingClassFactory(1, factory.put());
+        if (FAILED(hr))
+            Assert::Fail(L"CreatePoolingClassFactory failed");
+    }
+    TEST_METHOD_CLEANUP(Cleanup) {
+        factory = nullptr;
+    }
+
+    TEST_METHOD(TestRejectZeroCapacity) {
+        winrt::com_ptr<IClassFactory> other = nullptr;
+        Assert::AreEqual(::CreatePoolingClassFactory(0, other.put()), E_INVALIDARG);
+        Assert::IsNull(other.get());
+    }
+
+    TEST_METHOD(TestRecycleDeviceResources) {
+        winrt::com_ptr<IDeviceResources> resources = nullptr;
+        HRESULT hr = factory->CreateInstance(nullptr, __uuidof(IDeviceResources), resources.put_void());
+        Assert::AreEqual(hr, S_OK);
+        Assert::AreEqual(resources->InitializeDevice(DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_D32_FLOAT, 2,
+                                                     D3D_FEATURE_LEVEL_11_0, 0),
+                         S_OK);
+        Assert::AreEqual(resources->CreateDeviceResources(), S_OK);
+        IDeviceResources* first = resources.get();
+        resources = nullptr; // the instance is idle in the pool
+
+        hr = factory->CreateInstance(nullptr, __uuidof(IDeviceResources), resources.put_void());
+        Assert::AreEqual(hr, S_OK);
+        Assert::IsTrue(first == resources.get(), L"Released instance must be recycled");
+
+        // the device is kept. the same parameters don't create it again
+        Assert::AreEqual(resources->InitializeDevice(DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_D32_FLOAT, 2,
+                                                     D3D_FEATURE_LEVEL_11_0, 0),
+                         S_FALSE);
+        Assert::AreEqual(resources->CreateDeviceResources(), S_FALSE);
+
+        // the pooled instance is in use. the next one must be a different instance
+        winrt::com_ptr<IDeviceResources> second = nullptr;
+        hr = factory->CreateInstance(nullptr, __uuidof(IDeviceResources), second.put_void());
+        Assert::AreEqual(hr, S_OK);
+        Assert::IsFalse(second.get() == resources.get());
+    }
+
+    TEST_METHOD(TestRecycleReleasesSwapChain) {
+        winrt::com_ptr<IDeviceResources> resources = nullptr;
+        Assert::AreEqual(factory->CreateInstance(nullptr, __uuidof(IDeviceResources), resources.put_void()), S_OK);
+        Assert::AreEqual(resources->InitializeDevice(DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_D32_FLOAT, 2,
+                                                     D3D_FEATURE_LEVEL_11_0, 0),
+                         S_OK);
+        Assert::AreEqual(resources->CreateDeviceResources(), S_OK);
+        Assert::AreEqual(resources->CreateWindowSizeDependentResources(640, 360), S_OK);
+        {
+            winrt::com_ptr<IDXGISwapChain3> swapchain = nullptr;
+            Assert::AreEqual(resources->GetSwapChain(swapchain.put()), S_OK);
+        }
+        IDeviceResources* first = resources.get();
+        resources = nullptr;
+
+        Assert::AreEqual(factory->CreateInstance(nullptr, __uuidof(IDeviceResources), resources.put_void()), S_OK);
+        Assert::IsTrue(first == resources.get(), L"Released instance must be recycled");
+        winrt::com_ptr<IDXGISwapChain3> swapchain = nullptr;
+        Assert::AreEqual(resources->GetSwapChain(swapchain.put()), E_NOT_VALID_STATE);
+        Assert::IsNull(swapchain.get());
+        UINT width = 0, height = 0;
+        Assert::AreEqual(resources->GetOutputSize(&width, &height), E_NOT_VALID_STATE);
+    }
+};
+
 class DeviceResourcesTests : public TestClass<DeviceResourcesTests> {
     winrt::com_ptr<IClassFactory> factory = nullptr;
     winrt::com_ptr<IDeviceResources> resources = nullptr;
@@ -192,3 +306,2634 @@ class DeviceResourcesTests : public TestClass<DeviceResourcesTests> {
         // Note: actual value depends on hardware/driver support
     }
 };
+
+using winrt::Shared2::SeqLock;
+
+/// @note Contention benchmark for the read-only state of CDeviceResources. See the output of the test
+class SeqLockTests : public TestClass<SeqLockTests> {
+    struct Snapshot {
+        uint32_t width;
+        uint32_t height;
+        uint32_t format;
+        uint32_t generation;
+    };
+
+    /// @return reads per second of all readers
+    template <typename ReadFn, typename WriteFn>
+    static double run_readers(uint32_t reader_count, ReadFn&& read, WriteFn&& write) {
+        std::atomic<bool> stop{false};
+        std::atomic<uint64_t> reads{0};
+        std::vector<std::thread> readers{};
+        for (uint32_t i = 0; i < reader_count; ++i)
+            readers.emplace_back([&]() {
+                uint64_t count = 0;
+                while (stop.load(std::memory_order_relaxed) == false) {
+                    read();
+                    ++count;
+                }
+                reads.fetch_add(count);
+            });
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 1; i <= 2000; ++i) {
+            write(i);
+            std::this_thread::sleep_for(std::chrono::microseconds{50}); // reconfiguration is rare
+        }
+        stop = true;
+        for (auto& t : readers)
+            t.join();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return reads.load() / elapsed.count();
+    }
+
+  public:
+    TEST_METHOD(TestNoTornRead) {
+        SeqLock<Snapshot> state{};
+        std::atomic<uint32_t> torn{0};
+        run_readers(
+            8,
+            [&]() {
+                Snapshot s = state.load();
+                if (s.width != s.generation || s.height != s.generation)
+                    torn.fetch_add(1);
+            },
+            [&](uint32_t i) { state.store(Snapshot{i, i, 87, i}); });
+        Assert::AreEqual(torn.load(), 0u);
+        Assert::AreEqual(state.sequence(), uint64_t{2 * 2001});
+    }
+
+    TEST_METHOD(TestReaderContention) {
+        const uint32_t reader_count = (std::max)(2u, std::thread::hardware_concurrency());
+
+        SeqLock<Snapshot> state{};
+        const double seqlock_rate = run_readers(
+            reader_count, [&]() { std::ignore = state.load(); },
+            [&](uint32_t i) { state.store(Snapshot{i, i, 87, i}); });
+
+        std::shared_mutex mtx{};
+        Snapshot shared{};
+        const double rwlock_rate = run_readers(
+            reader_count,
+            [&]() {
+                std::shared_lock lck{mtx};
+                std::ignore = shared.generation;
+            },
+            [&](uint32_t i) {
+                std::unique_lock lck{mtx};
+                shared = Snapshot{i, i, 87, i};
+            });
+
+        auto message = std::format(L"{} readers: SeqLock {:.0f} reads/s, shared_mutex {:.0f} reads/s", reader_count,
+                                   seqlock_rate, rwlock_rate);
+        Logger::WriteMessage(message.c_str());
+        Assert::IsTrue(seqlock_rate > 0 && rwlock_rate > 0);
+    }
+};
+
+using DX::PipelineBlob;
+using DX::PipelineCache;
+using DX::PipelineLibrary;
+
+class PipelineCacheTests : public TestClass<PipelineCacheTests> {
+    using Cache = PipelineCache<std::string>;
+    using Result = DX::PipelineCompileResult<std::string>;
+
+    /// @brief Fake compiler. Rejects the blob which starts with 0xFF
+    static std::optional<Result> compile(const PipelineBlob* cached, uint32_t& count) {
+        ++count;
+        if (cached == nullptr)
+            return Result{"cold", PipelineBlob(16, std::byte{0x11})};
+        if (cached->empty() || cached->front() == std::byte{0xFF})
+            return std::nullopt;
+        return Result{"warm", *cached};
+    }
+
+  public:
+    TEST_METHOD(TestRoundTrip) {
+        PipelineLibrary library{0xABCD};
+        library.store(1, PipelineBlob(8, std::byte{1}));
+        library.store(2, PipelineBlob(3, std::byte{2}));
+        Assert::IsTrue(library.dirty());
+
+        PipelineLibrary other{0xABCD};
+        Assert::IsTrue(other.deserialize(library.serialize()));
+        Assert::AreEqual(other.size(), size_t{2});
+        Assert::IsFalse(other.dirty());
+        Assert::IsTrue(*other.find(2) == PipelineBlob(3, std::byte{2}));
+    }
+
+    TEST_METHOD(TestSignatureMismatch) {
+        PipelineLibrary library{1};
+        library.store(1, PipelineBlob(8, std::byte{1}));
+        const auto data = library.serialize();
+
+        PipelineLibrary other{2}; // driver was updated
+        Assert::IsFalse(other.deserialize(data));
+        Assert::AreEqual(other.size(), size_t{0});
+        Assert::IsTrue(other.dirty());
+    }
+
+    TEST_METHOD(TestCorruption) {
+        PipelineLibrary library{1};
+        library.store(7, PipelineBlob(8, std::byte{7}));
+        auto data = library.serialize();
+        data.back() = std::byte{0};
+
+        PipelineLibrary other{1};
+        Assert::IsTrue(other.deserialize(data));
+        Assert::IsNull(other.find(7));
+
+        data.resize(data.size() - 4); // truncated
+        Assert::IsTrue(other.deserialize(data));
+        Assert::AreEqual(other.size(), size_t{0});
+    }
+
+    TEST_METHOD(TestWarmColdRejected) {
+        PipelineLibrary library{1};
+        library.store(1, PipelineBlob(4, std::byte{1}));
+        library.store(2, PipelineBlob(4, std::byte{0xFF}));
+        Cache cache{std::move(library)};
+
+        uint32_t count = 0;
+        auto fn = [&count](const PipelineBlob* cached) { return compile(cached, count); };
+        Assert::AreEqual(cache.get_or_create(1, fn), std::string{"warm"});
+        Assert::AreEqual(cache.get_or_create(2, fn), std::string{"cold"});
+        Assert::AreEqual(cache.get_or_create(3, fn), std::string{"cold"});
+        Assert::AreEqual(cache.get_or_create(3, fn), std::string{"cold"});
+        Assert::AreEqual(count, 4u); // the rejected blob is compiled twice
+
+        const auto stats = cache.statistics();
+        Assert::AreEqual(stats.hits, 1u);
+        Assert::AreEqual(stats.warm, 1u);
+        Assert::AreEqual(stats.cold, 2u);
+        Assert::AreEqual(stats.rejected, 1u);
+        Assert::AreEqual(cache.library_size(), size_t{3});
+    }
+
+    TEST_METHOD(TestPrewarmAndSave) {
+        const auto filepath = std::filesystem::temp_directory_path() / L"PipelineCacheTests.bin";
+        uint32_t count = 0;
+        auto fn = [&count](const PipelineBlob* cached) { return compile(cached, count); };
+        {
+            Cache cache{PipelineLibrary{3}};
+            std::vector<std::pair<uint64_t, Cache::CompileFn>> requests{};
+            for (uint64_t key = 0; key < 8; ++key)
+                requests.emplace_back(key, fn);
+            Assert::AreEqual(cache.prewarm(std::move(requests)).get(), size_t{8});
+            cache.save(filepath);
+        }
+        PipelineLibrary library{3};
+        Assert::IsTrue(library.load(filepath));
+        Cache cache{std::move(library)};
+        Assert::AreEqual(cache.get_or_create(5, fn), std::string{"warm"});
+        Assert::AreEqual(cache.statistics().cold, 0u);
+        std::filesystem::remove(filepath);
+    }
+};
+
+using DX::ShaderPack;
+
+/// @see scripts/build-shaders.ps1 for the writer
+class ShaderPackTests : public TestClass<ShaderPackTests> {
+    struct Source {
+        std::string name;
+        uint64_t key;
+        size_t bytecode;
+        size_t reflection;
+    };
+
+    template <typename T>
+    static void write_at(std::vector<std::byte>& output, size_t offset, T value) {
+        std::memcpy(output.data() + offset, &value, sizeof(T));
+    }
+
+    static void append(std::vector<std::byte>& output, size_t size, std::byte value) {
+        output.insert(output.end(), size, value);
+        output.resize((output.size() + 15) / 16 * 16);
+    }
+
+    static std::vector<std::byte> make_pack(const std::vector<Source>& sources) {
+        std::vector<std::byte> output(16 + 32 * sources.size());
+        write_at(output, 0, ShaderPack::magic);
+        write_at(output, 4, ShaderPack::format_version);
+        write_at(output, 8, static_cast<uint32_t>(sources.size()));
+        for (size_t i = 0; i < sources.size(); ++i) {
+            const Source& source = sources[i];
+            const size_t row = 16 + 32 * i;
+            write_at(output, row, source.key);
+            write_at(output, row + 8, static_cast<uint32_t>(output.size()));
+            write_at(output, row + 12, static_cast<uint32_t>(source.name.size()));
+            output.resize(output.size() + source.name.size());
+            std::memcpy(output.data() + output.size() - source.name.size(), source.name.data(), source.name.size());
+            append(output, 0, std::byte{0});
+            write_at(output, row + 16, static_cast<uint32_t>(output.size()));
+            write_at(output, row + 20, static_cast<uint32_t>(source.bytecode));
+            append(output, source.bytecode, std::byte{0xDC});
+            write_at(output, row + 24, static_cast<uint32_t>(output.size()));
+            write_at(output, row + 28, static_cast<uint32_t>(source.reflection));
+            append(output, source.reflection, std::byte{0xEF});
+        }
+        return output;
+    }
+
+  public:
+    TEST_METHOD(TestFind) {
+        ShaderPack pack = ShaderPack::from_bytes(make_pack({
+            {"FullscreenPS", 1, 100, 20},
+            {"FullscreenVS", 2, 64, 0},
+            {"TonemapCS", 3, 48, 8},
+        }));
+        Assert::AreEqual(pack.size(), size_t{3});
+
+        auto vs = pack.find("FullscreenVS");
+        Assert::IsTrue(vs.has_value());
+        Assert::AreEqual(vs->key, uint64_t{2});
+        Assert::AreEqual(vs->bytecode.size(), size_t{64});
+        Assert::IsTrue(vs->reflection.empty());
+        Assert::IsTrue(reinterpret_cast<uintptr_t>(vs->bytecode.data()) % 4 == 0);
+
+        auto cs = pack.find("TonemapCS");
+        Assert::IsTrue(cs.has_value());
+        Assert::IsTrue(cs->bytecode.front() == std::byte{0xDC});
+        Assert::IsTrue(cs->reflection.front() == std::byte{0xEF});
+
+        Assert::IsFalse(pack.find("Fullscreen").has_value());
+        Assert::IsFalse(pack.find("ZZZ").has_value());
+    }
+
+    TEST_METHOD(TestInvalidPack) {
+        auto data = make_pack({{"A", 1, 16, 0}, {"B", 2, 16, 0}});
+        auto check = [](std::vector<std::byte> bytes) {
+            Assert::ExpectException<std::invalid_argument>([&bytes]() { ShaderPack::from_bytes(bytes); });
+        };
+        check(std::vector<std::byte>(8)); // too small
+        {
+            auto bytes = data;
+            bytes[0] = std::byte{0};
+            check(bytes); // magic
+        }
+        {
+            auto bytes = data;
+            bytes.resize(40);
+            check(bytes); // entry table
+        }
+        {
+            auto bytes = data;
+            write_at(bytes, 16 + 20, uint32_t{0x10000}); // bytecode size
+            check(bytes);
+        }
+        check(make_pack({{"B", 1, 16, 0}, {"A", 2, 16, 0}})); // not sorted
+        check(make_pack({{"A", 1, 16, 0}, {"A", 2, 16, 0}})); // duplicated
+    }
+};
+
+using DX::RenderGraph;
+using DX::RenderGraphHandle;
+using DX::ResourceState;
+
+class RenderGraphTests : public TestClass<RenderGraphTests> {
+    static constexpr DX::TextureDesc full{1920, 1080, 87};
+    static constexpr DX::TextureDesc half{960, 540, 10};
+
+    static RenderGraph::ExecuteFn noop() {
+        return nullptr;
+    }
+
+  public:
+    TEST_METHOD(TestCulling) {
+        RenderGraph graph{};
+        DX::RecordingBackend backend{};
+        auto backbuffer = graph.import_texture("BackBuffer", full, nullptr, ResourceState::RenderTarget,
+                                               ResourceState::Common);
+        auto albedo = graph.create_texture("Albedo", full);
+        auto hdr = graph.create_texture("HDR", full);
+        auto debug = graph.create_texture("Debug", half);
+        graph.add_pass("GBuffer", [&](RenderGraph::PassBuilder& builder) { builder.write(albedo); }, noop());
+        graph.add_pass(
+            "Lighting",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.read(albedo);
+                builder.write(hdr);
+            },
+            noop());
+        graph.add_pass(
+            "Debug",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.read(albedo);
+                builder.write(debug); // nobody reads
+            },
+            noop());
+        graph.add_pass(
+            "Tonemap",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.read(hdr);
+                builder.write(backbuffer);
+            },
+            noop());
+
+        const DX::CompiledGraph& compiled = graph.compile(backend);
+        Assert::AreEqual(compiled.culledPassCount, 1u);
+        Assert::IsTrue(compiled.order() == std::vector<uint32_t>{0, 1, 3});
+        Assert::AreEqual(compiled.allocations.size(), size_t{2}); // Debug is not allocated
+        Assert::AreEqual(compiled.finalBarriers.size(), size_t{1});
+    }
+
+    TEST_METHOD(TestSideEffect) {
+        RenderGraph graph{};
+        DX::RecordingBackend backend{};
+        auto capture = graph.create_texture("Capture", half);
+        graph.add_pass("Unused", [&](RenderGraph::PassBuilder& builder) { builder.write(capture); }, noop());
+        graph.add_pass(
+            "Readback",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.write(capture, ResourceState::CopyDest);
+                builder.side_effect();
+            },
+            noop());
+        const DX::CompiledGraph& compiled = graph.compile(backend);
+        Assert::AreEqual(compiled.culledPassCount, 1u);
+        Assert::IsTrue(compiled.order() == std::vector<uint32_t>{1});
+    }
+
+    TEST_METHOD(TestBatchedBarriers) {
+        RenderGraph graph{};
+        DX::RecordingBackend backend{};
+        auto backbuffer = graph.import_texture("BackBuffer", full, nullptr, ResourceState::RenderTarget,
+                                               ResourceState::Common);
+        auto shadow = graph.create_texture("Shadow", half);
+        auto albedo = graph.create_texture("Albedo", full);
+        graph.add_pass(
+            "Shadow", [&](RenderGraph::PassBuilder& builder) { builder.write(shadow, ResourceState::DepthWrite); },
+            noop());
+        graph.add_pass("GBuffer", [&](RenderGraph::PassBuilder& builder) { builder.write(albedo); }, noop());
+        graph.add_pass(
+            "Lighting",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.read(shadow);
+                builder.read(albedo);
+                builder.write(backbuffer);
+            },
+            noop());
+        graph.add_pass(
+            "Copy",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.read(albedo, ResourceState::CopySource);
+                builder.side_effect();
+            },
+            noop());
+
+        const DX::CompiledGraph& compiled = graph.compile(backend);
+        Assert::AreEqual(compiled.levels.size(), size_t{2});
+        Assert::IsTrue(compiled.levels[0].passes == std::vector<uint32_t>{0, 1});
+        Assert::IsTrue(compiled.levels[1].passes == std::vector<uint32_t>{2, 3});
+        // 2 transitions in 1 batch. the read states of Albedo are merged
+        Assert::AreEqual(compiled.levels[1].barriers.size(), size_t{2});
+        Assert::AreEqual(compiled.batch_count(), size_t{2});
+
+        graph.execute(backend);
+        const auto& commands = backend.commands();
+        Assert::AreEqual(commands[3], std::string{"pass Shadow"});
+        Assert::AreEqual(commands[5], std::string{"barrier T1:DepthWrite->ShaderResource "
+                                                  "T2:RenderTarget->ShaderResource|CopySource"});
+        Assert::AreEqual(commands[8], std::string{"barrier T0:RenderTarget->Common"});
+    }
+
+    TEST_METHOD(TestBindImport) {
+        RenderGraph graph{};
+        DX::RecordingBackend backend{};
+        int buffers[2]{};
+        auto backbuffer = graph.import_texture("BackBuffer", full, &buffers[0], ResourceState::RenderTarget,
+                                               ResourceState::Common);
+        auto scene = graph.create_texture("Scene", full);
+        graph.add_pass("Scene", [&](RenderGraph::PassBuilder& builder) { builder.write(scene); }, noop());
+        void* target = nullptr;
+        graph.add_pass(
+            "Composite",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.read(scene);
+                builder.write(backbuffer);
+            },
+            [&](DX::RenderPassContext& context) { target = context.native(backbuffer); });
+
+        graph.execute(backend);
+        Assert::IsTrue(target == &buffers[0]);
+        const std::vector<std::string> first = backend.commands();
+
+        // the next back buffer. the graph is not compiled again
+        backend.clear();
+        graph.bind_import(backbuffer, &buffers[1]);
+        graph.execute(backend);
+        Assert::IsTrue(target == &buffers[1]);
+        Assert::IsTrue(backend.commands() == first);
+
+        Assert::ExpectException<std::invalid_argument>([&]() { graph.bind_import(scene, &buffers[1]); });
+        Assert::ExpectException<std::out_of_range>([&]() { graph.bind_import(DX::RenderGraphHandle{}, nullptr); });
+    }
+
+    TEST_METHOD(TestTransientAliasing) {
+        RenderGraph graph{};
+        DX::RecordingBackend backend{};
+        auto backbuffer = graph.import_texture("BackBuffer", full, nullptr, ResourceState::RenderTarget,
+                                               ResourceState::Common);
+        RenderGraphHandle previous = graph.create_texture("Chain0", full);
+        graph.add_pass("Pass0", [&](RenderGraph::PassBuilder& builder) { builder.write(previous); }, noop());
+        for (int i = 1; i < 5; ++i) {
+            auto next = graph.create_texture("Chain" + std::to_string(i), full);
+            graph.add_pass(
+                "Pass" + std::to_string(i),
+                [&](RenderGraph::PassBuilder& builder) {
+                    builder.read(previous);
+                    builder.write(next);
+                },
+                noop());
+            previous = next;
+        }
+        graph.add_pass(
+            "Present",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.read(previous);
+                builder.write(backbuffer);
+            },
+            noop());
+
+        const DX::CompiledGraph& compiled = graph.compile(backend);
+        const uint64_t size = backend.query(full, ResourceState::RenderTarget).size;
+        Assert::AreEqual(compiled.allocations.size(), size_t{5});
+        Assert::AreEqual(compiled.heapSize, 2 * size); // ping-pong
+        Assert::AreEqual(compiled.allocations[0].offset, compiled.allocations[2].offset);
+        Assert::IsTrue(compiled.levels[2].barriers.front().type == DX::GraphBarrier::Type::Aliasing);
+    }
+
+    TEST_METHOD(TestUnorderedAccess) {
+        RenderGraph graph{};
+        DX::RecordingBackend backend{};
+        auto buffer = graph.create_texture("Histogram", half);
+        for (int i = 0; i < 2; ++i)
+            graph.add_pass(
+                "Accumulate",
+                [&](RenderGraph::PassBuilder& builder) {
+                    builder.write(buffer, ResourceState::UnorderedAccess);
+                    builder.side_effect();
+                },
+                noop());
+        const DX::CompiledGraph& compiled = graph.compile(backend);
+        Assert::AreEqual(compiled.levels.size(), size_t{2});
+        Assert::AreEqual(compiled.levels[1].barriers.size(), size_t{1});
+        Assert::IsTrue(compiled.levels[1].barriers[0].type == DX::GraphBarrier::Type::UnorderedAccess);
+    }
+
+    TEST_METHOD(TestExecute) {
+        RenderGraph graph{};
+        DX::RecordingBackend backend{};
+        int target = 0;
+        auto backbuffer = graph.import_texture("BackBuffer", full, &target, ResourceState::RenderTarget,
+                                               ResourceState::Common);
+        void* received = nullptr;
+        graph.add_pass(
+            "Clear", [&](RenderGraph::PassBuilder& builder) { builder.write(backbuffer); },
+            [&](DX::RenderPassContext& context) { received = context.get<int>(backbuffer); });
+        graph.execute(backend);
+        Assert::IsTrue(received == &target);
+        Assert::IsTrue(backend.commands() == std::vector<std::string>{"heap 0", "pass Clear",
+                                                                      "barrier T0:RenderTarget->Common", "end"});
+        auto wrong = [&](RenderGraph::PassBuilder& builder) { builder.read(backbuffer, ResourceState::RenderTarget); };
+        Assert::ExpectException<std::invalid_argument>([&]() { graph.add_pass("Wrong", wrong, noop()); });
+    }
+};
+
+/// @note Swapchain-less rendering with Shared2. The throughput test is a benchmark. See the output of the test
+class OffscreenTests : public TestClass<OffscreenTests> {
+    static constexpr UINT width = 640;
+    static constexpr UINT height = 360;
+    winrt::com_ptr<IClassFactory> factory = nullptr;
+    winrt::com_ptr<IDeviceResources> resources = nullptr;
+    winrt::com_ptr<IDeviceResourcesFrame> frame = nullptr;
+
+    /// @brief Typical post-processing chain. The last pass writes the imported target
+    static void build_graph(RenderGraph& graph, void* target) {
+        constexpr DX::TextureDesc full{width, height, DXGI_FORMAT_R16G16B16A16_FLOAT};
+        constexpr DX::TextureDesc half{width / 2, height / 2, DXGI_FORMAT_R16G16B16A16_FLOAT};
+        auto output = graph.import_texture("Output", DX::TextureDesc{width, height, DXGI_FORMAT_B8G8R8A8_UNORM},
+                                           target, ResourceState::RenderTarget, ResourceState::Common);
+        auto scene = graph.create_texture("Scene", full);
+        auto bloom = graph.create_texture("Bloom", half);
+        graph.add_pass("Scene", [&](RenderGraph::PassBuilder& builder) { builder.write(scene); }, nullptr);
+        graph.add_pass(
+            "Bloom",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.read(scene);
+                builder.write(bloom);
+            },
+            nullptr);
+        graph.add_pass(
+            "Composite",
+            [&](RenderGraph::PassBuilder& builder) {
+                builder.read(scene);
+                builder.read(bloom);
+                builder.write(output);
+            },
+            nullptr);
+    }
+
+    void render_frame() {
+        Assert::AreEqual(resources->Prepare(D3D12_RESOURCE_STATE_PRESENT), S_OK);
+        winrt::com_ptr<ID3D12GraphicsCommandList> commands = nullptr;
+        Assert::AreEqual(frame->GetCommandList(commands.put()), S_OK);
+        D3D12_CPU_DESCRIPTOR_HANDLE rtv{};
+        Assert::AreEqual(frame->GetRenderTargetView(&rtv), S_OK);
+        const float color[4]{0.1f, 0.2f, 0.3f, 1.0f};
+        commands->ClearRenderTargetView(rtv, color, 0, nullptr);
+        Assert::AreEqual(resources->Present(D3D12_RESOURCE_STATE_RENDER_TARGET), S_OK);
+    }
+
+  public:
+    TEST_METHOD_INITIALIZE(Initialize) {
+        HRESULT hr = ::CreateCustomClassFactory(factory.put());
+        if (FAILED(hr))
+            Assert::Fail(L"CreateCustomClassFactory failed");
+        hr = factory->CreateInstance(nullptr, __uuidof(IDeviceResources), resources.put_void());
+        Assert::AreEqual(hr, S_OK);
+        Assert::AreEqual(resources->InitializeDevice(DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_UNKNOWN, 3,
+                                                     D3D_FEATURE_LEVEL_11_0, DEVICE_RESOURCES_FLAG_OFFSCREEN),
+                         S_OK);
+        Assert::AreEqual(resources->CreateDeviceResources(), S_OK);
+        Assert::AreEqual(resources->CreateWindowSizeDependentResources(width, height), S_OK);
+        frame = resources.as<IDeviceResourcesFrame>();
+    }
+    TEST_METHOD_CLEANUP(Cleanup) {
+        frame = nullptr;
+        if (resources) {
+            resources->WaitForGpu();
+            resources = nullptr;
+        }
+        factory = nullptr;
+    }
+
+    TEST_METHOD(TestNoSwapChain) {
+        winrt::com_ptr<IDXGISwapChain3> swapchain = nullptr;
+        Assert::AreEqual(resources->GetSwapChain(swapchain.put()), E_NOT_VALID_STATE);
+        UINT w = 0, h = 0;
+        Assert::AreEqual(resources->GetOutputSize(&w, &h), S_OK);
+        Assert::AreEqual(w, width);
+        Assert::AreEqual(h, height);
+        BOOL tearing = TRUE;
+        Assert::AreEqual(resources->IsTearingSupported(&tearing), S_OK);
+        Assert::IsFalse(tearing);
+    }
+
+    TEST_METHOD(TestRoundRobin) {
+        winrt::com_ptr<ID3D12Resource> targets[3]{};
+        for (UINT i = 0; i < 6; ++i) {
+            UINT index = UINT_MAX;
+            Assert::AreEqual(frame->GetCurrentFrameIndex(&index), S_OK);
+            Assert::AreEqual(index, i % 3);
+            winrt::com_ptr<ID3D12Resource> target = nullptr;
+            Assert::AreEqual(frame->GetRenderTarget(target.put()), S_OK);
+            if (targets[index] == nullptr)
+                targets[index] = target;
+            Assert::IsTrue(targets[index] == target, L"The textures must be reused");
+            render_frame();
+        }
+        Assert::IsFalse(targets[0] == targets[1] || targets[1] == targets[2]);
+    }
+
+    TEST_METHOD(TestThroughput) {
+        constexpr uint32_t frame_count = 1000;
+        RenderGraph graph{};
+        DX::NullBackend backend{};
+
+        // CPU cost of the graph only
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < frame_count; ++i) {
+            graph.reset();
+            build_graph(graph, nullptr);
+            graph.execute(backend);
+        }
+        const std::chrono::duration<double> graph_elapsed = std::chrono::steady_clock::now() - start;
+
+        // the same graph with the GPU frames. nothing waits for the display
+        start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < frame_count; ++i) {
+            graph.reset();
+            build_graph(graph, nullptr);
+            graph.execute(backend);
+            render_frame();
+        }
+        Assert::AreEqual(resources->WaitForGpu(), S_OK);
+        const std::chrono::duration<double> offscreen_elapsed = std::chrono::steady_clock::now() - start;
+
+        Assert::AreEqual(backend.frame_count(), uint64_t{2 * frame_count});
+        Assert::AreEqual(backend.pass_count(), uint64_t{3 * 2 * frame_count});
+        auto message = std::format(L"{}x{}, {} frames: graph only {:.0f} fps, offscreen {:.0f} fps", width, height,
+                                   frame_count, frame_count / graph_elapsed.count(),
+                                   frame_count / offscreen_elapsed.count());
+        Logger::WriteMessage(message.c_str());
+    }
+};
+
+using DX::CpuReadbackDevice;
+using DX::FrameEncoderPool;
+using DX::ReadbackFrame;
+using DX::ReadbackRing;
+
+/// @note The throughput test is a benchmark with the CPU stand-in device. See the output of the test
+class ReadbackTests : public TestClass<ReadbackTests> {
+    static constexpr uint32_t bgra = 87; // DXGI_FORMAT_B8G8R8A8_UNORM
+
+    static void fill(CpuReadbackDevice& device, uint64_t frameNumber) {
+        std::span<std::byte> pixels = device.source();
+        std::memset(pixels.data(), static_cast<int>(frameNumber & 0xFF), pixels.size());
+    }
+
+  public:
+    TEST_METHOD(TestLatencyAndOrder) {
+        CpuReadbackDevice device{2}; // the GPU is 2 frames behind
+        ReadbackRing ring{device, 3};
+        ring.resize(33, 5, bgra);
+        Assert::AreEqual(ring.layout().rowPitch, 256u);
+
+        std::mutex mtx{};
+        std::vector<uint64_t> received{};
+        bool packed = true;
+        FrameEncoderPool encoders{2, 16, [&](ReadbackFrame& frame) {
+                                      const auto expected = static_cast<std::byte>(frame.frameNumber & 0xFF);
+                                      std::lock_guard lck{mtx};
+                                      packed &= frame.layout.rowPitch == 33 * 4;
+                                      packed &= frame.pixels.size() == 33 * 4 * 5;
+                                      packed &= frame.pixels.back() == expected;
+                                      received.emplace_back(frame.frameNumber);
+                                  }};
+        for (uint64_t i = 0; i < 10; ++i) {
+            // the copy of frame i is completed when frame i + 2 is submitted, and polled in frame i + 3
+            Assert::AreEqual(ring.poll(encoders), i < 3 ? size_t{0} : size_t{1});
+            fill(device, i);
+            Assert::IsTrue(ring.capture(i));
+            ring.submit();
+        }
+        Assert::AreEqual(ring.in_flight(), 3u);
+        device.drain();
+        Assert::AreEqual(ring.poll(encoders), size_t{3});
+        encoders.flush();
+
+        std::sort(received.begin(), received.end());
+        Assert::AreEqual(received.size(), size_t{10});
+        Assert::AreEqual(received.back(), uint64_t{9});
+        Assert::IsTrue(packed, L"The row padding must be removed");
+        Assert::AreEqual(encoders.stats().encoded, uint64_t{10});
+    }
+
+    TEST_METHOD(TestDropWhenFull) {
+        CpuReadbackDevice device{4};
+        ReadbackRing ring{device, 2};
+        ring.resize(16, 16, bgra);
+        FrameEncoderPool encoders{1, 4, [](ReadbackFrame&) {}};
+        uint32_t accepted = 0;
+        for (uint64_t i = 0; i < 12; ++i) {
+            ring.poll(encoders);
+            accepted += ring.capture(i) ? 1 : 0;
+            ring.submit();
+        }
+        const ReadbackRing::Stats stats = ring.stats();
+        Assert::AreEqual(stats.captured, uint64_t{accepted});
+        Assert::AreEqual(stats.captured + stats.dropped, uint64_t{12});
+        Assert::IsTrue(stats.dropped > 0, L"The render loop must not wait for the buffers");
+    }
+
+    TEST_METHOD(TestEncodePng) {
+        ReadbackFrame frame{};
+        frame.layout = DX::ReadbackLayout{2, 2, bgra, 8};
+        frame.pixels.assign(16, std::byte{0x40});
+        frame.pixels[0] = std::byte{0x10}; // B
+        Assert::IsTrue(DX::convert_to_rgba8(frame));
+        Assert::AreEqual(frame.layout.format, 28u); // DXGI_FORMAT_R8G8B8A8_UNORM
+        Assert::IsTrue(frame.pixels[2] == std::byte{0x10});
+
+        const std::vector<std::byte> png = DX::encode_png(frame);
+        const uint8_t signature[8]{0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A};
+        Assert::AreEqual(std::memcmp(png.data(), signature, 8), 0);
+        Assert::AreEqual(std::memcmp(png.data() + 12, "IHDR", 4), 0);
+
+        frame.layout.format = 10; // DXGI_FORMAT_R16G16B16A16_FLOAT
+        Assert::IsFalse(DX::convert_to_rgba8(frame));
+        Assert::ExpectException<std::invalid_argument>([&]() { std::ignore = DX::encode_png(frame); });
+        Assert::AreEqual(DX::encode_raw(frame).size(), size_t{28 + 16});
+    }
+
+    TEST_METHOD(TestThroughput) {
+        constexpr uint64_t frame_count = 240;
+        CpuReadbackDevice device{2};
+        ReadbackRing ring{device, 3};
+        ring.resize(1280, 720, bgra);
+        std::atomic<uint64_t> bytes{0};
+        FrameEncoderPool encoders{(std::max)(2u, std::thread::hardware_concurrency() / 2), 8,
+                                  [&](ReadbackFrame& frame) {
+                                      DX::convert_to_rgba8(frame);
+                                      bytes += DX::encode_png(frame).size();
+                                  }};
+
+        const auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < frame_count; ++i) {
+            ring.poll(encoders);
+            fill(device, i);
+            ring.capture(i);
+            ring.submit();
+        }
+        const std::chrono::duration<double> render_elapsed = std::chrono::steady_clock::now() - start;
+        device.drain();
+        ring.poll(encoders);
+        encoders.flush();
+        const std::chrono::duration<double> total_elapsed = std::chrono::steady_clock::now() - start;
+
+        const ReadbackRing::Stats ring_stats = ring.stats();
+        const FrameEncoderPool::Stats encoder_stats = encoders.stats();
+        Assert::AreEqual(ring_stats.completed, ring_stats.captured);
+        Assert::AreEqual(encoder_stats.encoded + encoder_stats.dropped, ring_stats.completed);
+        const double average_ms = encoder_stats.encoded
+                                      ? std::chrono::duration<double, std::milli>(encoder_stats.totalLatency).count() /
+                                            encoder_stats.encoded
+                                      : 0.0;
+        auto message = std::format(L"1280x720 {} frames: render loop {:.0f} fps, encoded {} ({:.1f} fps, {} MB), "
+                                   L"dropped {}/{}, latency avg {:.2f} ms, max {:.2f} ms",
+                                   frame_count, frame_count / render_elapsed.count(), encoder_stats.encoded,
+                                   encoder_stats.encoded / total_elapsed.count(), bytes.load() >> 20,
+                                   ring_stats.dropped, encoder_stats.dropped, average_ms,
+                                   std::chrono::duration<double, std::milli>(encoder_stats.maxLatency).count());
+        Logger::WriteMessage(message.c_str());
+    }
+};
+
+
+using winrt::App1::AsyncLogOptions;
+using winrt::App1::AsyncLogSink;
+using winrt::App1::LogQueue;
+using winrt::App1::OverflowPolicy;
+
+class LogQueueTests : public TestClass<LogQueueTests> {
+    static std::vector<int> pop_all(LogQueue<int>& queue) {
+        std::vector<int> items{};
+        int item = 0;
+        while (queue.try_pop(item))
+            items.emplace_back(item);
+        return items;
+    }
+
+  public:
+    TEST_METHOD(TestDropNewest) {
+        LogQueue<int> queue{4, OverflowPolicy::DropNewest};
+        for (int i = 0; i < 6; ++i)
+            Assert::AreEqual(queue.push(i), i < 4);
+        Assert::IsTrue(pop_all(queue) == std::vector<int>{0, 1, 2, 3});
+        Assert::AreEqual(queue.stats().dropped, uint64_t{2});
+    }
+
+    TEST_METHOD(TestDropOldest) {
+        LogQueue<int> queue{4, OverflowPolicy::DropOldest};
+        for (int i = 0; i < 6; ++i)
+            Assert::IsTrue(queue.push(i));
+        Assert::IsTrue(pop_all(queue) == std::vector<int>{2, 3, 4, 5});
+        Assert::AreEqual(queue.stats().overwritten, uint64_t{2});
+    }
+
+    TEST_METHOD(TestBlock) {
+        LogQueue<int> queue{4, OverflowPolicy::Block};
+        std::thread producer{[&queue]() {
+            for (int i = 0; i < 1000; ++i)
+                queue.push(i);
+            queue.close();
+        }};
+        std::vector<int> items{};
+        int item = 0;
+        while (true) {
+            while (queue.try_pop(item))
+                items.emplace_back(item);
+            if (queue.closed() && queue.size() == 0)
+                break;
+            queue.wait();
+        }
+        producer.join();
+        Assert::AreEqual(items.size(), size_t{1000});
+        Assert::IsTrue(std::is_sorted(items.begin(), items.end()));
+        Assert::AreEqual(queue.stats().pushed, uint64_t{1000});
+    }
+
+    TEST_METHOD(TestCapacity) {
+        Assert::AreEqual(LogQueue<int>{5, OverflowPolicy::Block}.capacity(), size_t{8});
+        Assert::ExpectException<std::invalid_argument>([]() { LogQueue<int> queue{1, OverflowPolicy::Block}; });
+    }
+};
+
+class AsyncLogSinkTests : public TestClass<AsyncLogSinkTests> {
+    struct Latency {
+        std::chrono::nanoseconds p50{};
+        std::chrono::nanoseconds p99{};
+        std::chrono::nanoseconds max{};
+    };
+
+    /// @brief `thread_count` threads log `count` messages each. Measures each call on the caller side
+    static Latency run_producers(spdlog::logger& logger, uint32_t thread_count, uint32_t count) {
+        std::vector<std::vector<std::chrono::nanoseconds>> samples(thread_count);
+        std::vector<std::thread> threads{};
+        for (uint32_t t = 0; t < thread_count; ++t)
+            threads.emplace_back([&logger, &samples, t, count]() {
+                std::vector<std::chrono::nanoseconds>& durations = samples[t];
+                durations.reserve(count);
+                for (uint32_t i = 0; i < count; ++i) {
+                    const auto start = std::chrono::steady_clock::now();
+                    logger.info("thread {} message {} value {:.3f}", t, i, i * 0.5);
+                    durations.emplace_back(std::chrono::steady_clock::now() - start);
+                }
+            });
+        for (auto& t : threads)
+            t.join();
+
+        std::vector<std::chrono::nanoseconds> all{};
+        for (const auto& durations : samples)
+            all.insert(all.end(), durations.begin(), durations.end());
+        std::sort(all.begin(), all.end());
+        return Latency{all[all.size() / 2], all[all.size() * 99 / 100], all.back()};
+    }
+
+    static size_t count_lines(const std::ostringstream& out) {
+        const std::string text = out.str();
+        return static_cast<size_t>(std::count(text.begin(), text.end(), '\n'));
+    }
+
+  public:
+    TEST_METHOD(TestFlushWritesAll) {
+        std::ostringstream out{};
+        auto sink = std::make_shared<AsyncLogSink>(
+            std::vector<spdlog::sink_ptr>{std::make_shared<spdlog::sinks::ostream_sink_st>(out)},
+            AsyncLogOptions{64, OverflowPolicy::Block});
+        spdlog::logger logger{"async", sink};
+        logger.set_pattern("%v");
+        run_producers(logger, 4, 1000);
+        logger.flush();
+        Assert::AreEqual(count_lines(out), size_t{4000});
+        Assert::AreEqual(sink->stats().pushed, uint64_t{4000});
+    }
+
+    TEST_METHOD(TestDropCounters) {
+        for (OverflowPolicy policy : {OverflowPolicy::DropNewest, OverflowPolicy::DropOldest}) {
+            std::ostringstream out{};
+            auto sink = std::make_shared<AsyncLogSink>(
+                std::vector<spdlog::sink_ptr>{std::make_shared<spdlog::sinks::ostream_sink_st>(out)},
+                AsyncLogOptions{16, policy});
+            spdlog::logger logger{"async", sink};
+            run_producers(logger, 4, 1000);
+            logger.flush();
+            const AsyncLogSink::Stats stats = sink->stats();
+            const uint64_t lost = policy == OverflowPolicy::DropNewest ? stats.dropped : stats.overwritten;
+            Assert::AreEqual(count_lines(out) + lost, size_t{4000});
+        }
+    }
+
+    TEST_METHOD(TestMergeOrder) {
+        std::ostringstream out{};
+        auto sink = std::make_shared<AsyncLogSink>(
+            std::vector<spdlog::sink_ptr>{std::make_shared<spdlog::sinks::ostream_sink_st>(out)},
+            AsyncLogOptions{64, OverflowPolicy::Block});
+        spdlog::logger logger{"async", sink};
+        logger.set_pattern("%v");
+        // the threads take turns, so the sequence is the order of the calls
+        std::mutex mtx{};
+        uint32_t sequence = 0;
+        std::vector<std::thread> threads{};
+        for (uint32_t t = 0; t < 4; ++t)
+            threads.emplace_back([&]() {
+                for (uint32_t i = 0; i < 1000; ++i) {
+                    std::lock_guard lck{mtx};
+                    logger.info("{}", sequence++);
+                }
+            });
+        for (auto& t : threads)
+            t.join();
+        logger.flush();
+
+        std::istringstream lines{out.str()};
+        std::vector<uint32_t> values{};
+        for (uint32_t value = 0; lines >> value;)
+            values.emplace_back(value);
+        Assert::AreEqual(values.size(), size_t{4000});
+        Assert::IsTrue(std::is_sorted(values.begin(), values.end()), L"The queues must be merged in the call order");
+    }
+
+    TEST_METHOD(TestThreadExit) {
+        std::ostringstream out{};
+        auto sink = std::make_shared<AsyncLogSink>(
+            std::vector<spdlog::sink_ptr>{std::make_shared<spdlog::sinks::ostream_sink_st>(out)}, AsyncLogOptions{});
+        spdlog::logger logger{"async", sink};
+        std::thread{[&logger]() { logger.warn("{} exits", "thread"); }}.join();
+        logger.flush();
+        Assert::AreEqual(count_lines(out), size_t{1});
+        Assert::AreEqual(sink->lanes(), size_t{0}, L"The queue of the exited thread must be released");
+        Assert::AreEqual(sink->stats().pushed, uint64_t{1});
+    }
+
+    TEST_METHOD(TestContention) {
+        constexpr uint32_t count = 20000;
+        const uint32_t max_threads = (std::max)(2u, std::thread::hardware_concurrency());
+        auto measure = [](spdlog::logger& logger, uint32_t thread_count) {
+            const auto start = std::chrono::steady_clock::now();
+            run_producers(logger, thread_count, count);
+            logger.flush();
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            return thread_count * count / elapsed.count();
+        };
+        for (uint32_t thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+            // every thread formats and writes under the mutex of the sink
+            spdlog::logger shared_logger{"shared", std::make_shared<spdlog::sinks::null_sink_mt>()};
+            const double shared_rate = measure(shared_logger, thread_count);
+
+            auto sink = std::make_shared<AsyncLogSink>(
+                std::vector<spdlog::sink_ptr>{std::make_shared<spdlog::sinks::null_sink_st>()},
+                AsyncLogOptions{4096, OverflowPolicy::Block});
+            spdlog::logger logger{"async", sink};
+            const double async_rate = measure(logger, thread_count);
+
+            auto message = std::format(L"{} threads: shared sink {:.0f} msg/s, per-thread queues {:.0f} msg/s "
+                                       L"(blocked {})",
+                                       thread_count, shared_rate, async_rate, sink->stats().blocked);
+            Logger::WriteMessage(message.c_str());
+        }
+    }
+
+    TEST_METHOD(TestCallerLatency) {
+        const uint32_t thread_count = (std::max)(2u, std::thread::hardware_concurrency() / 2);
+        constexpr uint32_t count = 20000;
+        auto to_us = [](std::chrono::nanoseconds ns) { return std::chrono::duration<double, std::micro>(ns).count(); };
+
+        std::ostringstream sync_out{};
+        spdlog::logger sync_logger{"sync", std::make_shared<spdlog::sinks::ostream_sink_mt>(sync_out)};
+        const Latency sync = run_producers(sync_logger, thread_count, count);
+        auto message = std::format(L"{} threads x {} messages. sync: p50 {:.2f} us, p99 {:.2f} us, max {:.2f} us",
+                                   thread_count, count, to_us(sync.p50), to_us(sync.p99), to_us(sync.max));
+        Logger::WriteMessage(message.c_str());
+
+        for (OverflowPolicy policy : {OverflowPolicy::Block, OverflowPolicy::DropNewest, OverflowPolicy::DropOldest}) {
+            std::ostringstream out{};
+            auto sink = std::make_shared<AsyncLogSink>(
+                std::vector<spdlog::sink_ptr>{std::make_shared<spdlog::sinks::ostream_sink_st>(out)},
+                AsyncLogOptions{4096, policy});
+            spdlog::logger logger{"async", sink};
+            const Latency async = run_producers(logger, thread_count, count);
+            logger.flush();
+            const AsyncLogSink::Stats stats = sink->stats();
+            message = std::format(L"async({}): p50 {:.2f} us, p99 {:.2f} us, max {:.2f} us, "
+                                  L"blocked {}, dropped {}, overwritten {}",
+                                  static_cast<int>(policy), to_us(async.p50), to_us(async.p99), to_us(async.max),
+                                  stats.blocked, stats.dropped, stats.overwritten);
+            Logger::WriteMessage(message.c_str());
+        }
+    }
+};
+
+using winrt::App1::BufferedLoggingOptions;
+using winrt::Windows::Foundation::Diagnostics::ILoggingChannel;
+using winrt::Windows::Foundation::Diagnostics::LoggingLevel;
+
+class BufferedLoggingChannelTests : public TestClass<BufferedLoggingChannelTests> {
+    static constexpr std::chrono::hours never{1};
+
+  public:
+    TEST_METHOD(TestFlushOnLevel) {
+        std::wostringstream out{};
+        ILoggingChannel channel =
+            winrt::App1::make_buffered_logging_channel(out, BufferedLoggingOptions{4096, never, LoggingLevel::Error});
+        channel.LogMessage(L"a", LoggingLevel::Information);
+        channel.LogValuePair(L"b", 2, LoggingLevel::Warning);
+        Assert::IsTrue(out.str().empty());
+        channel.LogMessage(L"c", LoggingLevel::Error);
+        Assert::AreEqual(out.str(), std::wstring{L"[1] a\n[2] b=2\n[3] c\n"});
+    }
+
+    TEST_METHOD(TestFlushOnSize) {
+        std::wostringstream out{};
+        ILoggingChannel channel =
+            winrt::App1::make_buffered_logging_channel(out, BufferedLoggingOptions{16, never, LoggingLevel::Critical});
+        channel.LogMessage(L"0123456789");
+        Assert::IsTrue(out.str().empty());
+        channel.LogMessage(L"abcdefghij"); // doesn't fit. The first record is written
+        Assert::AreEqual(out.str(), std::wstring{L"0123456789\n"});
+    }
+
+    TEST_METHOD(TestFlushOnInterval) {
+        std::wostringstream out{};
+        ILoggingChannel channel = winrt::App1::make_buffered_logging_channel(
+            out, BufferedLoggingOptions{4096, std::chrono::milliseconds{10}, LoggingLevel::Critical});
+        channel.StartActivity(L"load");
+        Assert::IsTrue(out.str().empty());
+        std::this_thread::sleep_for(std::chrono::milliseconds{20});
+        channel.StopActivity(L"load");
+        Assert::AreEqual(out.str(), std::wstring{L"START: load\nSTOP: load\n"});
+    }
+
+    TEST_METHOD(TestFlushOnShutdown) {
+        std::wostringstream out{};
+        ILoggingChannel channel =
+            winrt::App1::make_buffered_logging_channel(out, BufferedLoggingOptions{4096, never, LoggingLevel::Critical});
+        channel.LogMessage(L"crash", LoggingLevel::Error);
+        Assert::IsTrue(out.str().empty());
+        winrt::App1::flush_logging_channels(); // the crash handlers
+        Assert::AreEqual(out.str(), std::wstring{L"[3] crash\n"});
+
+        channel.LogMessage(L"exit", LoggingLevel::Information);
+        channel = nullptr;
+        Assert::AreEqual(out.str(), std::wstring{L"[3] crash\n[1] exit\n"});
+    }
+
+    TEST_METHOD(TestCopyForAbort) {
+        std::wostringstream out{};
+        ILoggingChannel channel =
+            winrt::App1::make_buffered_logging_channel(out, BufferedLoggingOptions{4096, never, LoggingLevel::Critical});
+        channel.LogMessage(L"caf\u00e9 \U0001F600");
+        auto self = winrt::get_self<winrt::App1::BufferedStreamLoggingChannel>(channel);
+        char buffer[64]{};
+        const size_t count = self->TryCopy(buffer);
+        Assert::AreEqual(std::string_view{buffer, count}, std::string_view{"caf\xC3\xA9 \xF0\x9F\x98\x80\n"});
+        Assert::IsTrue(out.str().empty(), L"SIGABRT must not use the stream");
+
+        // the code point which doesn't fit is dropped
+        Assert::AreEqual(self->TryCopy(std::span{buffer, 7}), size_t{6});
+    }
+
+    TEST_METHOD(TestFlushOtherThreads) {
+        std::wostringstream out{};
+        ILoggingChannel channel = nullptr;
+        std::thread{[&channel, &out]() {
+            channel = winrt::App1::make_buffered_logging_channel(
+                out, BufferedLoggingOptions{4096, never, LoggingLevel::Critical});
+            channel.LogMessage(L"worker", LoggingLevel::Information);
+        }}.join();
+        winrt::App1::flush_logging_channels(); // the hooks are process-wide
+        Assert::AreEqual(out.str(), std::wstring{L"[1] worker\n"});
+    }
+
+    TEST_METHOD(TestFlushInWrite) {
+        // crashes while the records are being written
+        struct CrashingBuffer : public std::wstringbuf {
+            std::streamsize xsputn(const wchar_t* s, std::streamsize n) override {
+                winrt::App1::flush_logging_channels();
+                return std::wstringbuf::xsputn(s, n);
+            }
+        };
+        CrashingBuffer buffer{};
+        std::wostream out{&buffer};
+        ILoggingChannel channel =
+            winrt::App1::make_buffered_logging_channel(out, BufferedLoggingOptions{4096, never, LoggingLevel::Error});
+        channel.LogMessage(L"a", LoggingLevel::Information);
+        channel.LogMessage(L"b", LoggingLevel::Error); // no deadlock, no duplicate
+        Assert::AreEqual(buffer.str(), std::wstring{L"[1] a\n[3] b\n"});
+    }
+
+    TEST_METHOD(TestThroughput) {
+        constexpr uint32_t count = 100000;
+        const auto filepath = std::filesystem::temp_directory_path() / L"BufferedLoggingChannelTests.log";
+        auto measure = [&filepath](auto&& make_channel) {
+            std::wofstream fout{filepath, std::ios::trunc};
+            ILoggingChannel channel = make_channel(fout);
+            const winrt::hstring message = L"frame rendered in 16.6 ms";
+            const auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < count; ++i)
+                channel.LogMessage(message, LoggingLevel::Information);
+            channel = nullptr; // flush
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            return count / elapsed.count();
+        };
+        const double stream_rate = measure([](std::wostream& out) {
+            return winrt::App1::make_stream_logging_channel(out); // flush for each record
+        });
+        const double buffered_rate = measure([](std::wostream& out) {
+            return winrt::App1::make_buffered_logging_channel(out, BufferedLoggingOptions{});
+        });
+        std::filesystem::remove(filepath);
+
+        auto message = std::format(L"{} records to a file: StreamLoggingChannel {:.0f} records/s, "
+                                   L"BufferedStreamLoggingChannel {:.0f} records/s ({:.1f}x)",
+                                   count, stream_rate, buffered_rate, buffered_rate / stream_rate);
+        Logger::WriteMessage(message.c_str());
+        Assert::IsTrue(stream_rate > 0 && buffered_rate > 0);
+    }
+};
+
+using winrt::App1::BinaryLogLevel;
+using winrt::App1::BinaryLogWriter;
+using winrt::App1::DecodedLog;
+
+class BinaryLogTests : public TestClass<BinaryLogTests> {
+    static std::span<const std::byte> as_bytes(const std::string& data) {
+        return {reinterpret_cast<const std::byte*>(data.data()), data.size()};
+    }
+
+  public:
+    TEST_METHOD(TestRoundTrip) {
+        std::ostringstream out{};
+        {
+            BinaryLogWriter writer{out};
+            for (int i = 0; i < 3; ++i)
+                writer.write(BINLOG_ID(BinaryLogLevel::Info, "frame {} in {:.2f} ms"), i, 16.5 + i);
+            writer.write(BINLOG_ID(BinaryLogLevel::Error, "{}: {} ({:#x}) {{retry={}}}"), L"SaveSettings",
+                         std::string{"failed"}, 0x80004005u, false);
+            Assert::AreEqual(writer.event_count(), uint64_t{4});
+        }
+        const std::string data = out.str();
+        const DecodedLog log = winrt::App1::decode_binary_log(as_bytes(data));
+        Assert::AreEqual(log.records.size(), size_t{4});
+        Assert::AreEqual(log.records[2].text, std::string{"frame 2 in 18.50 ms"});
+        Assert::AreEqual(log.records[3].text, std::string{"SaveSettings: failed (0x80004005) {retry=false}"});
+        Assert::IsTrue(log.records[3].level == BinaryLogLevel::Error);
+        Assert::IsTrue(log.records[0].timestamp <= log.records[3].timestamp);
+
+        // the format string is in the stream once
+        size_t count = 0;
+        for (size_t pos = data.find("frame {}"); pos != std::string::npos; pos = data.find("frame {}", pos + 1))
+            ++count;
+        Assert::AreEqual(count, size_t{1});
+    }
+
+    TEST_METHOD(TestTruncated) {
+        std::ostringstream out{};
+        {
+            BinaryLogWriter writer{out};
+            for (int i = 0; i < 3; ++i)
+                writer.write(BINLOG_ID(BinaryLogLevel::Warn, "{} of {}"), i, 3);
+        }
+        std::string data = out.str();
+        data.resize(data.size() - 3); // the writer has crashed in the middle
+        Assert::AreEqual(winrt::App1::decode_binary_log(as_bytes(data)).records.size(), size_t{2});
+
+        data[0] = 'X';
+        Assert::ExpectException<std::invalid_argument>(
+            [&data]() { std::ignore = winrt::App1::decode_binary_log(as_bytes(data)); });
+    }
+
+    TEST_METHOD(TestFormatCost) {
+        constexpr uint32_t count = 200000;
+
+        std::string text{};
+        text.reserve(64 * 1024);
+        size_t text_bytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; ++i) {
+            // the message only. The sinks add the time and the level
+            std::format_to(std::back_inserter(text), "frame {} in {:.2f} ms, {} draws, {} barriers\n", i, i * 0.01,
+                           i % 300, i % 17);
+            if (text.size() >= 64 * 1024) { // like a buffered text sink
+                text_bytes += text.size();
+                text.clear();
+            }
+        }
+        text_bytes += text.size();
+        const std::chrono::duration<double, std::nano> text_elapsed = std::chrono::steady_clock::now() - start;
+
+        std::ostringstream out{};
+        BinaryLogWriter writer{out};
+        start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; ++i)
+            writer.write(BINLOG_ID(BinaryLogLevel::Info, "frame {} in {:.2f} ms, {} draws, {} barriers"), i, i * 0.01,
+                         i % 300, i % 17);
+        writer.flush();
+        const std::chrono::duration<double, std::nano> binary_elapsed = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        const std::string data = out.str();
+        const size_t decoded = winrt::App1::decode_binary_log(as_bytes(data)).records.size();
+        const std::chrono::duration<double> decode_elapsed = std::chrono::steady_clock::now() - start;
+        Assert::AreEqual(decoded, size_t{count});
+
+        auto message = std::format(L"{} records: std::format {:.1f} ns/call {} KB, BinaryLogWriter {:.1f} ns/call {} KB, "
+                                   L"offline decode {:.2f} s",
+                                   count, text_elapsed.count() / count, text_bytes >> 10,
+                                   binary_elapsed.count() / count, writer.size() >> 10, decode_elapsed.count());
+        Logger::WriteMessage(message.c_str());
+    }
+};
+
+using winrt::App1::RotatingFileLog;
+using winrt::App1::RotatingFileOptions;
+
+class RotatingFileLogTests : public TestClass<RotatingFileLogTests> {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / L"RotatingFileLogTests";
+
+    /// @return the segments in the order of the index
+    std::vector<std::filesystem::path> list_segments() const {
+        std::vector<std::filesystem::path> segments{};
+        for (const auto& entry : std::filesystem::directory_iterator{directory})
+            segments.emplace_back(entry.path());
+        std::sort(segments.begin(), segments.end());
+        return segments;
+    }
+
+    static std::string read_all(const std::filesystem::path& path) {
+        std::ifstream fin{path, std::ios::binary};
+        return std::string{std::istreambuf_iterator<char>{fin}, std::istreambuf_iterator<char>{}};
+    }
+
+  public:
+    TEST_METHOD_INITIALIZE(Initialize) {
+        std::filesystem::remove_all(directory);
+    }
+
+    TEST_METHOD_CLEANUP(Cleanup) {
+        std::error_code ec{};
+        std::filesystem::remove_all(directory, ec);
+    }
+
+    TEST_METHOD(TestRotation) {
+        {
+            RotatingFileLog log{RotatingFileOptions{directory, "Test", 4096, 3, std::chrono::milliseconds{10}}};
+            for (uint32_t i = 0; i < 2000; ++i) {
+                const std::string text = std::format("record {:04}\n", i);
+                // the caller may retry while the next segment is prepared
+                while (log.write(text) == false)
+                    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+            }
+            Assert::IsTrue(log.stats().rotations >= 5);
+            Assert::AreEqual(log.stats().written, uint64_t{2000 * 12});
+        }
+        const auto segments = list_segments();
+        Assert::IsTrue(segments.size() <= 3, L"The oldest segments must be removed");
+        std::string text{};
+        for (const auto& segment : segments) {
+            Assert::IsTrue(std::filesystem::file_size(segment) <= 4096);
+            text += read_all(segment);
+        }
+        Assert::IsTrue(text.find('\0') == std::string::npos, L"The unused tail must be cut");
+        Assert::IsTrue(text.ends_with("record 1999\n"));
+        // the records are consecutive across the segments
+        uint32_t expected = 2000 - static_cast<uint32_t>(text.size() / 12);
+        for (size_t offset = 0; offset < text.size(); offset += 12, ++expected)
+            Assert::AreEqual(text.substr(offset, 12), std::format("record {:04}\n", expected));
+    }
+
+    TEST_METHOD(TestContinueIndex) {
+        const RotatingFileOptions options{directory, "Test", 4096, 4, std::chrono::milliseconds{10}};
+        {
+            RotatingFileLog log{options};
+            Assert::IsTrue(log.write("first run\n"));
+        }
+        {
+            RotatingFileLog log{options};
+            Assert::IsTrue(log.write("second run\n"));
+        }
+        const auto segments = list_segments();
+        Assert::AreEqual(segments.size(), size_t{2}, L"The preallocated segment must be removed");
+        Assert::AreEqual(segments[0].filename().string(), std::string{"Test.000001.log"});
+        Assert::AreEqual(read_all(segments[0]), std::string{"first run\n"});
+        Assert::AreEqual(read_all(segments[1]), std::string{"second run\n"});
+    }
+
+    TEST_METHOD(TestDropWithoutBlocking) {
+        RotatingFileLog log{RotatingFileOptions{directory, "Test", 4096, 2}};
+        Assert::IsFalse(log.write(std::string(8192, 'x')), L"The record is larger than the segment");
+        Assert::AreEqual(log.stats().dropped, uint64_t{1});
+        Assert::ExpectException<std::invalid_argument>([this]() {
+            RotatingFileLog invalid{RotatingFileOptions{directory, "Test", 4096, 1}};
+        });
+    }
+
+    TEST_METHOD(TestWriteLatency) {
+        RotatingFileLog log{RotatingFileOptions{directory, "Bench", 1 << 20, 4}};
+        const std::string text(100, 'x');
+        std::vector<int64_t> latencies(200000);
+        for (int64_t& latency : latencies) {
+            const auto start = std::chrono::steady_clock::now();
+            log.write(text);
+            latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
+                          .count();
+        }
+        std::sort(latencies.begin(), latencies.end());
+        const auto stats = log.stats();
+        auto message = std::format(L"write: p50 {} ns, p99 {} ns, max {} ns, rotations {}, dropped {}",
+                                   latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100],
+                                   latencies.back(), stats.rotations, stats.dropped);
+        Logger::WriteMessage(message.c_str());
+    }
+};
+
+using winrt::App1::LogBlockInfo;
+using winrt::App1::LogQuery;
+
+class LogArchiveTests : public TestClass<LogArchiveTests> {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / L"LogArchiveTests";
+
+    /// @brief The text of RotatingFileSink. 1 record for each 10 ms, and a multi-line record for each 100
+    static std::string make_segment(uint32_t count) {
+        static constexpr std::string_view channels[]{"App1.Core", "App1.ViewModel", "App1.DX", "App"};
+        std::string text{};
+        for (uint32_t i = 0; i < count; ++i) {
+            const auto time = std::chrono::sys_days{std::chrono::year{2025} / 3 / 1} + std::chrono::seconds{i / 100};
+            std::format_to(std::back_inserter(text), "{:%Y-%m-%d %H:%M:%S}.{:03} [{}] [{}] 1234 record {}\n", time,
+                           i % 100 * 10, "TDIWEC"[i % 6], channels[i % 4], i);
+            if (i % 100 == 0)
+                text += "channel,level,messages,bytes\nApp1.DX,info,1,2\n";
+        }
+        return text;
+    }
+
+    static void write_all(const std::filesystem::path& path, std::string_view text) {
+        std::ofstream fout{path, std::ios::binary | std::ios::trunc};
+        fout.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+
+  public:
+    TEST_METHOD_INITIALIZE(Initialize) {
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+    }
+
+    TEST_METHOD_CLEANUP(Cleanup) {
+        std::error_code ec{};
+        std::filesystem::remove_all(directory, ec);
+    }
+
+    TEST_METHOD(TestParse) {
+        const auto header = winrt::App1::parse_log_record("2025-03-01 00:00:01.250 [W] [App1.DX] 1234 lost\n");
+        Assert::IsTrue(header.has_value());
+        Assert::AreEqual(header->time, int64_t{1740787201250});
+        Assert::AreEqual(header->level, uint8_t{3});
+        Assert::IsTrue(header->channel == winrt::App1::LogChannel::DX);
+        // without the logger name
+        Assert::IsTrue(winrt::App1::parse_log_record("2025-03-01 00:00:01.250 [E] 1234 failed")->channel ==
+                       winrt::App1::LogChannel::Core);
+        Assert::IsFalse(winrt::App1::parse_log_record("App1.DX,info,1,2").has_value());
+        Assert::IsFalse(winrt::App1::parse_log_record("2025-02-30 00:00:01.250 [I] invalid date").has_value());
+        Assert::AreEqual(winrt::App1::parse_log_time("2025-03-01T00:00:01").value(), int64_t{1740787201000});
+    }
+
+    TEST_METHOD(TestQuery) {
+        const std::string text = make_segment(20000);
+        const auto segment = directory / "Test.000001.log";
+        write_all(segment, text);
+        auto start = std::chrono::steady_clock::now();
+        const auto archive = winrt::App1::compress_log_segment(segment, 16 * 1024);
+        const std::chrono::duration<double, std::milli> compress_elapsed = std::chrono::steady_clock::now() - start;
+        const std::vector<LogBlockInfo> blocks = winrt::App1::read_log_index(archive);
+        Assert::IsTrue(blocks.size() > 10);
+
+        // 1 second of the errors from App1.DX
+        LogQuery query{};
+        query.from = winrt::App1::parse_log_time("2025-03-01 00:01:00.000").value();
+        query.to = winrt::App1::parse_log_time("2025-03-01 00:01:00.999").value();
+        query.levels = 1u << 4;
+        query.channels = 1u << static_cast<uint8_t>(winrt::App1::LogChannel::DX);
+        std::string found{};
+        start = std::chrono::steady_clock::now();
+        const auto stats = winrt::App1::query_log_archive(archive, query, [&found](std::string_view record) {
+            found += record;
+        });
+        const std::chrono::duration<double, std::milli> query_elapsed = std::chrono::steady_clock::now() - start;
+        Assert::IsTrue(stats.decompressed < 3, L"Only the blocks in the time range must be read");
+
+        // same as the scan of the text
+        std::string expected{};
+        for (size_t offset = 0; offset < text.size();) {
+            const size_t end = text.find('\n', offset) + 1;
+            const std::string_view line{text.data() + offset, end - offset};
+            if (const auto header = winrt::App1::parse_log_record(line); header && query.matches(*header))
+                expected += line;
+            offset = end;
+        }
+        Assert::AreEqual(stats.records, size_t{8});
+        Assert::AreEqual(found, expected);
+
+        // all records with the continuation lines
+        std::string all{};
+        winrt::App1::query_log_archive(archive, LogQuery{}, [&all](std::string_view record) { all += record; });
+        Assert::AreEqual(all, text);
+
+        const auto stored = std::filesystem::file_size(archive) + std::filesystem::file_size(archive.parent_path() /
+                                                                                              "Test.000001.idx");
+        auto message = std::format(L"{} KB to {} KB in {:.1f} ms, {} blocks. query {:.2f} ms, {} blocks read",
+                                   text.size() >> 10, stored >> 10, compress_elapsed.count(), blocks.size(),
+                                   query_elapsed.count(), stats.decompressed);
+        Logger::WriteMessage(message.c_str());
+    }
+
+    TEST_METHOD(TestRotation) {
+        {
+            RotatingFileOptions options{directory, "Test", 16 * 1024, 16, std::chrono::milliseconds{10}};
+            options.compress = true;
+            RotatingFileLog log{options};
+            const std::string text = make_segment(2000);
+            for (size_t offset = 0; offset < text.size();) {
+                const size_t end = text.find('\n', offset) + 1;
+                while (log.write(std::string_view{text}.substr(offset, end - offset)) == false)
+                    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+                offset = end;
+            }
+        }
+        // the last segment is compressed in the next run
+        RotatingFileOptions options{directory, "Test", 16 * 1024, 16, std::chrono::milliseconds{10}};
+        options.compress = true;
+        {
+            RotatingFileLog log{options};
+            // the compressor is in the background priority. Wait until only the current segment is the text
+            auto count_segments = [this]() {
+                size_t count = 0;
+                for (const auto& entry : std::filesystem::directory_iterator{directory})
+                    count += entry.path().extension() == ".log";
+                return count;
+            };
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+            while (count_segments() > 1 && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::sleep_for(std::chrono::milliseconds{10});
+            Assert::IsTrue(log.stats().compressed >= 1);
+        }
+        size_t archives = 0, segments = 0, records = 0;
+        for (const auto& entry : std::filesystem::directory_iterator{directory}) {
+            if (entry.path().extension() == ".log") {
+                ++segments;
+            } else if (entry.path().extension() == ".lz4") {
+                ++archives;
+                const auto stats = winrt::App1::query_log_archive(entry.path(), LogQuery{}, [](std::string_view) {});
+                records += stats.records;
+            }
+        }
+        Assert::AreEqual(segments, size_t{1}, L"The segment of the last run stays as the text");
+        Assert::IsTrue(archives >= 2);
+        Assert::IsTrue(records > 0 && records <= 2000);
+    }
+};
+
+using winrt::App1::LogRateLimit;
+using winrt::App1::LogSampler;
+using winrt::App1::LogSite;
+
+class LogLimitTests : public TestClass<LogLimitTests> {
+  public:
+    TEST_METHOD(TestRateLimit) {
+        LogRateLimit site{"Shared1/LogLimit.cpp", 10, 2, 10.0, 3};
+        Assert::AreEqual(site.file(), std::string_view{"LogLimit.cpp"});
+        constexpr int64_t start = 1'000'000'000;
+        uint32_t passed = 0;
+        for (int i = 0; i < 5; ++i)
+            passed += site.acquire(start);
+        Assert::AreEqual(passed, 3u, L"The burst must pass at once");
+        // 1 token after 100 ms
+        Assert::IsTrue(site.acquire(start + 100'000'000));
+        Assert::IsFalse(site.acquire(start + 100'000'000));
+        Assert::AreEqual(site.take_suppressed(), uint64_t{3});
+        Assert::AreEqual(site.take_suppressed(), uint64_t{0});
+        // the bucket is full again
+        passed = 0;
+        for (int i = 0; i < 5; ++i)
+            passed += site.acquire(start + 10'000'000'000);
+        Assert::AreEqual(passed, 3u);
+    }
+
+    TEST_METHOD(TestSampler) {
+        LogSampler site{"LogLimit.cpp", 20, 2, 4};
+        uint32_t passed = 0;
+        for (int i = 0; i < 10; ++i)
+            passed += site.acquire();
+        Assert::AreEqual(passed, 3u);
+        Assert::AreEqual(site.take_suppressed(), uint64_t{7});
+    }
+
+    TEST_METHOD(TestMacroDoesNotFormat) {
+        std::ostringstream out{};
+        spdlog::logger logger{"sampled", std::make_shared<spdlog::sinks::ostream_sink_st>(out)};
+        logger.set_pattern("%v");
+        uint32_t evaluated = 0;
+        for (int i = 0; i < 100; ++i)
+            LOG_SAMPLED(&logger, spdlog::level::info, 10, "{}", ++evaluated);
+        Assert::AreEqual(evaluated, 10u, L"The suppressed calls must not evaluate the arguments");
+        for (int i = 0; i < 100; ++i)
+            LOG_RATE_LIMITED(&logger, spdlog::level::debug, 1000, 1000, "{}", ++evaluated);
+        Assert::AreEqual(evaluated, 10u, L"The disabled level must not take the tokens");
+
+        uint64_t suppressed = 0;
+        winrt::App1::report_suppressed_logs([&suppressed](const LogSite& site, uint64_t count) {
+            if (site.file() == "UnitTests.cpp")
+                suppressed += count;
+        });
+        Assert::AreEqual(suppressed, uint64_t{90});
+    }
+
+    TEST_METHOD(TestSuppressedCost) {
+        constexpr uint32_t count = 1'000'000;
+        std::ostringstream out{};
+        spdlog::logger logger{"chatty", std::make_shared<spdlog::sinks::ostream_sink_st>(out)};
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; ++i) {
+            logger.info("size ({:.2f},{:.2f})", 1280.0f + i, 720.0f);
+            if (out.tellp() > 1 << 20)
+                out.str({});
+        }
+        const std::chrono::duration<double, std::nano> plain = std::chrono::steady_clock::now() - start;
+        start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; ++i)
+            LOG_RATE_LIMITED(&logger, spdlog::level::info, 2, 4, "size ({:.2f},{:.2f})", 1280.0f + i, 720.0f);
+        const std::chrono::duration<double, std::nano> limited = std::chrono::steady_clock::now() - start;
+        auto message = std::format(L"plain {:.1f} ns/call, rate limited {:.1f} ns/call", plain.count() / count,
+                                   limited.count() / count);
+        Logger::WriteMessage(message.c_str());
+    }
+};
+
+using winrt::App1::LogChannel;
+using winrt::App1::LogCountersSnapshot;
+
+class LogCountersTests : public TestClass<LogCountersTests> {
+  public:
+    TEST_METHOD(TestChannelName) {
+        Assert::IsTrue(winrt::App1::find_log_channel("App1.DX") == LogChannel::DX);
+        Assert::IsTrue(winrt::App1::find_log_channel("App") == LogChannel::Core);
+        Assert::AreEqual(winrt::App1::to_string(LogChannel::Persistence), std::string_view{"App1.Persistence"});
+    }
+
+    TEST_METHOD(TestAggregateOnRead) {
+        const LogCountersSnapshot before = winrt::App1::snapshot_log_counters();
+        std::vector<std::thread> threads{};
+        for (int t = 0; t < 4; ++t)
+            threads.emplace_back([]() {
+                for (int i = 0; i < 1000; ++i)
+                    winrt::App1::count_log(LogChannel::ViewModel, 2, 10);
+                winrt::App1::count_log(LogChannel::ViewModel, 6, 10); // off
+            });
+        for (auto& t : threads)
+            t.join();
+        winrt::App1::count_log(LogChannel::Persistence, 4, 25);
+
+        const LogCountersSnapshot diff = winrt::App1::snapshot_log_counters() - before;
+        Assert::AreEqual(diff.at(LogChannel::ViewModel, 2).messages, uint64_t{4000},
+                         L"The exited threads must be kept in the totals");
+        Assert::AreEqual(diff.at(LogChannel::ViewModel, 2).bytes, uint64_t{40000});
+        Assert::AreEqual(diff.total(LogChannel::ViewModel).messages, uint64_t{4000});
+        Assert::AreEqual(diff.total(LogChannel::Persistence).bytes, uint64_t{25});
+
+        const std::string csv = winrt::App1::export_log_counters(diff);
+        Assert::IsTrue(csv.starts_with("channel,level,messages,bytes\n"));
+        Assert::IsTrue(csv.find("App1.ViewModel,info,4000,40000\n") != std::string::npos);
+        Assert::IsTrue(csv.find("App1.Persistence,error,1,25\n") != std::string::npos);
+    }
+
+    TEST_METHOD(TestChannelLoggers) {
+        std::ostringstream out{};
+        const winrt::App1::ChannelLoggers loggers =
+            winrt::App1::make_channel_loggers({std::make_shared<spdlog::sinks::ostream_sink_st>(out)});
+        spdlog::logger& viewmodel = *loggers[static_cast<size_t>(LogChannel::ViewModel)];
+        spdlog::logger& dx = *loggers[static_cast<size_t>(LogChannel::DX)];
+        viewmodel.set_pattern("[%n] %v");
+
+        const LogCountersSnapshot before = winrt::App1::snapshot_log_counters();
+        viewmodel.info("{} items", 3);
+        dx.error("device removed");
+        dx.error("device removed");
+        const LogCountersSnapshot diff = winrt::App1::snapshot_log_counters() - before;
+
+        Assert::AreEqual(diff.at(LogChannel::ViewModel, 2).messages, uint64_t{1});
+        Assert::AreEqual(diff.at(LogChannel::ViewModel, 2).bytes, uint64_t{7});
+        Assert::AreEqual(diff.at(LogChannel::DX, 4).messages, uint64_t{2});
+        Assert::AreEqual(diff.at(LogChannel::DX, 4).bytes, uint64_t{28});
+        Assert::AreEqual(diff.total(LogChannel::Core).messages, uint64_t{0});
+        Assert::AreEqual(out.str(), std::string{"[App1.ViewModel] 3 items\n[App1.DX] device removed\n"
+                                                "[App1.DX] device removed\n"});
+    }
+
+    TEST_METHOD(TestCountCost) {
+        constexpr uint32_t count = 2'000'000;
+        const uint32_t max_threads = (std::max)(2u, std::thread::hardware_concurrency());
+        auto run = [](uint32_t thread_count, auto&& fn) {
+            std::vector<std::thread> threads{};
+            const auto start = std::chrono::steady_clock::now();
+            for (uint32_t t = 0; t < thread_count; ++t)
+                threads.emplace_back([&fn]() {
+                    for (uint32_t i = 0; i < count; ++i)
+                        fn();
+                });
+            for (auto& t : threads)
+                t.join();
+            const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            return elapsed.count() / count;
+        };
+        for (uint32_t thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+            // the shared counters which every thread increments
+            std::atomic<uint64_t> messages{0}, bytes{0};
+            const double shared = run(thread_count, [&]() {
+                messages.fetch_add(1, std::memory_order_relaxed);
+                bytes.fetch_add(64, std::memory_order_relaxed);
+            });
+            const double local = run(thread_count, []() { winrt::App1::count_log(LogChannel::DX, 1, 64); });
+            auto message = std::format(L"{} threads: shared atomic {:.2f} ns/call, per-thread {:.2f} ns/call",
+                                       thread_count, shared, local);
+            Logger::WriteMessage(message.c_str());
+        }
+    }
+};
+
+using winrt::App1::FilteringLoggingChannel;
+using winrt::App1::LoggingFilter;
+
+class FilteringLoggingChannelTests : public TestClass<FilteringLoggingChannelTests> {
+    using LoggingLevel = winrt::Windows::Foundation::Diagnostics::LoggingLevel;
+    using ILoggingChannel = winrt::Windows::Foundation::Diagnostics::ILoggingChannel;
+
+  public:
+    TEST_METHOD(TestLevel) {
+        std::wostringstream out{};
+        auto channel = winrt::App1::make_filtering_logging_channel(winrt::App1::make_stream_logging_channel(out),
+                                                                   LoggingLevel::Warning);
+        ILoggingChannel logging = channel.as<ILoggingChannel>();
+        logging.LogMessage(L"info", LoggingLevel::Information);
+        logging.LogValuePair(L"count", 1);
+        logging.LogMessage(L"warn", LoggingLevel::Warning);
+        Assert::AreEqual(out.str(), std::wstring{L"[2] warn\n"});
+        Assert::IsTrue(logging.Level() == LoggingLevel::Warning);
+
+        channel->Filter().SetLevel(LoggingLevel::Verbose);
+        logging.LogValuePair(L"count", 2);
+        Assert::AreEqual(out.str(), std::wstring{L"[2] warn\ncount=2\n"});
+        Assert::IsTrue(logging.Level() == LoggingLevel::Verbose);
+    }
+
+    TEST_METHOD(TestKeywords) {
+        std::wostringstream out{};
+        auto channel = winrt::App1::make_filtering_logging_channel(winrt::App1::make_stream_logging_channel(out),
+                                                                   LoggingLevel::Verbose);
+        LoggingFilter& filter = channel->Filter();
+        filter.DisableKeywords(0b10);
+        Assert::AreEqual(filter.Keywords(), LoggingFilter::all_keywords & ~uint64_t{0b10});
+
+        uint32_t evaluated = 0;
+        LOGGING_CHANNEL_MESSAGE(*channel, LoggingLevel::Error, 0b10, L"{}", ++evaluated);
+        LOGGING_CHANNEL_MESSAGE(*channel, LoggingLevel::Error, 0b11, L"{}", ++evaluated);
+        Assert::AreEqual(evaluated, 0u, L"The disabled record must not evaluate the arguments");
+        LOGGING_CHANNEL_MESSAGE(*channel, LoggingLevel::Error, 0b01, L"{}", ++evaluated);
+        filter.EnableKeywords(0b10);
+        winrt::App1::log_message(*channel, LoggingLevel::Error, 0b11, L"{}", ++evaluated);
+        Assert::AreEqual(out.str(), std::wstring{L"[3] 1\n[3] 2\n"});
+    }
+
+    TEST_METHOD(TestKeywordRange) {
+        LoggingFilter filter{LoggingLevel::Verbose};
+        constexpr uint64_t last = uint64_t{1} << (LoggingFilter::keyword_count - 1);
+        Assert::IsTrue(filter.IsEnabled(LoggingLevel::Error, last));
+        for (uint32_t bit = LoggingFilter::keyword_count; bit < 64; ++bit) {
+            const uint64_t keyword = uint64_t{1} << bit;
+            filter.EnableKeywords(keyword);
+            Assert::IsFalse(filter.IsEnabled(LoggingLevel::Error, keyword), L"The keyword has no bit in the filter");
+            Assert::IsFalse(filter.IsEnabled(LoggingLevel::Error, keyword | 0b1));
+        }
+        Assert::AreEqual(filter.Keywords(), LoggingFilter::all_keywords);
+    }
+
+    TEST_METHOD(TestDisabledCost) {
+        constexpr uint32_t count = 1'000'000;
+        auto channel =
+            winrt::App1::make_filtering_logging_channel(winrt::App1::make_null_logging_channel(), LoggingLevel::Warning);
+        ILoggingChannel logging = channel.as<ILoggingChannel>();
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; ++i)
+            logging.LogMessage(winrt::hstring{std::format(L"size {}x{}", i, i)}, LoggingLevel::Verbose);
+        const std::chrono::duration<double, std::nano> eager = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; ++i)
+            LOGGING_CHANNEL_MESSAGE(*channel, LoggingLevel::Verbose, 0, L"size {}x{}", i, i);
+        const std::chrono::duration<double, std::nano> checked = std::chrono::steady_clock::now() - start;
+
+        auto message = std::format(L"disabled record: message built {:.2f} ns/call, checked first {:.2f} ns/call",
+                                   eager.count() / count, checked.count() / count);
+        Logger::WriteMessage(message.c_str());
+    }
+};
+
+using winrt::App1::FormatBuffer;
+using winrt::App1::WFormatBuffer;
+
+/**
+ * @brief Counts the CRT heap allocations of the current thread while it is alive
+ * @details The allocation hook is installed for the scope only, so the other tests and threads are not affected.
+ *          It sees `operator new` and `malloc` of all modules on the CRT, including spdlog.
+ *          The HSTRING is allocated with HeapAlloc, which the hook doesn't see. See `ReferenceCheckChannel` for it
+ * @note The hook exists in the debug CRT only. `count` is always 0 in the Release build
+ */
+class AllocationScope final {
+    static thread_local size_t t_count;
+    static thread_local bool t_counting;
+    static _CRT_ALLOC_HOOK s_previous;
+
+    static int __cdecl hook(int type, void* data, size_t size, int block, long request, const unsigned char* file,
+                            int line) {
+        if (t_counting && block != _CRT_BLOCK && (type == _HOOK_ALLOC || type == _HOOK_REALLOC))
+            ++t_count;
+        return s_previous ? s_previous(type, data, size, block, request, file, line) : TRUE;
+    }
+
+  public:
+#if defined(_DEBUG)
+    static constexpr bool available = true;
+#else
+    static constexpr bool available = false;
+#endif
+
+    AllocationScope() noexcept {
+        t_count = 0;
+        t_counting = true;
+        s_previous = _CrtSetAllocHook(&AllocationScope::hook);
+    }
+    ~AllocationScope() noexcept {
+        _CrtSetAllocHook(s_previous);
+        t_counting = false;
+    }
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+
+    size_t count() const noexcept {
+        return t_count;
+    }
+};
+
+thread_local size_t AllocationScope::t_count = 0;
+thread_local bool AllocationScope::t_counting = false;
+_CRT_ALLOC_HOOK AllocationScope::s_previous = nullptr;
+
+/**
+ * @brief Counts the messages which are not the fast-pass HSTRING references
+ * @details A fast-pass reference points to the caller's text. The other messages were copied to the heap
+ */
+struct ReferenceCheckChannel
+    : winrt::implements<ReferenceCheckChannel, winrt::Windows::Foundation::Diagnostics::ILoggingChannel> {
+    using ILoggingChannel = winrt::Windows::Foundation::Diagnostics::ILoggingChannel;
+    using LoggingLevel = winrt::Windows::Foundation::Diagnostics::LoggingLevel;
+    using LoggingOptions = winrt::Windows::Foundation::Diagnostics::LoggingOptions;
+
+    mutable size_t messages = 0;
+    mutable size_t copies = 0;
+
+    void check(winrt::hstring const& message) const noexcept {
+        ++messages;
+        auto header = static_cast<const winrt::impl::hstring_header*>(winrt::get_abi(message));
+        if (header == nullptr || (header->flags & winrt::impl::hstring_reference_flag) == 0)
+            ++copies;
+    }
+
+    void LogMessage(winrt::hstring const& message) const noexcept {
+        check(message);
+    }
+    void LogMessage(winrt::hstring const& message, LoggingLevel) const noexcept {
+        check(message);
+    }
+    void LogMessage(winrt::hstring const& message, LoggingLevel, LoggingOptions const&) const noexcept {
+        check(message);
+    }
+    void LogValuePair(winrt::hstring const&, int32_t) const noexcept {
+    }
+    void LogValuePair(winrt::hstring const&, int32_t, LoggingLevel) const noexcept {
+    }
+    void StartActivity(winrt::hstring const&) const noexcept {
+    }
+    void StopActivity(winrt::hstring const&) const noexcept {
+    }
+
+    winrt::hstring Name() const noexcept {
+        return L"ReferenceCheck";
+    }
+    bool Enabled() const noexcept {
+        return true;
+    }
+    LoggingLevel Level() const noexcept {
+        return LoggingLevel::Verbose;
+    }
+
+    winrt::event_token LoggingEnabled(
+        winrt::Windows::Foundation::TypedEventHandler<ILoggingChannel, winrt::Windows::Foundation::IInspectable> const&)
+        const noexcept {
+        return {};
+    }
+    void LoggingEnabled(winrt::event_token const&) const noexcept {
+    }
+};
+
+class FormatBufferTests : public TestClass<FormatBufferTests> {
+    using LoggingLevel = winrt::Windows::Foundation::Diagnostics::LoggingLevel;
+    using ILoggingChannel = winrt::Windows::Foundation::Diagnostics::ILoggingChannel;
+
+  public:
+    TEST_METHOD(TestInline) {
+        const std::wstring full(WFormatBuffer::inline_capacity(), L'a');
+        WFormatBuffer buffer{};
+        Assert::IsTrue(buffer.empty());
+        Assert::AreEqual(buffer.c_str(), L"");
+
+        AllocationScope allocations{};
+        Assert::IsTrue(buffer.format(L"size {}x{} {}", 1920, 1080, std::wstring_view{L"px"}) == L"size 1920x1080 px");
+        Assert::AreEqual(allocations.count(), size_t{0});
+        Assert::IsFalse(buffer.spilled());
+        Assert::AreEqual(buffer.c_str(), L"size 1920x1080 px");
+
+        // exactly the inline capacity
+        Assert::IsTrue(buffer.format(L"{}", std::wstring_view{full}) == full);
+        Assert::AreEqual(allocations.count(), size_t{0});
+        Assert::IsFalse(buffer.spilled());
+        Assert::AreEqual(buffer.c_str()[full.size()], L'\0');
+
+        buffer.clear();
+        Assert::IsTrue(buffer.empty());
+    }
+
+    TEST_METHOD(TestSpill) {
+        const std::string text(FormatBuffer::inline_capacity() * 3, 'b');
+        const std::string expected = "[" + text + "]";
+        FormatBuffer buffer{};
+        {
+            AllocationScope allocations{};
+            Assert::IsTrue(buffer.format("[{}]", text) == expected);
+            if (AllocationScope::available)
+                Assert::AreEqual(allocations.count(), size_t{1});
+        }
+        Assert::IsTrue(buffer.spilled());
+        Assert::AreEqual(buffer.size(), expected.size());
+        Assert::AreEqual(buffer.c_str()[buffer.size()], '\0');
+
+        // the heap memory is reused, and the short message goes back to the inline array
+        AllocationScope allocations{};
+        Assert::IsTrue(buffer.format("{}", std::string_view{text}.substr(1)) == std::string_view{text}.substr(1));
+        Assert::IsTrue(buffer.format("short {}", 1) == "short 1");
+        Assert::AreEqual(allocations.count(), size_t{0});
+        Assert::IsFalse(buffer.spilled());
+    }
+
+    TEST_METHOD(TestNoAllocation) {
+        auto inner = winrt::make_self<ReferenceCheckChannel>();
+        auto channel = winrt::App1::make_filtering_logging_channel(inner.as<ILoggingChannel>(),
+                                                                   LoggingLevel::Information);
+        ILoggingChannel logging = channel.as<ILoggingChannel>();
+        spdlog::logger logger{"format", std::make_shared<spdlog::sinks::null_sink_mt>()};
+        const winrt::hstring name{L"MainWindow"};
+
+        AllocationScope allocations{};
+        for (uint32_t i = 0; i < 100; ++i) {
+            LOGGING_CHANNEL_MESSAGE(*channel, LoggingLevel::Information, 0, L"{}: size {}x{}", std::wstring_view{name},
+                                    i, i);
+            winrt::App1::log_message(*channel, LoggingLevel::Warning, 0, L"{}: frame {}", std::wstring_view{name}, i);
+
+            WFormatBuffer message{};
+            logging.LogMessage(message.format(L"{}: {:.2f}", std::wstring_view{name}, i * 0.5), LoggingLevel::Error);
+
+            winrt::App1::log_buffered(logger, spdlog::level::info, "{}: visibility {}", "MainWindow", i % 2 == 0);
+        }
+        Assert::AreEqual(allocations.count(), size_t{0}, L"The common case must not allocate");
+        Assert::AreEqual(inner->messages, size_t{300});
+        Assert::AreEqual(inner->copies, size_t{0}, L"The messages must reach the channel as the HSTRING references");
+    }
+
+    TEST_METHOD(TestFormatCost) {
+        constexpr uint32_t count = 1'000'000;
+        size_t heap_allocations = 0;
+        auto start = std::chrono::steady_clock::now();
+        {
+            AllocationScope allocations{};
+            for (uint32_t i = 0; i < count; ++i) {
+                winrt::hstring message{std::format(L"size {}x{}", i, i)};
+                Assert::IsFalse(message.empty());
+            }
+            heap_allocations = allocations.count();
+        }
+        const std::chrono::duration<double, std::nano> heap = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        {
+            AllocationScope allocations{};
+            for (uint32_t i = 0; i < count; ++i) {
+                WFormatBuffer message{};
+                Assert::IsFalse(message.format(L"size {}x{}", i, i).empty());
+            }
+            Assert::AreEqual(allocations.count(), size_t{0});
+        }
+        const std::chrono::duration<double, std::nano> buffered = std::chrono::steady_clock::now() - start;
+
+        auto message = std::format(L"format: hstring {:.2f} ns/call ({} CRT allocations), WFormatBuffer {:.2f} ns/call",
+                                   heap.count() / count, heap_allocations, buffered.count() / count);
+        Logger::WriteMessage(message.c_str());
+    }
+};
+
+using winrt::App1::Setting;
+using winrt::App1::SettingsMask;
+using winrt::App1::SettingsSchema;
+using winrt::App1::SettingsState;
+
+namespace schema_tests {
+inline constexpr Setting<uint32_t> counter{SettingsKey{"Counter"}, 0};
+inline constexpr Setting<float> scale{SettingsKey{"Scale"}, 1.0f,
+                                      [](const float& value) noexcept { return value >= 0.5f && value <= 4.0f; }};
+inline constexpr Setting<bool> vsync{SettingsKey{"VSync"}, true};
+using Schema = SettingsSchema<counter, scale, vsync>;
+} // namespace schema_tests
+
+class SettingsSchemaTests : public TestClass<SettingsSchemaTests> {
+    using Schema = schema_tests::Schema;
+    std::filesystem::path path{};
+
+  public:
+    TEST_METHOD_INITIALIZE(Initialize) {
+        path = std::filesystem::temp_directory_path() / "settings-schema-tests.bin";
+        std::filesystem::remove(path);
+    }
+
+    TEST_METHOD_CLEANUP(Cleanup) {
+        std::filesystem::remove(path);
+    }
+
+    TEST_METHOD(TestSchema) {
+        static_assert(Schema::size() == 3);
+        static_assert(Schema::index_of<schema_tests::scale>() == 1);
+        static_assert(Schema::contains<schema_tests::vsync>());
+        static_assert(schema_tests::counter.key.hash == winrt::App1::hash_settings_key("Counter"));
+        static_assert(std::get<1>(Schema::defaults()) == 1.0f);
+        static_assert(schema_tests::scale.sanitize(8.0f) == 1.0f);
+        static_assert(std::is_same_v<Schema::Values, std::tuple<uint32_t, float, bool>>);
+    }
+
+    TEST_METHOD(TestState) {
+        SettingsState<Schema> state{};
+        Assert::AreEqual(state.get<schema_tests::counter>(), 0u);
+        Assert::IsTrue(state.set<schema_tests::counter>(3));
+        Assert::IsFalse(state.set<schema_tests::counter>(3), L"Same value is not a change");
+        Assert::IsTrue(state.set<schema_tests::scale>(2.0f));
+        Assert::IsTrue(state.set<schema_tests::scale>(0.1f), L"The invalid value is the default");
+        Assert::AreEqual(state.get<schema_tests::scale>(), 1.0f);
+        Assert::IsTrue(state.snapshot() == Schema::Values{3, 1.0f, true});
+    }
+
+    TEST_METHOD(TestTransaction) {
+        static_assert(Schema::bit<schema_tests::vsync>() == 0b100);
+        static_assert(Schema::all() == 0b111);
+        static_assert(Schema::compare(Schema::Values{1, 1.0f, true}, Schema::Values{1, 2.0f, false}) == 0b110);
+
+        SettingsState<Schema> state{};
+        auto update = state.begin();
+        update.set<schema_tests::counter>(5);
+        update.set<schema_tests::scale>(3.0f);
+        update.set<schema_tests::vsync>(true);
+        Assert::AreEqual(state.get<schema_tests::counter>(), 0u, L"Not visible before the commit");
+        Assert::AreEqual(update.staged(), SettingsMask{0b111});
+        Assert::AreEqual(state.commit(update), SettingsMask{0b011}, L"vsync is not changed");
+        Assert::IsTrue(state.snapshot() == Schema::Values{5, 3.0f, true});
+        Assert::AreEqual(state.commit(update), SettingsMask{0});
+
+        // the values which are not staged are not overwritten by the older snapshot
+        auto reset = state.begin();
+        reset.set<schema_tests::vsync>(false);
+        state.set<schema_tests::counter>(6);
+        Assert::AreEqual(state.commit(reset), Schema::bit<schema_tests::vsync>());
+        Assert::AreEqual(state.get<schema_tests::counter>(), 6u);
+
+        reset.assign(Schema::Values{9, 0.1f, true});
+        Assert::AreEqual(state.commit(reset), Schema::all());
+        Assert::IsTrue(state.snapshot() == Schema::Values{9, 1.0f, true}, L"The invalid value is the default");
+    }
+
+    TEST_METHOD(TestChangeBeforeLoad) {
+        {
+            MappedSettingsStore store{path};
+            Schema::save(store, Schema::Values{7, 2.5f, false});
+            store.commit();
+        }
+        MappedSettingsStore store{path};
+        SettingsState<Schema> state{};
+        // the setter before the load completes
+        auto update = state.begin();
+        update.set<schema_tests::counter>(3);
+        Assert::AreEqual(state.commit(update), Schema::bit<schema_tests::counter>());
+
+        const auto changed = state.load(Schema::load(store));
+        Assert::AreEqual(changed, SettingsMask{0b110}, L"The counter is not overwritten");
+        Assert::IsTrue(state.snapshot() == Schema::Values{3, 2.5f, false});
+        Assert::AreEqual(state.load(Schema::Values{}), SettingsMask{0}, L"Loaded once");
+
+        // the writer saves the merged values. The other stored keys survive
+        Schema::save(store, state.snapshot());
+        store.commit();
+        Assert::IsTrue(Schema::load(MappedSettingsStore{path}) == Schema::Values{3, 2.5f, false});
+    }
+
+    TEST_METHOD(TestLoad) {
+        MappedSettingsStore store{path};
+        Assert::IsTrue(Schema::load(store) == Schema::defaults());
+
+        Schema::save(store, Schema::Values{7, 2.5f, false});
+        store.commit();
+        Assert::AreEqual(store.size(), Schema::size());
+        Assert::IsTrue(Schema::load(MappedSettingsStore{path}) == Schema::Values{7, 2.5f, false});
+
+        // the wrong sized and the invalid values are the defaults
+        store.set(schema_tests::counter.key, uint64_t{8});
+        store.set(schema_tests::scale.key, 10.0f);
+        store.commit();
+        Assert::IsTrue(Schema::load(store) == Schema::Values{0, 1.0f, false});
+    }
+};
+
+using winrt::App1::SettingsWriter;
+using winrt::App1::SettingsWriterOptions;
+
+class SettingsWriterTests : public TestClass<SettingsWriterTests> {
+  public:
+    TEST_METHOD(TestCoalesce) {
+        std::atomic<uint32_t> value{0};
+        std::atomic<uint32_t> written{0};
+        SettingsWriter writer{[&]() {
+                                  written = value.load();
+                                  return true;
+                              },
+                              SettingsWriterOptions{std::chrono::milliseconds{50}, std::chrono::seconds{10}}};
+        // holding the increment button
+        for (uint32_t i = 1; i <= 100; ++i) {
+            value = i;
+            writer.mark_dirty();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{300});
+        const auto stats = writer.stats();
+        Assert::AreEqual(stats.changes, uint64_t{100});
+        Assert::AreEqual(stats.writes, uint64_t{1});
+        Assert::AreEqual(written.load(), 100u);
+    }
+
+    TEST_METHOD(TestMaxDelay) {
+        std::atomic<uint32_t> count{0};
+        SettingsWriter writer{[&]() {
+                                  ++count;
+                                  return true;
+                              },
+                              SettingsWriterOptions{std::chrono::milliseconds{50}, std::chrono::milliseconds{100}}};
+        // the changes never stop for the delay
+        const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds{500};
+        while (std::chrono::steady_clock::now() < end) {
+            writer.mark_dirty();
+            std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        }
+        Assert::IsTrue(count >= 2, L"The write must not wait for the end of the changes");
+        Assert::IsTrue(count <= 6);
+    }
+
+    TEST_METHOD(TestFlush) {
+        std::atomic<uint32_t> count{0};
+        bool succeeded = true;
+        {
+            SettingsWriter writer{[&]() {
+                                      ++count;
+                                      return succeeded;
+                                  },
+                                  SettingsWriterOptions{std::chrono::hours{1}, std::chrono::hours{1}}};
+            Assert::IsTrue(writer.flush(), L"Nothing to write");
+            Assert::AreEqual(count.load(), 0u);
+            writer.mark_dirty();
+            writer.mark_dirty();
+            Assert::IsTrue(writer.flush());
+            Assert::AreEqual(count.load(), 1u);
+
+            succeeded = false;
+            writer.mark_dirty();
+            Assert::IsFalse(writer.flush());
+            Assert::AreEqual(writer.stats().failures, uint64_t{1});
+
+            succeeded = true;
+            writer.mark_dirty();
+        }
+        Assert::AreEqual(count.load(), 3u, L"The destructor must write the pending changes");
+    }
+
+    TEST_METHOD(TestRequestFlush) {
+        std::atomic<uint32_t> count{0};
+        std::atomic<bool> succeeded = true;
+        std::thread::id writer_thread{};
+        SettingsWriter writer{[&]() {
+                                  writer_thread = std::this_thread::get_id();
+                                  ++count;
+                                  return succeeded.load();
+                              },
+                              SettingsWriterOptions{std::chrono::hours{1}, std::chrono::hours{1}}};
+        Assert::IsTrue(writer.request_flush(std::chrono::seconds{0}), L"Nothing to write");
+        writer.mark_dirty();
+        // the worker doesn't wait for the delay. The deadline is only for the broken writer
+        Assert::IsTrue(writer.request_flush(std::chrono::seconds{30}));
+        Assert::AreEqual(count.load(), 1u);
+        Assert::IsTrue(writer_thread != std::this_thread::get_id(), L"The caller must not write");
+
+        succeeded = false;
+        writer.mark_dirty();
+        Assert::IsFalse(writer.request_flush(std::chrono::seconds{30}));
+        Assert::AreEqual(writer.stats().failures, uint64_t{1});
+        succeeded = true;
+    }
+
+    TEST_METHOD(TestRetry) {
+        std::atomic<uint32_t> count{0};
+        SettingsWriter writer{[&]() { return ++count > 3; },
+                              SettingsWriterOptions{std::chrono::milliseconds{10}, std::chrono::milliseconds{100},
+                                                    std::chrono::milliseconds{20}, std::chrono::milliseconds{40}}};
+        writer.mark_dirty();
+        // 10 ms, then the backoff of 20, 40, 40 ms. The deadline is only for the broken writer
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{30};
+        while (writer.stats().writes < 4 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        // waits for the write of the worker. The success has cleared the changes, so nothing is written after it
+        Assert::IsTrue(writer.flush());
+        const auto stats = writer.stats();
+        Assert::AreEqual(stats.changes, uint64_t{1});
+        Assert::AreEqual(stats.writes, uint64_t{4}, L"No more writes after the success");
+        Assert::AreEqual(stats.failures, uint64_t{3});
+        Assert::AreEqual(stats.retries, uint64_t{3});
+    }
+
+    TEST_METHOD(TestCallerCost) {
+        constexpr uint32_t count = 1000;
+        const auto path = std::filesystem::temp_directory_path() / "settings-writer.bin";
+        auto save = [&path, value = uint32_t{0}]() mutable {
+            std::ofstream fout{path, std::ios::binary | std::ios::trunc};
+            fout.write(reinterpret_cast<const char*>(&value), sizeof(value));
+            ++value;
+            return fout.good();
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; ++i)
+            save();
+        const std::chrono::duration<double, std::micro> direct = std::chrono::steady_clock::now() - start;
+
+        SettingsWriter writer{save, SettingsWriterOptions{std::chrono::milliseconds{20}, std::chrono::milliseconds{100}}};
+        start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; ++i)
+            writer.mark_dirty();
+        const std::chrono::duration<double, std::micro> marked = std::chrono::steady_clock::now() - start;
+        writer.flush();
+        const auto stats = writer.stats();
+        std::filesystem::remove(path);
+
+        auto message = std::format(L"settings: write each {:.2f} us/change, coalesced {:.3f} us/change ({} writes "
+                                   L"for {} changes)",
+                                   direct.count() / count, marked.count() / count, stats.writes, stats.changes);
+        Logger::WriteMessage(message.c_str());
+    }
+};
+
+using winrt::App1::MappedSettingsStore;
+using winrt::App1::SettingsKey;
+
+class SettingsStoreTests : public TestClass<SettingsStoreTests> {
+    std::filesystem::path path{};
+
+  public:
+    TEST_METHOD_INITIALIZE(Initialize) {
+        path = std::filesystem::temp_directory_path() / "settings-store-tests.bin";
+        std::filesystem::remove(path);
+    }
+
+    TEST_METHOD_CLEANUP(Cleanup) {
+        std::filesystem::remove(path);
+    }
+
+    TEST_METHOD(TestHash) {
+        static_assert(winrt::App1::hash_settings_key("") == 14695981039346656037ull);
+        static_assert(winrt::App1::hash_settings_key("a") == 0xaf63dc4c8601ec8cull);
+        constexpr SettingsKey key{"Counter"};
+        static_assert(key.hash == winrt::App1::hash_settings_key("Counter"));
+    }
+
+    TEST_METHOD(TestCommit) {
+        constexpr SettingsKey counter{"Counter"};
+        constexpr SettingsKey scale{"Scale"};
+        {
+            MappedSettingsStore store{path};
+            Assert::AreEqual(store.size(), size_t{0});
+            Assert::IsFalse(store.get<uint32_t>(counter).has_value());
+            store.set(counter, uint32_t{7});
+            Assert::AreEqual(*store.get<uint32_t>(counter), 7u, L"The staged value must be visible");
+            store.commit();
+            Assert::AreEqual(store.generation(), uint64_t{1});
+            Assert::IsFalse(std::filesystem::exists(path.string() + ".tmp"));
+        }
+        MappedSettingsStore store{path};
+        Assert::AreEqual(store.size(), size_t{1});
+        Assert::AreEqual(*store.get<uint32_t>(counter), 7u);
+        Assert::IsFalse(store.get<uint64_t>(counter).has_value(), L"The size must match");
+
+        store.set(scale, 1.5f);
+        store.set(counter, uint32_t{8});
+        store.commit();
+        Assert::AreEqual(store.generation(), uint64_t{2});
+        Assert::AreEqual(store.size(), size_t{2});
+        Assert::AreEqual(*store.get<uint32_t>(counter), 8u);
+        Assert::AreEqual(*store.get<float>(scale), 1.5f);
+    }
+
+    TEST_METHOD(TestBroken) {
+        constexpr SettingsKey counter{"Counter"};
+        {
+            MappedSettingsStore store{path};
+            store.set(counter, uint32_t{7});
+            store.commit();
+        }
+        const auto size = std::filesystem::file_size(path);
+        {
+            std::fstream file{path, std::ios::binary | std::ios::in | std::ios::out};
+            file.seekp(static_cast<std::streamoff>(size - 1));
+            file.put('\x7F'); // the last byte of the value
+        }
+        MappedSettingsStore store{path};
+        Assert::IsFalse(store.load(), L"The checksum must not match");
+        Assert::AreEqual(store.size(), size_t{0});
+        Assert::IsFalse(store.get<uint32_t>(counter).has_value());
+
+        std::filesystem::resize_file(path, size - 2);
+        Assert::IsFalse(store.load(), L"The truncated file must be ignored");
+
+        // the broken file is replaced by the next commit
+        store.set(counter, uint32_t{9});
+        store.commit();
+        Assert::IsTrue(store.load());
+        Assert::AreEqual(*store.get<uint32_t>(counter), 9u);
+    }
+
+    TEST_METHOD(TestLoadCost) {
+        constexpr uint32_t count = 1000;
+        std::vector<std::string> names{};
+        for (uint32_t i = 0; i < count; ++i)
+            names.emplace_back(std::format("Setting{}", i));
+        {
+            MappedSettingsStore store{path};
+            for (uint32_t i = 0; i < count; ++i)
+                store.set(SettingsKey{names[i]}, uint64_t{i});
+            store.commit();
+        }
+        std::vector<SettingsKey> keys{};
+        for (const std::string& name : names)
+            keys.emplace_back(name);
+
+        const auto start = std::chrono::steady_clock::now();
+        MappedSettingsStore store{path};
+        uint64_t sum = 0;
+        for (const SettingsKey& key : keys)
+            sum += store.get<uint64_t>(key).value_or(0);
+        const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        Assert::AreEqual(sum, uint64_t{count} * (count - 1) / 2);
+
+        auto message = std::format(L"settings: load {} settings {:.1f} us ({} bytes)", count, elapsed.count(),
+                                   std::filesystem::file_size(path));
+        Logger::WriteMessage(message.c_str());
+    }
+};
+
+using winrt::App1::JournaledSettingsStore;
+using winrt::App1::SettingsJournalOptions;
+
+class SettingsJournalTests : public TestClass<SettingsJournalTests> {
+    std::filesystem::path path{};
+    std::filesystem::path journal{};
+
+    void remove_files() {
+        for (const char* suffix : {"", ".tmp", ".journal", ".journal.tmp"}) {
+            auto file = path;
+            file += suffix;
+            std::filesystem::remove(file);
+        }
+    }
+
+  public:
+    TEST_METHOD_INITIALIZE(Initialize) {
+        path = std::filesystem::temp_directory_path() / "settings-journal-tests.bin";
+        journal = path;
+        journal += ".journal";
+        remove_files();
+    }
+
+    TEST_METHOD_CLEANUP(Cleanup) {
+        remove_files();
+    }
+
+    TEST_METHOD(TestReplay) {
+        const SettingsKey counter{"Counter"};
+        const SettingsKey scale{"Scale"};
+        {
+            JournaledSettingsStore store{path};
+            Assert::IsTrue(store.empty());
+            store.set(counter, uint32_t{1});
+            store.set(scale, 2.0f);
+            store.commit();
+            const auto size = store.journal_size();
+            store.set(counter, uint32_t{2});
+            store.commit();
+            Assert::IsTrue(store.journal_size() - size < size, L"Only the changed value is appended");
+            store.set(counter, uint32_t{3});
+            store.commit();
+            Assert::AreEqual(store.sequence(), uint64_t{3});
+        }
+        Assert::IsFalse(std::filesystem::exists(path), L"No snapshot before the compaction");
+        JournaledSettingsStore store{path};
+        Assert::AreEqual(store.sequence(), uint64_t{3});
+        Assert::AreEqual(store.get<uint32_t>(counter).value_or(0), 3u);
+        Assert::AreEqual(store.get<float>(scale).value_or(0), 2.0f);
+        Assert::IsFalse(store.get<uint64_t>(JournaledSettingsStore::sequence_key).has_value());
+    }
+
+    TEST_METHOD(TestTornTail) {
+        const SettingsKey counter{"Counter"};
+        {
+            JournaledSettingsStore store{path};
+            store.set(counter, uint32_t{1});
+            store.commit();
+            store.set(counter, uint32_t{2});
+            store.commit();
+        }
+        // the crash in the middle of the last append
+        std::filesystem::resize_file(journal, std::filesystem::file_size(journal) - 3);
+        {
+            JournaledSettingsStore store{path};
+            Assert::AreEqual(store.sequence(), uint64_t{1});
+            Assert::AreEqual(store.get<uint32_t>(counter).value_or(0), 1u);
+            store.set(counter, uint32_t{5});
+            store.commit();
+        }
+        JournaledSettingsStore store{path};
+        Assert::AreEqual(store.get<uint32_t>(counter).value_or(0), 5u, L"The torn batch must be overwritten");
+        Assert::AreEqual(store.journal_size(), uint64_t{std::filesystem::file_size(journal)});
+    }
+
+    TEST_METHOD(TestCompaction) {
+        const SettingsKey counter{"Counter"};
+        {
+            JournaledSettingsStore store{path, SettingsJournalOptions{1024}};
+            for (uint32_t i = 1; i <= 100; ++i) {
+                store.set(counter, i);
+                store.commit();
+            }
+            const auto end = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+            while (store.compactions() == 0 && std::chrono::steady_clock::now() < end)
+                std::this_thread::sleep_for(std::chrono::milliseconds{10});
+            Assert::IsTrue(store.compactions() > 0);
+            Assert::AreEqual(store.compact_failures(), uint64_t{0});
+        }
+        Assert::IsTrue(std::filesystem::exists(path));
+        JournaledSettingsStore store{path};
+        Assert::AreEqual(store.sequence(), uint64_t{100});
+        Assert::AreEqual(store.get<uint32_t>(counter).value_or(0), 100u);
+    }
+
+    TEST_METHOD(TestStaleJournal) {
+        const SettingsKey counter{"Counter"};
+        const auto backup = std::filesystem::temp_directory_path() / "settings-journal-tests.backup";
+        {
+            JournaledSettingsStore store{path};
+            for (uint32_t i = 1; i <= 3; ++i) {
+                store.set(counter, i);
+                store.commit();
+            }
+            std::filesystem::copy_file(journal, backup, std::filesystem::copy_options::overwrite_existing);
+            store.compact();
+            Assert::AreEqual(store.journal_size(), uint64_t{JournaledSettingsStore::header_size});
+        }
+        // the crash after the snapshot, before the journal is rewritten
+        std::filesystem::copy_file(backup, journal, std::filesystem::copy_options::overwrite_existing);
+        std::filesystem::remove(backup);
+        {
+            JournaledSettingsStore store{path};
+            Assert::AreEqual(store.sequence(), uint64_t{3});
+            Assert::AreEqual(store.get<uint32_t>(counter).value_or(0), 3u);
+            store.set(counter, uint32_t{4});
+            store.commit();
+        }
+        JournaledSettingsStore store{path};
+        Assert::AreEqual(store.get<uint32_t>(counter).value_or(0), 4u);
+    }
+
+    TEST_METHOD(TestLoadCost) {
+        constexpr uint32_t count = 100;
+        constexpr uint32_t changes = 10000;
+        std::vector<SettingsKey> keys{};
+        std::vector<std::string> names{};
+        for (uint32_t i = 0; i < count; ++i)
+            names.emplace_back(std::format("Setting{}", i));
+        for (const std::string& name : names)
+            keys.emplace_back(name);
+        {
+            JournaledSettingsStore store{path, SettingsJournalOptions{UINT64_MAX}};
+            for (uint32_t i = 0; i < changes; ++i) {
+                store.set(keys[i % count], uint64_t{i});
+                store.commit();
+            }
+        }
+        auto load = [this, &keys]() {
+            const auto start = std::chrono::steady_clock::now();
+            JournaledSettingsStore store{path};
+            uint64_t sum = 0;
+            for (const SettingsKey& key : keys)
+                sum += store.get<uint64_t>(key).value_or(0);
+            const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+            Assert::AreEqual(sum, uint64_t{changes - count + changes - 1} * count / 2);
+            return elapsed;
+        };
+        const auto replayed = load();
+        const auto size = std::filesystem::file_size(journal);
+        JournaledSettingsStore{path}.compact();
+        const auto compacted = load();
+
+        auto message = std::format(L"settings: load {} settings with {} changes in the journal {:.1f} us ({} bytes), "
+                                   L"after the compaction {:.1f} us",
+                                   count, changes, replayed.count(), size, compacted.count());
+        Logger::WriteMessage(message.c_str());
+    }
+};
+
+using winrt::App1::TextConvertIsa;
+
+class TextConvertTests : public TestClass<TextConvertTests> {
+    static constexpr TextConvertIsa isas[]{TextConvertIsa::Scalar, TextConvertIsa::SSE2, TextConvertIsa::AVX2,
+                                           TextConvertIsa::NEON};
+
+    /// @brief Reference implementation
+    static std::string convert_system(std::wstring_view text) {
+        if (text.empty())
+            return {};
+        const int size = WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0,
+                                             nullptr, nullptr);
+        std::string out(static_cast<size_t>(size), '\0');
+        WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), out.data(), size, nullptr,
+                            nullptr);
+        return out;
+    }
+
+    static std::string convert(std::wstring_view text, TextConvertIsa isa) {
+        std::string out(winrt::App1::get_utf8_capacity(text.size()), '\0');
+        out.resize(winrt::App1::convert_utf16_to_utf8(winrt::App1::to_u16string_view(text), out.data(), isa));
+        return out;
+    }
+
+    /// @brief Mostly ASCII with the runs of the other ranges, like the log messages
+    static std::wstring make_text(std::mt19937& gen, size_t size) {
+        std::uniform_int_distribution<int> kind{0, 9};
+        std::wstring text{};
+        while (text.size() < size) {
+            switch (kind(gen)) {
+            case 0:
+                text += static_cast<wchar_t>(std::uniform_int_distribution<int>{0x80, 0x7FF}(gen));
+                break;
+            case 1:
+                text += static_cast<wchar_t>(std::uniform_int_distribution<int>{0x800, 0xD7FF}(gen));
+                break;
+            case 2: // surrogate pair
+                text += static_cast<wchar_t>(std::uniform_int_distribution<int>{0xD800, 0xDBFF}(gen));
+                text += static_cast<wchar_t>(std::uniform_int_distribution<int>{0xDC00, 0xDFFF}(gen));
+                break;
+            case 3: // unpaired surrogate
+                text += static_cast<wchar_t>(std::uniform_int_distribution<int>{0xD800, 0xDFFF}(gen));
+                break;
+            default:
+                for (int i = std::uniform_int_distribution<int>{1, 40}(gen); i > 0; --i)
+                    text += static_cast<wchar_t>(std::uniform_int_distribution<int>{0x00, 0x7F}(gen));
+                break;
+            }
+        }
+        return text;
+    }
+
+  public:
+    TEST_METHOD(TestKnownText) {
+        Assert::AreEqual(winrt::App1::to_utf8(std::wstring_view{L"Log folder: C:\\\uD55C\uAE00"}),
+                         std::string{"Log folder: C:\\\xED\x95\x9C\xEA\xB8\x80"});
+        Assert::AreEqual(winrt::App1::to_utf8(std::wstring_view{L"\xD83D\xDE00 \xD83D"}),
+                         std::string{"\xF0\x9F\x98\x80 \xEF\xBF\xBD"});
+        Assert::AreEqual(std::format("[{}]", winrt::App1::Utf8Text{std::wstring_view{L"a\u00E9"}}),
+                         std::string{"[a\xC3\xA9]"});
+        const std::wstring text(1000, L'\u00E9'); // longer than the stack buffer of the formatter
+        Assert::AreEqual(std::format("{}", winrt::App1::Utf8Text{text}).size(), size_t{2000});
+    }
+
+    TEST_METHOD(TestFuzz) {
+        std::mt19937 gen{20251019};
+        for (int round = 0; round < 2000; ++round) {
+            const std::wstring text = make_text(gen, std::uniform_int_distribution<size_t>{0, 300}(gen));
+            const std::string expected = convert_system(text);
+            for (TextConvertIsa isa : isas)
+                Assert::AreEqual(convert(text, isa), expected);
+        }
+    }
+
+    TEST_METHOD(TestThroughput) {
+        std::mt19937 gen{7};
+        const std::wstring mixed = make_text(gen, 1 << 20);
+        const std::wstring ascii(1 << 20, L'a');
+        std::string out(winrt::App1::get_utf8_capacity(mixed.size()), '\0');
+        for (const auto& [name, text] : {std::pair{L"ascii", std::wstring_view{ascii}},
+                                         std::pair{L"mixed", std::wstring_view{mixed}}}) {
+            auto measure = [&text](auto&& fn) {
+                constexpr int repeat = 20;
+                const auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < repeat; ++i)
+                    fn();
+                const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                return repeat * text.size() * sizeof(wchar_t) / elapsed.count() / (1 << 20);
+            };
+            const double system = measure([&]() {
+                WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), out.data(),
+                                    static_cast<int>(out.size()), nullptr, nullptr);
+            });
+            std::wstring message = std::format(L"{}: WideCharToMultiByte {:.0f} MB/s", name, system);
+            for (TextConvertIsa isa : isas) {
+                const double rate = measure([&]() {
+                    winrt::App1::convert_utf16_to_utf8(winrt::App1::to_u16string_view(text), out.data(), isa);
+                });
+                message += std::format(L", isa {} {:.0f} MB/s", static_cast<int>(isa), rate);
+            }
+            Logger::WriteMessage(message.c_str());
+        }
+    }
+};
+
+using winrt::App1::FlightRecorder;
+
+class FlightRecorderTests : public TestClass<FlightRecorderTests> {
+    static DecodedLog decode(const std::string& data) {
+        return winrt::App1::decode_binary_log({reinterpret_cast<const std::byte*>(data.data()), data.size()});
+    }
+
+  public:
+    TEST_METHOD(TestDump) {
+        FlightRecorder recorder{16};
+        recorder.mark_frame(7);
+        recorder.record(BINLOG_ID(BinaryLogLevel::Warn, "{} took {:.1f} ms"), L"Present", 2.5);
+        recorder.record(BINLOG_ID(BinaryLogLevel::Info, "{}"), std::string(1000, 'x')); // truncated to the slot
+        std::ostringstream out{};
+        Assert::AreEqual(recorder.dump(out), size_t{3});
+
+        const DecodedLog log = decode(out.str());
+        Assert::AreEqual(log.records.size(), size_t{3});
+        Assert::AreEqual(log.records[0].text, std::string{"frame 7"});
+        Assert::AreEqual(log.records[1].text, std::string{"Present took 2.5 ms"});
+        Assert::IsTrue(log.records[1].level == BinaryLogLevel::Warn);
+        Assert::IsTrue(log.records[2].text.size() < FlightRecorder::payload_capacity);
+        Assert::IsTrue(log.records[2].text.size() > FlightRecorder::payload_capacity - 8);
+        // the records are older than the dump
+        Assert::IsTrue(log.records[0].timestamp < std::chrono::nanoseconds{0});
+    }
+
+    TEST_METHOD(TestEmptyPayload) {
+        FlightRecorder recorder{16};
+        recorder.record(BINLOG_ID(BinaryLogLevel::Error, "device removed"));
+        recorder.record(BINLOG_ID(BinaryLogLevel::Info, "{}"), std::string{});
+        std::ostringstream out{};
+        Assert::AreEqual(recorder.dump(out), size_t{2});
+
+        const DecodedLog log = decode(out.str());
+        Assert::AreEqual(log.records.size(), size_t{2});
+        Assert::AreEqual(log.records[0].text, std::string{"device removed"});
+        Assert::IsTrue(log.records[0].level == BinaryLogLevel::Error, L"The id must be kept");
+        Assert::AreEqual(log.records[1].text, std::string{});
+    }
+
+    TEST_METHOD(TestWrap) {
+        FlightRecorder recorder{16};
+        for (uint32_t i = 0; i < 100; ++i)
+            recorder.record(BINLOG_ID(BinaryLogLevel::Debug, "record {}"), i);
+        Assert::AreEqual(recorder.stats().recorded, uint64_t{100});
+
+        std::ostringstream out{};
+        Assert::AreEqual(recorder.dump(out), size_t{16});
+        const DecodedLog log = decode(out.str());
+        Assert::AreEqual(log.records.front().text, std::string{"record 84"});
+        Assert::AreEqual(log.records.back().text, std::string{"record 99"});
+    }
+
+    /// @brief The dump while the writers are wrapping the ring. The torn slots must be skipped
+    TEST_METHOD(TestConcurrentDump) {
+        FlightRecorder recorder{256};
+        std::atomic_bool stop{false};
+        std::vector<std::thread> writers{};
+        for (uint32_t t = 0; t < 4; ++t)
+            writers.emplace_back([&recorder, &stop, t]() {
+                for (uint32_t i = 0; stop.load(std::memory_order_relaxed) == false; ++i)
+                    recorder.record(BINLOG_ID(BinaryLogLevel::Trace, "{} {} {}"), t, i, std::string((t + 1) * 20, 'a'));
+            });
+        while (recorder.stats().recorded < 4 * recorder.capacity()) // wrapped a few times
+            std::this_thread::yield();
+        for (int i = 0; i < 20; ++i) {
+            std::ostringstream out{};
+            const size_t count = recorder.dump(out);
+            const DecodedLog log = decode(out.str());
+            Assert::AreEqual(log.records.size(), count);
+            for (const auto& record : log.records) {
+                uint32_t t = 0, n = 0;
+                char text[128]{};
+                Assert::AreEqual(std::sscanf(record.text.c_str(), "%u %u %127s", &t, &n, text), 3);
+                Assert::AreEqual(std::strlen(text), size_t{(t + 1) * 20});
+            }
+        }
+        stop = true;
+        for (auto& writer : writers)
+            writer.join();
+        const FlightRecorder::Stats stats = recorder.stats();
+        Logger::WriteMessage(std::format(L"recorded {} dropped {}", stats.recorded, stats.dropped).c_str());
+    }
+
+    TEST_METHOD(TestRecordCost) {
+        constexpr uint32_t count = 1'000'000;
+        FlightRecorder recorder{};
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; ++i)
+            recorder.record(BINLOG_ID(BinaryLogLevel::Trace, "frame {} in {:.2f} ms, {} draws"), i, i * 0.01, i % 300);
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        Logger::WriteMessage(std::format(L"FlightRecorder {:.1f} ns/record", elapsed.count() / count).c_str());
+    }
+};
@@ -0,0 +1,202 @@
+<#
+.SYNOPSIS
+    Compile HLSL shaders with DXC and write a shader pack
+.DESCRIPTION
+    Read the shader manifest (JSON) and compile each shader into DXIL with reflection data.
+    The outputs are stored in a content-addressed cache. The cache key is the SHA-256 of
+    the source, the included files, the entry point, the profile, the defines, the arguments and the compiler version.
+    Unchanged shaders are never recompiled, even after clean build of the project.
+
+    The compiled shaders are written into a single pack file. See Shared1/ShaderPack.h for the layout.
+    The script runs on both Windows and Linux with PowerShell 7.
+
+    * https://github.com/microsoft/DirectXShaderCompiler
+
+.PARAMETER Manifest
+    Path to the JSON file. { "shaders": [ { "name", "file", "entry", "profile", "defines"?, "arguments"? } ] }
+    The "file" is relative to the manifest.
+.PARAMETER OutFile
+    Path to the shader pack to generate
+.PARAMETER CacheDir
+    Folder for the content-addressed cache. "<key>.dxil" and "<key>.refl" files
+.PARAMETER Compiler
+    Path to the dxc executable. Searched in PATH by default
+.PARAMETER IncludeDirs
+    Additional folders for the #include lookup
+
+.EXAMPLE
+    PS> build-shaders.ps1 -Manifest '.\App1\Shaders\shaders.json' -OutFile '.\x64\Debug\Shaders.pack' -CacheDir '.\x64\Debug\ShaderCache'
+.EXAMPLE
+    PS> build-shaders.ps1 -Manifest ./App1/Shaders/shaders.json -OutFile ./build/Shaders.pack -CacheDir ./build/cache -Compiler /opt/dxc/bin/dxc
+#>
+using namespace System.IO
+using namespace System.Text
+using namespace System.Security.Cryptography
+param
+(
+    [Parameter(Mandatory = $true)][String]$Manifest,
+    [Parameter(Mandatory = $true)][String]$OutFile,
+    [Parameter(Mandatory = $true)][String]$CacheDir,
+    [String]$Compiler = "dxc",
+    [String[]]$IncludeDirs = @()
+)
+$ErrorActionPreference = "Stop"
+
+function Get-TextHash([String]$Text) {
+    return [Convert]::ToHexString([SHA256]::HashData([Encoding]::UTF8.GetBytes($Text)))
+}
+
+# Collect the source and the included files in the order of appearance. Each file is visited once
+function Get-IncludedFiles([String]$FilePath, [String[]]$SearchDirs, [System.Collections.Generic.List[String]]$Visited) {
+    $FullPath = [Path]::GetFullPath($FilePath)
+    if ($Visited.Contains($FullPath)) {
+        return
+    }
+    $Visited.Add($FullPath)
+    $Folder = [Path]::GetDirectoryName($FullPath)
+    foreach ($Line in [File]::ReadAllLines($FullPath)) {
+        if ($Line -notmatch '^\s*#\s*include\s*[<"]([^>"]+)[>"]') {
+            continue
+        }
+        $Name = $Matches[1]
+        $Candidates = @($Folder) + $SearchDirs | ForEach-Object { Join-Path $_ $Name } | Where-Object { Test-Path $_ -PathType Leaf }
+        if ($null -eq $Candidates) {
+            throw "${FullPath}: can't find the include file '$Name'"
+        }
+        Get-IncludedFiles -FilePath @($Candidates)[0] -SearchDirs $SearchDirs -Visited $Visited
+    }
+}
+
+function Get-CacheKey($Shader, [String]$SourcePath, [String]$CompilerVersion, [String[]]$SearchDirs) {
+    $Visited = [System.Collections.Generic.List[String]]::new()
+    Get-IncludedFiles -FilePath $SourcePath -SearchDirs $SearchDirs -Visited $Visited
+    $Builder = [StringBuilder]::new()
+    [void]$Builder.AppendLine("compiler:$CompilerVersion")
+    [void]$Builder.AppendLine("entry:$($Shader.entry)")
+    [void]$Builder.AppendLine("profile:$($Shader.profile)")
+    foreach ($Define in @($Shader.defines | Sort-Object)) {
+        [void]$Builder.AppendLine("define:$Define")
+    }
+    foreach ($Argument in @($Shader.arguments | Where-Object { $_ })) {
+        [void]$Builder.AppendLine("argument:$Argument")
+    }
+    # the file names are not hashed. moving the source folder doesn't invalidate the cache
+    foreach ($FilePath in $Visited) {
+        [void]$Builder.AppendLine("file:" + (Get-FileHash -Path $FilePath -Algorithm SHA256).Hash)
+    }
+    return Get-TextHash $Builder.ToString()
+}
+
+function Invoke-Compiler($Shader, [String]$SourcePath, [String]$Key, [String[]]$SearchDirs) {
+    $ObjectPath = Join-Path $CacheDir "$Key.dxil"
+    $ReflectionPath = Join-Path $CacheDir "$Key.refl"
+    if ((Test-Path $ObjectPath) -and (Test-Path $ReflectionPath)) {
+        return $false
+    }
+    # write to the temporary files first. the interrupted build must not leave a broken cache entry
+    $Arguments = @("-nologo", "-T", $Shader.profile, "-E", $Shader.entry, "-Qstrip_reflect",
+        "-Fo", "$ObjectPath.tmp", "-Fre", "$ReflectionPath.tmp")
+    foreach ($Folder in $SearchDirs) {
+        $Arguments += @("-I", $Folder)
+    }
+    foreach ($Define in @($Shader.defines | Where-Object { $_ })) {
+        $Arguments += @("-D", $Define)
+    }
+    $Arguments += @($Shader.arguments | Where-Object { $_ })
+    $Arguments += $SourcePath
+    & $Compiler @Arguments
+    if ($LASTEXITCODE -ne 0) {
+        throw "$($Shader.name): $Compiler exited with $LASTEXITCODE"
+    }
+    Move-Item -Force "$ReflectionPath.tmp" $ReflectionPath
+    Move-Item -Force "$ObjectPath.tmp" $ObjectPath
+    return $true
+}
+
+function Write-Padding([BinaryWriter]$Writer, [Int]$Alignment) {
+    while ($Writer.BaseStream.Position % $Alignment -ne 0) {
+        $Writer.Write([Byte]0)
+    }
+}
+
+# See Shared1/ShaderPack.h
+function Write-ShaderPack([String]$FilePath, $Entries) {
+    $HeaderSize = 16
+    $EntrySize = 32
+    $TempPath = "$FilePath.tmp"
+    $Stream = [File]::Create($TempPath)
+    $Writer = [BinaryWriter]::new($Stream)
+    try {
+        $Writer.Write([UInt32]0x4B504853) # "SHPK"
+        $Writer.Write([UInt32]1)
+        $Writer.Write([UInt32]$Entries.Count)
+        $Writer.Write([UInt32]0)
+        # reserve the table. it is written after the data
+        $Writer.Write([Byte[]]::new($Entries.Count * $EntrySize))
+        $Table = @()
+        foreach ($Entry in $Entries) {
+            $Name = [Encoding]::UTF8.GetBytes($Entry.Name)
+            $NameOffset = $Writer.BaseStream.Position
+            $Writer.Write($Name)
+            Write-Padding $Writer 16
+            $CodeOffset = $Writer.BaseStream.Position
+            $Writer.Write($Entry.Bytecode)
+            Write-Padding $Writer 16
+            $ReflectionOffset = $Writer.BaseStream.Position
+            $Writer.Write($Entry.Reflection)
+            Write-Padding $Writer 16
+            $Table += , @($Entry.Key, $NameOffset, $Name.Length, $CodeOffset, $Entry.Bytecode.Length,
+                $ReflectionOffset, $Entry.Reflection.Length)
+        }
+        [void]$Writer.Seek($HeaderSize, [SeekOrigin]::Begin)
+        foreach ($Row in $Table) {
+            $Writer.Write([UInt64]$Row[0])
+            for ($i = 1; $i -lt $Row.Count; ++$i) {
+                $Writer.Write([UInt32]$Row[$i])
+            }
+        }
+    }
+    finally {
+        $Writer.Dispose()
+    }
+    Move-Item -Force $TempPath $FilePath
+}
+
+$ManifestPath = [Path]::GetFullPath($Manifest)
+$ManifestFolder = [Path]::GetDirectoryName($ManifestPath)
+$Shaders = @((Get-Content -Raw $ManifestPath | ConvertFrom-Json).shaders)
+$SearchDirs = @($IncludeDirs | ForEach-Object { [Path]::GetFullPath($_) })
+$Duplicates = @($Shaders | Group-Object -Property name | Where-Object { $_.Count -gt 1 })
+if ($Duplicates.Count -gt 0) {
+    throw "${ManifestPath}: duplicated shader name '$($Duplicates[0].Name)'"
+}
+
+New-Item -ItemType Directory -Force -Path $CacheDir | Out-Null
+New-Item -ItemType Directory -Force -Path ([Path]::GetDirectoryName([Path]::GetFullPath($OutFile))) | Out-Null
+
+# the version line changes with the compiler update, so the whole cache is invalidated
+$CompilerVersion = (& $Compiler --version 2>&1 | Out-String).Trim()
+if ($LASTEXITCODE -ne 0) {
+    throw "$Compiler is not available: $CompilerVersion"
+}
+
+$Entries = [System.Collections.Generic.List[Object]]::new()
+$Compiled = 0
+foreach ($Shader in $Shaders) {
+    $SourcePath = Join-Path $ManifestFolder $Shader.file
+    $Key = Get-CacheKey -Shader $Shader -SourcePath $SourcePath -CompilerVersion $CompilerVersion -SearchDirs $SearchDirs
+    if (Invoke-Compiler -Shader $Shader -SourcePath $SourcePath -Key $Key -SearchDirs $SearchDirs) {
+        $Compiled += 1
+    }
+    $Entries.Add([PSCustomObject]@{
+            Name       = [String]$Shader.name
+            Key        = [Convert]::ToUInt64($Key.Substring(0, 16), 16)
+            Bytecode   = [File]::ReadAllBytes((Join-Path $CacheDir "$Key.dxil"))
+            Reflection = [File]::ReadAllBytes((Join-Path $CacheDir "$Key.refl"))
+        })
+}
+# ShaderPack::find is a binary search with the byte order of the names
+$Sorted = [Object[]]$Entries.ToArray()
+[Array]::Sort([String[]]($Sorted | ForEach-Object { $_.Name }), $Sorted, [StringComparer]::Ordinal)
+Write-ShaderPack -FilePath $OutFile -Entries $Sorted
+Write-Host "$($Shaders.Count) shaders, $Compiled compiled, $($Shaders.Count - $Compiled) from cache: $OutFile"
@@ -0,0 +1,165 @@
+<#
+.SYNOPSIS
+    Render the binary log of BinaryLogWriter as text
+.DESCRIPTION
+    Read the descriptors and the events of the log, and format each event with the format string of its descriptor.
+    See Shared1/BinaryLog.h for the layout. The output is like the spdlog pattern "%T.%e [%L] %v" (UTC time).
+    A truncated record at the end of the file is ignored.
+
+    The replacement fields of std::format are translated to .NET composite formatting.
+    Only the common specs are supported: fill-less alignment and width, '#', precision, 'd', 'x', 'X', 'f', 'e'.
+    Use `winrt::App1::render_binary_log` when the exact std::format output is needed.
+    The script runs on both Windows and Linux with PowerShell 7.
+
+.PARAMETER Path
+    Path to the binary log file
+.PARAMETER ShowSource
+    Append the file and the line of the call site to each line
+
+.EXAMPLE
+    PS> decode-binlog.ps1 -Path "$env:LOCALAPPDATA\Packages\...\LocalState\logs\App.binlog"
+.EXAMPLE
+    PS> decode-binlog.ps1 -Path ./App.binlog -ShowSource | Select-String '\[E\]'
+#>
+using namespace System.IO
+using namespace System.Text
+param
+(
+    [Parameter(Mandatory = $true)][String]$Path,
+    [Switch]$ShowSource
+)
+$ErrorActionPreference = "Stop"
+
+$Magic = 0x474F4C42 # "BLOG"
+$FormatVersion = 1
+$Levels = "TDIWEC"
+
+function Read-VarInt([BinaryReader]$Reader) {
+    [UInt64]$Value = 0
+    for ($Shift = 0; $Shift -lt 64; $Shift += 7) {
+        $Byte = $Reader.ReadByte()
+        $Value = $Value -bor ([UInt64]($Byte -band 0x7F) -shl $Shift)
+        if (($Byte -band 0x80) -eq 0) {
+            return $Value
+        }
+    }
+    throw "varint is too long"
+}
+
+function ConvertFrom-ZigZag([UInt64]$Value) {
+    $Half = [Int64]($Value -shr 1)
+    if (($Value -band 1) -eq 0) {
+        return $Half
+    }
+    return -$Half - 1
+}
+
+function Read-Arguments([Byte[]]$Payload) {
+    $Reader = [BinaryReader]::new([MemoryStream]::new($Payload))
+    $Arguments = [System.Collections.Generic.List[Object]]::new()
+    while ($Reader.BaseStream.Position -lt $Payload.Length) {
+        $Tag = $Reader.ReadByte()
+        switch ($Tag) {
+            1 { $Arguments.Add((ConvertFrom-ZigZag (Read-VarInt $Reader))) }
+            2 { $Arguments.Add((Read-VarInt $Reader)) }
+            3 { $Arguments.Add($Reader.ReadDouble()) }
+            4 { $Arguments.Add($(if ($Reader.ReadByte() -ne 0) { "true" } else { "false" })) }
+            5 { $Arguments.Add([Encoding]::UTF8.GetString($Reader.ReadBytes([Int32](Read-VarInt $Reader)))) }
+            6 { $Arguments.Add([Encoding]::Unicode.GetString($Reader.ReadBytes([Int32](Read-VarInt $Reader) * 2))) }
+            default { throw "unknown argument tag $Tag" }
+        }
+    }
+    return , $Arguments
+}
+
+# "{}", "{1}", "{:>8.2f}" -> "{0}", "{1}", "{0,8:F2}"
+function ConvertTo-CompositeFormat([String]$Format) {
+    $script:Next = 0
+    $Evaluator = {
+        param($Match)
+        $Index = $Match.Groups['index'].Value
+        if ($Index -eq '') {
+            $Index = $script:Next
+            $script:Next += 1
+        }
+        $Item = "$Index"
+        $Width = $Match.Groups['width'].Value
+        if ($Width -ne '') {
+            $Item += $(if ($Match.Groups['align'].Value -eq '<') { ",-$Width" } else { ",$Width" })
+        }
+        $Precision = $Match.Groups['precision'].Value
+        $Spec = switch -CaseSensitive ($Match.Groups['type'].Value) {
+            'f' { "F$(if ($Precision) { $Precision } else { 6 })" }
+            'e' { "0.$('0' * $(if ($Precision) { [Int32]$Precision } else { 6 }))e+00" }
+            'x' { "x" }
+            'X' { "X" }
+            default { $(if ($Precision) { "F$Precision" } else { "" }) }
+        }
+        $Prefix = $(if ($Match.Groups['alt'].Value -and $Spec -in 'x', 'X') { "0x" } else { "" })
+        if ($Spec) {
+            $Item += ":$Spec"
+        }
+        return "$Prefix{$Item}"
+    }
+    $Pattern = '(?<!\{)\{(?<index>\d*)(?::(?<align>[<>^]?)(?<alt>#?)(?<width>\d*)(?:\.(?<precision>\d+))?(?<type>[a-zA-Z]?))?\}'
+    return [regex]::Replace($Format, $Pattern, $Evaluator)
+}
+
+$Data = [File]::ReadAllBytes((Resolve-Path $Path))
+$Reader = [BinaryReader]::new([MemoryStream]::new($Data))
+if ($Reader.ReadUInt32() -ne $Magic) {
+    throw "binary log magic mismatch"
+}
+if ($Reader.ReadUInt32() -ne $FormatVersion) {
+    throw "binary log version mismatch"
+}
+$Start = [DateTime]::UnixEpoch.AddTicks([Int64]($Reader.ReadInt64() / 100))
+
+$Descriptors = @{}
+[Int64]$Timestamp = 0
+try {
+    while ($Reader.BaseStream.Position -lt $Data.Length) {
+        $Kind = $Reader.ReadByte()
+        if ($Kind -eq 1) {
+            $Id = $Reader.ReadUInt32()
+            $Level = $Reader.ReadByte()
+            $Line = $Reader.ReadUInt32()
+            $File = [Encoding]::UTF8.GetString($Reader.ReadBytes($Reader.ReadUInt16()))
+            $Format = [Encoding]::UTF8.GetString($Reader.ReadBytes($Reader.ReadUInt16()))
+            $Descriptors[[UInt64]$Id] = [PSCustomObject]@{
+                Level  = $Level
+                Line   = $Line
+                File   = $File
+                Format = (ConvertTo-CompositeFormat $Format)
+            }
+        }
+        elseif ($Kind -eq 2) {
+            $Id = Read-VarInt $Reader
+            $Delta = ConvertFrom-ZigZag (Read-VarInt $Reader)
+            $Size = [Int32](Read-VarInt $Reader)
+            $Payload = $Reader.ReadBytes($Size)
+            if ($Payload.Length -ne $Size) {
+                break # truncated
+            }
+            $Descriptor = $Descriptors[$Id]
+            if ($null -eq $Descriptor) {
+                throw "binary log event has no descriptor"
+            }
+            $Timestamp += $Delta
+            $Text = [String]::Format([Globalization.CultureInfo]::InvariantCulture, $Descriptor.Format,
+                [Object[]](Read-Arguments $Payload))
+            $Time = $Start.AddTicks([Int64]($Timestamp / 100)).ToString("HH:mm:ss.fff")
+            $Output = "$Time [$($Levels[$Descriptor.Level])] $Text"
+            if ($ShowSource) {
+                $Output += " ($($Descriptor.File):$($Descriptor.Line))"
+            }
+            Write-Output $Output
+        }
+        else {
+            throw "binary log record kind is unknown: $Kind"
+        }
+    }
+}
+catch [EndOfStreamException] {
+    # truncated. The writer has stopped in the middle of a record
+}
@@ -0,0 +1,202 @@
+<#
+.SYNOPSIS
+    Search the compressed log segments of RotatingFileLog
+.DESCRIPTION
+    Read the index of each archive, and decompress only the blocks which can match the time, the levels and the
+    channels. See Shared1/LogArchive.h for the layout. The matched records are written with their continuation lines.
+    The time is compared as the text in the file. There is no time zone conversion.
+    Use -Verbose to see how many blocks were read.
+    The script runs on both Windows and Linux with PowerShell 7.
+
+.PARAMETER Path
+    Path to an archive (.lz4) or a folder of the archives. The folder is searched in the order of the file names
+.PARAMETER From
+    The first time to find. Inclusive
+.PARAMETER To
+    The last time to find. Inclusive
+.PARAMETER Level
+    Short names of the levels. For example, "WEC" for warning, error and critical
+.PARAMETER Channel
+    Names of the channels. "App1.DX" or "DX". The logger names which are not a channel are "App1.Core"
+
+.EXAMPLE
+    PS> query-logs.ps1 -Path "$env:LOCALAPPDATA\Packages\...\LocalState\logs" -Level EC
+.EXAMPLE
+    PS> query-logs.ps1 -Path ./logs -From "2025-03-01 10:00" -To "2025-03-01 10:05" -Channel DX -Verbose
+#>
+using namespace System.IO
+using namespace System.Text
+param
+(
+    [Parameter(Mandatory = $true)][String]$Path,
+    [DateTime]$From = [DateTime]::MinValue,
+    [DateTime]$To = [DateTime]::MaxValue,
+    [String]$Level = "TDIWECO",
+    [String[]]$Channel = @()
+)
+$ErrorActionPreference = "Stop"
+
+$IndexMagic = 0x5844494C # "LIDX"
+$IndexVersion = 1
+$Levels = "TDIWECO"
+$Channels = @("App1.Core", "App1.ViewModel", "App1.DX", "App1.Persistence")
+$RecordPattern = [regex]'^(?<time>\d{4}-\d{2}-\d{2} \d{2}:\d{2}:\d{2}\.\d{3}) \[(?<level>[TDIWECO])\](?: \[(?<name>[^\]]*)\])?'
+
+function ConvertTo-Milliseconds([DateTime]$Time) {
+    return [Int64]($Time - [DateTime]::UnixEpoch).TotalMilliseconds
+}
+
+function Get-ChannelBit([String]$Name) {
+    $Index = [Array]::IndexOf($Channels, $Name)
+    if ($Index -lt 0) {
+        $Index = [Array]::IndexOf($Channels, "App1.$Name")
+    }
+    return $(if ($Index -lt 0) { 1 } else { 1 -shl $Index })
+}
+
+# LZ4 block format. https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+function Expand-Lz4Block([Byte[]]$Source, [Int32]$Size) {
+    $Output = [Byte[]]::new($Size)
+    $In = 0
+    $Out = 0
+    while ($In -lt $Source.Length) {
+        $Token = $Source[$In++]
+        $Literals = $Token -shr 4
+        if ($Literals -eq 15) {
+            do {
+                $Byte = $Source[$In++]
+                $Literals += $Byte
+            } while ($Byte -eq 255)
+        }
+        [Array]::Copy($Source, $In, $Output, $Out, $Literals)
+        $In += $Literals
+        $Out += $Literals
+        if ($In -ge $Source.Length) {
+            break # the last sequence has the literals only
+        }
+        $Offset = $Source[$In] -bor ($Source[$In + 1] -shl 8)
+        $In += 2
+        $Length = ($Token -band 0x0F) + 4
+        if (($Token -band 0x0F) -eq 15) {
+            do {
+                $Byte = $Source[$In++]
+                $Length += $Byte
+            } while ($Byte -eq 255)
+        }
+        $Match = $Out - $Offset
+        if ($Offset -ge $Length) {
+            [Array]::Copy($Output, $Match, $Output, $Out, $Length)
+            $Out += $Length
+        }
+        else {
+            # the match overlaps the output. Copy one by one
+            for ($i = 0; $i -lt $Length; $i++) {
+                $Output[$Out++] = $Output[$Match + $i]
+            }
+        }
+    }
+    if ($Out -ne $Size) {
+        throw "lz4 block is corrupted"
+    }
+    return , $Output
+}
+
+function Read-LogIndex([String]$Archive) {
+    $IndexPath = [Path]::ChangeExtension($Archive, ".idx")
+    $Reader = [BinaryReader]::new([MemoryStream]::new([File]::ReadAllBytes($IndexPath)))
+    if ($Reader.ReadUInt32() -ne $IndexMagic) {
+        throw "log index magic mismatch: $IndexPath"
+    }
+    if ($Reader.ReadUInt32() -ne $IndexVersion) {
+        throw "log index version mismatch: $IndexPath"
+    }
+    $Count = $Reader.ReadUInt32()
+    $null = $Reader.ReadUInt32() # block size
+    for ($i = 0; $i -lt $Count; $i++) {
+        $Block = [PSCustomObject]@{
+            Offset   = $Reader.ReadUInt64()
+            Stored   = $Reader.ReadUInt32()
+            Size     = $Reader.ReadUInt32()
+            First    = $Reader.ReadInt64()
+            Last     = $Reader.ReadInt64()
+            Records  = $Reader.ReadUInt32()
+            Levels   = $Reader.ReadByte()
+            Channels = $Reader.ReadByte()
+        }
+        $null = $Reader.ReadUInt16() # reserved
+        Write-Output $Block
+    }
+}
+
+$FromTime = ConvertTo-Milliseconds $From
+$ToTime = $(if ($To -eq [DateTime]::MaxValue) { [Int64]::MaxValue } else { ConvertTo-Milliseconds $To })
+$LevelMask = 0
+foreach ($Name in $Level.ToUpperInvariant().ToCharArray()) {
+    $Index = $Levels.IndexOf($Name)
+    if ($Index -lt 0) {
+        throw "unknown level: $Name"
+    }
+    $LevelMask = $LevelMask -bor (1 -shl $Index)
+}
+$ChannelMask = $(if ($Channel.Count -eq 0) { 0xFF } else { 0 })
+foreach ($Name in $Channel) {
+    $ChannelMask = $ChannelMask -bor (Get-ChannelBit $Name)
+}
+
+function Test-Record([Text.RegularExpressions.Match]$Match) {
+    $Time = ConvertTo-Milliseconds ([DateTime]::ParseExact($Match.Groups['time'].Value, "yyyy-MM-dd HH:mm:ss.fff",
+            [Globalization.CultureInfo]::InvariantCulture))
+    $LevelBit = 1 -shl $Levels.IndexOf($Match.Groups['level'].Value)
+    $ChannelBit = $(if ($Match.Groups['name'].Success) { Get-ChannelBit $Match.Groups['name'].Value } else { 1 })
+    return ($Time -ge $FromTime) -and ($Time -le $ToTime) -and ($LevelMask -band $LevelBit) -and
+    ($ChannelMask -band $ChannelBit)
+}
+
+$Item = Get-Item (Resolve-Path $Path)
+$Archives = $(if ($Item.PSIsContainer) { Get-ChildItem $Item -Filter "*.lz4" | Sort-Object Name } else { @($Item) })
+foreach ($Archive in $Archives) {
+    $Blocks = @(Read-LogIndex $Archive.FullName)
+    $Stream = [File]::OpenRead($Archive.FullName)
+    $Decompressed = 0
+    try {
+        foreach ($Block in $Blocks) {
+            $Skip = ($Block.Records -eq 0) -or (($Block.Levels -band $LevelMask) -eq 0) -or
+            (($Block.Channels -band $ChannelMask) -eq 0) -or ($Block.Last -lt $FromTime) -or ($Block.First -gt $ToTime)
+            if ($Skip) {
+                continue
+            }
+            $Stored = [Byte[]]::new($Block.Stored)
+            $null = $Stream.Seek([Int64]$Block.Offset, [SeekOrigin]::Begin)
+            if ($Stream.Read($Stored, 0, $Stored.Length) -ne $Stored.Length) {
+                throw "log archive is truncated: $($Archive.FullName)"
+            }
+            $Text = [Encoding]::UTF8.GetString((Expand-Lz4Block $Stored ([Int32]$Block.Size)))
+            $Decompressed += 1
+
+            # a record and its continuation lines
+            $Record = $null
+            $Matched = $false
+            foreach ($Line in $Text.TrimEnd("`n").Split("`n")) {
+                $Line = $Line.TrimEnd("`r") # spdlog uses CRLF on Windows
+                $Match = $RecordPattern.Match($Line)
+                if ($Match.Success) {
+                    if ($Matched) {
+                        Write-Output $Record
+                    }
+                    $Record = $Line
+                    $Matched = Test-Record $Match
+                }
+                elseif ($null -ne $Record) {
+                    $Record += "`n$Line"
+                }
+            }
+            if ($Matched) {
+                Write-Output $Record
+            }
+        }
+    }
+    finally {
+        $Stream.Dispose()
+    }
+    Write-Verbose "$($Archive.Name): $Decompressed of $($Blocks.Count) blocks read"
+}